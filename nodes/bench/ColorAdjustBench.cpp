@@ -0,0 +1,207 @@
+// The color section of node_bench: the CPU backend of the colour nodes
+// against its scalar reference, and what the baked lut of Color Adjust
+// costs in accuracy against the exact chain.
+#include "ColorAdjustBench.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+static inline float Clamp01(float v)
+{
+    return std::min(std::max(v, 0.f), 1.f);
+}
+
+template<typename T> struct SampleTraits;
+template<> struct SampleTraits<uint8_t>
+{
+    static float ToFloat(uint8_t v) { return v * (1.f / 255.f); }
+    static uint8_t FromFloat(float v) { return (uint8_t)(Clamp01(v) * 255.f + 0.5f); }
+};
+template<> struct SampleTraits<uint16_t>
+{
+    static float ToFloat(uint16_t v) { return v * (1.f / 65535.f); }
+    static uint16_t FromFloat(float v) { return (uint16_t)(Clamp01(v) * 65535.f + 0.5f); }
+};
+template<> struct SampleTraits<float>
+{
+    static float ToFloat(float v) { return v; }
+    static float FromFloat(float v) { return v; }
+};
+
+// tetrahedral interpolation of a lut laid out as ColorAdjustBakeLut writes it
+static void SampleLut(const float* lut, int size, const float in[3], float out[3])
+{
+    int i0[3], i1[3];
+    float f[3];
+    for (int c = 0; c < 3; c++)
+    {
+        float s = Clamp01(in[c]) * (size - 1);
+        i0[c] = std::min((int)s, size - 2);
+        i1[c] = i0[c] + 1;
+        f[c] = s - i0[c];
+    }
+    auto at = [&](int r, int g, int b, int k) { return lut[(((size_t)r * size + g) * size + b) * 4 + k]; };
+    const float fr = f[0], fg = f[1], fb = f[2];
+    const int r0 = i0[0], g0 = i0[1], b0 = i0[2], r1 = i1[0], g1 = i1[1], b1 = i1[2];
+    for (int k = 0; k < 3; k++)
+    {
+        const float c000 = at(r0, g0, b0, k), c111 = at(r1, g1, b1, k);
+        if (fr > fg)
+        {
+            if (fg > fb)        out[k] = (1 - fr) * c000 + (fr - fg) * at(r1, g0, b0, k) + (fg - fb) * at(r1, g1, b0, k) + fb * c111;
+            else if (fr > fb)   out[k] = (1 - fr) * c000 + (fr - fb) * at(r1, g0, b0, k) + (fb - fg) * at(r1, g0, b1, k) + fg * c111;
+            else                out[k] = (1 - fb) * c000 + (fb - fr) * at(r0, g0, b1, k) + (fr - fg) * at(r1, g0, b1, k) + fg * c111;
+        }
+        else
+        {
+            if (fb > fg)        out[k] = (1 - fb) * c000 + (fb - fg) * at(r0, g0, b1, k) + (fg - fr) * at(r0, g1, b1, k) + fr * c111;
+            else if (fb > fr)   out[k] = (1 - fg) * c000 + (fg - fb) * at(r0, g1, b0, k) + (fb - fr) * at(r0, g1, b1, k) + fr * c111;
+            else                out[k] = (1 - fg) * c000 + (fg - fr) * at(r0, g1, b0, k) + (fr - fb) * at(r1, g1, b0, k) + fb * c111;
+        }
+    }
+}
+
+int ColorAdjustLutMaxError(const ColorAdjustParams& params, int size)
+{
+    if (size < 2)
+        return -1;
+    std::vector<float> lut((size_t)size * size * size * 4);
+    ColorAdjustBakeLut(params, size, lut.data());
+    // one red level per task, every task keeps its own max
+    std::vector<int> errors(256, 0);
+    std::atomic<int> next {0};
+    auto worker = [&]()
+    {
+        for (int r = next++; r < 256; r = next++)
+        {
+            int error = 0;
+            for (int g = 0; g < 256; g++)
+                for (int b = 0; b < 256; b++)
+                {
+                    float ref[3] = { r / 255.f, g / 255.f, b / 255.f };
+                    float out[3];
+                    SampleLut(lut.data(), size, ref, out);
+                    ColorAdjustPixel(params, ref);
+                    for (int k = 0; k < 3; k++)
+                        error = std::max(error, std::abs((int)(Clamp01(out[k]) * 255.f + 0.5f) - (int)(ref[k] * 255.f + 0.5f)));
+                }
+            errors[r] = error;
+        }
+    };
+    std::vector<std::thread> workers;
+    const int threads = std::max(1, (int)std::thread::hardware_concurrency());
+    for (int i = 1; i < threads; i++)
+        workers.emplace_back(worker);
+    worker();
+    for (auto& t : workers)
+        t.join();
+    return *std::max_element(errors.begin(), errors.end());
+}
+
+template<typename T>
+static void FillFrame(ImGui::ImMat& mat)
+{
+    // gradient plus xorshift noise, the same values on every run
+    uint32_t seed = 0x9e3779b9u;
+    for (int y = 0; y < mat.h; y++)
+    {
+        T* row = (T*)mat.data + (size_t)y * mat.w * 4;
+        for (int x = 0; x < mat.w; x++)
+        {
+            seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+            float v[3] = { (float)x / std::max(mat.w - 1, 1), (float)y / std::max(mat.h - 1, 1), (seed & 0xffff) / 65535.f };
+            for (int k = 0; k < 3; k++)
+                row[x * 4 + k] = SampleTraits<T>::FromFloat(v[k]);
+            row[x * 4 + 3] = SampleTraits<T>::FromFloat(1.f);
+        }
+    }
+}
+
+template<typename T>
+static float MaxDiff(const ImGui::ImMat& a, const ImGui::ImMat& b)
+{
+    float diff = 0.f;
+    const size_t count = (size_t)a.w * a.h * a.c;
+    for (size_t i = 0; i < count; i++)
+        diff = std::max(diff, fabsf(SampleTraits<T>::ToFloat(((const T*)a.data)[i]) - SampleTraits<T>::ToFloat(((const T*)b.data)[i])));
+    return diff;
+}
+
+imgui_json::value ColorAdjustBenchmark(int width, int height, int frames)
+{
+    struct Stage { const char* name; ColorAdjustParams params; };
+    std::vector<Stage> stages(9);
+    stages[0].name = "brightness";  stages[0].params.brightness = 0.1f;
+    stages[1].name = "contrast";    stages[1].params.contrast = 1.2f;
+    stages[2].name = "gamma";       stages[2].params.gamma = 0.8f;
+    stages[3].name = "exposure";    stages[3].params.exposure = 0.5f;
+    stages[4].name = "saturation";  stages[4].params.saturation = 1.3f;
+    stages[5].name = "hue";         stages[5].params.hue = 30.f;
+    stages[6].name = "vibrance";    stages[6].params.vibrance = 0.5f;
+    stages[7].name = "whitebalance";stages[7].params.temperature = 6500.f;
+    stages[8].name = "all";
+    for (int i = 0; i < 8; i++)
+    {
+        const ColorAdjustParams& p = stages[i].params;
+        ColorAdjustParams& all = stages[8].params;
+        if (p.brightness != 0.f) all.brightness = p.brightness;
+        if (p.contrast != 1.f) all.contrast = p.contrast;
+        if (p.gamma != 1.f) all.gamma = p.gamma;
+        if (p.exposure != 0.f) all.exposure = p.exposure;
+        if (p.saturation != 1.f) all.saturation = p.saturation;
+        if (p.hue != 0.f) all.hue = p.hue;
+        if (p.vibrance != 0.f) all.vibrance = p.vibrance;
+        if (p.temperature != 5000.f) all.temperature = p.temperature;
+    }
+
+    frames = std::max(frames, 1);
+    // the reference is far slower, fewer frames keep the run short
+    const int refFrames = std::max(frames / 4, 1);
+    const double mpixels = (double)width * height / 1e6;
+    const ImDataType types[3] = { IM_DT_INT8, IM_DT_INT16, IM_DT_FLOAT32 };
+    const char* typeNames[3] = { "int8", "int16", "float32" };
+    imgui_json::value value;
+    value["width"] = imgui_json::number(width);
+    value["height"] = imgui_json::number(height);
+    value["threads"] = imgui_json::number(std::max(1, (int)std::thread::hardware_concurrency()));
+    for (int t = 0; t < 3; t++)
+    {
+        ImGui::ImMat src;
+        src.create_type(width, height, 4, types[t]);
+        if (types[t] == IM_DT_INT8) FillFrame<uint8_t>(src);
+        else if (types[t] == IM_DT_INT16) FillFrame<uint16_t>(src);
+        else FillFrame<float>(src);
+        imgui_json::value typeValue;
+        for (auto& stage : stages)
+        {
+            ImGui::ImMat simdOut, refOut;
+            simdOut.type = refOut.type = types[t];
+            double simdMs = 0, refMs = 0;
+            ColorAdjustMat(stage.params, src, simdOut);
+            for (int i = 0; i < frames; i++)
+                simdMs += ColorAdjustMat(stage.params, src, simdOut);
+            for (int i = 0; i < refFrames; i++)
+                refMs += ColorAdjustMatReference(stage.params, src, refOut);
+            imgui_json::value entry;
+            double simdRate = simdMs > 0 ? mpixels * frames * 1000.0 / simdMs : 0;
+            double refRate = refMs > 0 ? mpixels * refFrames * 1000.0 / refMs : 0;
+            entry["mpixel_per_s"] = imgui_json::number(simdRate);
+            entry["reference_mpixel_per_s"] = imgui_json::number(refRate);
+            entry["speedup"] = imgui_json::number(refRate > 0 ? simdRate / refRate : 0);
+            entry["max_diff"] = imgui_json::number(types[t] == IM_DT_INT8 ? MaxDiff<uint8_t>(simdOut, refOut) :
+                                                   types[t] == IM_DT_INT16 ? MaxDiff<uint16_t>(simdOut, refOut) :
+                                                   MaxDiff<float>(simdOut, refOut));
+            typeValue[stage.name] = entry;
+        }
+        value[typeNames[t]] = typeValue;
+    }
+    // what the vulkan path of Color Adjust costs in accuracy
+    imgui_json::value lutValue;
+    for (auto& stage : stages)
+        lutValue[stage.name] = imgui_json::number(ColorAdjustLutMaxError(stage.params, COLOR_ADJUST_LUT_SIZE));
+    value["lut"] = lutValue;
+    return value;
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <imgui_json.h>
+#include "ColorAdjust.h"
+
+// Largest difference, in 8 bit levels, between ColorAdjustPixel and the
+// size^3 lut of the chain sampled with tetrahedral interpolation, over all
+// 8 bit rgb inputs
+int ColorAdjustLutMaxError(const ColorAdjustParams& params, int size);
+
+// Mpixel/s of ColorAdjustMat and ColorAdjustMatReference for each stage on
+// its own and for all of them, per data type, plus the largest difference
+// between the two outputs and the lut error of each stage
+imgui_json::value ColorAdjustBenchmark(int width = 1920, int height = 1080, int frames = 8);
@@ -0,0 +1,220 @@
+// node_bench sections of the media nodes, built with FFmpeg only.
+// The player section opens --clip on PLAYER_BENCH_PLAYERS MediaPlayers with
+// video only. It reports the process CPU while they sit paused, the CPU
+// while they all play and the intervals at which each one hands out a new
+// frame through GetVideo, the way the Media Source node polls it.
+// The thumbnail section times ThumbnailExtractor on THUMBNAIL_BENCH_COUNT
+// thumbnails spread over --clip, with every core and with one worker, both
+// without the disk cache, and reopening the clip from its disk cache.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+#include "MediaPlayer.h"
+#include "ThumbnailExtractor.h"
+#include "NodeBench.h"
+
+#define PLAYER_BENCH_PLAYERS    16
+#define PLAYER_BENCH_IDLE_MS    2000
+#define PLAYER_BENCH_PLAY_MS    5000
+#define THUMBNAIL_BENCH_COUNT   100
+#define THUMBNAIL_BENCH_WIDTH   160
+#define THUMBNAIL_BENCH_TIMEOUT 120000
+
+static int64_t GetTimeUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// user plus system time of the whole process, every player thread included
+static int64_t CpuTimeUs()
+{
+#if defined(_WIN32)
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+        return 0;
+    auto to_us = [](const FILETIME& t) { return (int64_t)(((uint64_t)t.dwHighDateTime << 32) | t.dwLowDateTime) / 10; };
+    return to_us(kernel) + to_us(user);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return (int64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#endif
+}
+
+static double Percentile(std::vector<double> samples, double p)
+{
+    if (samples.empty())
+        return -1;
+    std::sort(samples.begin(), samples.end());
+    size_t index = (size_t)std::llround(p / 100.0 * (samples.size() - 1));
+    return samples[std::min(index, samples.size() - 1)];
+}
+
+// CPU time of the process over a wall time, in % of one core
+static double CpuPercent(int64_t cpu_us, int64_t wall_us)
+{
+    return wall_us > 0 ? cpu_us * 100.0 / wall_us : 0;
+}
+
+void RunPlayer(const BenchOptions& options, BenchReports& reports)
+{
+    if (options.clip.empty())
+    {
+        fprintf(stderr, "player: no --clip given, skipped\n");
+        return;
+    }
+    std::vector<MediaPlayer*> players;
+    auto release = [&]()
+    {
+        for (auto& player : players)
+        {
+            player->Close();
+            ReleaseMediaPlayer(&player);
+        }
+        players.clear();
+    };
+    for (int i = 0; i < PLAYER_BENCH_PLAYERS; i++)
+    {
+        MediaPlayer* player = CreateMediaPlayer();
+        player->SetPlayMode(MP_DECODE_VIDEO);
+        players.push_back(player);
+        if (!player->Open(options.clip) || !player->HasVideo())
+        {
+            fprintf(stderr, "player: can't open %s: %s, skipped\n", options.clip.c_str(), player->GetError().c_str());
+            release();
+            return;
+        }
+    }
+
+    // opened and paused, the threads only wait for work
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    int64_t cpu0 = CpuTimeUs(), wall0 = GetTimeUs();
+    std::this_thread::sleep_for(std::chrono::milliseconds(PLAYER_BENCH_IDLE_MS));
+    const double idle_cpu = CpuPercent(CpuTimeUs() - cpu0, GetTimeUs() - wall0);
+
+    // a new frame is seen within the 1 ms poll, that bounds the resolution
+    std::vector<double> intervals;
+    std::vector<double> last_pts(players.size(), -1);
+    std::vector<int64_t> last_us(players.size(), -1);
+    for (auto player : players)
+        player->Play();
+    cpu0 = CpuTimeUs(); wall0 = GetTimeUs();
+    while (GetTimeUs() - wall0 < PLAYER_BENCH_PLAY_MS * 1000)
+    {
+        bool playing = false;
+        for (size_t i = 0; i < players.size(); i++)
+        {
+            ImGui::ImMat frame;
+            players[i]->GetVideo(frame);
+            playing |= !players[i]->IsEof();
+            if (frame.empty() || frame.time_stamp == last_pts[i])
+                continue;
+            int64_t now = GetTimeUs();
+            if (last_us[i] >= 0)
+                intervals.push_back((now - last_us[i]) / 1000.0);
+            last_pts[i] = frame.time_stamp;
+            last_us[i] = now;
+        }
+        if (!playing)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    const double play_cpu = CpuPercent(CpuTimeUs() - cpu0, GetTimeUs() - wall0);
+    release();
+    if (intervals.empty())
+    {
+        fprintf(stderr, "player: no frames delivered from %s\n", options.clip.c_str());
+        return;
+    }
+
+    double mean = 0, var = 0;
+    for (auto interval : intervals) mean += interval;
+    mean /= intervals.size();
+    for (auto interval : intervals) var += (interval - mean) * (interval - mean);
+    const double p50 = Percentile(intervals, 50);
+    imgui_json::value report;
+    report["name"] = std::string("player_") + std::to_string(PLAYER_BENCH_PLAYERS);
+    report["device"] = std::string("cpu");
+    report["players"] = imgui_json::number(PLAYER_BENCH_PLAYERS);
+    report["frames"] = imgui_json::number((double)intervals.size());
+    report["idle_cpu_pct"] = imgui_json::number(idle_cpu);
+    report["play_cpu_pct"] = imgui_json::number(play_cpu);
+    report["interval_p50_ms"] = imgui_json::number(p50);
+    report["interval_stddev_ms"] = imgui_json::number(std::sqrt(var / intervals.size()));
+    // how late the late frames come, the bound a viewer notices
+    report["jitter_p99_ms"] = imgui_json::number(Percentile(intervals, 99) - p50);
+    reports.push_back(report);
+}
+
+// Time from Open to every requested thumbnail done, -1 when the extractor
+// failed or timed out. got is the number of thumbnails that came out.
+static int64_t ThumbnailRunMs(const std::string& clip, uint32_t workers, bool disk_cache, int& got)
+{
+    ThumbnailExtractor extractor;
+    got = 0;
+    int64_t t0 = GetTimeUs();
+    if (!extractor.Open(clip, THUMBNAIL_BENCH_WIDTH, 0, workers, disk_cache))
+    {
+        fprintf(stderr, "thumbnail: %s\n", extractor.GetError().c_str());
+        return -1;
+    }
+    auto timestamps = extractor.RequestEvenly(THUMBNAIL_BENCH_COUNT);
+    while (!extractor.IsDone() && GetTimeUs() - t0 < THUMBNAIL_BENCH_TIMEOUT * 1000ll)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    int64_t ms = (GetTimeUs() - t0) / 1000;
+    if (extractor.IsFailed() || !extractor.IsDone())
+    {
+        fprintf(stderr, "thumbnail: %s\n", extractor.IsFailed() ? extractor.GetError().c_str() : "timed out");
+        return -1;
+    }
+    ImGui::ImMat thumbnail;
+    for (auto timestamp : timestamps)
+        got += extractor.Get(timestamp, thumbnail) ? 1 : 0;
+    return ms;
+}
+
+void RunThumbnail(const BenchOptions& options, BenchReports& reports)
+{
+    if (options.clip.empty())
+    {
+        fprintf(stderr, "thumbnail: no --clip given, skipped\n");
+        return;
+    }
+    ThumbnailExtractor probe;
+    if (!probe.Open(options.clip, THUMBNAIL_BENCH_WIDTH, 0, 1, false))
+    {
+        fprintf(stderr, "thumbnail: %s, skipped\n", probe.GetError().c_str());
+        return;
+    }
+    const int64_t duration = probe.GetDuration();
+    probe.Close();
+
+    int got = 0, got_single = 0, got_cached = 0;
+    const int64_t extract_ms = ThumbnailRunMs(options.clip, 0, false, got);
+    const int64_t single_ms = ThumbnailRunMs(options.clip, 1, false, got_single);
+    // the first run fills the disk cache, the second only reads it
+    ThumbnailRunMs(options.clip, 0, true, got_cached);
+    const int64_t cached_ms = ThumbnailRunMs(options.clip, 0, true, got_cached);
+    if (extract_ms < 0)
+        return;
+
+    imgui_json::value report;
+    report["name"] = std::string("thumbnail_") + std::to_string(THUMBNAIL_BENCH_COUNT);
+    report["device"] = std::string("cpu");
+    report["clip_duration_s"] = imgui_json::number(duration / 1000.0);
+    report["requested"] = imgui_json::number(THUMBNAIL_BENCH_COUNT);
+    report["missing"] = imgui_json::number(THUMBNAIL_BENCH_COUNT - got);
+    report["extract_ms"] = imgui_json::number((double)extract_ms);
+    report["extract_1worker_ms"] = imgui_json::number((double)single_ms);
+    report["cached_ms"] = imgui_json::number((double)cached_ms);
+    reports.push_back(report);
+}
@@ -0,0 +1,1000 @@
+// Out-of-graph benchmark of the node processing code. Every section runs the
+// same functions the nodes call in Execute on fixed inputs, in its own
+// process, so nothing here shows up in the latency the nodes report.
+// The AI section also runs each network tiled and untiled and reports the
+// largest difference, that is the seam error of the tiler for the network,
+// and the output error temporal reuse lets through at its default threshold.
+// The int8 section compares the INT8 packages with their fp32 network.
+// The rgba2yuv section checks the encoder's RGBA to YUV conversion against
+// swscale on 16 bit input, it is only built when FFmpeg is found.
+// The player section plays --clip on 16 MediaPlayers at once and reports the
+// CPU they use paused and playing and the jitter of the frame intervals, it
+// is only built with FFmpeg as well. So is the thumbnail section, it times the
+// filmstrip of 100 thumbnails over --clip, for a 2 hour clip that should take
+// a few seconds.
+// The color section times the CPU backend of the colour nodes and reports the
+// error of the lut Color Adjust runs on vulkan.
+// The blur section times the recursive gaussian of the Gaussian Blur node on
+// both its paths and reports its error against the FIR blur for each sigma.
+// The audio section times AudioSampleCopy against the per-sample loops of the
+// Media Source Sample and encoder nodes it replaced, for 2, 6 and 8 channels.
+// The hqdn3d section times the CPU engine of the HQDN3D node on all threads
+// and on one against ffmpeg's loops and, with FFmpeg, libavfilter's hqdn3d,
+// at 8, 10 and 16 bit, and reports how far its output is from them.
+// Each report is written to <out>/<name>.json and compared with the baseline:
+// a p50 slower than the baseline by more than latency_tolerance, or an output
+// checksum that changed on the same device, or a lut, blur, audio or hqdn3d
+// error above the baseline, is a regression. So is a report the baseline has
+// no entry for and a run without reports, record them with --update-baseline
+// on the reference machine first.
+//
+// usage: node_bench [--plugins <dir>] [--out <dir>] [--baseline <json>]
+//                   [--section <name>] [--clip <file>] [--update-baseline]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <imgui_json.h>
+#include <realsr.h>
+#include "AIBenchmark.h"
+#include "AudioSampleCopy.h"
+#include "ColorAdjustBench.h"
+#include "HQDN3DCpu.h"
+#include "RecursiveGaussian.h"
+#include "RealSRCache.h"
+#include "RealSRProcess.h"
+#include "RealSRTiler.h"
+#include "NodeBench.h"
+#if NODE_BENCH_WITH_FFMPEG
+#include "../media/MediaEncoder/ffmedia/rgba2yuv.h"
+#endif
+
+// p50 slowdown accepted when the baseline has no latency_tolerance
+#define NODE_BENCH_TOLERANCE    0.15
+// PSNR drop of an INT8 package, or of the RGBA to YUV conversion against
+// swscale, accepted against the baseline, in dB
+#define NODE_BENCH_PSNR_TOLERANCE   0.1
+// Samples per channel of an audio frame, and how the copies are timed
+#define AUDIO_BENCH_SAMPLES     1024
+#define AUDIO_BENCH_LOOPS       2000
+#define AUDIO_BENCH_RUNS        9
+
+struct BenchSection
+{
+    const char* name;
+    std::function<void (const BenchOptions& options, BenchReports& reports)> run;
+};
+
+static int64_t GetTimeMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::string DirPath(std::string path)
+{
+    if (!path.empty() && path.back() != '/' && path.back() != '\\')
+        path += "/";
+    return path;
+}
+
+// The AI nodes: the model package each one loads and the settings its
+// ProcessMat runs with by default
+struct AIBenchModel
+{
+    const char* name;
+    const char* folder;     // where the node's CMakeLists puts the package
+    const char* model;
+    bool int8;              // has a Speed (INT8) package, Quality runs fp32 on CPU
+};
+
+static const AIBenchModel ai_models[] =
+{
+    { "AnimeFaster",                "upscale/",                 "AnimeFaster",                      false },
+    { "AnimeGeneral",               "upscale/AnimeGeneral/",    "AnimeGeneral",                     false },
+    { "AnimeSlower",                "upscale/AnimeSlower/",     "AnimeSlower",                      false },
+    { "General",                    "upscale/General/",         "General",                          false },
+    { "RefineSlower",               "upscale/RefineSlower/",    "RefineSlower",                     false },
+    { "SimpleFast",                 "upscale/",                 "ClearReality_x4",                  false },
+    { "SimpleFaster",               "upscale/",                 "NomosUni_compact_otf_medium_x2",   false },
+    { "AIDenoise",                  "enhance/AIDenoise/",       "AIDenoise",                        true },
+    { "AIDenoiseISO",               "enhance/AIDenoiseISO/",    "AIDenoiseISO",                     true },
+    { "AIReFocus",                  "enhance/AIReFocus/",       "AIReFocus",                        true },
+    { "OverExposureCorrection",     "enhance/",                 "OverExposureCorrection",           false },
+    { "UnderExposureCorrection",    "enhance/",                 "UnderExposureCorrection",          false },
+};
+
+// Largest difference, in 8 bit levels, between two mats of the same layout
+static double MaxDiff(const ImGui::ImMat& a, const ImGui::ImMat& b)
+{
+    if (a.empty() || b.empty() || a.w != b.w || a.h != b.h || a.c != b.c || a.type != b.type || a.elempack != b.elempack)
+        return -1;
+    const bool planar = a.elempack == 1 && a.c > 1;
+    const size_t plane = (size_t)a.w * a.h * (planar ? 1 : a.c);
+    double max_diff = 0;
+    for (int c = 0; c < (planar ? a.c : 1); c++)
+    {
+        const uint8_t* pa = (const uint8_t*)a.data + (planar ? c * a.cstep * a.elemsize : 0);
+        const uint8_t* pb = (const uint8_t*)b.data + (planar ? c * b.cstep * b.elemsize : 0);
+        for (size_t i = 0; i < plane; i++)
+        {
+            double diff;
+            switch (a.type)
+            {
+                case IM_DT_INT8:    diff = std::abs((int)pa[i] - (int)pb[i]); break;
+                case IM_DT_INT16:   diff = std::abs((int)((const uint16_t*)pa)[i] - (int)((const uint16_t*)pb)[i]) / 256.0; break;
+                case IM_DT_FLOAT32: diff = std::fabs(((const float*)pa)[i] - ((const float*)pb)[i]) * 255.0; break;
+                default:            return -1;
+            }
+            max_diff = std::max(max_diff, diff);
+        }
+    }
+    return max_diff;
+}
+
+// What tiling at the default tile size costs in accuracy: the 1080p frame run
+// whole and tiled, -1 if the outputs can't be compared
+static double TileMaxDiff(RealSR* realsr)
+{
+    ImGui::ImMat in = AIBenchmark::SyntheticFrame(1920, 1080, 0);
+    ImGui::ImMat whole, tiled;
+    RealSRSettings settings;
+    float progress = 0;
+    RealSRProcessMat(realsr, settings, nullptr, in, whole, progress);
+    settings.tiled = true;
+    RealSRProcessMat(realsr, settings, nullptr, in, tiled, progress);
+    return MaxDiff(whole, tiled);
+}
+
+// What temporal reuse costs in accuracy: the second frame changes a spot in
+// the middle and drifts every other sample by up to the default threshold.
+// The tiles that see the spot within the receptive radius run again, the rest
+// reuse the first frame. The difference to running the second frame tiled is
+// the error the reuse lets through, 0 when the threshold is.
+static double TemporalMaxDiff(RealSR* realsr)
+{
+    ImGui::ImMat first = AIBenchmark::SyntheticFrame(960, 540, 0);
+    ImGui::ImMat second = first.clone();
+    uint8_t* data = (uint8_t*)second.data;
+    const size_t samples = (size_t)second.w * second.h * second.c;
+    for (size_t i = 0; i < samples; i++)
+    {
+        // alternate +threshold and -threshold, clamped
+        int value = data[i] + ((i / 4 + i / second.w) % 2 ? REALSR_TEMPORAL_THRESHOLD_DEFAULT : -REALSR_TEMPORAL_THRESHOLD_DEFAULT);
+        data[i] = (uint8_t)std::max(0, std::min(value, 255));
+    }
+    for (int y = second.h / 2 - 8; y < second.h / 2 + 8; y++)
+        for (int x = second.w / 2 - 8; x < second.w / 2 + 8; x++)
+            for (int c = 0; c < 3; c++)
+                data[((size_t)y * second.w + x) * second.c + c] ^= 0x80;
+    RealSRTemporal temporal;
+    RealSRSettings settings;
+    settings.temporal = true;
+    ImGui::ImMat reused, full;
+    float progress = 0;
+    RealSRProcessMat(realsr, settings, &temporal, first, reused, progress);
+    RealSRProcessMat(realsr, settings, &temporal, second, reused, progress);
+    if (temporal.TilesSkipped() == 0)
+        return -1;
+    // temporal runs the tiles of the grid, compare with the frame tiled the same way
+    settings.temporal = false;
+    settings.tiled = true;
+    RealSRProcessMat(realsr, settings, nullptr, second, full, progress);
+    return MaxDiff(reused, full);
+}
+
+static void RunAI(const BenchOptions& options, BenchReports& reports)
+{
+    int device = ncnn::get_default_gpu_index();
+    for (auto& entry : ai_models)
+    {
+        std::string path = DirPath(options.plugins) + entry.folder;
+        int64_t t1 = GetTimeMs();
+        bool fp16 = !entry.int8 || device >= 0;
+        RealSRHolder realsr = RealSRCache::Load(path, entry.model, device, fp16, true /*packing*/, device < 0 ? RealSRTiler::DefaultThreads() : 1);
+        int64_t t2 = GetTimeMs();
+        if (!realsr)
+        {
+            fprintf(stderr, "%s: can't load %s%s.model, skipped\n", entry.name, path.c_str(), entry.model);
+            continue;
+        }
+        // the nodes run the frame whole unless tiling is switched on
+        RealSRSettings settings;
+        AIBenchmark bench(entry.name);
+        bench.SetWarmupMs(t2 - t1);
+        bench.Run([&](const ImGui::ImMat& in, ImGui::ImMat& out)
+        {
+            float progress = 0;
+            return RealSRProcessMat(realsr.get(), settings, nullptr, in, out, progress);
+        });
+        auto report = bench.ToJson();
+        report["device"] = std::string(device < 0 ? "cpu" : "gpu");
+        report["receptive_radius"] = imgui_json::number(RealSRCache::ReceptiveRadius(realsr.get()));
+        report["tile_overlap"] = imgui_json::number(RealSRTiler::Overlap(realsr.get(), REALSR_TILE_SIZE_DEFAULT));
+        report["tile_max_diff"] = imgui_json::number(TileMaxDiff(realsr.get()));
+        report["temporal_max_diff"] = imgui_json::number(TemporalMaxDiff(realsr.get()));
+        reports.push_back(report);
+    }
+}
+
+// Sample c of pixel (x, y) in 8 bit levels, interleaved or planar as RealSRTiler::CopyRect
+static double Sample(const ImGui::ImMat& mat, int x, int y, int c)
+{
+    const bool planar = mat.elempack == 1 && mat.c > 1;
+    size_t index = planar ? (size_t)c * mat.cstep + (size_t)y * mat.w + x : ((size_t)y * mat.w + x) * mat.c + c;
+    switch (mat.type)
+    {
+        case IM_DT_INT8:    return ((const uint8_t*)mat.data)[index];
+        case IM_DT_INT16:   return ((const uint16_t*)mat.data)[index] / 256.0;
+        case IM_DT_FLOAT32: return ((const float*)mat.data)[index] * 255.0;
+        default:            return 0;
+    }
+}
+
+// PSNR in dB over the colour channels, alpha left out
+static double PSNR(const ImGui::ImMat& a, const ImGui::ImMat& b)
+{
+    const int channels = std::min(a.c, 3);
+    double sum = 0;
+    for (int y = 0; y < a.h; y++)
+        for (int x = 0; x < a.w; x++)
+            for (int c = 0; c < channels; c++)
+            {
+                double diff = Sample(a, x, y, c) - Sample(b, x, y, c);
+                sum += diff * diff;
+            }
+    double mse = sum / ((double)a.w * a.h * channels);
+    return mse > 0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+// Mean SSIM over 8x8 blocks of each colour channel
+static double SSIM(const ImGui::ImMat& a, const ImGui::ImMat& b)
+{
+    const double c1 = (0.01 * 255) * (0.01 * 255);
+    const double c2 = (0.03 * 255) * (0.03 * 255);
+    const int channels = std::min(a.c, 3);
+    double total = 0;
+    int blocks = 0;
+    for (int c = 0; c < channels; c++)
+        for (int by = 0; by + 8 <= a.h; by += 8)
+            for (int bx = 0; bx + 8 <= a.w; bx += 8)
+            {
+                double sa = 0, sb = 0, saa = 0, sbb = 0, sab = 0;
+                for (int y = by; y < by + 8; y++)
+                    for (int x = bx; x < bx + 8; x++)
+                    {
+                        double va = Sample(a, x, y, c), vb = Sample(b, x, y, c);
+                        sa += va; sb += vb; saa += va * va; sbb += vb * vb; sab += va * vb;
+                    }
+                const double n = 64;
+                double ma = sa / n, mb = sb / n;
+                double va = saa / n - ma * ma, vb = sbb / n - mb * mb, cov = sab / n - ma * mb;
+                total += ((2 * ma * mb + c1) * (2 * cov + c2)) / ((ma * ma + mb * mb + c1) * (va + vb + c2));
+                blocks++;
+            }
+    return blocks ? total / blocks : 0;
+}
+
+// The INT8 packages against the fp32 network they were quantized from, on
+// CPU where the nodes use them: PSNR, SSIM and p50 of both over the 540p
+// frames. Models without a <model>_int8.model next to them are skipped.
+static void RunInt8(const BenchOptions& options, BenchReports& reports)
+{
+    const int threads = RealSRTiler::DefaultThreads();
+    for (auto& entry : ai_models)
+    {
+        if (!entry.int8)
+            continue;
+        std::string path = DirPath(options.plugins) + entry.folder;
+        RealSRHolder fp32 = RealSRCache::Load(path, entry.model, -1, false /*fp16*/, true /*packing*/, threads);
+        RealSRHolder int8 = RealSRCache::Load(path, std::string(entry.model) + "_int8", -1, false /*fp16*/, true /*packing*/, threads);
+        if (!fp32 || !int8)
+        {
+            fprintf(stderr, "%s: no fp32 or int8 package in %s, skipped\n", entry.name, path.c_str());
+            continue;
+        }
+        AIBenchmark fp32_bench(std::string(entry.name) + "_fp32"), int8_bench(std::string(entry.name) + "_int8");
+        double psnr_min = 99, ssim_min = 1;
+        for (int i = 0; i <= AI_BENCHMARK_FRAMES; i++)
+        {
+            ImGui::ImMat in = AIBenchmark::SyntheticFrame(960, 540, i);
+            ImGui::ImMat fp32_out, int8_out;
+            float progress = 0;
+            int64_t fp32_ms = RealSRProcessMat(fp32.get(), RealSRSettings(), nullptr, in, fp32_out, progress);
+            int64_t int8_ms = RealSRProcessMat(int8.get(), RealSRSettings(), nullptr, in, int8_out, progress);
+            if (fp32_out.empty() || int8_out.empty() || fp32_out.w != int8_out.w || fp32_out.h != int8_out.h || fp32_out.c != int8_out.c)
+                break;
+            // the first frame warms both up
+            if (i == 0)
+                continue;
+            fp32_bench.AddFrame(in.w, in.h, fp32_ms);
+            int8_bench.AddFrame(in.w, in.h, int8_ms);
+            psnr_min = std::min(psnr_min, PSNR(fp32_out, int8_out));
+            ssim_min = std::min(ssim_min, SSIM(fp32_out, int8_out));
+        }
+        imgui_json::value report;
+        report["name"] = std::string(entry.name) + "_int8";
+        report["device"] = std::string("cpu");
+        report["psnr_db"] = imgui_json::number(psnr_min);
+        report["ssim"] = imgui_json::number(ssim_min);
+        report["fp32_p50_ms"] = imgui_json::number(fp32_bench.Percentile(50));
+        report["int8_p50_ms"] = imgui_json::number(int8_bench.Percentile(50));
+        reports.push_back(report);
+    }
+}
+
+#if NODE_BENCH_WITH_FFMPEG
+// One of the frame formats the encoder node converts CPU input into
+struct YUVBenchFormat
+{
+    const char* name;
+    AVPixelFormat format;
+    int bits;
+    int shift;          // msb aligned samples
+    bool semi_planar;
+};
+
+static const YUVBenchFormat yuv_formats[] =
+{
+    { "yuv420p",        AV_PIX_FMT_YUV420P,     8,  0, false },
+    { "nv12",           AV_PIX_FMT_NV12,        8,  0, true },
+    { "yuv420p10le",    AV_PIX_FMT_YUV420P10LE, 10, 0, false },
+    { "p010le",         AV_PIX_FMT_P010LE,      10, 6, true },
+};
+
+static AVFrame* AllocFrame(AVPixelFormat format, int width, int height)
+{
+    AVFrame* frame = av_frame_alloc();
+    frame->format = format;
+    frame->width = width;
+    frame->height = height;
+    if (av_frame_get_buffer(frame, 0) < 0)
+        av_frame_free(&frame);
+    return frame;
+}
+
+// Interleaved RGBA of 16 bit with detail below the top 8 bits, so a path
+// that drops to 8 bit on the way shows up in the 10 bit formats
+static ImGui::ImMat SyntheticFrame16(int width, int height, int index)
+{
+    ImGui::ImMat frame8 = AIBenchmark::SyntheticFrame(width, height, index);
+    ImGui::ImMat frame16(width, height, 4, 2u, 4);
+    frame16.type = IM_DT_INT16;
+    frame16.depth = 16;
+    const uint8_t* src = (const uint8_t*)frame8.data;
+    uint16_t* dst = (uint16_t*)frame16.data;
+    uint32_t seed = 0x2545f491u ^ (uint32_t)index;
+    for (size_t i = 0; i < (size_t)width * height * 4; i++)
+    {
+        seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+        dst[i] = (uint16_t)((src[i] << 8) | (i % 4 == 3 ? 0xff : seed & 0xff));
+    }
+    return frame16;
+}
+
+// Largest difference, in output levels, between the planes of two frames of
+// format, and the sum of squared differences in 8 bit levels
+static void FrameDiff(const AVFrame* a, const AVFrame* b, const YUVBenchFormat& format, double& y_max, double& uv_max, double& sse, size_t& samples)
+{
+    const double to8 = 1.0 / (1 << (format.bits - 8));
+    y_max = uv_max = sse = 0;
+    samples = 0;
+    for (int plane = 0; plane < (format.semi_planar ? 2 : 3); plane++)
+    {
+        const int width = plane == 0 || format.semi_planar ? a->width : a->width / 2;
+        const int height = plane == 0 ? a->height : a->height / 2;
+        for (int y = 0; y < height; y++)
+        {
+            const uint8_t* row_a = a->data[plane] + (size_t)y * a->linesize[plane];
+            const uint8_t* row_b = b->data[plane] + (size_t)y * b->linesize[plane];
+            for (int x = 0; x < width; x++)
+            {
+                int va = format.bits > 8 ? ((const uint16_t*)row_a)[x] >> format.shift : row_a[x];
+                int vb = format.bits > 8 ? ((const uint16_t*)row_b)[x] >> format.shift : row_b[x];
+                double diff = std::abs(va - vb);
+                double& max_diff = plane == 0 ? y_max : uv_max;
+                max_diff = std::max(max_diff, diff);
+                sse += diff * to8 * diff * to8;
+                samples++;
+            }
+        }
+    }
+}
+
+// The encoder's rgba_to_yuv420 against swscale with accurate rounding, both
+// BT.709 full range RGBA64 in and limited range out, on 1080p frames. Luma is
+// the same matrix and should stay within 1 level, chroma differs by the
+// siting and filter swscale downsamples with, PSNR covers both.
+static void RunRGBA2YUV(const BenchOptions& options, BenchReports& reports)
+{
+    const int width = 1920, height = 1080;
+    for (auto& format : yuv_formats)
+    {
+        AVFrame* ours = AllocFrame(format.format, width, height);
+        AVFrame* ref = AllocFrame(format.format, width, height);
+        SwsContext* sws = sws_getContext(width, height, AV_PIX_FMT_RGBA64LE, width, height, format.format,
+                                         SWS_BICUBIC | SWS_ACCURATE_RND, NULL, NULL, NULL);
+        if (!ours || !ref || !sws)
+        {
+            fprintf(stderr, "rgba2yuv %s: can't allocate frames or swscale, skipped\n", format.name);
+            av_frame_free(&ours);
+            av_frame_free(&ref);
+            sws_freeContext(sws);
+            continue;
+        }
+        sws_setColorspaceDetails(sws, sws_getCoefficients(SWS_CS_ITU709), 1, sws_getCoefficients(SWS_CS_ITU709), 0, 0, 1 << 16, 1 << 16);
+        AIBenchmark bench(std::string("rgba2yuv_") + format.name), sws_bench("swscale");
+        double y_max = 0, uv_max = 0, sse = 0;
+        size_t samples = 0;
+        for (int i = 0; i <= AI_BENCHMARK_FRAMES; i++)
+        {
+            ImGui::ImMat in = SyntheticFrame16(width, height, i);
+            RGBAImage image;
+            image.data = in.data;
+            image.linesize = width * 4 * 2;
+            image.width = width;
+            image.height = height;
+            image.sample = RGBA_SAMPLE::UINT16;
+            image.depth = 16;
+            int64_t t1 = GetTimeMs();
+            rgba_to_yuv420(image, ours, AVCOL_SPC_BT709, AVCOL_RANGE_MPEG);
+            int64_t t2 = GetTimeMs();
+            const uint8_t* src_data[4] = { (const uint8_t*)in.data };
+            int src_linesize[4] = { image.linesize };
+            sws_scale(sws, src_data, src_linesize, 0, height, ref->data, ref->linesize);
+            int64_t t3 = GetTimeMs();
+            // the first frame warms both up
+            if (i == 0)
+                continue;
+            bench.AddFrame(width, height, t2 - t1);
+            sws_bench.AddFrame(width, height, t3 - t2);
+            double frame_y, frame_uv, frame_sse;
+            size_t frame_samples;
+            FrameDiff(ours, ref, format, frame_y, frame_uv, frame_sse, frame_samples);
+            y_max = std::max(y_max, frame_y);
+            uv_max = std::max(uv_max, frame_uv);
+            sse += frame_sse;
+            samples += frame_samples;
+        }
+        double mse = samples ? sse / samples : 0;
+        auto report = bench.ToJson();
+        report["device"] = std::string("cpu");
+        report["psnr_db"] = imgui_json::number(mse > 0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0);
+        report["y_max_diff"] = imgui_json::number(y_max);
+        report["uv_max_diff"] = imgui_json::number(uv_max);
+        report["swscale_p50_ms"] = imgui_json::number(sws_bench.Percentile(50));
+        reports.push_back(report);
+        av_frame_free(&ours);
+        av_frame_free(&ref);
+        sws_freeContext(sws);
+    }
+}
+#endif
+
+// The CPU backend the colour nodes fall back to without a vulkan device, the
+// full grade through AIBenchmark::Run, with the SIMD and scalar throughput of
+// every stage per data type and the largest error, in 8 bit levels, of the
+// lut Color Adjust runs on vulkan against the exact chain.
+static void RunColor(const BenchOptions& options, BenchReports& reports)
+{
+    ColorAdjustParams grade;
+    grade.brightness = 0.1f;
+    grade.contrast = 1.2f;
+    grade.gamma = 0.8f;
+    grade.exposure = 0.5f;
+    grade.saturation = 1.3f;
+    grade.hue = 30.f;
+    grade.vibrance = 0.5f;
+    grade.temperature = 6500.f;
+    AIBenchmark bench("color_adjust");
+    bench.Run([&](const ImGui::ImMat& in, ImGui::ImMat& out) -> int64_t
+    {
+        out.type = in.type;
+        return std::llround(ColorAdjustMat(grade, in, out));
+    });
+    auto stages = ColorAdjustBenchmark();
+    auto report = bench.ToJson();
+    report["device"] = std::string("cpu");
+    report["lut_max_diff"] = imgui_json::number(ColorAdjustLutMaxError(grade, COLOR_ADJUST_LUT_SIZE));
+    report["lut"] = stages["lut"];
+    report["int8"] = stages["int8"];
+    report["int16"] = stages["int16"];
+    report["float32"] = stages["float32"];
+    reports.push_back(report);
+}
+
+// The recursive gaussian the Gaussian Blur node runs on cpu, through
+// AIBenchmark::Run at a sigma on each of its paths, and its max and RMS
+// error in 8 bit levels against the FIR blur per sigma. blur_max_diff is the
+// worst of those.
+static void RunBlur(const BenchOptions& options, BenchReports& reports)
+{
+    struct BlurCase { const char* name; float sigma; };
+    const BlurCase cases[] =
+    {
+        { "recursive_gaussian_fir", 2.f },
+        { "recursive_gaussian", 10.f },
+    };
+    auto accuracy = RecursiveGaussianAccuracy();
+    double max_diff = 0;
+    for (auto& it : accuracy.get<imgui_json::object>())
+    {
+        if (it.second.is_object() && it.second.contains("max_diff"))
+            max_diff = std::max(max_diff, it.second["max_diff"].get<imgui_json::number>());
+    }
+    for (auto& entry : cases)
+    {
+        RecursiveGaussian blur;
+        blur.SetSigma(entry.sigma);
+        AIBenchmark bench(entry.name);
+        bench.Run([&](const ImGui::ImMat& in, ImGui::ImMat& out) -> int64_t
+        {
+            out.type = in.type;
+            return std::llround(blur.filter(in, out));
+        });
+        auto report = bench.ToJson();
+        report["device"] = std::string("cpu");
+        report["sigma"] = imgui_json::number(entry.sigma);
+        report["blur_max_diff"] = imgui_json::number(max_diff);
+        report["accuracy"] = accuracy;
+        reports.push_back(report);
+    }
+}
+
+// The per-sample copies AudioSampleCopy replaced: the Media Source Sample
+// node's at<T>() loop with the type branch inside, and the encoder's int16
+// to float one
+static void ReferenceSourceCopy(const void* const* src, ImDataType type, int channels, int samples, ImGui::ImMat& mat)
+{
+    mat.create_type(samples, 1, channels, type);
+    for (int i = 0; i < channels; i++)
+    {
+        for (int x = 0; x < samples; x++)
+        {
+            if (type == IM_DT_FLOAT32)
+                mat.at<float>(x, 0, i) = ((const float *)src[i])[x];
+            else if (type == IM_DT_INT32)
+                mat.at<int32_t>(x, 0, i) = ((const int32_t *)src[i])[x];
+            else if (type == IM_DT_INT16)
+                mat.at<int16_t>(x, 0, i) = ((const int16_t *)src[i])[x];
+            else
+                mat.at<int8_t>(x, 0, i) = ((const int8_t *)src[i])[x];
+        }
+    }
+}
+
+static void ReferenceEncoderCopy(ImGui::ImMat& mat, float* const* dst, int channels)
+{
+    for (int c = 0; c < channels; c++)
+    {
+        float* out = dst[c];
+        for (int i = 0; i < mat.w; i++)
+            *out++ = mat.at<int16_t>(i, 0, c) / 32768.f;
+    }
+}
+
+// Median over AUDIO_BENCH_RUNS of the mean time of AUDIO_BENCH_LOOPS calls, in us
+static double AudioTimeUs(const std::function<void ()>& job)
+{
+    std::vector<double> runs;
+    for (int r = 0; r < AUDIO_BENCH_RUNS; r++)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < AUDIO_BENCH_LOOPS; i++)
+            job();
+        auto t1 = std::chrono::steady_clock::now();
+        runs.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count() / AUDIO_BENCH_LOOPS);
+    }
+    std::sort(runs.begin(), runs.end());
+    return runs[runs.size() / 2];
+}
+
+// AudioSampleCopy against the loops it replaced, on frames of
+// AUDIO_BENCH_SAMPLES planar samples: float into the source node's mat
+// and an int16 mat into the encoder's float frame. audio_max_diff is the
+// largest difference of their outputs, in 8 bit levels, 0 when they agree.
+static void RunAudio(const BenchOptions& options, BenchReports& reports)
+{
+    for (int channels : { 2, 6, 8 })
+    {
+        std::vector<std::vector<float>> src_float(channels, std::vector<float>(AUDIO_BENCH_SAMPLES));
+        std::vector<std::vector<float>> dst_ref(channels, std::vector<float>(AUDIO_BENCH_SAMPLES));
+        std::vector<std::vector<float>> dst_copy(channels, std::vector<float>(AUDIO_BENCH_SAMPLES));
+        std::vector<const void*> src(channels);
+        std::vector<float*> ref_ptrs(channels), copy_ptrs(channels);
+        ImGui::ImMat mat_s16;
+        mat_s16.create_type(AUDIO_BENCH_SAMPLES, 1, channels, IM_DT_INT16);
+        uint32_t seed = 0x9e3779b9u;
+        for (int c = 0; c < channels; c++)
+        {
+            for (int i = 0; i < AUDIO_BENCH_SAMPLES; i++)
+            {
+                seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+                src_float[c][i] = (int32_t)seed / 2147483648.f;
+                mat_s16.at<int16_t>(i, 0, c) = (int16_t)(seed >> 16);
+            }
+            src[c] = src_float[c].data();
+            ref_ptrs[c] = dst_ref[c].data();
+            copy_ptrs[c] = dst_copy[c].data();
+        }
+        std::vector<const void*> s16_src(channels);
+        for (int c = 0; c < channels; c++)
+            s16_src[c] = mat_s16.channel(c).data;
+
+        ImGui::ImMat ref_mat, copy_mat;
+        auto copy_source = [&]()
+        {
+            copy_mat.create_type(AUDIO_BENCH_SAMPLES, 1, channels, IM_DT_FLOAT32);
+            std::vector<void*> channel_data(channels);
+            for (int c = 0; c < channels; c++)
+                channel_data[c] = copy_mat.channel(c).data;
+            AudioSampleCopy(channel_data.data(), IM_DT_FLOAT32, src.data(), IM_DT_FLOAT32, true, channels, AUDIO_BENCH_SAMPLES);
+        };
+        auto copy_encoder = [&]()
+        {
+            AudioSampleCopy((void* const*)copy_ptrs.data(), IM_DT_FLOAT32, s16_src.data(), IM_DT_INT16, true, channels, AUDIO_BENCH_SAMPLES);
+        };
+        imgui_json::value source, encoder;
+        source["reference_us"] = imgui_json::number(AudioTimeUs([&]() { ReferenceSourceCopy(src.data(), IM_DT_FLOAT32, channels, AUDIO_BENCH_SAMPLES, ref_mat); }));
+        source["copy_us"] = imgui_json::number(AudioTimeUs(copy_source));
+        encoder["reference_us"] = imgui_json::number(AudioTimeUs([&]() { ReferenceEncoderCopy(mat_s16, ref_ptrs.data(), channels); }));
+        encoder["copy_us"] = imgui_json::number(AudioTimeUs(copy_encoder));
+
+        double max_diff = MaxDiff(ref_mat, copy_mat);
+        for (int c = 0; c < channels && max_diff >= 0; c++)
+            for (int i = 0; i < AUDIO_BENCH_SAMPLES; i++)
+                max_diff = std::max(max_diff, std::fabs(dst_ref[c][i] - dst_copy[c][i]) * 255.0);
+        imgui_json::value report;
+        report["name"] = std::string("audio_copy_") + std::to_string(channels) + "ch";
+        report["device"] = std::string("cpu");
+        report["channels"] = imgui_json::number(channels);
+        report["samples"] = imgui_json::number(AUDIO_BENCH_SAMPLES);
+        report["source_fltp"] = source;
+        report["encoder_s16p"] = encoder;
+        report["audio_max_diff"] = imgui_json::number(max_diff);
+        reports.push_back(report);
+    }
+}
+
+// The three planes of a frame the hqdn3d section filters, 8 bit samples in
+// bytes and 9 ~ 16 bit ones in uint16_t, rows packed
+struct HQDN3DFrame
+{
+    int depth {8};
+    std::vector<uint8_t> planes[3];
+
+    HQDN3DFrame(int width, int height, int bits) : depth(bits)
+    {
+        for (auto& plane : planes)
+            plane.resize((size_t)width * height * (depth > 8 ? 2 : 1));
+    }
+    int Sample(int plane, size_t i) const { return depth > 8 ? ((const uint16_t*)planes[plane].data())[i] : planes[plane][i]; }
+};
+
+// The rgb of a synthetic frame as planes of depth, with noise for the
+// denoiser to take out and detail below the top 8 bits
+static void FillHQDN3DFrame(HQDN3DFrame& frame, int width, int height, int index)
+{
+    ImGui::ImMat rgba = AIBenchmark::SyntheticFrame(width, height, index);
+    const uint8_t* src = (const uint8_t*)rgba.data;
+    const int max_value = (1 << frame.depth) - 1;
+    uint32_t seed = 0x6a09e667u ^ (uint32_t)index;
+    for (int p = 0; p < 3; p++)
+    {
+        for (size_t i = 0; i < (size_t)width * height; i++)
+        {
+            seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+            int value = ((src[i * 4 + p] + (int)(seed % 17) - 8) << (frame.depth - 8)) | (int)((seed >> 8) & (max_value >> 8));
+            value = std::max(0, std::min(value, max_value));
+            if (frame.depth > 8)
+                ((uint16_t*)frame.planes[p].data())[i] = (uint16_t)value;
+            else
+                frame.planes[p][i] = (uint8_t)value;
+        }
+    }
+}
+
+// Largest difference of two frames, in 8 bit levels
+static double HQDN3DMaxDiff(const HQDN3DFrame& a, const HQDN3DFrame& b)
+{
+    const double to8 = 255.0 / ((1 << a.depth) - 1);
+    int max_diff = 0;
+    for (int p = 0; p < 3; p++)
+        for (size_t i = 0; i < a.planes[p].size() / (a.depth > 8 ? 2 : 1); i++)
+            max_diff = std::max(max_diff, std::abs(a.Sample(p, i) - b.Sample(p, i)));
+    return max_diff * to8;
+}
+
+#if NODE_BENCH_WITH_FFMPEG
+// buffer -> hqdn3d -> buffersink with the strengths of the cpu engine
+static AVFilterGraph* OpenHQDN3DGraph(AVPixelFormat format, int width, int height, const float strength[4], AVFilterContext*& src, AVFilterContext*& sink)
+{
+    char args[256], options[256];
+    snprintf(args, sizeof(args), "video_size=%dx%d:pix_fmt=%d:time_base=1/25:pixel_aspect=1/1", width, height, (int)format);
+    snprintf(options, sizeof(options), "luma_spatial=%g:chroma_spatial=%g:luma_tmp=%g:chroma_tmp=%g", strength[0], strength[1], strength[2], strength[3]);
+    AVFilterGraph* graph = avfilter_graph_alloc();
+    const AVFilter* hqdn3d = avfilter_get_by_name("hqdn3d");
+    AVFilterContext* filter = nullptr;
+    if (!graph || !hqdn3d ||
+        avfilter_graph_create_filter(&src, avfilter_get_by_name("buffer"), "in", args, NULL, graph) < 0 ||
+        avfilter_graph_create_filter(&filter, hqdn3d, "hqdn3d", options, NULL, graph) < 0 ||
+        avfilter_graph_create_filter(&sink, avfilter_get_by_name("buffersink"), "out", NULL, NULL, graph) < 0 ||
+        avfilter_link(src, 0, filter, 0) < 0 || avfilter_link(filter, 0, sink, 0) < 0 ||
+        avfilter_graph_config(graph, NULL) < 0)
+    {
+        avfilter_graph_free(&graph);
+    }
+    return graph;
+}
+#endif
+
+// The CPU engine of the HQDN3D node on 1080p yuv444 frames at 8, 10 and 16
+// bit: FilterPlane on all threads and on one, against FilterPlaneReference,
+// ffmpeg's loops as they are, and against libavfilter's hqdn3d when built
+// with FFmpeg. The history runs over all frames, so the temporal pass is
+// compared too. hqdn3d_max_diff is the largest difference of any of them
+// from the reference, in 8 bit levels, 0 when they are bit exact.
+static void RunHQDN3D(const BenchOptions& options, BenchReports& reports)
+{
+    const int width = 1920, height = 1080;
+    const float strength[4] = { 4.0f, 3.0f, 6.0f, 4.5f };
+    const int threads = std::max(1, (int)std::thread::hardware_concurrency());
+    for (int depth : { 8, 10, 16 })
+    {
+        HQDN3DCpu reference, single, multi;
+        for (auto engine : { &reference, &single, &multi })
+            engine->SetParam(strength[0], strength[1], strength[2], strength[3]);
+        HQDN3DFrame in(width, height, depth), ref_out(width, height, depth), single_out(width, height, depth), multi_out(width, height, depth);
+        auto run_planes = [&](HQDN3DFrame& out, const std::function<void (int, const void*, void*)>& plane_job) -> int64_t
+        {
+            int64_t t0 = GetTimeMs();
+            for (int p = 0; p < 3; p++)
+                plane_job(p, in.planes[p].data(), out.planes[p].data());
+            return GetTimeMs() - t0;
+        };
+        AIBenchmark bench(std::string("hqdn3d_") + std::to_string(depth) + "bit"), ref_bench("reference"), single_bench("single");
+        double threads_diff = 0;
+#if NODE_BENCH_WITH_FFMPEG
+        const AVPixelFormat format = depth == 8 ? AV_PIX_FMT_YUV444P : depth == 10 ? AV_PIX_FMT_YUV444P10 : AV_PIX_FMT_YUV444P16;
+        AVFilterContext* graph_src = nullptr, *graph_sink = nullptr;
+        AVFilterGraph* graph = OpenHQDN3DGraph(format, width, height, strength, graph_src, graph_sink);
+        if (!graph)
+            fprintf(stderr, "hqdn3d %d bit: can't set up libavfilter's hqdn3d, compared with the reference only\n", depth);
+        AIBenchmark av_bench("libavfilter");
+        const int bytes = depth > 8 ? 2 : 1;
+        HQDN3DFrame av_out(width, height, depth);
+        double av_diff = graph ? 0 : -1;
+#endif
+        for (int i = 0; i <= AI_BENCHMARK_FRAMES; i++)
+        {
+            FillHQDN3DFrame(in, width, height, i);
+            int64_t ref_ms = run_planes(ref_out, [&](int p, const void* src, void* dst)
+                { reference.FilterPlaneReference(p, p > 0, src, width, dst, width, width, height, depth); });
+            int64_t single_ms = run_planes(single_out, [&](int p, const void* src, void* dst)
+                { single.FilterPlane(p, p > 0, src, width, dst, width, width, height, depth, 1); });
+            int64_t multi_ms = run_planes(multi_out, [&](int p, const void* src, void* dst)
+                { multi.FilterPlane(p, p > 0, src, width, dst, width, width, height, depth, threads); });
+            threads_diff = std::max(threads_diff, std::max(HQDN3DMaxDiff(ref_out, single_out), HQDN3DMaxDiff(ref_out, multi_out)));
+#if NODE_BENCH_WITH_FFMPEG
+            int64_t av_ms = -1;
+            if (graph)
+            {
+                AVFrame* frame = av_frame_alloc();
+                AVFrame* filtered = av_frame_alloc();
+                frame->format = format;
+                frame->width = width;
+                frame->height = height;
+                frame->pts = i;
+                bool ok = av_frame_get_buffer(frame, 0) >= 0;
+                for (int p = 0; p < 3 && ok; p++)
+                    for (int y = 0; y < height; y++)
+                        memcpy(frame->data[p] + (size_t)y * frame->linesize[p], in.planes[p].data() + (size_t)y * width * bytes, (size_t)width * bytes);
+                int64_t t0 = GetTimeMs();
+                ok = ok && av_buffersrc_add_frame(graph_src, frame) >= 0 && av_buffersink_get_frame(graph_sink, filtered) >= 0;
+                av_ms = GetTimeMs() - t0;
+                for (int p = 0; p < 3 && ok; p++)
+                    for (int y = 0; y < height; y++)
+                        memcpy(av_out.planes[p].data() + (size_t)y * width * bytes, filtered->data[p] + (size_t)y * filtered->linesize[p], (size_t)width * bytes);
+                if (ok)
+                    av_diff = std::max(av_diff, HQDN3DMaxDiff(ref_out, av_out));
+                else
+                    av_diff = -1, av_ms = -1;
+                av_frame_free(&frame);
+                av_frame_free(&filtered);
+                if (!ok)
+                {
+                    fprintf(stderr, "hqdn3d %d bit: libavfilter failed on frame %d\n", depth, i);
+                    avfilter_graph_free(&graph);
+                }
+            }
+#endif
+            // the first frame warms up and starts every history
+            if (i == 0)
+                continue;
+            bench.AddFrame(width, height, multi_ms);
+            ref_bench.AddFrame(width, height, ref_ms);
+            single_bench.AddFrame(width, height, single_ms);
+#if NODE_BENCH_WITH_FFMPEG
+            if (av_ms >= 0)
+                av_bench.AddFrame(width, height, av_ms);
+#endif
+        }
+        auto report = bench.ToJson();
+        report["device"] = std::string("cpu");
+        report["depth"] = imgui_json::number(depth);
+        report["threads"] = imgui_json::number(threads);
+        report["reference_p50_ms"] = imgui_json::number(ref_bench.Percentile(50));
+        report["single_thread_p50_ms"] = imgui_json::number(single_bench.Percentile(50));
+        report["threads_max_diff"] = imgui_json::number(threads_diff);
+        double max_diff = threads_diff;
+#if NODE_BENCH_WITH_FFMPEG
+        if (av_diff >= 0)
+        {
+            report["libavfilter_p50_ms"] = imgui_json::number(av_bench.Percentile(50));
+            report["libavfilter_max_diff"] = imgui_json::number(av_diff);
+            max_diff = std::max(max_diff, av_diff);
+        }
+        avfilter_graph_free(&graph);
+#endif
+        report["hqdn3d_max_diff"] = imgui_json::number(max_diff);
+        reports.push_back(report);
+    }
+}
+
+static const BenchSection sections[] =
+{
+    { "ai", RunAI },
+    { "int8", RunInt8 },
+    { "color", RunColor },
+    { "blur", RunBlur },
+    { "audio", RunAudio },
+    { "hqdn3d", RunHQDN3D },
+#if NODE_BENCH_WITH_FFMPEG
+    { "rgba2yuv", RunRGBA2YUV },
+    { "player", RunPlayer },
+    { "thumbnail", RunThumbnail },
+#endif
+};
+
+// Number of regressions of report against its baseline entry
+static int CheckReport(imgui_json::value& report, imgui_json::value& base, double tolerance)
+{
+    auto name = report["name"].get<imgui_json::string>();
+    bool same_device = base.contains("device") && base["device"].is_string() &&
+                       base["device"].get<imgui_json::string>() == report["device"].get<imgui_json::string>();
+    int regressions = 0;
+    // quality of a quantized package or of a conversion may not drop below what it shipped with
+    if (base.contains("psnr_db") && base["psnr_db"].is_number() && report.contains("psnr_db") &&
+        report["psnr_db"].get<imgui_json::number>() < base["psnr_db"].get<imgui_json::number>() - NODE_BENCH_PSNR_TOLERANCE)
+    {
+        printf("%s: PSNR %.2f dB, baseline %.2f dB\n", name.c_str(), report["psnr_db"].get<imgui_json::number>(), base["psnr_db"].get<imgui_json::number>());
+        regressions++;
+    }
+    // the lut, blur, audio and hqdn3d errors only move with the math, the slack
+    // covers float rounding of the blur on another SIMD width
+    for (const char* key : { "lut_max_diff", "blur_max_diff", "audio_max_diff", "hqdn3d_max_diff" })
+    {
+        if (base.contains(key) && base[key].is_number() && report.contains(key) &&
+            report[key].get<imgui_json::number>() > base[key].get<imgui_json::number>() + 0.01)
+        {
+            printf("%s: %s %.2f levels, baseline %.2f levels\n", name.c_str(), key, report[key].get<imgui_json::number>(), base[key].get<imgui_json::number>());
+            regressions++;
+        }
+    }
+    // cost and timing of the player and thumbnail sections, more is worse, 1 of
+    // slack so an idle CPU near 0 or a jitter at the poll resolution doesn't flap
+    for (const char* key : { "idle_cpu_pct", "play_cpu_pct", "jitter_p99_ms", "missing", "extract_ms", "cached_ms" })
+    {
+        if (base.contains(key) && base[key].is_number() && report.contains(key) &&
+            report[key].get<imgui_json::number>() > base[key].get<imgui_json::number>() * (1.0 + tolerance) + 1.0)
+        {
+            printf("%s: %s %.1f, baseline %.1f (+%.0f%%)\n", name.c_str(), key, report[key].get<imgui_json::number>(), base[key].get<imgui_json::number>(), tolerance * 100);
+            regressions++;
+        }
+    }
+    if (!base.contains("sizes") || !base["sizes"].is_object())
+        return regressions;
+    auto& sizes = report["sizes"].get<imgui_json::object>();
+    for (auto& it : sizes)
+    {
+        if (!base["sizes"].contains(it.first))
+            continue;
+        auto& entry = it.second;
+        auto& base_entry = base["sizes"][it.first];
+        if (base_entry.contains("p50_ms") && base_entry["p50_ms"].is_number())
+        {
+            double p50 = entry["p50_ms"].get<imgui_json::number>();
+            double base_p50 = base_entry["p50_ms"].get<imgui_json::number>();
+            // 1 ms of slack so the fast cases don't flap on timer resolution
+            if (p50 > base_p50 * (1.0 + tolerance) + 1.0)
+            {
+                printf("%s %s: p50 %.0f ms, baseline %.0f ms (+%.0f%%)\n", name.c_str(), it.first.c_str(), p50, base_p50, tolerance * 100);
+                regressions++;
+            }
+        }
+        if (same_device && base_entry.contains("checksum") && entry.contains("checksum") &&
+            base_entry["checksum"].get<imgui_json::string>() != entry["checksum"].get<imgui_json::string>())
+        {
+            printf("%s %s: checksum %s, baseline %s\n", name.c_str(), it.first.c_str(),
+                    entry["checksum"].get<imgui_json::string>().c_str(), base_entry["checksum"].get<imgui_json::string>().c_str());
+            regressions++;
+        }
+    }
+    return regressions;
+}
+
+static bool ParseOptions(int argc, char** argv, BenchOptions& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--plugins") && has_value)         options.plugins = argv[++i];
+        else if (!strcmp(argv[i], "--out") && has_value)        options.out = argv[++i];
+        else if (!strcmp(argv[i], "--baseline") && has_value)   options.baseline = argv[++i];
+        else if (!strcmp(argv[i], "--section") && has_value)    options.section = argv[++i];
+        else if (!strcmp(argv[i], "--clip") && has_value)       options.clip = argv[++i];
+        else if (!strcmp(argv[i], "--update-baseline"))         options.update_baseline = true;
+        else
+        {
+            fprintf(stderr, "usage: %s [--plugins <dir>] [--out <dir>] [--baseline <json>] [--section <name>] [--clip <file>] [--update-baseline]\n", argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    BenchOptions options;
+    if (!ParseOptions(argc, argv, options))
+        return 2;
+
+    imgui_json::value baseline;
+    auto loaded = imgui_json::value::load(options.baseline);
+    if (loaded.second)
+        baseline = loaded.first;
+    double tolerance = NODE_BENCH_TOLERANCE;
+    if (baseline.contains("latency_tolerance") && baseline["latency_tolerance"].is_number())
+        tolerance = baseline["latency_tolerance"].get<imgui_json::number>();
+
+    BenchReports reports;
+    for (auto& section : sections)
+    {
+        if (options.section.empty() || options.section == section.name)
+            section.run(options, reports);
+    }
+
+    int regressions = 0;
+    for (auto& report : reports)
+    {
+        auto name = report["name"].get<imgui_json::string>();
+        report.save(DirPath(options.out) + name + ".json");
+        if (options.update_baseline)
+            baseline["nodes"][name] = report;
+        else if (baseline.contains("nodes") && baseline["nodes"].contains(name))
+            regressions += CheckReport(report, baseline["nodes"][name], tolerance);
+        else
+        {
+            // an unrecorded report would pass whatever it measured
+            printf("%s: no baseline, record it with --update-baseline\n", name.c_str());
+            regressions++;
+        }
+    }
+    if (options.update_baseline)
+    {
+        baseline["latency_tolerance"] = imgui_json::number(tolerance);
+        if (!baseline.save(options.baseline))
+        {
+            fprintf(stderr, "can't write %s\n", options.baseline.c_str());
+            return 1;
+        }
+        printf("%d reports written to %s\n", (int)reports.size(), options.baseline.c_str());
+        return 0;
+    }
+    printf("%d reports, %d regressions\n", (int)reports.size(), regressions);
+    return regressions || reports.empty() ? 1 : 0;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <imgui_json.h>
+
+#ifndef NODE_BENCH_PLUGIN_DIR
+#define NODE_BENCH_PLUGIN_DIR   "plugins"
+#endif
+#ifndef NODE_BENCH_BASELINE
+#define NODE_BENCH_BASELINE     "baseline.json"
+#endif
+
+struct BenchOptions
+{
+    std::string plugins {NODE_BENCH_PLUGIN_DIR};
+    std::string out {"."};
+    std::string baseline {NODE_BENCH_BASELINE};
+    std::string section;
+    std::string clip;       // media file of the player and thumbnail sections
+    bool update_baseline {false};
+};
+
+using BenchReports = std::vector<imgui_json::value>;
+
+// Sections built from their own source, each appends one report per case
+#if NODE_BENCH_WITH_FFMPEG
+void RunPlayer(const BenchOptions& options, BenchReports& reports);
+void RunThumbnail(const BenchOptions& options, BenchReports& reports);
+#endif
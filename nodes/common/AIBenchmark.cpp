@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+#include "AIBenchmark.h"
+
+AIBenchmark::AIBenchmark(const std::string& name)
+    : m_name(name)
+{
+}
+
+std::string AIBenchmark::SizeKey(int width, int height)
+{
+    return std::to_string(width) + "x" + std::to_string(height);
+}
+
+void AIBenchmark::SetWarmupMs(int64_t ms)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_warmup_ms = ms;
+}
+
+int64_t AIBenchmark::WarmupMs() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_warmup_ms;
+}
+
+void AIBenchmark::AddFrame(int width, int height, int64_t ms)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_last_key = SizeKey(width, height);
+    auto& series = m_series[m_last_key];
+    if (series.samples.size() < AI_BENCHMARK_SAMPLES_MAX)
+        series.samples.push_back(ms);
+    else
+        series.samples[series.next] = ms;
+    series.next = (series.next + 1) % AI_BENCHMARK_SAMPLES_MAX;
+    series.frames++;
+}
+
+void AIBenchmark::Reset()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_series.clear();
+    m_last_key.clear();
+}
+
+int64_t AIBenchmark::Percentile(const std::vector<int64_t>& samples, double p)
+{
+    if (samples.empty())
+        return -1;
+    std::vector<int64_t> sorted(samples);
+    size_t rank = (size_t)(std::min(std::max(p, 0.0), 100.0) / 100.0 * (sorted.size() - 1) + 0.5);
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+int64_t AIBenchmark::Percentile(double p) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_series.find(m_last_key);
+    return it != m_series.end() ? Percentile(it->second.samples, p) : -1;
+}
+
+ImGui::ImMat AIBenchmark::SyntheticFrame(int width, int height, int index)
+{
+    // gradient plus xorshift noise, the same bytes for the same (size, index) on every run
+    ImGui::ImMat mat(width, height, 4, 1u, 4);
+    uint32_t seed = 0x9e3779b9u ^ (uint32_t)(width * 73856093) ^ (uint32_t)(height * 19349663) ^ (uint32_t)(index * 83492791);
+    for (int y = 0; y < height; y++)
+    {
+        uint8_t* row = (uint8_t*)mat.data + (size_t)y * width * 4;
+        for (int x = 0; x < width; x++)
+        {
+            seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+            row[x * 4 + 0] = (uint8_t)((x * 255 / std::max(width - 1, 1) + index * 4 + (seed & 15)) & 0xff);
+            row[x * 4 + 1] = (uint8_t)((y * 255 / std::max(height - 1, 1) + ((seed >> 4) & 15)) & 0xff);
+            row[x * 4 + 2] = (uint8_t)(((x ^ y) + ((seed >> 8) & 15)) & 0xff);
+            row[x * 4 + 3] = 0xff;
+        }
+    }
+    return mat;
+}
+
+uint64_t AIBenchmark::Checksum(const ImGui::ImMat& mat)
+{
+    // FNV-1a over the visible samples, padding between planes is skipped
+    uint64_t hash = 0xcbf29ce484222325ull;
+    if (mat.empty())
+        return hash;
+    auto feed = [&hash](const uint8_t* data, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= data[i];
+            hash *= 0x100000001b3ull;
+        }
+    };
+    if (mat.elempack > 1 || mat.c == 1)
+        feed((const uint8_t*)mat.data, (size_t)mat.w * mat.h * mat.c * mat.elemsize);
+    else
+    {
+        for (int c = 0; c < mat.c; c++)
+            feed((const uint8_t*)mat.data + c * mat.cstep * mat.elemsize, (size_t)mat.w * mat.h * mat.elemsize);
+    }
+    return hash;
+}
+
+int64_t AIBenchmark::PeakRSSKb()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return (int64_t)(counters.PeakWorkingSetSize / 1024);
+    return -1;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1;
+#if defined(__APPLE__)
+    return (int64_t)usage.ru_maxrss / 1024;
+#else
+    return (int64_t)usage.ru_maxrss;
+#endif
+#endif
+}
+
+void AIBenchmark::Run(const Job& job, int frames)
+{
+    static const int sizes[][2] = { {960, 540}, {1920, 1080}, {3840, 2160} };
+    for (auto& size : sizes)
+    {
+        ImGui::ImMat warmup_out;
+        job(SyntheticFrame(size[0], size[1], 0), warmup_out);
+        uint64_t checksum = 0;
+        for (int i = 0; i < frames; i++)
+        {
+            ImGui::ImMat in = SyntheticFrame(size[0], size[1], i + 1);
+            ImGui::ImMat out;
+            int64_t ms = job(in, out);
+            // fold every frame so a change on any of them shows up
+            checksum = checksum * 31 + Checksum(out);
+            AddFrame(size[0], size[1], ms);
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_series[SizeKey(size[0], size[1])].checksum = checksum;
+    }
+}
+
+imgui_json::value AIBenchmark::ToJson() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    imgui_json::value value;
+    value["name"] = m_name;
+    value["warmup_ms"] = imgui_json::number(m_warmup_ms);
+    value["peak_rss_kb"] = imgui_json::number(PeakRSSKb());
+    imgui_json::value sizes;
+    for (auto& it : m_series)
+    {
+        auto& series = it.second;
+        int64_t total = 0;
+        for (auto ms : series.samples) total += ms;
+        imgui_json::value entry;
+        entry["frames"] = imgui_json::number(series.frames);
+        entry["mean_ms"] = imgui_json::number(series.samples.empty() ? 0.0 : (double)total / series.samples.size());
+        entry["p50_ms"] = imgui_json::number(Percentile(series.samples, 50));
+        entry["p90_ms"] = imgui_json::number(Percentile(series.samples, 90));
+        entry["p99_ms"] = imgui_json::number(Percentile(series.samples, 99));
+        entry["max_ms"] = imgui_json::number(Percentile(series.samples, 100));
+        if (series.checksum)
+        {
+            char hex[17];
+            snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)series.checksum);
+            entry["checksum"] = std::string(hex);
+        }
+        sizes[it.first] = entry;
+    }
+    value["sizes"] = sizes;
+    return value;
+}
+
+bool AIBenchmark::Save(const std::string& path) const
+{
+    return ToJson().save(path);
+}
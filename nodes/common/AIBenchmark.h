@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <immat.h>
+#include <imgui_json.h>
+
+// Latency samples kept per input size, older ones are dropped first
+#define AI_BENCHMARK_SAMPLES_MAX    1024
+// Frames timed per resolution by Run(), after one untimed warm-up frame
+#define AI_BENCHMARK_FRAMES         8
+
+// Per-node performance record for the AI nodes: model warm-up time, frame
+// latency percentiles per input size, peak RSS and the output checksum of the
+// fixed inputs. Reports are plain json so runs can be diffed across builds.
+class AIBenchmark
+{
+public:
+    // job returns its processing time in ms, the same contract as AsyncMatPipeline
+    using Job = std::function<int64_t (const ImGui::ImMat& in, ImGui::ImMat& out)>;
+
+    explicit AIBenchmark(const std::string& name);
+
+    void SetWarmupMs(int64_t ms);
+    void AddFrame(int width, int height, int64_t ms);
+    void Reset();
+
+    // p in [0, 100] over the samples of the most recent input size, -1 if none
+    int64_t Percentile(double p) const;
+    int64_t WarmupMs() const;
+
+    // Feed deterministic frames at 540p, 1080p and 4K through job and record
+    // latency and output checksum for each. Only the bench calls this, on its
+    // own instance, the nodes only AddFrame() what they process
+    void Run(const Job& job, int frames = AI_BENCHMARK_FRAMES);
+    imgui_json::value ToJson() const;
+    bool Save(const std::string& path) const;
+
+    static ImGui::ImMat SyntheticFrame(int width, int height, int index);
+    static uint64_t Checksum(const ImGui::ImMat& mat);
+    static int64_t PeakRSSKb();
+
+private:
+    struct Series
+    {
+        std::vector<int64_t> samples;
+        size_t next {0};
+        uint64_t frames {0};
+        uint64_t checksum {0};
+    };
+    static std::string SizeKey(int width, int height);
+    static int64_t Percentile(const std::vector<int64_t>& samples, double p);
+
+private:
+    std::string m_name;
+    mutable std::mutex m_mutex;
+    std::map<std::string, Series> m_series;
+    std::string m_last_key;
+    int64_t m_warmup_ms {-1};
+};
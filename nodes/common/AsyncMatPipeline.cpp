@@ -0,0 +1,121 @@
+#include <chrono>
+#include "AsyncMatPipeline.h"
+
+static int64_t GetTimeMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+AsyncMatPipeline::AsyncMatPipeline(Job job)
+    : m_job(job)
+{
+    m_worker = std::thread(&AsyncMatPipeline::WorkerProc, this);
+}
+
+AsyncMatPipeline::~AsyncMatPipeline()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+        m_pending.clear();
+        m_in_flight.clear();
+    }
+    m_cond.notify_all();
+    if (m_worker.joinable())
+        m_worker.join();
+}
+
+void AsyncMatPipeline::Push(const ImGui::ImMat& in, Job job)
+{
+    auto entry = std::make_shared<Entry>();
+    entry->in = in;
+    entry->job = job ? job : m_job;
+    entry->width = in.w;
+    entry->height = in.h;
+    entry->push_time = GetTimeMs();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (in.time_stamp < m_last_time_stamp)
+        {
+            m_pending.clear();
+            m_in_flight.clear();
+        }
+        m_last_time_stamp = in.time_stamp;
+        m_in_flight.push_back(entry);
+        m_pending.push_back(entry);
+    }
+    m_cond.notify_all();
+}
+
+bool AsyncMatPipeline::Pop(ImGui::ImMat& out)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_in_flight.empty())
+        return false;
+    auto entry = m_in_flight.front();
+    m_cond.wait(lock, [&] { return entry->done || m_quit || m_in_flight.empty() || m_in_flight.front() != entry; });
+    if (!entry->done || m_in_flight.empty() || m_in_flight.front() != entry)
+        return false;
+    m_in_flight.pop_front();
+    out = entry->out;
+    m_process_ms = entry->process_ms;
+    m_latency_ms = GetTimeMs() - entry->push_time;
+    m_popped_width = entry->width;
+    m_popped_height = entry->height;
+    return true;
+}
+
+int AsyncMatPipeline::Drain(std::vector<ImGui::ImMat>& outs)
+{
+    int count = 0;
+    ImGui::ImMat out;
+    while (Pop(out))
+    {
+        outs.push_back(out);
+        count++;
+    }
+    return count;
+}
+
+void AsyncMatPipeline::Flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_pending.clear();
+    m_in_flight.clear();
+    m_last_time_stamp = -1;
+    m_cond.notify_all();
+    m_cond.wait(lock, [&] { return !m_running; });
+}
+
+int AsyncMatPipeline::InFlight() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return (int)m_in_flight.size();
+}
+
+void AsyncMatPipeline::WorkerProc()
+{
+    while (true)
+    {
+        EntryHolder entry;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [&] { return m_quit || !m_pending.empty(); });
+            if (m_quit)
+                break;
+            entry = m_pending.front();
+            m_pending.pop_front();
+            m_running = true;
+        }
+        int64_t process_ms = entry->job ? entry->job(entry->in, entry->out) : 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running = false;
+            entry->in.release();
+            entry->job = nullptr;
+            entry->process_ms = process_ms;
+            entry->done = true;
+        }
+        m_cond.notify_all();
+    }
+}
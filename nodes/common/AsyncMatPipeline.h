@@ -0,0 +1,80 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <immat.h>
+
+#define ASYNC_PIPELINE_DEPTH_MAX    8
+
+// Runs a mat job on its own thread so conversion and inference of the next
+// frame overlap with the consumers of the current one. Frames come back in
+// submission order, each output carries the attributes (time_stamp) of the
+// input it was made from.
+class AsyncMatPipeline
+{
+public:
+    // job returns its processing time in ms
+    using Job = std::function<int64_t (const ImGui::ImMat& in, ImGui::ImMat& out)>;
+
+    AsyncMatPipeline(Job job);
+    ~AsyncMatPipeline();
+
+    AsyncMatPipeline(const AsyncMatPipeline&) = delete;
+    AsyncMatPipeline& operator=(const AsyncMatPipeline&) = delete;
+
+    // Queue a frame. A time_stamp going backwards (seek) drops every frame
+    // still in flight first. job, when given, runs for this frame instead of
+    // the pipeline's, it carries the settings the frame was pushed with.
+    void Push(const ImGui::ImMat& in, Job job = nullptr);
+    // Wait for the oldest frame in flight, false if nothing is in flight
+    bool Pop(ImGui::ImMat& out);
+    // Wait for every frame in flight and append them to outs in order, for
+    // end of stream and stop. Returns the number of frames popped.
+    int Drain(std::vector<ImGui::ImMat>& outs);
+    // Drop every queued and finished frame, waiting for the one the worker
+    // runs, so nothing its job touches is written after this returns
+    void Flush();
+
+    int InFlight() const;
+    int64_t ProcessTimeMs() const { return m_process_ms; }
+    int64_t LatencyMs() const { return m_latency_ms; }
+    // input size of the last popped frame, the output may be scaled
+    int PoppedWidth() const { return m_popped_width; }
+    int PoppedHeight() const { return m_popped_height; }
+
+private:
+    struct Entry
+    {
+        ImGui::ImMat in;
+        ImGui::ImMat out;
+        Job job;
+        int width {0};
+        int height {0};
+        int64_t push_time {0};
+        int64_t process_ms {0};
+        bool done {false};
+    };
+    using EntryHolder = std::shared_ptr<Entry>;
+
+    void WorkerProc();
+
+private:
+    Job m_job;
+    std::thread m_worker;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<EntryHolder> m_in_flight;
+    std::deque<EntryHolder> m_pending;
+    double m_last_time_stamp {-1};
+    bool m_quit {false};
+    bool m_running {false};
+    std::atomic<int64_t> m_process_ms {0};
+    std::atomic<int64_t> m_latency_ms {0};
+    std::atomic<int> m_popped_width {0};
+    std::atomic<int> m_popped_height {0};
+};
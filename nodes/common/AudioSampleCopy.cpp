@@ -0,0 +1,182 @@
+#include "AudioSampleCopy.h"
+#include <cstdint>
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+static size_t SampleSize(ImDataType type)
+{
+    switch (type)
+    {
+        case IM_DT_INT8:    return 1;
+        case IM_DT_INT16:   return 2;
+        case IM_DT_INT32:   return 4;
+        case IM_DT_INT64:   return 8;
+        case IM_DT_FLOAT32: return 4;
+        case IM_DT_FLOAT64: return 8;
+        default:            return 0;
+    }
+}
+
+static inline float ToFloat(int16_t v) { return v * (1.f / 32768.f); }
+static inline float ToFloat(int32_t v) { return (float)v * (1.f / 2147483648.f); }
+static inline float ToFloat(double v) { return (float)v; }
+
+template<typename T>
+static void DeinterleaveCopy(void* const* dst, const T* src, int channels, int samples)
+{
+    for (int c = 0; c < channels; c++)
+    {
+        T* out = (T*)dst[c];
+        const T* in = src + c;
+        for (int i = 0; i < samples; i++, in += channels)
+            out[i] = *in;
+    }
+}
+
+template<typename T>
+static void DeinterleaveToFloat(void* const* dst, const T* src, int channels, int samples)
+{
+    for (int c = 0; c < channels; c++)
+    {
+        float* out = (float*)dst[c];
+        const T* in = src + c;
+        for (int i = 0; i < samples; i++, in += channels)
+            out[i] = ToFloat(*in);
+    }
+}
+
+static void ConvertS16(float* dst, const int16_t* src, int samples)
+{
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128 scale = _mm_set1_ps(1.f / 32768.f);
+    for (; i + 8 <= samples; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        // sign extend by placing each sample in the top half, then shifting down
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+#elif defined(__ARM_NEON)
+    const float32x4_t scale = vdupq_n_f32(1.f / 32768.f);
+    for (; i + 8 <= samples; i += 8)
+    {
+        int16x8_t v = vld1q_s16(src + i);
+        vst1q_f32(dst + i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), scale));
+        vst1q_f32(dst + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), scale));
+    }
+#endif
+    for (; i < samples; i++)
+        dst[i] = ToFloat(src[i]);
+}
+
+static void ConvertS32(float* dst, const int32_t* src, int samples)
+{
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128 scale = _mm_set1_ps(1.f / 2147483648.f);
+    for (; i + 4 <= samples; i += 4)
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(src + i))), scale));
+#elif defined(__ARM_NEON)
+    const float32x4_t scale = vdupq_n_f32(1.f / 2147483648.f);
+    for (; i + 4 <= samples; i += 4)
+        vst1q_f32(dst + i, vmulq_f32(vcvtq_f32_s32(vld1q_s32(src + i)), scale));
+#endif
+    for (; i < samples; i++)
+        dst[i] = ToFloat(src[i]);
+}
+
+static void ConvertDbl(float* dst, const double* src, int samples)
+{
+    int i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= samples; i += 4)
+    {
+        __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(src + i));
+        __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(src + i + 2));
+        _mm_storeu_ps(dst + i, _mm_movelh_ps(lo, hi));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 4 <= samples; i += 4)
+    {
+        float32x2_t lo = vcvt_f32_f64(vld1q_f64(src + i));
+        float32x2_t hi = vcvt_f32_f64(vld1q_f64(src + i + 2));
+        vst1q_f32(dst + i, vcombine_f32(lo, hi));
+    }
+#endif
+    for (; i < samples; i++)
+        dst[i] = ToFloat(src[i]);
+}
+
+bool AudioSampleCopy(void* const* dst, ImDataType dst_type,
+                     const void* const* src, ImDataType src_type, bool src_planar,
+                     int channels, int samples)
+{
+    if (!dst || !src || channels <= 0 || samples <= 0)
+        return false;
+    size_t size = SampleSize(src_type);
+    if (size == 0)
+        return false;
+
+    if (dst_type == src_type)
+    {
+        if (src_planar)
+        {
+            for (int c = 0; c < channels; c++)
+                memcpy(dst[c], src[c], size * samples);
+        }
+        else if (channels == 1)
+            memcpy(dst[0], src[0], size * samples);
+        else if (size == 1)
+            DeinterleaveCopy(dst, (const int8_t*)src[0], channels, samples);
+        else if (size == 2)
+            DeinterleaveCopy(dst, (const int16_t*)src[0], channels, samples);
+        else if (size == 4)
+            DeinterleaveCopy(dst, (const int32_t*)src[0], channels, samples);
+        else
+            DeinterleaveCopy(dst, (const int64_t*)src[0], channels, samples);
+        return true;
+    }
+
+    if (dst_type != IM_DT_FLOAT32)
+        return false;
+    if (src_type == IM_DT_INT16)
+    {
+        if (!src_planar)
+            DeinterleaveToFloat(dst, (const int16_t*)src[0], channels, samples);
+        else
+        {
+            for (int c = 0; c < channels; c++)
+                ConvertS16((float*)dst[c], (const int16_t*)src[c], samples);
+        }
+    }
+    else if (src_type == IM_DT_INT32)
+    {
+        if (!src_planar)
+            DeinterleaveToFloat(dst, (const int32_t*)src[0], channels, samples);
+        else
+        {
+            for (int c = 0; c < channels; c++)
+                ConvertS32((float*)dst[c], (const int32_t*)src[c], samples);
+        }
+    }
+    else if (src_type == IM_DT_FLOAT64)
+    {
+        if (!src_planar)
+            DeinterleaveToFloat(dst, (const double*)src[0], channels, samples);
+        else
+        {
+            for (int c = 0; c < channels; c++)
+                ConvertDbl((float*)dst[c], (const double*)src[c], samples);
+        }
+    }
+    else
+        return false;
+    return true;
+}
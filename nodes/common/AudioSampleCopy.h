@@ -0,0 +1,11 @@
+#pragma once
+#include <immat.h>
+
+// Copies 'samples' audio samples of each channel into planar dst, one pointer
+// per channel. A planar src has one pointer per channel as well, an
+// interleaved one holds every channel in src[0]. Matching types are copied as
+// they are, IM_DT_INT16, IM_DT_INT32 and IM_DT_FLOAT64 sources also convert to
+// IM_DT_FLOAT32 in [-1, 1]. Returns false for any other pair of types.
+bool AudioSampleCopy(void* const* dst, ImDataType dst_type,
+                     const void* const* src, ImDataType src_type, bool src_planar,
+                     int channels, int samples);
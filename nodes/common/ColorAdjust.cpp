@@ -0,0 +1,516 @@
+#include "ColorAdjust.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// pixels converted to float and run through the chain at a time
+#define COLOR_ADJUST_CHUNK  64
+
+static inline float Clamp01(float v)
+{
+    return std::min(std::max(v, 0.f), 1.f);
+}
+
+// luminance weights of the Saturation shader
+static const float kLumR = 0.2125f, kLumG = 0.7154f, kLumB = 0.0721f;
+
+// YIQ transform shared by the Hue and Whitebalance shaders
+static const float kRGBToYIQ[3][3] = {
+    { 0.299f,     0.587f,     0.114f     },
+    { 0.595716f, -0.274453f, -0.321263f  },
+    { 0.211456f, -0.522591f,  0.31135f   },
+};
+static const float kYIQToRGB[3][3] = {
+    { 1.0f,  0.9563f,  0.6210f },
+    { 1.0f, -0.2721f, -0.6474f },
+    { 1.0f, -1.1070f,  1.7046f },
+};
+
+static inline void Mul3(const float m[3][3], const float in[3], float out[3])
+{
+    for (int i = 0; i < 3; i++)
+        out[i] = m[i][0] * in[0] + m[i][1] * in[1] + m[i][2] * in[2];
+}
+
+// the Whitebalance node passes kelvin, the shader works on a -1 ~ 1 amount
+static inline float TemperatureAmount(float temperature)
+{
+    return temperature < 5000.f ? 0.0004f * (temperature - 5000.f) : 0.00006f * (temperature - 5000.f);
+}
+
+int ColorAdjustParams::ActiveStages() const
+{
+    return (brightness != 0.f) + (contrast != 1.f) + (gamma != 1.f) + (exposure != 0.f) +
+           (saturation != 1.f) + (fmodf(hue, 360.f) != 0.f) + (vibrance != 0.f) + (temperature != 5000.f);
+}
+
+bool ColorAdjustParams::operator==(const ColorAdjustParams& other) const
+{
+    return brightness == other.brightness && contrast == other.contrast && gamma == other.gamma &&
+           exposure == other.exposure && saturation == other.saturation && hue == other.hue &&
+           vibrance == other.vibrance && temperature == other.temperature;
+}
+
+void ColorAdjustPixel(const ColorAdjustParams& params, float rgb[3])
+{
+    float r = rgb[0], g = rgb[1], b = rgb[2];
+    if (params.brightness != 0.f)
+    {
+        r = Clamp01(r + params.brightness);
+        g = Clamp01(g + params.brightness);
+        b = Clamp01(b + params.brightness);
+    }
+    if (params.contrast != 1.f)
+    {
+        r = Clamp01((r - 0.5f) * params.contrast + 0.5f);
+        g = Clamp01((g - 0.5f) * params.contrast + 0.5f);
+        b = Clamp01((b - 0.5f) * params.contrast + 0.5f);
+    }
+    if (params.gamma != 1.f)
+    {
+        r = Clamp01(powf(r, params.gamma));
+        g = Clamp01(powf(g, params.gamma));
+        b = Clamp01(powf(b, params.gamma));
+    }
+    if (params.exposure != 0.f)
+    {
+        float scale = powf(2.f, params.exposure);
+        r = Clamp01(r * scale);
+        g = Clamp01(g * scale);
+        b = Clamp01(b * scale);
+    }
+    if (params.saturation != 1.f)
+    {
+        float lum = r * kLumR + g * kLumG + b * kLumB;
+        r = Clamp01(lum + (r - lum) * params.saturation);
+        g = Clamp01(lum + (g - lum) * params.saturation);
+        b = Clamp01(lum + (b - lum) * params.saturation);
+    }
+    if (fmodf(params.hue, 360.f) != 0.f)
+    {
+        // rotate the chroma in the IQ plane
+        float in[3] = { r, g, b }, yiq[3], out[3];
+        Mul3(kRGBToYIQ, in, yiq);
+        float angle = atan2f(yiq[2], yiq[1]) - fmodf(params.hue, 360.f) * (float)M_PI / 180.f;
+        float chroma = sqrtf(yiq[1] * yiq[1] + yiq[2] * yiq[2]);
+        yiq[1] = chroma * cosf(angle);
+        yiq[2] = chroma * sinf(angle);
+        Mul3(kYIQToRGB, yiq, out);
+        r = Clamp01(out[0]); g = Clamp01(out[1]); b = Clamp01(out[2]);
+    }
+    if (params.vibrance != 0.f)
+    {
+        float average = (r + g + b) / 3.f;
+        float mx = std::max(r, std::max(g, b));
+        float amount = (mx - average) * (-params.vibrance * 3.f);
+        r = Clamp01(r + (mx - r) * amount);
+        g = Clamp01(g + (mx - g) * amount);
+        b = Clamp01(b + (mx - b) * amount);
+    }
+    if (params.temperature != 5000.f)
+    {
+        // overlay blend with the warm filter colour
+        const float warm[3] = { 0.93f, 0.54f, 0.0f };
+        float amount = TemperatureAmount(params.temperature);
+        float in[3] = { r, g, b };
+        for (int i = 0; i < 3; i++)
+        {
+            float processed = in[i] < 0.5f ? 2.f * in[i] * warm[i] : 1.f - 2.f * (1.f - in[i]) * (1.f - warm[i]);
+            in[i] = Clamp01(in[i] + (processed - in[i]) * amount);
+        }
+        r = in[0]; g = in[1]; b = in[2];
+    }
+    rgb[0] = r; rgb[1] = g; rgb[2] = b;
+}
+
+// The per channel stages (brightness, contrast, gamma, exposure) are the
+// same curve on every channel, and tetrahedral interpolation of a curve that
+// only depends on its own channel is linear interpolation along that channel.
+// Sampling that curve at the lut nodes puts every bend of it, like the foot
+// of gamma 0.5, between two of them. The nodes are instead fitted to the 256
+// 8 bit inputs by least squares, reweighted towards the largest errors so the
+// fit approaches minimax, see Lawson's algorithm.
+static void FitCurveNodes(const ColorAdjustParams& curve, int size, std::vector<float>& nodes)
+{
+    const int iterations = 16;
+    float target[256];
+    for (int m = 0; m < 256; m++)
+    {
+        float rgb[3] = { m / 255.f, m / 255.f, m / 255.f };
+        ColorAdjustPixel(curve, rgb);
+        target[m] = rgb[0];
+    }
+    std::vector<double> weight(256, 1.0), diag(size), upper(size), rhs(size);
+    nodes.resize(size);
+    for (int it = 0; it < iterations; it++)
+    {
+        // normal equations of the weighted fit are tridiagonal, a node only
+        // meets its neighbours; a small pull towards the sampled curve keeps
+        // nodes without an input between them defined
+        for (int n = 0; n < size; n++)
+        {
+            float rgb[3] = { (float)n / (size - 1), (float)n / (size - 1), (float)n / (size - 1) };
+            ColorAdjustPixel(curve, rgb);
+            diag[n] = 1e-6; upper[n] = 0; rhs[n] = 1e-6 * rgb[0];
+        }
+        for (int m = 0; m < 256; m++)
+        {
+            double s = m / 255.0 * (size - 1);
+            int n = std::min((int)s, size - 2);
+            double f = s - n, w = weight[m];
+            diag[n] += w * (1 - f) * (1 - f);
+            diag[n + 1] += w * f * f;
+            upper[n] += w * (1 - f) * f;
+            rhs[n] += w * (1 - f) * target[m];
+            rhs[n + 1] += w * f * target[m];
+        }
+        // Thomas algorithm on the symmetric system
+        for (int n = 1; n < size; n++)
+        {
+            double k = upper[n - 1] / diag[n - 1];
+            diag[n] -= k * upper[n - 1];
+            rhs[n] -= k * rhs[n - 1];
+        }
+        std::vector<double> v(size);
+        v[size - 1] = rhs[size - 1] / diag[size - 1];
+        for (int n = size - 2; n >= 0; n--)
+            v[n] = (rhs[n] - upper[n] * v[n + 1]) / diag[n];
+        double total = 0;
+        for (int m = 0; m < 256; m++)
+        {
+            double s = m / 255.0 * (size - 1);
+            int n = std::min((int)s, size - 2);
+            double f = s - n;
+            weight[m] *= std::fabs(v[n] + (v[n + 1] - v[n]) * f - target[m]) + 1e-9;
+            total += weight[m];
+        }
+        for (auto& w : weight)
+            w *= 256.0 / total;
+        for (int n = 0; n < size; n++)
+            nodes[n] = (float)v[n];
+    }
+}
+
+void ColorAdjustBakeLut(const ColorAdjustParams& params, int size, float* lut)
+{
+    if (size < 2 || !lut)
+        return;
+    ColorAdjustParams curve, rest;
+    curve.brightness = params.brightness;
+    curve.contrast = params.contrast;
+    curve.gamma = params.gamma;
+    curve.exposure = params.exposure;
+    rest.saturation = params.saturation;
+    rest.hue = params.hue;
+    rest.vibrance = params.vibrance;
+    rest.temperature = params.temperature;
+    std::vector<float> nodes;
+    FitCurveNodes(curve, size, nodes);
+    for (int i = 0; i < size; i++)
+    {
+        for (int j = 0; j < size; j++)
+        {
+            for (int k = 0; k < size; k++)
+            {
+                // the fitted nodes may leave [0, 1] a little, the stages
+                // after them clamp as they would on the curve itself
+                float rgb[3] = { nodes[i], nodes[j], nodes[k] };
+                if (rest.ActiveStages() > 0)
+                    ColorAdjustPixel(rest, rgb);
+                float* entry = lut + ((size_t)i * size * size + (size_t)j * size + k) * 4;
+                entry[0] = rgb[0];
+                entry[1] = rgb[1];
+                entry[2] = rgb[2];
+                entry[3] = 0.f;
+            }
+        }
+    }
+}
+
+
+#if defined(__SSE2__)
+typedef __m128 v4f;
+static inline v4f v_set(float v) { return _mm_set1_ps(v); }
+static inline v4f v_load(const float* p) { return _mm_loadu_ps(p); }
+static inline void v_store(float* p, v4f a) { _mm_storeu_ps(p, a); }
+static inline v4f v_add(v4f a, v4f b) { return _mm_add_ps(a, b); }
+static inline v4f v_sub(v4f a, v4f b) { return _mm_sub_ps(a, b); }
+static inline v4f v_mul(v4f a, v4f b) { return _mm_mul_ps(a, b); }
+static inline v4f v_max(v4f a, v4f b) { return _mm_max_ps(a, b); }
+static inline v4f v_clamp01(v4f a) { return _mm_min_ps(_mm_max_ps(a, _mm_setzero_ps()), _mm_set1_ps(1.f)); }
+// a < b ? x : y
+static inline v4f v_select_lt(v4f a, v4f b, v4f x, v4f y) { v4f m = _mm_cmplt_ps(a, b); return _mm_or_ps(_mm_and_ps(m, x), _mm_andnot_ps(m, y)); }
+#elif defined(__ARM_NEON)
+typedef float32x4_t v4f;
+static inline v4f v_set(float v) { return vdupq_n_f32(v); }
+static inline v4f v_load(const float* p) { return vld1q_f32(p); }
+static inline void v_store(float* p, v4f a) { vst1q_f32(p, a); }
+static inline v4f v_add(v4f a, v4f b) { return vaddq_f32(a, b); }
+static inline v4f v_sub(v4f a, v4f b) { return vsubq_f32(a, b); }
+static inline v4f v_mul(v4f a, v4f b) { return vmulq_f32(a, b); }
+static inline v4f v_max(v4f a, v4f b) { return vmaxq_f32(a, b); }
+static inline v4f v_clamp01(v4f a) { return vminq_f32(vmaxq_f32(a, vdupq_n_f32(0.f)), vdupq_n_f32(1.f)); }
+static inline v4f v_select_lt(v4f a, v4f b, v4f x, v4f y) { return vbslq_f32(vcltq_f32(a, b), x, y); }
+#else
+struct v4f { float v[4]; };
+static inline v4f v_set(float v) { return { { v, v, v, v } }; }
+static inline v4f v_load(const float* p) { return { { p[0], p[1], p[2], p[3] } }; }
+static inline void v_store(float* p, v4f a) { for (int i = 0; i < 4; i++) p[i] = a.v[i]; }
+static inline v4f v_add(v4f a, v4f b) { for (int i = 0; i < 4; i++) a.v[i] += b.v[i]; return a; }
+static inline v4f v_sub(v4f a, v4f b) { for (int i = 0; i < 4; i++) a.v[i] -= b.v[i]; return a; }
+static inline v4f v_mul(v4f a, v4f b) { for (int i = 0; i < 4; i++) a.v[i] *= b.v[i]; return a; }
+static inline v4f v_max(v4f a, v4f b) { for (int i = 0; i < 4; i++) a.v[i] = std::max(a.v[i], b.v[i]); return a; }
+static inline v4f v_clamp01(v4f a) { for (int i = 0; i < 4; i++) a.v[i] = Clamp01(a.v[i]); return a; }
+static inline v4f v_select_lt(v4f a, v4f b, v4f x, v4f y) { for (int i = 0; i < 4; i++) x.v[i] = a.v[i] < b.v[i] ? x.v[i] : y.v[i]; return x; }
+#endif
+
+// per call constants of the chain, hue becomes a 3x3 matrix since rotating
+// IQ is linear
+struct ColorAdjustPlan
+{
+    ColorAdjustParams params;
+    float exposureScale {1.f};
+    float hueMatrix[3][3];
+    float temperatureAmount {0.f};
+};
+
+static ColorAdjustPlan MakePlan(const ColorAdjustParams& params)
+{
+    ColorAdjustPlan plan;
+    plan.params = params;
+    plan.exposureScale = powf(2.f, params.exposure);
+    plan.temperatureAmount = TemperatureAmount(params.temperature);
+    float angle = fmodf(params.hue, 360.f) * (float)M_PI / 180.f;
+    float c = cosf(angle), s = sinf(angle);
+    const float rot[3][3] = { { 1.f, 0.f, 0.f }, { 0.f, c, s }, { 0.f, -s, c } };
+    float tmp[3][3];
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            tmp[i][j] = rot[i][0] * kRGBToYIQ[0][j] + rot[i][1] * kRGBToYIQ[1][j] + rot[i][2] * kRGBToYIQ[2][j];
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            plan.hueMatrix[i][j] = kYIQToRGB[i][0] * tmp[0][j] + kYIQToRGB[i][1] * tmp[1][j] + kYIQToRGB[i][2] * tmp[2][j];
+    return plan;
+}
+
+static inline v4f PowLanes(v4f a, float e)
+{
+    float t[4];
+    v_store(t, a);
+    for (int i = 0; i < 4; i++)
+        t[i] = powf(t[i], e);
+    return v_clamp01(v_load(t));
+}
+
+// n is a multiple of 4, every stage stays in registers
+static void ApplyPlan(const ColorAdjustPlan& plan, float* r, float* g, float* b, int n)
+{
+    const ColorAdjustParams& p = plan.params;
+    const bool hue = fmodf(p.hue, 360.f) != 0.f;
+    const v4f half = v_set(0.5f), one = v_set(1.f), two = v_set(2.f);
+    for (int i = 0; i < n; i += 4)
+    {
+        v4f vr = v_load(r + i), vg = v_load(g + i), vb = v_load(b + i);
+        if (p.brightness != 0.f)
+        {
+            v4f v = v_set(p.brightness);
+            vr = v_clamp01(v_add(vr, v)); vg = v_clamp01(v_add(vg, v)); vb = v_clamp01(v_add(vb, v));
+        }
+        if (p.contrast != 1.f)
+        {
+            v4f v = v_set(p.contrast);
+            vr = v_clamp01(v_add(v_mul(v_sub(vr, half), v), half));
+            vg = v_clamp01(v_add(v_mul(v_sub(vg, half), v), half));
+            vb = v_clamp01(v_add(v_mul(v_sub(vb, half), v), half));
+        }
+        if (p.gamma != 1.f)
+        {
+            vr = PowLanes(vr, p.gamma); vg = PowLanes(vg, p.gamma); vb = PowLanes(vb, p.gamma);
+        }
+        if (p.exposure != 0.f)
+        {
+            v4f v = v_set(plan.exposureScale);
+            vr = v_clamp01(v_mul(vr, v)); vg = v_clamp01(v_mul(vg, v)); vb = v_clamp01(v_mul(vb, v));
+        }
+        if (p.saturation != 1.f)
+        {
+            v4f v = v_set(p.saturation);
+            v4f lum = v_add(v_add(v_mul(vr, v_set(kLumR)), v_mul(vg, v_set(kLumG))), v_mul(vb, v_set(kLumB)));
+            vr = v_clamp01(v_add(lum, v_mul(v_sub(vr, lum), v)));
+            vg = v_clamp01(v_add(lum, v_mul(v_sub(vg, lum), v)));
+            vb = v_clamp01(v_add(lum, v_mul(v_sub(vb, lum), v)));
+        }
+        if (hue)
+        {
+            const float (*m)[3] = plan.hueMatrix;
+            v4f nr = v_add(v_add(v_mul(vr, v_set(m[0][0])), v_mul(vg, v_set(m[0][1]))), v_mul(vb, v_set(m[0][2])));
+            v4f ng = v_add(v_add(v_mul(vr, v_set(m[1][0])), v_mul(vg, v_set(m[1][1]))), v_mul(vb, v_set(m[1][2])));
+            v4f nb = v_add(v_add(v_mul(vr, v_set(m[2][0])), v_mul(vg, v_set(m[2][1]))), v_mul(vb, v_set(m[2][2])));
+            vr = v_clamp01(nr); vg = v_clamp01(ng); vb = v_clamp01(nb);
+        }
+        if (p.vibrance != 0.f)
+        {
+            v4f average = v_mul(v_add(v_add(vr, vg), vb), v_set(1.f / 3.f));
+            v4f mx = v_max(vr, v_max(vg, vb));
+            v4f amount = v_mul(v_sub(mx, average), v_set(-p.vibrance * 3.f));
+            vr = v_clamp01(v_add(vr, v_mul(v_sub(mx, vr), amount)));
+            vg = v_clamp01(v_add(vg, v_mul(v_sub(mx, vg), amount)));
+            vb = v_clamp01(v_add(vb, v_mul(v_sub(mx, vb), amount)));
+        }
+        if (p.temperature != 5000.f)
+        {
+            v4f amount = v_set(plan.temperatureAmount);
+            v4f* ch[3] = { &vr, &vg, &vb };
+            const float warm[3] = { 0.93f, 0.54f, 0.0f };
+            for (int k = 0; k < 3; k++)
+            {
+                v4f x = *ch[k], w = v_set(warm[k]);
+                v4f lo = v_mul(v_mul(two, x), w);
+                v4f hi = v_sub(one, v_mul(v_mul(two, v_sub(one, x)), v_sub(one, w)));
+                v4f processed = v_select_lt(x, half, lo, hi);
+                *ch[k] = v_clamp01(v_add(x, v_mul(v_sub(processed, x), amount)));
+            }
+        }
+        v_store(r + i, vr); v_store(g + i, vg); v_store(b + i, vb);
+    }
+}
+
+template<typename T> struct SampleTraits;
+template<> struct SampleTraits<uint8_t>
+{
+    static float ToFloat(uint8_t v) { return v * (1.f / 255.f); }
+    static uint8_t FromFloat(float v) { return (uint8_t)(Clamp01(v) * 255.f + 0.5f); }
+};
+template<> struct SampleTraits<uint16_t>
+{
+    static float ToFloat(uint16_t v) { return v * (1.f / 65535.f); }
+    static uint16_t FromFloat(float v) { return (uint16_t)(Clamp01(v) * 65535.f + 0.5f); }
+};
+template<> struct SampleTraits<float>
+{
+    static float ToFloat(float v) { return v; }
+    static float FromFloat(float v) { return v; }
+};
+
+template<typename TS, typename TD>
+static void ProcessRows(const ColorAdjustPlan& plan, const ImGui::ImMat& src, ImGui::ImMat& dst, int y0, int y1, bool reference)
+{
+    alignas(16) float r[COLOR_ADJUST_CHUNK], g[COLOR_ADJUST_CHUNK], b[COLOR_ADJUST_CHUNK];
+    const int c = src.c;
+    for (int y = y0; y < y1; y++)
+    {
+        const TS* in = (const TS*)src.data + (size_t)y * src.w * c;
+        TD* out = (TD*)dst.data + (size_t)y * dst.w * c;
+        for (int x0 = 0; x0 < src.w; x0 += COLOR_ADJUST_CHUNK)
+        {
+            const int n = std::min(COLOR_ADJUST_CHUNK, src.w - x0);
+            const TS* pin = in + (size_t)x0 * c;
+            for (int i = 0; i < n; i++)
+            {
+                r[i] = SampleTraits<TS>::ToFloat(pin[i * c + 0]);
+                g[i] = SampleTraits<TS>::ToFloat(pin[i * c + 1]);
+                b[i] = SampleTraits<TS>::ToFloat(pin[i * c + 2]);
+            }
+            const int n4 = (n + 3) & ~3;
+            for (int i = n; i < n4; i++)
+                r[i] = g[i] = b[i] = 0.f;
+            if (reference)
+            {
+                for (int i = 0; i < n; i++)
+                {
+                    float rgb[3] = { r[i], g[i], b[i] };
+                    ColorAdjustPixel(plan.params, rgb);
+                    r[i] = rgb[0]; g[i] = rgb[1]; b[i] = rgb[2];
+                }
+            }
+            else
+                ApplyPlan(plan, r, g, b, n4);
+            TD* pout = out + (size_t)x0 * c;
+            for (int i = 0; i < n; i++)
+            {
+                pout[i * c + 0] = SampleTraits<TD>::FromFloat(r[i]);
+                pout[i * c + 1] = SampleTraits<TD>::FromFloat(g[i]);
+                pout[i * c + 2] = SampleTraits<TD>::FromFloat(b[i]);
+                if (c == 4)
+                    pout[i * c + 3] = SampleTraits<TD>::FromFloat(SampleTraits<TS>::ToFloat(pin[i * c + 3]));
+            }
+        }
+    }
+}
+
+template<typename TS>
+static void ProcessRowsTo(const ColorAdjustPlan& plan, const ImGui::ImMat& src, ImGui::ImMat& dst, int y0, int y1, bool reference)
+{
+    if (dst.type == IM_DT_INT8)
+        ProcessRows<TS, uint8_t>(plan, src, dst, y0, y1, reference);
+    else if (dst.type == IM_DT_INT16)
+        ProcessRows<TS, uint16_t>(plan, src, dst, y0, y1, reference);
+    else
+        ProcessRows<TS, float>(plan, src, dst, y0, y1, reference);
+}
+
+static void ProcessBand(const ColorAdjustPlan& plan, const ImGui::ImMat& src, ImGui::ImMat& dst, int y0, int y1, bool reference)
+{
+    if (src.type == IM_DT_INT8)
+        ProcessRowsTo<uint8_t>(plan, src, dst, y0, y1, reference);
+    else if (src.type == IM_DT_INT16)
+        ProcessRowsTo<uint16_t>(plan, src, dst, y0, y1, reference);
+    else
+        ProcessRowsTo<float>(plan, src, dst, y0, y1, reference);
+}
+
+static inline bool IsSupportedType(ImDataType type)
+{
+    return type == IM_DT_INT8 || type == IM_DT_INT16 || type == IM_DT_FLOAT32;
+}
+
+static double RunMat(const ColorAdjustParams& params, const ImGui::ImMat& src, ImGui::ImMat& dst, int threads, bool reference)
+{
+    if (src.empty() || src.device != IM_DD_CPU || (src.c != 3 && src.c != 4) || !IsSupportedType(src.type))
+        return -1;
+    auto start = std::chrono::steady_clock::now();
+    ImDataType type = IsSupportedType(dst.type) ? dst.type : src.type;
+    ImGui::ImMat out;
+    out.create_type(src.w, src.h, src.c, type);
+    if (out.empty())
+        return -1;
+    out.copy_attribute(src);
+    const ColorAdjustPlan plan = MakePlan(params);
+
+    // bands of at least 16 rows, smaller ones cost more to start than to run
+    if (threads <= 0)
+        threads = std::max(1, (int)std::thread::hardware_concurrency());
+    threads = std::max(1, std::min(threads, src.h / 16));
+    const int band = (src.h + threads - 1) / threads;
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads; i++)
+    {
+        const int y0 = i * band;
+        const int y1 = std::min(src.h, y0 + band);
+        if (y0 < y1)
+            workers.emplace_back(ProcessBand, std::cref(plan), std::cref(src), std::ref(out), y0, y1, reference);
+    }
+    ProcessBand(plan, src, out, 0, std::min(src.h, band), reference);
+    for (auto& worker : workers)
+        worker.join();
+    dst = out;
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+double ColorAdjustMat(const ColorAdjustParams& params, const ImGui::ImMat& src, ImGui::ImMat& dst, int threads)
+{
+    return RunMat(params, src, dst, threads, false);
+}
+
+double ColorAdjustMatReference(const ColorAdjustParams& params, const ImGui::ImMat& src, ImGui::ImMat& dst)
+{
+    return RunMat(params, src, dst, 1, true);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <string>
+#include <immat.h>
+
+// Nodes per side of the lut Color Adjust bakes for its vulkan path
+#define COLOR_ADJUST_LUT_SIZE       65
+
+// Parameters of the pointwise colour filters, with the same meaning and
+// defaults as the Brightness, Contrast, Gamma, Exposure, Saturation, Hue,
+// Vibrance and Whitebalance nodes. Default values leave a stage out.
+struct ColorAdjustParams
+{
+    float brightness    {0.0f};     // -1 ~ 1, added
+    float contrast      {1.0f};     // around 0.5
+    float gamma         {1.0f};     // 0 ~ 4, power
+    float exposure      {0.0f};     // -2 ~ 2, stops
+    float saturation    {1.0f};     // 0 ~ 2
+    float hue           {0.0f};     // degree
+    float vibrance      {0.0f};     // -4 ~ 4
+    float temperature   {5000.0f};  // 2000 ~ 8000 kelvin
+
+    // number of stages that change the image, which is the number of passes
+    // the unfused chain would take
+    int ActiveStages() const;
+    bool operator==(const ColorAdjustParams& other) const;
+    bool operator!=(const ColorAdjustParams& other) const { return !(*this == other); }
+};
+
+// Runs the chain in the order listed above on one rgb pixel in [0, 1], with
+// the math of the corresponding vulkan shaders. Each stage clamps to [0, 1]
+// like the INT8 mats between unfused nodes do.
+void ColorAdjustPixel(const ColorAdjustParams& params, float rgb[3]);
+
+// Bakes the chain into a size^3 rgba float lut for LUT3D_vulkan (blue moves
+// fastest, then green, then red), domain [0, 1]. The nodes of the per channel
+// stages are fitted to the 8 bit inputs between them rather than sampled.
+void ColorAdjustBakeLut(const ColorAdjustParams& params, int size, float* lut);
+
+// CPU backend of the chain for INT8, INT16 and FLOAT32 cpu mats with 3 or 4
+// interleaved channels, alpha is copied. dst keeps its type if it is one of
+// those, otherwise takes the src type. Pixels are processed with SSE2/NEON in
+// row bands over 'threads' (0 = hardware concurrency). Returns the processing
+// time in ms, or -1 if the mat is not supported.
+double ColorAdjustMat(const ColorAdjustParams& params, const ImGui::ImMat& src, ImGui::ImMat& dst, int threads = 0);
+// Same contract with ColorAdjustPixel on every pixel, the scalar reference
+double ColorAdjustMatReference(const ColorAdjustParams& params, const ImGui::ImMat& src, ImGui::ImMat& dst);
@@ -0,0 +1,22 @@
+#pragma once
+#include <UI.h>
+#include <ImVulkanShader.h>
+#include "ColorAdjust.h"
+
+// What the colour nodes run on a worker without a vulkan device: for a cpu
+// mat_in when there is no gpu, ColorAdjustMat with params writes out in type
+// (the mat_in type when IM_DT_UNDEFINED) and sets the node time. False when
+// the node should take its vulkan path.
+inline bool ColorAdjustCpuFallback(const ColorAdjustParams& params, const ImGui::ImMat& mat_in, ImDataType type, BluePrint::Node& node, BluePrint::MatPin& out)
+{
+    if (mat_in.device != IM_DD_CPU || ImGui::get_gpu_count() > 0)
+        return false;
+    ImGui::ImMat im_cpu;
+    im_cpu.type = type == IM_DT_UNDEFINED ? mat_in.type : type;
+    double time_ms = ColorAdjustMat(params, mat_in, im_cpu);
+    if (time_ms < 0)
+        return false;
+    node.m_NodeTimeMs = time_ms;
+    out.SetValue(im_cpu);
+    return true;
+}
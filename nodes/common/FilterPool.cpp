@@ -0,0 +1,45 @@
+#include "FilterPool.h"
+
+bool FilterStream::Discontinuity(const ImGui::ImMat& mat)
+{
+    bool discontinuity = false;
+    if (!m_started)
+    {
+        m_started = true;
+        discontinuity = true;
+    }
+    else if (mat.w != m_width || mat.h != m_height || mat.c != m_channels)
+    {
+        discontinuity = true;
+    }
+    else
+    {
+        double delta = mat.time_stamp - m_time_stamp;
+        if (delta < 0)
+            discontinuity = true;
+        else if (delta > 0)
+        {
+            if (m_interval > 0 && delta > m_interval * FILTER_STREAM_JUMP_FRAMES)
+                discontinuity = true;
+            else
+                m_interval = delta;
+        }
+    }
+    if (discontinuity)
+    {
+        // frame rate of the new segment may differ, learn it again
+        m_interval = 0;
+        m_discontinuities++;
+    }
+    m_width = mat.w;
+    m_height = mat.h;
+    m_channels = mat.c;
+    m_time_stamp = mat.time_stamp;
+    return discontinuity;
+}
+
+void FilterStream::Reset()
+{
+    m_started = false;
+    m_interval = 0;
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <immat.h>
+
+// Filter instances a node keeps alive, one per input geometry
+#define FILTER_POOL_CAPACITY_DEFAULT    3
+// A time_stamp step larger than this many frame intervals is a jump
+#define FILTER_STREAM_JUMP_FRAMES       4
+
+// Filters built for a fixed (width, height, channels, gpu) held by one node.
+// The vulkan filters allocate their buffers for the size they are built with,
+// so instead of deleting the filter whenever the input size changes the node
+// keeps up to 'capacity' of them and switches between them; the least recently
+// used one is dropped when a new geometry does not fit. A timeline alternating
+// between clips of a few resolutions then stops reallocating at every cut.
+// Not thread safe, a node uses it from Execute only.
+template<typename T>
+class FilterPool
+{
+public:
+    explicit FilterPool(size_t capacity = FILTER_POOL_CAPACITY_DEFAULT) : m_capacity(capacity > 0 ? capacity : 1) {}
+
+    // filter built for the geometry, 'creator' is called only when none is pooled
+    T* Get(int width, int height, int channels, int gpu, std::function<T* ()> creator)
+    {
+        m_clock++;
+        for (auto& entry : m_entries)
+        {
+            if (entry.width == width && entry.height == height && entry.channels == channels && entry.gpu == gpu)
+            {
+                entry.last_used = m_clock;
+                return entry.filter.get();
+            }
+        }
+        T* filter = creator();
+        if (!filter)
+            return nullptr;
+        m_allocations++;
+        if (m_entries.size() >= m_capacity)
+        {
+            auto oldest = m_entries.begin();
+            for (auto iter = m_entries.begin(); iter != m_entries.end(); iter++)
+                if (iter->last_used < oldest->last_used) oldest = iter;
+            m_entries.erase(oldest);
+        }
+        m_entries.push_back({width, height, channels, gpu, m_clock, std::unique_ptr<T>(filter)});
+        return filter;
+    }
+    void Clear() { m_entries.clear(); }
+
+    size_t Size() const { return m_entries.size(); }
+    size_t Capacity() const { return m_capacity; }
+    uint64_t Allocations() const { return m_allocations; }
+
+private:
+    struct Entry
+    {
+        int width;
+        int height;
+        int channels;
+        int gpu;
+        uint64_t last_used;
+        std::unique_ptr<T> filter;
+    };
+    std::vector<Entry> m_entries;
+    size_t m_capacity;
+    uint64_t m_clock {0};
+    uint64_t m_allocations {0};
+};
+
+// Watches the frames a temporal filter is fed and tells when its history no
+// longer belongs to the incoming frame: the geometry changed (a cut between
+// clips) or time_stamp went back or skipped ahead by more than
+// FILTER_STREAM_JUMP_FRAMES frame intervals (a seek). The same time_stamp
+// again is a re-render of the frame, not a discontinuity.
+class FilterStream
+{
+public:
+    bool Discontinuity(const ImGui::ImMat& mat);
+    void Reset();
+
+    uint64_t Discontinuities() const { return m_discontinuities; }
+
+private:
+    bool m_started {false};
+    int m_width {0};
+    int m_height {0};
+    int m_channels {0};
+    double m_time_stamp {0};
+    double m_interval {0};
+    uint64_t m_discontinuities {0};
+};
@@ -0,0 +1,526 @@
+#include "HQDN3DCpu.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <thread>
+
+// rows of a band of the horizontal pass, and columns of a strip of the vertical one
+#define HQDN3D_BAND_ROWS    16
+#define HQDN3D_STRIP_COLS   64
+
+// table precision of ffmpeg, 4 bits below the 8 bit difference up to depth 15
+static inline int LutBits(int depth)
+{
+    return depth == 16 ? 8 : 4;
+}
+
+// ffmpeg's precalc_coefs, entry 0 flags whether the stage is on
+static void PrecalcCoefs(double dist25, int depth, int16_t* ct)
+{
+    const int lut_bits = LutBits(depth);
+    double gamma = log(0.25) / log(1.0 - std::min(dist25, 252.0) / 255.0 - 0.00001);
+    for (int i = -256 * (1 << lut_bits); i < 256 * (1 << lut_bits); i++)
+    {
+        // midpoint of the bin
+        double f = (i * (1 << (9 - lut_bits)) + (1 << (8 - lut_bits)) - 1) / 512.0;
+        double simil = std::max(0.0, 1.0 - fabs(f) / 255.0);
+        double C = pow(simil, gamma) * 256.0 * f;
+        ct[(256 << lut_bits) + i] = (int16_t)lrint(C);
+    }
+    ct[0] = dist25 != 0;
+}
+
+// 'coef' points at the middle of the table, 'shift' is 8 - lut bits
+static inline uint32_t LowPass(int prev, int cur, const int16_t* coef, int shift)
+{
+    int d = (prev - cur) >> shift;
+    return cur + coef[d];
+}
+
+// samples scaled to 16 bit with half of the dropped range added, as ffmpeg does
+template<typename T>
+static inline int Load(const T* src, int x, int depth)
+{
+    return (src[x] << (16 - depth)) + (((1 << (16 - depth)) - 1) >> 1);
+}
+
+template<typename T>
+static inline void Store(T* dst, int x, uint32_t val, int depth)
+{
+    dst[x] = (T)(val >> (16 - depth));
+}
+
+// rows [y0, y1) in bands of at least 16 rows over 'threads'
+static void ParallelRows(int height, int threads, const std::function<void (int, int)>& func)
+{
+    threads = std::max(1, std::min(threads, height / HQDN3D_BAND_ROWS));
+    const int band = (height + threads - 1) / threads;
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads; i++)
+    {
+        const int y0 = i * band;
+        const int y1 = std::min(height, y0 + band);
+        if (y0 < y1)
+            workers.emplace_back(func, y0, y1);
+    }
+    func(0, std::min(height, band));
+    for (auto& worker : workers)
+        worker.join();
+}
+
+static inline int ResolveThreads(int threads)
+{
+    return threads > 0 ? threads : std::max(1, (int)std::thread::hardware_concurrency());
+}
+
+void HQDN3DCpu::SetParam(float lum_spac, float chrom_spac, float lum_tmp, float chrom_tmp)
+{
+    // tables are rebuilt by GetTables when these no longer match them
+    m_strength[0] = lum_spac;
+    m_strength[1] = chrom_spac;
+    m_strength[2] = lum_tmp;
+    m_strength[3] = chrom_tmp;
+}
+
+void HQDN3DCpu::Reset()
+{
+    for (auto& history : m_history)
+        history.frame.clear();
+}
+
+const HQDN3DCpu::Tables& HQDN3DCpu::GetTables(int depth)
+{
+    Tables& tables = m_tables[depth == 16 ? 1 : 0];
+    if (tables.valid && std::equal(m_strength, m_strength + 4, tables.strength))
+        return tables;
+    const size_t size = (size_t)512 << LutBits(depth);
+    for (int i = 0; i < 4; i++)
+    {
+        tables.coefs[i].resize(size);
+        PrecalcCoefs(m_strength[i], depth, tables.coefs[i].data());
+        tables.strength[i] = m_strength[i];
+    }
+    tables.valid = true;
+    return tables;
+}
+
+HQDN3DCpu::History& HQDN3DCpu::GetHistory(int plane, int width, int height, int depth)
+{
+    History& history = m_history[std::max(0, std::min(plane, 3))];
+    if (history.width != width || history.height != height || history.depth != depth)
+    {
+        history.width = width;
+        history.height = height;
+        history.depth = depth;
+        history.frame.clear();
+    }
+    return history;
+}
+
+// the first frame is its own history
+template<typename T>
+static void InitRows(const T* src, int src_stride, uint16_t* frame, int width, int y0, int y1, int depth)
+{
+    for (int y = y0; y < y1; y++)
+    {
+        const T* s = src + (size_t)y * src_stride;
+        uint16_t* f = frame + (size_t)y * width;
+        for (int x = 0; x < width; x++)
+            f[x] = Load(s, x, depth);
+    }
+}
+
+// Horizontal pass of rows [y0, y1): each row is its own recurrence, four of
+// them are run side by side so the table lookups of one hide the latency of
+// the others. Row 0 starts with a low-pass of its first sample on itself and
+// the others with the sample as is, like ffmpeg's denoise_spatial.
+template<typename T>
+static void HorizontalRows(const T* src, int src_stride, uint16_t* line, int width, int y0, int y1, int depth, const int16_t* spatial, int shift)
+{
+    auto first = [&](const T* s, int y) -> uint32_t {
+        uint32_t p = Load(s, 0, depth);
+        return y == 0 ? LowPass(p, p, spatial, shift) : p;
+    };
+    int y = y0;
+    for (; y + 4 <= y1; y += 4)
+    {
+        const T* s0 = src + (size_t)y * src_stride;
+        const T* s1 = s0 + src_stride;
+        const T* s2 = s1 + src_stride;
+        const T* s3 = s2 + src_stride;
+        uint16_t* l0 = line + (size_t)y * width;
+        uint16_t* l1 = l0 + width;
+        uint16_t* l2 = l1 + width;
+        uint16_t* l3 = l2 + width;
+        uint32_t p0 = l0[0] = first(s0, y);
+        uint32_t p1 = l1[0] = first(s1, y + 1);
+        uint32_t p2 = l2[0] = first(s2, y + 2);
+        uint32_t p3 = l3[0] = first(s3, y + 3);
+        for (int x = 1; x < width; x++)
+        {
+            l0[x] = p0 = LowPass(p0, Load(s0, x, depth), spatial, shift);
+            l1[x] = p1 = LowPass(p1, Load(s1, x, depth), spatial, shift);
+            l2[x] = p2 = LowPass(p2, Load(s2, x, depth), spatial, shift);
+            l3[x] = p3 = LowPass(p3, Load(s3, x, depth), spatial, shift);
+        }
+    }
+    for (; y < y1; y++)
+    {
+        const T* s = src + (size_t)y * src_stride;
+        uint16_t* l = line + (size_t)y * width;
+        uint32_t p = l[0] = first(s, y);
+        for (int x = 1; x < width; x++)
+            l[x] = p = LowPass(p, Load(s, x, depth), spatial, shift);
+    }
+}
+
+// Vertical and temporal pass of rows [y0, y1) over columns [x0, x1). Columns
+// are independent, the vertical result replaces the horizontal one in 'line'
+// and is what the row below reads. Without 'line' only the temporal pass runs.
+template<typename T>
+static void VerticalRows(const T* src, int src_stride, T* dst, int dst_stride, uint16_t* line, uint16_t* frame, int width, int x0, int x1, int y0, int y1,
+                         int depth, const int16_t* spatial, const int16_t* temporal, int shift)
+{
+    for (int y = y0; y < y1; y++)
+    {
+        T* d = dst + (size_t)y * dst_stride;
+        uint16_t* f = frame + (size_t)y * width;
+        if (!line)
+        {
+            const T* s = src + (size_t)y * src_stride;
+            for (int x = x0; x < x1; x++)
+            {
+                uint32_t t = f[x] = LowPass(f[x], Load(s, x, depth), temporal, shift);
+                Store(d, x, t, depth);
+            }
+        }
+        else if (y == 0)
+        {
+            const uint16_t* l = line;
+            for (int x = x0; x < x1; x++)
+            {
+                uint32_t t = f[x] = LowPass(f[x], l[x], temporal, shift);
+                Store(d, x, t, depth);
+            }
+        }
+        else
+        {
+            uint16_t* l = line + (size_t)y * width;
+            const uint16_t* up = l - width;
+            for (int x = x0; x < x1; x++)
+            {
+                uint32_t v = l[x] = LowPass(up[x], l[x], spatial, shift);
+                uint32_t t = f[x] = LowPass(f[x], v, temporal, shift);
+                Store(d, x, t, depth);
+            }
+        }
+    }
+}
+
+template<typename T>
+void HQDN3DCpu::RunPlane(History& history, bool chroma, const T* src, int src_stride, T* dst, int dst_stride, int width, int height, int depth, int threads)
+{
+    const Tables& tables = GetTables(depth);
+    const int shift = 8 - LutBits(depth);
+    const int16_t* spatial = tables.coefs[chroma ? 1 : 0].data();
+    const int16_t* temporal = tables.coefs[chroma ? 3 : 2].data() + (256 << LutBits(depth));
+    const bool spatial_on = spatial[0] != 0;
+    spatial += 256 << LutBits(depth);
+    const bool init = history.frame.empty();
+    if (init)
+        history.frame.resize((size_t)width * height);
+    uint16_t* frame = history.frame.data();
+    uint16_t* line = nullptr;
+    if (spatial_on)
+    {
+        m_line.resize((size_t)width * height);
+        line = m_line.data();
+    }
+
+    const int bands = (height + HQDN3D_BAND_ROWS - 1) / HQDN3D_BAND_ROWS;
+    threads = std::max(1, std::min(ResolveThreads(threads), bands));
+    // two strips per thread at least, so the last ones to finish are short
+    int strip = (width + threads * 2 - 1) / (threads * 2);
+    strip = std::max(HQDN3D_STRIP_COLS, (strip + HQDN3D_STRIP_COLS - 1) / HQDN3D_STRIP_COLS * HQDN3D_STRIP_COLS);
+    const int strips = (width + strip - 1) / strip;
+    std::atomic<int> next_band {0};
+    std::atomic<int> next_strip {0};
+    std::unique_ptr<std::atomic<bool>[]> band_done(new std::atomic<bool>[bands]);
+    for (int b = 0; b < bands; b++)
+        band_done[b].store(false, std::memory_order_relaxed);
+
+    if (threads == 1)
+    {
+        // nothing to wait for, run each band through both passes while it is in cache
+        for (int b = 0; b < bands; b++)
+        {
+            const int y0 = b * HQDN3D_BAND_ROWS;
+            const int y1 = std::min(height, y0 + HQDN3D_BAND_ROWS);
+            if (init)
+                InitRows(src, src_stride, frame, width, y0, y1, depth);
+            if (line)
+                HorizontalRows(src, src_stride, line, width, y0, y1, depth, spatial, shift);
+            VerticalRows(src, src_stride, dst, dst_stride, line, frame, width, 0, width, y0, y1, depth, spatial, temporal, shift);
+        }
+        return;
+    }
+
+    auto worker = [&]() {
+        // every row band is claimed before any thread takes a strip, so the
+        // waits below only cover bands other threads are still running
+        for (int b; (b = next_band.fetch_add(1)) < bands;)
+        {
+            const int y0 = b * HQDN3D_BAND_ROWS;
+            const int y1 = std::min(height, y0 + HQDN3D_BAND_ROWS);
+            if (init)
+                InitRows(src, src_stride, frame, width, y0, y1, depth);
+            if (line)
+                HorizontalRows(src, src_stride, line, width, y0, y1, depth, spatial, shift);
+            band_done[b].store(true, std::memory_order_release);
+        }
+        for (int s; (s = next_strip.fetch_add(1)) < strips;)
+        {
+            const int x0 = s * strip;
+            const int x1 = std::min(width, x0 + strip);
+            for (int b = 0; b < bands; b++)
+            {
+                while (!band_done[b].load(std::memory_order_acquire))
+                    std::this_thread::yield();
+                const int y0 = b * HQDN3D_BAND_ROWS;
+                const int y1 = std::min(height, y0 + HQDN3D_BAND_ROWS);
+                VerticalRows(src, src_stride, dst, dst_stride, line, frame, width, x0, x1, y0, y1, depth, spatial, temporal, shift);
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads; i++)
+        workers.emplace_back(worker);
+    worker();
+    for (auto& thread : workers)
+        thread.join();
+}
+
+// ffmpeg's denoise_depth, denoise_spatial and denoise_temporal as they are
+template<typename T>
+void HQDN3DCpu::RunPlaneReference(History& history, bool chroma, const T* src, int src_stride, T* dst, int dst_stride, int width, int height, int depth)
+{
+    const Tables& tables = GetTables(depth);
+    const int shift = 8 - LutBits(depth);
+    const int16_t* spatial = tables.coefs[chroma ? 1 : 0].data();
+    const int16_t* temporal = tables.coefs[chroma ? 3 : 2].data() + (256 << LutBits(depth));
+    const bool spatial_on = spatial[0] != 0;
+    spatial += 256 << LutBits(depth);
+    if (history.frame.empty())
+    {
+        history.frame.resize((size_t)width * height);
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++)
+                history.frame[(size_t)y * width + x] = Load(src + (size_t)y * src_stride, x, depth);
+    }
+    uint16_t* frame_ant = history.frame.data();
+    uint32_t tmp;
+    if (!spatial_on)
+    {
+        for (int y = 0; y < height; y++, src += src_stride, dst += dst_stride, frame_ant += width)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                frame_ant[x] = tmp = LowPass(frame_ant[x], Load(src, x, depth), temporal, shift);
+                Store(dst, x, tmp, depth);
+            }
+        }
+        return;
+    }
+    std::vector<uint16_t> line_ant(width);
+    uint32_t pixel_ant = Load(src, 0, depth);
+    for (int x = 0; x < width; x++)
+    {
+        line_ant[x] = tmp = pixel_ant = LowPass(pixel_ant, Load(src, x, depth), spatial, shift);
+        frame_ant[x] = tmp = LowPass(frame_ant[x], tmp, temporal, shift);
+        Store(dst, x, tmp, depth);
+    }
+    for (int y = 1; y < height; y++)
+    {
+        src += src_stride;
+        dst += dst_stride;
+        frame_ant += width;
+        pixel_ant = Load(src, 0, depth);
+        int x;
+        for (x = 0; x < width - 1; x++)
+        {
+            line_ant[x] = tmp = LowPass(line_ant[x], pixel_ant, spatial, shift);
+            pixel_ant = LowPass(pixel_ant, Load(src, x + 1, depth), spatial, shift);
+            frame_ant[x] = tmp = LowPass(frame_ant[x], tmp, temporal, shift);
+            Store(dst, x, tmp, depth);
+        }
+        line_ant[x] = tmp = LowPass(line_ant[x], pixel_ant, spatial, shift);
+        frame_ant[x] = tmp = LowPass(frame_ant[x], tmp, temporal, shift);
+        Store(dst, x, tmp, depth);
+    }
+}
+
+void HQDN3DCpu::FilterPlane(int plane, bool chroma, const void* src, int src_stride, void* dst, int dst_stride, int width, int height, int depth, int threads)
+{
+    if (!src || !dst || width <= 0 || height <= 0 || depth < 8 || depth > 16)
+        return;
+    History& history = GetHistory(plane, width, height, depth);
+    if (depth == 8)
+        RunPlane(history, chroma, (const uint8_t*)src, src_stride, (uint8_t*)dst, dst_stride, width, height, depth, threads);
+    else
+        RunPlane(history, chroma, (const uint16_t*)src, src_stride, (uint16_t*)dst, dst_stride, width, height, depth, threads);
+}
+
+void HQDN3DCpu::FilterPlaneReference(int plane, bool chroma, const void* src, int src_stride, void* dst, int dst_stride, int width, int height, int depth)
+{
+    if (!src || !dst || width <= 0 || height <= 0 || depth < 8 || depth > 16)
+        return;
+    History& history = GetHistory(plane, width, height, depth);
+    if (depth == 8)
+        RunPlaneReference(history, chroma, (const uint8_t*)src, src_stride, (uint8_t*)dst, dst_stride, width, height, depth);
+    else
+        RunPlaneReference(history, chroma, (const uint16_t*)src, src_stride, (uint16_t*)dst, dst_stride, width, height, depth);
+}
+
+static bool IsSupportedType(ImDataType type)
+{
+    return type == IM_DT_INT8 || type == IM_DT_INT16 || type == IM_DT_FLOAT32;
+}
+
+template<typename T>
+static inline float ToUnit(T v);
+template<> inline float ToUnit(uint8_t v) { return v * (1.0f / 255.0f); }
+template<> inline float ToUnit(uint16_t v) { return v * (1.0f / 65535.0f); }
+template<> inline float ToUnit(float v) { return std::max(0.0f, std::min(1.0f, v)); }
+
+template<typename T>
+static inline T FromUnit(float v);
+template<> inline uint8_t FromUnit(float v) { return (uint8_t)lrintf(std::max(0.0f, std::min(1.0f, v)) * 255.0f); }
+template<> inline uint16_t FromUnit(float v) { return (uint16_t)lrintf(std::max(0.0f, std::min(1.0f, v)) * 65535.0f); }
+template<> inline float FromUnit(float v) { return std::max(0.0f, std::min(1.0f, v)); }
+
+static inline uint16_t ToPlane(float v)
+{
+    return (uint16_t)lrintf(std::max(0.0f, std::min(1.0f, v)) * 65535.0f);
+}
+
+// interleaved rows [y0, y1) to Y/Cb/Cr planes, or one plane for a single channel
+template<typename T>
+static void SplitRows(const ImGui::ImMat& src, uint16_t* planes[3], int y0, int y1)
+{
+    const int w = src.w, c = src.c;
+    for (int y = y0; y < y1; y++)
+    {
+        const T* s = (const T*)src.data + (size_t)y * w * c;
+        const size_t row = (size_t)y * w;
+        if (c == 1)
+        {
+            for (int x = 0; x < w; x++)
+                planes[0][row + x] = ToPlane(ToUnit(s[x]));
+            continue;
+        }
+        for (int x = 0; x < w; x++, s += c)
+        {
+            float r = ToUnit(s[0]), g = ToUnit(s[1]), b = ToUnit(s[2]);
+            float luma = 0.299f * r + 0.587f * g + 0.114f * b;
+            planes[0][row + x] = ToPlane(luma);
+            planes[1][row + x] = ToPlane((b - luma) / 1.772f + 0.5f);
+            planes[2][row + x] = ToPlane((r - luma) / 1.402f + 0.5f);
+        }
+    }
+}
+
+template<typename TS, typename TD>
+static void MergeRows(const ImGui::ImMat& src, ImGui::ImMat& dst, uint16_t* planes[3], int y0, int y1)
+{
+    const int w = src.w, c = src.c;
+    const float scale = 1.0f / 65535.0f;
+    for (int y = y0; y < y1; y++)
+    {
+        const TS* s = (const TS*)src.data + (size_t)y * w * c;
+        TD* d = (TD*)dst.data + (size_t)y * w * c;
+        const size_t row = (size_t)y * w;
+        if (c == 1)
+        {
+            for (int x = 0; x < w; x++)
+                d[x] = FromUnit<TD>(planes[0][row + x] * scale);
+            continue;
+        }
+        for (int x = 0; x < w; x++, s += c, d += c)
+        {
+            float luma = planes[0][row + x] * scale;
+            float cb = planes[1][row + x] * scale - 0.5f;
+            float cr = planes[2][row + x] * scale - 0.5f;
+            float r = luma + 1.402f * cr;
+            float b = luma + 1.772f * cb;
+            float g = (luma - 0.299f * r - 0.114f * b) / 0.587f;
+            d[0] = FromUnit<TD>(r);
+            d[1] = FromUnit<TD>(g);
+            d[2] = FromUnit<TD>(b);
+            if (c == 4)
+                d[3] = FromUnit<TD>(ToUnit(s[3]));
+        }
+    }
+}
+
+template<typename TS>
+static void MergeRowsTo(const ImGui::ImMat& src, ImGui::ImMat& dst, uint16_t* planes[3], int y0, int y1)
+{
+    switch (dst.type)
+    {
+        case IM_DT_INT8:    MergeRows<TS, uint8_t>(src, dst, planes, y0, y1); break;
+        case IM_DT_INT16:   MergeRows<TS, uint16_t>(src, dst, planes, y0, y1); break;
+        default:            MergeRows<TS, float>(src, dst, planes, y0, y1); break;
+    }
+}
+
+double HQDN3DCpu::filter(const ImGui::ImMat& src, ImGui::ImMat& dst, int threads)
+{
+    if (src.empty() || src.device != IM_DD_CPU || (src.c != 1 && src.c != 3 && src.c != 4) || !IsSupportedType(src.type))
+        return -1;
+    auto start = std::chrono::steady_clock::now();
+    ImDataType type = IsSupportedType(dst.type) ? dst.type : src.type;
+    ImGui::ImMat out;
+    out.create_type(src.w, src.h, src.c, type);
+    if (out.empty())
+        return -1;
+    out.copy_attribute(src);
+    threads = ResolveThreads(threads);
+
+    const int count = src.c == 1 ? 1 : 3;
+    const size_t size = (size_t)src.w * src.h;
+    uint16_t* planes_in[3] = {nullptr, nullptr, nullptr};
+    uint16_t* planes_out[3] = {nullptr, nullptr, nullptr};
+    for (int i = 0; i < count; i++)
+    {
+        m_planes_in[i].resize(size);
+        m_planes_out[i].resize(size);
+        planes_in[i] = m_planes_in[i].data();
+        planes_out[i] = m_planes_out[i].data();
+    }
+    ParallelRows(src.h, threads, [&](int y0, int y1) {
+        switch (src.type)
+        {
+            case IM_DT_INT8:    SplitRows<uint8_t>(src, planes_in, y0, y1); break;
+            case IM_DT_INT16:   SplitRows<uint16_t>(src, planes_in, y0, y1); break;
+            default:            SplitRows<float>(src, planes_in, y0, y1); break;
+        }
+    });
+    for (int i = 0; i < count; i++)
+    {
+        History& history = GetHistory(i, src.w, src.h, 16);
+        RunPlane(history, i > 0, (const uint16_t*)planes_in[i], src.w, planes_out[i], src.w, src.w, src.h, 16, threads);
+    }
+    ParallelRows(src.h, threads, [&](int y0, int y1) {
+        switch (src.type)
+        {
+            case IM_DT_INT8:    MergeRowsTo<uint8_t>(src, out, planes_out, y0, y1); break;
+            case IM_DT_INT16:   MergeRowsTo<uint16_t>(src, out, planes_out, y0, y1); break;
+            default:            MergeRowsTo<float>(src, out, planes_out, y0, y1); break;
+        }
+    });
+    dst = out;
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <immat.h>
+
+// CPU engine of the HQDN3D denoiser, the algorithm and fixed point of ffmpeg's
+// hqdn3d filter: a recursive low-pass along rows, then down columns, then over
+// time against the previous output kept at 16 bit. The coefficient tables are
+// built once per parameter change. Each frame runs as one loop over row bands
+// (horizontal pass) feeding column strips (vertical and temporal pass) that
+// move down the bands as soon as they are done, on all threads.
+class HQDN3DCpu
+{
+public:
+    // same strengths as HQDN3D_vulkan::SetParam, 0 turns a stage off
+    void SetParam(float lum_spac, float chrom_spac, float lum_tmp, float chrom_tmp);
+    // the next frame starts the history again, like the first one
+    void Reset();
+
+    // Denoise a cpu mat of INT8, INT16 or FLOAT32 with 1, 3 or 4 interleaved
+    // channels. Colour is filtered as full range BT.601 Y/Cb/Cr planes at 16
+    // bit with the luma and chroma strengths, alpha is copied. dst keeps its
+    // type if it is one of those, otherwise takes the src type. Returns the
+    // processing time in ms, or -1 if the mat is not supported.
+    double filter(const ImGui::ImMat& src, ImGui::ImMat& dst, int threads = 0);
+
+    // One plane the way ffmpeg's hqdn3d filters it, for checking against it:
+    // 'depth' 8 reads and writes uint8_t samples, 9 ~ 16 uint16_t ones, strides
+    // are in samples. 'plane' (0 ~ 3) picks the history, 'chroma' the strengths.
+    void FilterPlane(int plane, bool chroma, const void* src, int src_stride, void* dst, int dst_stride, int width, int height, int depth, int threads = 0);
+    // Same with ffmpeg's scalar loops in their order, the reference for the above
+    void FilterPlaneReference(int plane, bool chroma, const void* src, int src_stride, void* dst, int dst_stride, int width, int height, int depth);
+
+private:
+    struct Tables
+    {
+        bool valid {false};
+        float strength[4] {0, 0, 0, 0};
+        std::vector<int16_t> coefs[4];
+    };
+    struct History
+    {
+        int width {0};
+        int height {0};
+        int depth {0};
+        std::vector<uint16_t> frame;
+    };
+
+    const Tables& GetTables(int depth);
+    History& GetHistory(int plane, int width, int height, int depth);
+    template<typename T>
+    void RunPlane(History& history, bool chroma, const T* src, int src_stride, T* dst, int dst_stride, int width, int height, int depth, int threads);
+    template<typename T>
+    void RunPlaneReference(History& history, bool chroma, const T* src, int src_stride, T* dst, int dst_stride, int width, int height, int depth);
+
+private:
+    // luma spatial, chroma spatial, luma temporal, chroma temporal
+    float m_strength[4] {6.0f, 4.0f, 4.5f, 3.375f};
+    // [0] for depth 8 ~ 15, [1] for depth 16, their tables differ in precision
+    Tables m_tables[2];
+    History m_history[4];
+    // horizontal pass output, overwritten in place by the vertical pass
+    std::vector<uint16_t> m_line;
+    std::vector<uint16_t> m_planes_in[3];
+    std::vector<uint16_t> m_planes_out[3];
+};
@@ -0,0 +1,57 @@
+# add_model_package(<plugin>
+#     MODEL <name> SCALE <n> DESTINATION <dir>
+#     PARAM <param array> [BIN <weight array>] [DATA <encrypted weights> KEY <key>]
+#     SOURCES <files holding the arrays>...)
+#
+# Writes <dir>/<name>.model when <plugin> is built. The ncnn arrays are only
+# linked into a small packer run at build time, the plugin loads the package
+# through RealSRCache::Load and maps the weights on first use. DATA weights
+# stay encrypted, they are copied to <dir>/<name>.data and the package only
+# holds the param, the plugin decrypts them in memory with KEY.
+set(MODEL_PACKAGE_COMMON_DIR ${CMAKE_CURRENT_LIST_DIR})
+
+function(add_model_package PLUGIN)
+    cmake_parse_arguments(PACKAGE "" "MODEL;SCALE;DESTINATION;PARAM;BIN;DATA;KEY" "SOURCES" ${ARGN})
+    set(PACKER ${PLUGIN}_packer)
+    set(PACKAGE_FILE ${PACKAGE_DESTINATION}/${PACKAGE_MODEL}.model)
+    add_executable(
+        ${PACKER}
+        ${MODEL_PACKAGE_COMMON_DIR}/ModelPacker.cpp
+        ${MODEL_PACKAGE_COMMON_DIR}/ModelPackage.h
+        ${MODEL_PACKAGE_COMMON_DIR}/ModelPackage.cpp
+        ${MODEL_PACKAGE_COMMON_DIR}/ModelParam.h
+        ${MODEL_PACKAGE_COMMON_DIR}/ModelParam.cpp
+        ${PACKAGE_SOURCES}
+    )
+    target_include_directories(${PACKER} PRIVATE ${MODEL_PACKAGE_COMMON_DIR})
+    target_compile_definitions(${PACKER} PRIVATE MODEL_PACKER_PARAM=${PACKAGE_PARAM})
+    # --unpack decrypts the .data of a package, any packer may need imgui
+    add_dependencies(${PACKER} imgui)
+    target_link_libraries(${PACKER} -L${CMAKE_BINARY_DIR} imgui)
+    set(PACKAGE_OUTPUTS ${PACKAGE_FILE})
+    if (PACKAGE_BIN)
+        target_compile_definitions(${PACKER} PRIVATE MODEL_PACKER_BIN=${PACKAGE_BIN})
+    else()
+        set(PACKAGE_DATA_FILE ${PACKAGE_DESTINATION}/${PACKAGE_MODEL}.data)
+        add_custom_command(
+            OUTPUT ${PACKAGE_DATA_FILE}
+            COMMAND ${CMAKE_COMMAND} -E make_directory ${PACKAGE_DESTINATION}
+            COMMAND ${CMAKE_COMMAND} -E copy ${PACKAGE_DATA} ${PACKAGE_DATA_FILE}
+            DEPENDS ${PACKAGE_DATA}
+            COMMENT "Copying ${PACKAGE_MODEL}.data"
+        )
+        list(APPEND PACKAGE_OUTPUTS ${PACKAGE_DATA_FILE})
+        target_compile_definitions(${PLUGIN} PRIVATE MODEL_PACKAGE_KEY="${PACKAGE_KEY}")
+    endif()
+    # rpath is skipped for the whole build, point the loader at the build libraries
+    add_custom_command(
+        OUTPUT ${PACKAGE_FILE}
+        COMMAND ${CMAKE_COMMAND} -E make_directory ${PACKAGE_DESTINATION}
+        COMMAND ${CMAKE_COMMAND} -E env LD_LIBRARY_PATH=${CMAKE_BINARY_DIR} DYLD_LIBRARY_PATH=${CMAKE_BINARY_DIR}
+                $<TARGET_FILE:${PACKER}> ${PACKAGE_FILE} ${PACKAGE_SCALE}
+        DEPENDS ${PACKER}
+        COMMENT "Packing ${PACKAGE_MODEL}.model"
+    )
+    add_custom_target(${PLUGIN}_model DEPENDS ${PACKAGE_OUTPUTS})
+    add_dependencies(${PLUGIN} ${PLUGIN}_model)
+endfunction()
@@ -0,0 +1,132 @@
+#include <cstdio>
+#include <vector>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "ModelPackage.h"
+
+ModelPackageHolder ModelPackage::Open(const std::string& path)
+{
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp)
+        return nullptr;
+    ModelPackageHeader header;
+    size_t read_size = fread(&header, 1, sizeof(header), fp);
+    fseek(fp, 0, SEEK_END);
+    uint64_t file_size = (uint64_t)ftell(fp);
+    fclose(fp);
+    if (read_size != sizeof(header) || header.magic != MODEL_PACKAGE_MAGIC || header.version != MODEL_PACKAGE_VERSION)
+        return nullptr;
+    if (header.param_size == 0 || header.param_offset + header.param_size > file_size)
+        return nullptr;
+    if (header.flags & MODEL_PACKAGE_FLAG_EXTERNAL_DATA)
+    {
+        if (header.model_offset != 0 || header.model_size != 0)
+            return nullptr;
+    }
+    else if (header.model_size == 0 || header.model_offset + header.model_size > file_size ||
+            header.model_offset % PageSize() != 0)
+        return nullptr;
+    return ModelPackageHolder(new ModelPackage(path, header, file_size));
+}
+
+bool ModelPackage::Write(const std::string& path, const unsigned char* param, size_t param_size,
+                        const unsigned char* model, size_t model_size, uint32_t scale, uint32_t flags)
+{
+    const bool external = (flags & MODEL_PACKAGE_FLAG_EXTERNAL_DATA) != 0;
+    if (!param || !param_size || (external ? (model || model_size) : (!model || !model_size)))
+        return false;
+    ModelPackageHeader header;
+    header.scale = scale;
+    header.flags = flags;
+    header.param_offset = sizeof(header);
+    header.param_size = param_size;
+    if (!external)
+    {
+        header.model_offset = (header.param_offset + param_size + MODEL_PACKAGE_ALIGN - 1) / MODEL_PACKAGE_ALIGN * MODEL_PACKAGE_ALIGN;
+        header.model_size = model_size;
+    }
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (!fp)
+        return false;
+    std::vector<unsigned char> padding(external ? 0 : (size_t)(header.model_offset - header.param_offset - param_size), 0);
+    bool ok = fwrite(&header, 1, sizeof(header), fp) == sizeof(header) &&
+            fwrite(param, 1, param_size, fp) == param_size &&
+            fwrite(padding.data(), 1, padding.size(), fp) == padding.size() &&
+            (external || fwrite(model, 1, model_size, fp) == model_size);
+    ok = fclose(fp) == 0 && ok;
+    if (!ok)
+        remove(path.c_str());
+    return ok;
+}
+
+size_t ModelPackage::PageSize()
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (size_t)info.dwPageSize;
+#else
+    long page_size = sysconf(_SC_PAGESIZE);
+    return page_size > 0 ? (size_t)page_size : 4096;
+#endif
+}
+
+ModelPackage::ModelPackage(const std::string& path, const ModelPackageHeader& header, uint64_t file_size)
+    : m_path(path), m_header(header), m_file_size(file_size)
+{
+}
+
+ModelPackage::~ModelPackage()
+{
+#if defined(_WIN32)
+    if (m_base) UnmapViewOfFile(m_base);
+    if (m_mapping) CloseHandle((HANDLE)m_mapping);
+    if (m_file) CloseHandle((HANDLE)m_file);
+#else
+    if (m_base) munmap((void*)m_base, (size_t)m_file_size);
+#endif
+    m_base = nullptr;
+}
+
+bool ModelPackage::Map()
+{
+    if (m_base)
+        return true;
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(m_path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    void* base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!base)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    m_file = file;
+    m_mapping = mapping;
+    m_base = (const unsigned char*)base;
+#else
+    int fd = open(m_path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    void* base = mmap(nullptr, (size_t)m_file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return false;
+    m_base = (const unsigned char*)base;
+#endif
+    return true;
+}
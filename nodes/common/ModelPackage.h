@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Model package layout, all offsets from the start of file:
+//   ModelPackageHeader
+//   ncnn param blob  (param_offset, param_size)
+//   ncnn weight blob (model_offset, model_size), page aligned so it can be
+//                    mapped and referenced in place
+// A package with MODEL_PACKAGE_FLAG_EXTERNAL_DATA has no weight blob, offset
+// and size are 0. Its weights stay in the encrypted <model>.data next to it
+// and are only decrypted into memory when the network is built.
+#define MODEL_PACKAGE_MAGIC     0x504d4d49 // "IMMP"
+#define MODEL_PACKAGE_VERSION   1
+#define MODEL_PACKAGE_FLAG_EXTERNAL_DATA    0x1
+// Packages are written with the weight blob on this boundary, a whole number of
+// pages for the 4K, 16K and 64K pages of the platforms we run on
+#define MODEL_PACKAGE_ALIGN     65536
+
+struct ModelPackageHeader
+{
+    uint32_t magic          {MODEL_PACKAGE_MAGIC};
+    uint32_t version        {MODEL_PACKAGE_VERSION};
+    uint32_t scale          {1};
+    uint32_t flags          {0};
+    uint64_t param_offset   {0};
+    uint64_t param_size     {0};
+    uint64_t model_offset   {0};
+    uint64_t model_size     {0};
+};
+
+class ModelPackage;
+using ModelPackageHolder = std::shared_ptr<ModelPackage>;
+
+class ModelPackage
+{
+public:
+    // Read and check the header only, nothing is mapped yet.
+    // Returns nullptr if the file is missing, is not a model package or its
+    // weight blob does not start on a page of this system.
+    static ModelPackageHolder Open(const std::string& path);
+    // Write a package, the weight blob at a multiple of MODEL_PACKAGE_ALIGN.
+    // With MODEL_PACKAGE_FLAG_EXTERNAL_DATA model must be nullptr.
+    static bool Write(const std::string& path, const unsigned char* param, size_t param_size,
+                    const unsigned char* model, size_t model_size, uint32_t scale, uint32_t flags = 0);
+    static size_t PageSize();
+
+    ModelPackage(const ModelPackage&) = delete;
+    ModelPackage& operator=(const ModelPackage&) = delete;
+    ~ModelPackage();
+
+    // Map the file read-only, called on first use of the network
+    bool Map();
+    bool IsMapped() const { return m_base != nullptr; }
+
+    const ModelPackageHeader& Header() const { return m_header; }
+    bool ExternalData() const { return (m_header.flags & MODEL_PACKAGE_FLAG_EXTERNAL_DATA) != 0; }
+    const unsigned char* ParamData() const { return m_base ? m_base + m_header.param_offset : nullptr; }
+    size_t ParamSize() const { return (size_t)m_header.param_size; }
+    const unsigned char* ModelData() const { return m_base && !ExternalData() ? m_base + m_header.model_offset : nullptr; }
+    size_t ModelSize() const { return (size_t)m_header.model_size; }
+
+private:
+    ModelPackage(const std::string& path, const ModelPackageHeader& header, uint64_t file_size);
+
+private:
+    std::string m_path;
+    ModelPackageHeader m_header;
+    uint64_t m_file_size {0};
+    const unsigned char* m_base {nullptr};
+#if defined(_WIN32)
+    void* m_file {nullptr};
+    void* m_mapping {nullptr};
+#endif
+};
@@ -0,0 +1,150 @@
+// Build time tool writing the <model>.model package of an AI node, see
+// ModelPackage.cmake. It is compiled once per node with the node's ncnn arrays:
+//   MODEL_PACKER_PARAM  name of the param blob array (<name>_size is its size)
+//   MODEL_PACKER_BIN    name of the weight array, when the weights are embedded
+// Otherwise the package only holds the param and is flagged for external
+// data, the node's encrypted .data file ships next to it as it is.
+// Any packer also converts a package to and from the text .param and .bin
+// the ncnn tools work on, quantize_int8.sh uses that. Unpacking a package
+// with external data takes the key of its .data.
+//
+// usage: packer <out.model> <scale>
+//        packer --unpack <in.model> <out.param> <out.bin> [<key>]
+//        packer --pack <in.param> <in.bin> <scale> <out.model>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "ModelPackage.h"
+#include "ModelParam.h"
+#include <imgui_helper.h>
+
+#define MODEL_PACKER_CONCAT_(a, b)  a##b
+#define MODEL_PACKER_CONCAT(a, b)   MODEL_PACKER_CONCAT_(a, b)
+
+extern const unsigned char MODEL_PACKER_PARAM[];
+extern const size_t MODEL_PACKER_CONCAT(MODEL_PACKER_PARAM, _size);
+#ifdef MODEL_PACKER_BIN
+extern const unsigned char MODEL_PACKER_BIN[];
+extern const size_t MODEL_PACKER_CONCAT(MODEL_PACKER_BIN, _size);
+#endif
+
+static bool ReadFile(const char* path, std::vector<uint8_t>& data)
+{
+    FILE* fp = fopen(path, "rb");
+    if (!fp)
+        return false;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    data.resize(size > 0 ? (size_t)size : 0);
+    bool ok = size > 0 && fread(data.data(), 1, data.size(), fp) == data.size();
+    fclose(fp);
+    return ok;
+}
+
+static bool WriteFile(const char* path, const void* data, size_t size)
+{
+    FILE* fp = fopen(path, "wb");
+    if (!fp)
+        return false;
+    bool ok = fwrite(data, 1, size, fp) == size;
+    return fclose(fp) == 0 && ok;
+}
+
+static int Unpack(const char* model_path, const char* param_path, const char* bin_path, const char* key)
+{
+    auto package = ModelPackage::Open(model_path);
+    std::string text;
+    if (!package || !package->Map())
+    {
+        fprintf(stderr, "can't open %s\n", model_path);
+        return 1;
+    }
+    if (!ModelParam::ToText(package->ParamData(), package->ParamSize(), text))
+    {
+        fprintf(stderr, "can't convert the param of %s\n", model_path);
+        return 1;
+    }
+    const unsigned char* model = package->ModelData();
+    size_t model_size = package->ModelSize();
+    std::vector<uint8_t> data;
+    if (package->ExternalData())
+    {
+        std::string data_path(model_path);
+        data_path = data_path.substr(0, data_path.rfind('.')) + ".data";
+        if (key)
+            ImGuiHelper::ImDecryptFile(data_path, key, data);
+        if (data.empty())
+        {
+            fprintf(stderr, "can't decrypt %s, the key is the KEY of the node's add_model_package\n", data_path.c_str());
+            return 1;
+        }
+        model = data.data();
+        model_size = data.size();
+    }
+    if (!WriteFile(param_path, text.data(), text.size()) || !WriteFile(bin_path, model, model_size))
+    {
+        fprintf(stderr, "can't write %s or %s\n", param_path, bin_path);
+        return 1;
+    }
+    return 0;
+}
+
+static int Pack(const char* param_path, const char* bin_path, const char* scale_text, const char* model_path)
+{
+    std::vector<uint8_t> text, param, model;
+    int scale = atoi(scale_text);
+    if (!ReadFile(param_path, text) || !ReadFile(bin_path, model) || scale <= 0)
+    {
+        fprintf(stderr, "can't read %s or %s, or bad scale %s\n", param_path, bin_path, scale_text);
+        return 1;
+    }
+    if (!ModelParam::FromText(std::string(text.begin(), text.end()), param))
+    {
+        fprintf(stderr, "can't convert %s\n", param_path);
+        return 1;
+    }
+    if (!ModelPackage::Write(model_path, param.data(), param.size(), model.data(), model.size(), (uint32_t)scale))
+    {
+        fprintf(stderr, "can't write %s\n", model_path);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if ((argc == 5 || argc == 6) && !strcmp(argv[1], "--unpack"))
+        return Unpack(argv[2], argv[3], argv[4], argc == 6 ? argv[5] : nullptr);
+    if (argc == 6 && !strcmp(argv[1], "--pack"))
+        return Pack(argv[2], argv[3], argv[4], argv[5]);
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: %s <out.model> <scale>\n", argv[0]);
+        return 1;
+    }
+#ifdef MODEL_PACKER_BIN
+    const unsigned char* model = MODEL_PACKER_BIN;
+    size_t model_size = MODEL_PACKER_CONCAT(MODEL_PACKER_BIN, _size);
+    uint32_t flags = 0;
+#else
+    // the weights stay encrypted in the .data shipped next to the package
+    const unsigned char* model = nullptr;
+    size_t model_size = 0;
+    uint32_t flags = MODEL_PACKAGE_FLAG_EXTERNAL_DATA;
+#endif
+    int scale = atoi(argv[2]);
+    if (scale <= 0)
+    {
+        fprintf(stderr, "%s: bad scale %s\n", argv[0], argv[2]);
+        return 1;
+    }
+    if (!ModelPackage::Write(argv[1], MODEL_PACKER_PARAM, MODEL_PACKER_CONCAT(MODEL_PACKER_PARAM, _size), model, model_size, (uint32_t)scale, flags))
+    {
+        fprintf(stderr, "%s: can't write %s\n", argv[0], argv[1]);
+        return 1;
+    }
+    return 0;
+}
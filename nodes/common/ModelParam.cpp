@@ -0,0 +1,288 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include "ModelParam.h"
+
+#define MODEL_PARAM_MAGIC   7767517
+#define MODEL_PARAM_END     -233
+#define MODEL_PARAM_ARRAY   -23300
+// ints in a param dict stay below this, the bits of a float of any useful
+// magnitude are above it
+#define MODEL_PARAM_INT_MAX (1 << 26)
+
+// ncnn layer type names by type index
+static const char* layer_names[] =
+{
+    "AbsVal", "ArgMax", "BatchNorm", "Bias", "BNLL", "Concat", "Convolution", "Crop",
+    "Deconvolution", "Dropout", "Eltwise", "ELU", "Embed", "Exp", "Flatten", "InnerProduct",
+    "Input", "Log", "LRN", "MemoryData", "MVN", "Pooling", "Power", "PReLU",
+    "Proposal", "Reduction", "ReLU", "Reshape", "ROIPooling", "Scale", "Sigmoid", "Slice",
+    "Softmax", "Split", "SPP", "TanH", "Threshold", "Tile", "RNN", "LSTM",
+    "BinaryOp", "UnaryOp", "ConvolutionDepthWise", "Padding", "Squeeze", "ExpandDims", "Normalize", "Permute",
+    "PriorBox", "DetectionOutput", "Interp", "DeconvolutionDepthWise", "ShuffleChannel", "InstanceNorm", "Clip", "Reorg",
+    "YoloDetectionOutput", "Quantize", "Dequantize", "Yolov3DetectionOutput", "PSROIPooling", "ROIAlign", "Packing", "Requantize",
+    "Cast", "HardSigmoid", "SELU", "HardSwish", "Noop", "PixelShuffle", "DeepCopy", "Mish",
+    "StatisticsPooling", "Swish", "Gemm", "GroupNorm", "LayerNorm", "Softplus", "GRU", "MultiHeadAttention",
+    "GELU",
+};
+static const int layer_name_count = (int)(sizeof(layer_names) / sizeof(layer_names[0]));
+
+namespace
+{
+struct ParamReader
+{
+    const uint8_t* data;
+    size_t size;
+    size_t pos {0};
+    bool ok {true};
+
+    int32_t Int()
+    {
+        int32_t value = 0;
+        if (pos + 4 > size) { ok = false; return 0; }
+        memcpy(&value, data + pos, 4);
+        pos += 4;
+        return value;
+    }
+    std::string String()
+    {
+        uint64_t length = 0;
+        if (pos + 8 > size) { ok = false; return std::string(); }
+        memcpy(&length, data + pos, 8);
+        pos += 8;
+        if (length > size - pos) { ok = false; return std::string(); }
+        std::string value((const char*)data + pos, (size_t)length);
+        pos += (size_t)length;
+        return value;
+    }
+};
+
+struct ParamWriter
+{
+    std::vector<uint8_t>& data;
+
+    void Int(int32_t value)
+    {
+        const uint8_t* bytes = (const uint8_t*)&value;
+        data.insert(data.end(), bytes, bytes + 4);
+    }
+    void String(const std::string& value)
+    {
+        uint64_t length = value.size();
+        const uint8_t* bytes = (const uint8_t*)&length;
+        data.insert(data.end(), bytes, bytes + 8);
+        data.insert(data.end(), value.begin(), value.end());
+    }
+};
+}
+
+static std::string ValueText(int32_t value)
+{
+    char text[32];
+    if (value > -MODEL_PARAM_INT_MAX && value < MODEL_PARAM_INT_MAX)
+        snprintf(text, sizeof(text), "%d", value);
+    else
+    {
+        float f;
+        memcpy(&f, &value, 4);
+        snprintf(text, sizeof(text), "%.9e", f);
+    }
+    return text;
+}
+
+static int32_t TextValue(const std::string& text)
+{
+    if (text.find_first_of(".eE") == std::string::npos)
+        return (int32_t)strtol(text.c_str(), nullptr, 10);
+    float f = strtof(text.c_str(), nullptr);
+    int32_t value;
+    memcpy(&value, &f, 4);
+    return value;
+}
+
+int32_t ModelParamLayer::Int(int id, int32_t value) const
+{
+    for (auto& param : params)
+    {
+        if (param.id == id && param.values.size() == 1)
+            return param.values[0];
+    }
+    return value;
+}
+
+float ModelParamLayer::Float(int id, float value) const
+{
+    for (auto& param : params)
+    {
+        if (param.id == id && param.values.size() == 1)
+            memcpy(&value, &param.values[0], 4);
+    }
+    return value;
+}
+
+bool ModelParam::Walk(const void* data, size_t size, int& blob_count, const std::function<bool (const ModelParamLayer& layer)>& func)
+{
+    ParamReader reader { (const uint8_t*)data, size };
+    if (!data || reader.Int() != MODEL_PARAM_MAGIC)
+        return false;
+    const int layer_count = reader.Int();
+    blob_count = reader.Int();
+    if (!reader.ok || layer_count <= 0 || blob_count <= 0)
+        return false;
+    for (int l = 0; l < layer_count; l++)
+    {
+        ModelParamLayer layer;
+        layer.type = reader.Int();
+        layer.type_name = layer.type >= 0 && layer.type < layer_name_count ? layer_names[layer.type] : nullptr;
+        layer.name = reader.String();
+        const int bottom_count = reader.Int();
+        const int top_count = reader.Int();
+        if (!reader.ok || bottom_count < 0 || top_count < 0)
+            return false;
+        for (int i = 0; i < bottom_count + top_count; i++)
+        {
+            ModelParamLayer::Blob blob;
+            blob.index = reader.Int();
+            blob.name = reader.String();
+            if (!reader.ok || blob.index < 0 || blob.index >= blob_count)
+                return false;
+            (i < bottom_count ? layer.bottoms : layer.tops).push_back(blob);
+        }
+        for (int id = reader.Int(); reader.ok && id != MODEL_PARAM_END; id = reader.Int())
+        {
+            ModelParamLayer::Value value;
+            value.id = id;
+            if (id <= MODEL_PARAM_ARRAY)
+            {
+                int count = reader.Int();
+                if (count < 0 || (size_t)count * 4 > size - std::min(size, reader.pos))
+                    return false;
+                for (int i = 0; i < count; i++)
+                    value.values.push_back(reader.Int());
+            }
+            else
+                value.values.push_back(reader.Int());
+            layer.params.push_back(value);
+        }
+        if (!reader.ok || !func(layer))
+            return false;
+    }
+    return true;
+}
+
+bool ModelParam::ToText(const void* data, size_t size, std::string& text)
+{
+    std::ostringstream out;
+    int layer_count = 0, blob_count = 0;
+    bool walked = Walk(data, size, blob_count, [&](const ModelParamLayer& layer)
+    {
+        if (!layer.type_name)
+            return false;
+        out << layer.type_name << " " << layer.name << " " << layer.bottoms.size() << " " << layer.tops.size();
+        for (auto& blob : layer.bottoms)
+            out << " " << blob.name;
+        for (auto& blob : layer.tops)
+            out << " " << blob.name;
+        for (auto& param : layer.params)
+        {
+            if (param.id <= MODEL_PARAM_ARRAY)
+            {
+                out << " " << param.id << "=" << param.values.size();
+                for (auto value : param.values)
+                    out << "," << ValueText(value);
+            }
+            else
+                out << " " << param.id << "=" << ValueText(param.values[0]);
+        }
+        out << "\n";
+        layer_count++;
+        return true;
+    });
+    if (!walked)
+        return false;
+    std::ostringstream head;
+    head << MODEL_PARAM_MAGIC << "\n" << layer_count << " " << blob_count << "\n";
+    text = head.str() + out.str();
+    return true;
+}
+
+bool ModelParam::FromText(const std::string& text, std::vector<uint8_t>& data)
+{
+    std::istringstream in(text);
+    int magic = 0, layer_count = 0, blob_count = 0;
+    if (!(in >> magic >> layer_count >> blob_count) || magic != MODEL_PARAM_MAGIC || layer_count <= 0 || blob_count <= 0)
+        return false;
+    std::map<std::string, int> types;
+    for (int i = 0; i < layer_name_count; i++)
+        types[layer_names[i]] = i;
+    std::map<std::string, int> blobs;
+    data.clear();
+    ParamWriter writer { data };
+    writer.Int(MODEL_PARAM_MAGIC);
+    writer.Int(layer_count);
+    writer.Int(blob_count);
+    std::string line;
+    std::getline(in, line);
+    int layers = 0;
+    while (layers < layer_count && std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        std::string type, name;
+        int bottom_count = 0, top_count = 0;
+        if (!(fields >> type))
+            continue;
+        if (!(fields >> name >> bottom_count >> top_count) || !types.count(type) || bottom_count < 0 || top_count < 0)
+            return false;
+        writer.Int(types[type]);
+        writer.String(name);
+        writer.Int(bottom_count);
+        writer.Int(top_count);
+        for (int i = 0; i < bottom_count + top_count; i++)
+        {
+            std::string blob;
+            if (!(fields >> blob))
+                return false;
+            auto it = blobs.find(blob);
+            if (it == blobs.end())
+            {
+                // a bottom must come from an earlier top
+                if (i < bottom_count || (int)blobs.size() >= blob_count)
+                    return false;
+                it = blobs.emplace(blob, (int)blobs.size()).first;
+            }
+            writer.Int(it->second);
+            writer.String(blob);
+        }
+        std::string param;
+        while (fields >> param)
+        {
+            size_t eq = param.find('=');
+            if (eq == std::string::npos)
+                return false;
+            int id = atoi(param.substr(0, eq).c_str());
+            std::string value = param.substr(eq + 1);
+            writer.Int(id);
+            if (id <= MODEL_PARAM_ARRAY)
+            {
+                std::vector<std::string> values;
+                std::istringstream items(value);
+                std::string item;
+                while (std::getline(items, item, ','))
+                    values.push_back(item);
+                if (values.empty() || atoi(values[0].c_str()) != (int)values.size() - 1)
+                    return false;
+                writer.Int((int32_t)values.size() - 1);
+                for (size_t i = 1; i < values.size(); i++)
+                    writer.Int(TextValue(values[i]));
+            }
+            else
+                writer.Int(TextValue(value));
+        }
+        writer.Int(MODEL_PARAM_END);
+        layers++;
+    }
+    return layers == layer_count;
+}
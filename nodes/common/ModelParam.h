@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Conversion between the binary ncnn param the model packages hold and the
+// text .param the ncnn tools (ncnn2table, ncnn2int8) read and write. The
+// binary form keeps layer and blob names: per layer its type index, name,
+// bottom and top blobs as index plus name, then the param dict closed by -233.
+// Strings are a uint64 length followed by the bytes.
+
+// One layer of a binary param as ModelParam::Walk hands it out
+struct ModelParamLayer
+{
+    struct Blob
+    {
+        int index;
+        std::string name;
+    };
+    struct Value
+    {
+        int id;                         // array ids are <= -23300
+        std::vector<int32_t> values;    // one value unless an array
+    };
+    int type;
+    const char* type_name;              // nullptr for a type index without a name here
+    std::string name;
+    std::vector<Blob> bottoms;
+    std::vector<Blob> tops;
+    std::vector<Value> params;
+
+    // scalar param 'id', or 'value' when the layer doesn't set it
+    int32_t Int(int id, int32_t value) const;
+    float Float(int id, float value) const;
+};
+
+struct ModelParam
+{
+    // Call func on every layer of a binary param in order, blob_count is set
+    // before the first call. False if the param can't be read, a blob index is
+    // out of range or func returns false.
+    static bool Walk(const void* data, size_t size, int& blob_count, const std::function<bool (const ModelParamLayer& layer)>& func);
+
+    // Text param of a binary one, false if it can't be read or holds a layer
+    // type without a name here. The binary form doesn't say which values are
+    // floats, a value is written as a float when its bits are not a small int.
+    static bool ToText(const void* data, size_t size, std::string& text);
+    // Binary param of a text one, blob indices in order of first appearance
+    static bool FromText(const std::string& text, std::vector<uint8_t>& data);
+};
@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+#include <imgui_helper.h>
+#include <realsr.h>
+#include "ModelPackage.h"
+#include "RealSRTiler.h"
+#include "RealSRCache.h"
+
+// Key of the encrypted weights of a package with external data, defined by
+// add_model_package for the plugin of a node built from a .data file
+#ifndef MODEL_PACKAGE_KEY
+#define MODEL_PACKAGE_KEY   ""
+#endif
+
+using RealSRCacheKey = std::tuple<std::string, int, bool, bool, int>;
+
+struct RealSRCacheEntry
+{
+    std::weak_ptr<RealSR> network;
+    const RealSR* pointer {nullptr};
+    std::shared_ptr<std::mutex> process_mutex;
+    int radius {-1};
+};
+
+static std::mutex& CacheMutex()
+{
+    static std::mutex cache_mutex;
+    return cache_mutex;
+}
+
+static std::map<RealSRCacheKey, RealSRCacheEntry>& CacheMap()
+{
+    static std::map<RealSRCacheKey, RealSRCacheEntry> cache_map;
+    return cache_map;
+}
+
+// call with the cache mutex held
+static RealSRCacheEntry* FindEntry(const RealSR* realsr)
+{
+    for (auto& it : CacheMap())
+    {
+        if (it.second.pointer == realsr && !it.second.network.expired())
+            return &it.second;
+    }
+    return nullptr;
+}
+
+RealSRHolder RealSRCache::Get(const std::string& model, int device, bool fp16, bool packing, int threads, std::function<RealSRHolder ()> creator)
+{
+    std::lock_guard<std::mutex> lock(CacheMutex());
+    auto& cache = CacheMap();
+    for (auto it = cache.begin(); it != cache.end();)
+    {
+        if (it->second.network.expired()) it = cache.erase(it);
+        else it++;
+    }
+
+    // a GPU network ignores the thread count, don't load it once per count
+    RealSRCacheKey key(model, device, fp16, packing, device < 0 ? threads : 0);
+    auto iter = cache.find(key);
+    if (iter != cache.end())
+    {
+        auto holder = iter->second.network.lock();
+        if (holder) return holder;
+    }
+    if (!creator)
+        return nullptr;
+    RealSRHolder holder = creator();
+    if (!holder)
+        return nullptr;
+    auto& entry = cache[key];
+    entry.network = holder;
+    entry.pointer = holder.get();
+    entry.process_mutex = std::make_shared<std::mutex>();
+    entry.radius = -1;
+    return holder;
+}
+
+RealSRHolder RealSRCache::Load(const std::string& path, const std::string& model, int device, bool fp16, bool packing, int threads)
+{
+    int radius = -1;
+    auto holder = Get(model, device, fp16, packing, threads, [&]() -> RealSRHolder
+    {
+        auto package = ModelPackage::Open(path + model + ".model");
+        if (!package || !package->Map())
+            return nullptr;
+        const unsigned char* model_data = package->ModelData();
+        size_t model_size = package->ModelSize();
+        std::shared_ptr<std::vector<uint8_t>> weights;
+        if (package->ExternalData())
+        {
+            // plain weights only ever exist in this process
+            weights = std::make_shared<std::vector<uint8_t>>();
+            ImGuiHelper::ImDecryptFile(path + model + ".data", MODEL_PACKAGE_KEY, *weights);
+            if (weights->empty())
+                return nullptr;
+            model_data = weights->data();
+            model_size = weights->size();
+        }
+        RealSR* realsr = new RealSR(package->ParamData(), package->ParamSize(), model_data, model_size,
+                                    device, fp16, packing, false /*tta*/, std::max(threads, 1));
+        realsr->scale = package->Header().scale;
+        realsr->prepadding = floor(realsr->scale);
+        radius = RealSRTiler::ReceptiveRadius(package->ParamData(), package->ParamSize());
+        // preload model once, nobody else holds it yet
+        ImGui::ImMat tmp(64, 64, 4, 1u, 4), tmp_out;
+        float progress = 0;
+        realsr->process(tmp, tmp_out, progress);
+        // the package stays mapped, and decrypted weights alive, as long as the network lives
+        return RealSRHolder(realsr, [package, weights](RealSR* p) { delete p; });
+    });
+    if (holder && radius >= 0)
+    {
+        std::lock_guard<std::mutex> lock(CacheMutex());
+        auto entry = FindEntry(holder.get());
+        if (entry) entry->radius = radius;
+    }
+    return holder;
+}
+
+int RealSRCache::Process(RealSR* realsr, const ImGui::ImMat& in, ImGui::ImMat& out, float& progress)
+{
+    // networks built outside the cache share one lock
+    static std::shared_ptr<std::mutex> uncached_mutex = std::make_shared<std::mutex>();
+    if (!realsr)
+        return -1;
+    std::shared_ptr<std::mutex> process_mutex;
+    {
+        std::lock_guard<std::mutex> lock(CacheMutex());
+        auto entry = FindEntry(realsr);
+        process_mutex = entry ? entry->process_mutex : uncached_mutex;
+    }
+    std::lock_guard<std::mutex> lock(*process_mutex);
+    return realsr->process(in, out, progress);
+}
+
+int RealSRCache::ReceptiveRadius(const RealSR* realsr)
+{
+    std::lock_guard<std::mutex> lock(CacheMutex());
+    auto entry = FindEntry(realsr);
+    return entry ? entry->radius : -1;
+}
+
+size_t RealSRCache::Count()
+{
+    std::lock_guard<std::mutex> lock(CacheMutex());
+    size_t count = 0;
+    for (auto& entry : CacheMap())
+    {
+        if (!entry.second.network.expired()) count++;
+    }
+    return count;
+}
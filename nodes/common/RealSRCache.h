@@ -0,0 +1,42 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include <immat.h>
+
+class RealSR;
+
+using RealSRHolder = std::shared_ptr<RealSR>;
+
+struct RealSRCache
+{
+    // Return the network loaded for (model, device, fp16, packing, threads),
+    // calling creator only when no other node holds it. The network is deleted
+    // when the last holder is released, so reopening a project or adding a
+    // second instance of the same node does not decrypt and upload the weights
+    // again. The creator may attach a deleter to keep the memory the weights
+    // live in alive.
+    static RealSRHolder Get(const std::string& model, int device, bool fp16, bool packing, int threads, std::function<RealSRHolder ()> creator);
+
+    // Get() for the network of <path><model>.model. The package is mapped and
+    // the network built and warmed up only when nobody holds it yet, its scale
+    // comes from the package header and its receptive radius from the graph.
+    // The weights of a package with external data are decrypted from
+    // <path><model>.data into memory held by the network.
+    // threads is the ncnn thread count of a CPU network. Returns nullptr if the
+    // package is missing or can't be mapped.
+    static RealSRHolder Load(const std::string& path, const std::string& model, int device, bool fp16, bool packing, int threads = 1);
+
+    // RealSR::process under the lock of the network. Nothing shows that
+    // process() is reentrant and the nodes holding one cached network, or the
+    // threads of an async pipeline, may call it at the same time, so every
+    // call on a network goes through here.
+    static int Process(RealSR* realsr, const ImGui::ImMat& in, ImGui::ImMat& out, float& progress);
+
+    // Input pixels on each side of an output pixel that reach it through the
+    // network, read from the graph by Load(). -1 if unknown.
+    static int ReceptiveRadius(const RealSR* realsr);
+
+    // Number of networks alive in the cache
+    static size_t Count();
+};
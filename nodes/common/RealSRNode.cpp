@@ -0,0 +1,282 @@
+#include <chrono>
+#include <imgui.h>
+#include <ImVulkanShader.h>
+#include <realsr.h>
+#include "ModelPackage.h"
+#include "RealSRTiler.h"
+#include "RealSRNode.h"
+
+static int64_t GetTimeMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+RealSRNode::RealSRNode(const std::string& bench_name, const std::string& model, int features, bool cpu_fp16)
+    : m_model(model), m_features(features), m_cpu_fp16(cpu_fp16), m_bench(bench_name)
+{
+}
+
+RealSRNode::~RealSRNode()
+{
+    // stop the worker before the tile cache its job writes goes
+    m_pipeline.reset();
+}
+
+void RealSRNode::Reset()
+{
+    if (m_pipeline) m_pipeline->Flush();
+    m_temporal_cache.Reset();
+    m_last_mat.release();
+}
+
+bool RealSRNode::Drain(ImGui::ImMat& out)
+{
+    // hand out the last of the frames still in flight instead of dropping them
+    std::vector<ImGui::ImMat> frames;
+    if (!m_pipeline || m_pipeline->Drain(frames) == 0)
+        return false;
+    m_last_mat = frames.back();
+    out = m_last_mat;
+    return true;
+}
+
+int RealSRNode::CPUThreads() const
+{
+    return m_tile_threads > 0 ? m_tile_threads : RealSRTiler::DefaultThreads();
+}
+
+bool RealSRNode::NeedsLoad() const
+{
+    if (!m_model_loaded)
+        return true;
+    if ((m_features & REALSR_NODE_TILED) && (m_cpu != m_loaded_cpu || (m_device < 0 && m_loaded_threads != m_tile_threads)))
+        return true;
+    return (m_features & REALSR_NODE_INT8) && m_int8_requested != m_int8;
+}
+
+void RealSRNode::LoadModel(const std::string& path)
+{
+    // a worker without a GPU runs the frame whole on CPU, tiling stays opt-in
+    m_device = m_cpu ? -1 : ncnn::get_default_gpu_index();
+    m_model_loaded = true;
+    m_loaded_cpu = m_cpu;
+    m_loaded_threads = m_tile_threads;
+    m_temporal_cache.Reset();
+    const int threads = m_device < 0 ? CPUThreads() : 1;
+    int64_t t1 = GetTimeMs();
+    // the int8 network only ships as a model package and only runs on CPU,
+    // the fp32 one is loaded under its own key when that package won't load
+    m_int8_requested = m_int8;
+    m_int8_available = (m_features & REALSR_NODE_INT8) && ModelPackage::Open(path + m_model + "_int8.model") != nullptr;
+    m_realsr = nullptr;
+    if (m_int8_available && m_int8 && m_device < 0)
+        m_realsr = RealSRCache::Load(path, m_model + "_int8", m_device, false /*fp16*/, true /*packing*/, threads);
+    m_int8_loaded = m_realsr != nullptr;
+    if (!m_realsr)
+        m_realsr = RealSRCache::Load(path, m_model, m_device, m_cpu_fp16 || m_device >= 0, true /*packing*/, threads);
+    m_bench.SetWarmupMs(GetTimeMs() - t1);
+}
+
+RealSRSettings RealSRNode::Settings() const
+{
+    RealSRSettings settings;
+    settings.tiled = (m_features & REALSR_NODE_TILED) && m_tiled && m_device < 0;
+    settings.tile_size = m_tile_size;
+    settings.temporal = (m_features & REALSR_NODE_TEMPORAL) && m_temporal;
+    settings.temporal_threshold = m_temporal_threshold;
+    return settings;
+}
+
+bool RealSRNode::Execute(const std::string& path, const ImGui::ImMat& in, ImGui::ImMat& out)
+{
+    if (NeedsLoad())
+    {
+        m_pipeline.reset();
+        LoadModel(path);
+    }
+    if (!m_realsr)
+        return false;
+    if (m_async_depth > 1)
+    {
+        // output lags the input by up to m_async_depth - 1 frames
+        // while it fills, and after a seek dropped it, the previous output is held
+        ImGui::ImMat mat;
+        if (!m_pipeline)
+            m_pipeline.reset(new AsyncMatPipeline(nullptr));
+        bool popped = false;
+        if (in.empty())
+            popped = m_pipeline->Pop(mat);  // end of stream, drain one frame per call
+        else
+        {
+            // the settings are taken now, the UI thread may change them
+            // while the worker runs the frame
+            RealSRHolder realsr = m_realsr;
+            RealSRSettings settings = Settings();
+            m_pipeline->Push(in, [this, realsr, settings](const ImGui::ImMat& in, ImGui::ImMat& out) {
+                return RealSRProcessMat(realsr.get(), settings, &m_temporal_cache, in, out, m_progress);
+            });
+            popped = m_pipeline->InFlight() >= m_async_depth && m_pipeline->Pop(mat);
+        }
+        if (popped)
+        {
+            m_time_ms = m_pipeline->ProcessTimeMs();
+            m_bench.AddFrame(m_pipeline->PoppedWidth(), m_pipeline->PoppedHeight(), m_time_ms);
+            m_last_mat = mat;
+        }
+        out = m_last_mat;
+    }
+    else
+    {
+        m_pipeline.reset();
+        m_time_ms = RealSRProcessMat(m_realsr.get(), Settings(), &m_temporal_cache, in, out, m_progress);
+        m_bench.AddFrame(in.w, in.h, m_time_ms);
+    }
+    return true;
+}
+
+bool RealSRNode::DrawSettings()
+{
+    bool changed = false;
+    if (m_features & REALSR_NODE_TILED)
+    {
+        const bool has_gpu = ncnn::get_default_gpu_index() >= 0;
+        bool cpu = m_cpu || !has_gpu;
+        ImGui::TextUnformatted("Inference Device:"); ImGui::SameLine();
+        ImGui::BeginDisabled(!has_gpu);
+        if (ImGui::RadioButton("GPU", !cpu)) cpu = false;
+        ImGui::EndDisabled();
+        ImGui::SameLine();
+        if (ImGui::RadioButton("CPU", cpu)) cpu = true;
+        if (has_gpu && cpu != m_cpu) { m_cpu = cpu; changed = true; }
+        ImGui::BeginDisabled(!cpu);
+        changed |= ImGui::SliderInt("CPU Threads", &m_tile_threads, 0, RealSRTiler::DefaultThreads(), m_tile_threads > 0 ? "%d" : "Auto", ImGuiSliderFlags_AlwaysClamp);
+        // the whole frame in one pass is the reference, tiles bound the
+        // memory of a CPU run at the cost of the overlap computed again
+        changed |= ImGui::Checkbox("Tiled", &m_tiled);
+        ImGui::EndDisabled();
+        const bool tiled = m_tiled && cpu;
+        ImGui::BeginDisabled(!tiled && !m_temporal);
+        changed |= ImGui::SliderInt("Tile Size", &m_tile_size, REALSR_TILE_SIZE_MIN, REALSR_TILE_SIZE_MAX, "%d", ImGuiSliderFlags_AlwaysClamp);
+        ImGui::EndDisabled();
+        if (m_realsr && (tiled || m_temporal))
+        {
+            int radius = RealSRCache::ReceptiveRadius(m_realsr.get());
+            int overlap = RealSRTiler::Overlap(m_realsr.get(), m_tile_size);
+            ImGui::Text("Overlap: %d px  Receptive Radius: %d px", overlap, radius);
+            if (radius < 0 || overlap < radius)
+                ImGui::TextUnformatted("Seams may differ from the untiled output");
+        }
+        ImGui::Separator();
+    }
+    // no INT8 package ships yet, the choice only shows once one is built
+    // with quantize_int8.sh and placed next to the fp32 one
+    if (m_int8_available)
+    {
+        bool int8 = m_int8;
+        ImGui::TextUnformatted("Precision:"); ImGui::SameLine();
+        ImGui::BeginDisabled(ncnn::get_default_gpu_index() >= 0);
+        if (ImGui::RadioButton(ncnn::get_default_gpu_index() < 0 ? "Quality (FP32)" : "Quality (FP16)", !int8)) int8 = false;
+        ImGui::SameLine();
+        if (ImGui::RadioButton("Speed (INT8)", int8)) int8 = true;
+        ImGui::EndDisabled();
+        if (int8 != m_int8) { m_int8 = int8; changed = true; }
+        if (m_model_loaded && m_int8 && !m_int8_loaded && m_device < 0)
+            ImGui::TextUnformatted("INT8 model not loaded, running FP32");
+        ImGui::Separator();
+    }
+    changed |= ImGui::SliderInt("Async Depth", &m_async_depth, 1, ASYNC_PIPELINE_DEPTH_MAX, m_async_depth > 1 ? "%d" : "Off", ImGuiSliderFlags_AlwaysClamp);
+    if (m_pipeline)
+        ImGui::Text("In Flight: %d  Latency: %d ms", m_pipeline->InFlight(), (int)m_pipeline->LatencyMs());
+    ImGui::Separator();
+    if (m_features & REALSR_NODE_TEMPORAL)
+    {
+        changed |= ImGui::Checkbox("Temporal Reuse", &m_temporal);
+        ImGui::BeginDisabled(!m_temporal);
+        changed |= ImGui::SliderInt("Reuse Threshold", &m_temporal_threshold, 0, REALSR_TEMPORAL_THRESHOLD_MAX, m_temporal_threshold > 0 ? "%d" : "Exact", ImGuiSliderFlags_AlwaysClamp);
+        ImGui::EndDisabled();
+        if (m_temporal)
+            ImGui::Text("Tiles Skipped: %.1f%%", m_temporal_cache.SkippedRatio() * 100.f);
+        ImGui::Separator();
+    }
+    ImGui::Text("Latency p50/p90/p99: %d/%d/%d ms", (int)m_bench.Percentile(50), (int)m_bench.Percentile(90), (int)m_bench.Percentile(99));
+    ImGui::Text("Warm-up: %d ms", (int)m_bench.WarmupMs());
+    return changed;
+}
+
+void RealSRNode::Load(const imgui_json::value& value)
+{
+    if (value.contains("async_depth"))
+    {
+        auto& val = value["async_depth"];
+        if (val.is_number())
+            m_async_depth = val.get<imgui_json::number>();
+    }
+    if ((m_features & REALSR_NODE_TILED) && value.contains("cpu_tiled"))
+    {
+        // projects saved before tiling had its own switch
+        auto& val = value["cpu_tiled"];
+        if (val.is_boolean())
+            m_cpu = m_tiled = val.get<imgui_json::boolean>();
+    }
+    if ((m_features & REALSR_NODE_TILED) && value.contains("cpu"))
+    {
+        auto& val = value["cpu"];
+        if (val.is_boolean())
+            m_cpu = val.get<imgui_json::boolean>();
+    }
+    if ((m_features & REALSR_NODE_TILED) && value.contains("tiled"))
+    {
+        auto& val = value["tiled"];
+        if (val.is_boolean())
+            m_tiled = val.get<imgui_json::boolean>();
+    }
+    if ((m_features & REALSR_NODE_TILED) && value.contains("tile_size"))
+    {
+        auto& val = value["tile_size"];
+        if (val.is_number())
+            m_tile_size = val.get<imgui_json::number>();
+    }
+    if ((m_features & REALSR_NODE_TILED) && value.contains("tile_threads"))
+    {
+        auto& val = value["tile_threads"];
+        if (val.is_number())
+            m_tile_threads = val.get<imgui_json::number>();
+    }
+    if ((m_features & REALSR_NODE_INT8) && value.contains("int8"))
+    {
+        auto& val = value["int8"];
+        if (val.is_boolean())
+            m_int8 = val.get<imgui_json::boolean>();
+    }
+    if ((m_features & REALSR_NODE_TEMPORAL) && value.contains("temporal"))
+    {
+        auto& val = value["temporal"];
+        if (val.is_boolean())
+            m_temporal = val.get<imgui_json::boolean>();
+    }
+    if ((m_features & REALSR_NODE_TEMPORAL) && value.contains("temporal_threshold"))
+    {
+        auto& val = value["temporal_threshold"];
+        if (val.is_number())
+            m_temporal_threshold = val.get<imgui_json::number>();
+    }
+}
+
+void RealSRNode::Save(imgui_json::value& value) const
+{
+    value["async_depth"] = imgui_json::number(m_async_depth);
+    if (m_features & REALSR_NODE_TILED)
+    {
+        value["cpu"] = imgui_json::boolean(m_cpu);
+        value["tiled"] = imgui_json::boolean(m_tiled);
+        value["tile_size"] = imgui_json::number(m_tile_size);
+        value["tile_threads"] = imgui_json::number(m_tile_threads);
+    }
+    if (m_features & REALSR_NODE_INT8)
+        value["int8"] = imgui_json::boolean(m_int8);
+    if (m_features & REALSR_NODE_TEMPORAL)
+    {
+        value["temporal"] = imgui_json::boolean(m_temporal);
+        value["temporal_threshold"] = imgui_json::number(m_temporal_threshold);
+    }
+}
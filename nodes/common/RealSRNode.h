@@ -0,0 +1,82 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <immat.h>
+#include <imgui_json.h>
+#include "AIBenchmark.h"
+#include "AsyncMatPipeline.h"
+#include "RealSRCache.h"
+#include "RealSRProcess.h"
+#include "RealSRTemporal.h"
+
+// Settings an AI node shows besides the async depth
+#define REALSR_NODE_TILED       0x01    // device choice, CPU threads and opt-in tiles
+#define REALSR_NODE_TEMPORAL    0x02    // reuse of unchanged tiles across frames
+#define REALSR_NODE_INT8        0x04    // Speed (INT8) package on CPU, when it ships
+
+// What the AI nodes share around their network: loading it through
+// RealSRCache, the async pipeline, the tile cache, the latency record and the
+// settings UI with its json keys. The node keeps its pins, mat type and logo
+// and forwards Reset, OnStop, Execute, DrawSettingLayout, Load and Save here.
+class RealSRNode
+{
+public:
+    // model is the package name under the node's folder, bench_name the name
+    // of its latency record. cpu_fp16 runs the CPU network in fp16 as well,
+    // off when Quality means fp32 on CPU.
+    RealSRNode(const std::string& bench_name, const std::string& model, int features, bool cpu_fp16 = true);
+    ~RealSRNode();
+
+    RealSRNode(const RealSRNode&) = delete;
+    RealSRNode& operator=(const RealSRNode&) = delete;
+
+    // Drop the frames in flight and the cached tiles
+    void Reset();
+    // Wait for the frames in flight, false if there were none. out is the last.
+    bool Drain(ImGui::ImMat& out);
+    // Run in through the network of <path><model>.model, loading it on first
+    // use and when a setting it was loaded with changed. With an async depth
+    // out is the latest frame done, held while the pipeline fills. False when
+    // the network can't be loaded, the node passes in through then.
+    bool Execute(const std::string& path, const ImGui::ImMat& in, ImGui::ImMat& out);
+    // processing time of the frame out came from
+    int64_t TimeMs() const { return m_time_ms; }
+
+    bool DrawSettings();
+    void Load(const imgui_json::value& value);
+    void Save(imgui_json::value& value) const;
+
+private:
+    bool NeedsLoad() const;
+    void LoadModel(const std::string& path);
+    int CPUThreads() const;
+    RealSRSettings Settings() const;
+
+private:
+    const std::string m_model;
+    const int m_features;
+    const bool m_cpu_fp16;
+    int m_device            {-1};
+    float m_progress        {0.f};
+    RealSRHolder m_realsr;
+    bool m_model_loaded     {false};
+    int64_t m_time_ms       {0};
+    int m_async_depth       {1};
+    std::unique_ptr<AsyncMatPipeline> m_pipeline;
+    ImGui::ImMat m_last_mat;
+    AIBenchmark m_bench;
+    bool m_temporal         {false};
+    int m_temporal_threshold {REALSR_TEMPORAL_THRESHOLD_DEFAULT};
+    RealSRTemporal m_temporal_cache;
+    bool m_cpu              {false};    // CPU even when there is a GPU
+    bool m_loaded_cpu       {false};
+    bool m_tiled            {false};    // CPU network on RealSRTiler tiles
+    int m_tile_size         {REALSR_TILE_SIZE_DEFAULT};
+    int m_tile_threads      {0};
+    int m_loaded_threads    {0};
+    bool m_int8             {false};
+    bool m_int8_requested   {false};
+    bool m_int8_loaded      {false};
+    bool m_int8_available   {false};    // <path><model>_int8.model was found
+};
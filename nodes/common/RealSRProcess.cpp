@@ -0,0 +1,36 @@
+#include <chrono>
+#include <realsr.h>
+#include <ImVulkanShader.h>
+#include "RealSRCache.h"
+#include "RealSRProcess.h"
+
+static int64_t GetTimeMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t RealSRProcessMat(RealSR* realsr, const RealSRSettings& settings, RealSRTemporal* temporal, const ImGui::ImMat& in, ImGui::ImMat& out, float& progress)
+{
+    ImGui::ImMat src_mat;
+    if (in.device != IM_DD_CPU)
+        ImGui::ImVulkanVkMatToImMat(in, src_mat);
+    else
+        src_mat = in;
+    if (!realsr || src_mat.empty())
+    {
+        out = in;
+        return 0;
+    }
+    src_mat.elempack = src_mat.c;
+    int64_t t1 = GetTimeMs();
+    if (settings.temporal && temporal)
+        temporal->Process(realsr, src_mat, out, settings.tile_size, settings.temporal_threshold, progress);
+    else if (settings.tiled)
+        RealSRTiler::Process(realsr, src_mat, out, settings.tile_size, progress);
+    else
+        RealSRCache::Process(realsr, src_mat, out, progress);
+    int64_t t2 = GetTimeMs();
+    out.copy_attribute(in);
+    out.elempack = 1;
+    return t2 - t1;
+}
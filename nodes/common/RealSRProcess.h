@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+#include <immat.h>
+#include "RealSRTiler.h"
+#include "RealSRTemporal.h"
+
+class RealSR;
+
+// How an AI node runs its network on a frame. The nodes and the bench build
+// it from the same settings, so the bench times what the node executes.
+struct RealSRSettings
+{
+    bool tiled              {false};    // split the frame into RealSRTiler tiles
+    int tile_size           {REALSR_TILE_SIZE_DEFAULT};
+    bool temporal           {false};    // reuse the output of unchanged tiles
+    int temporal_threshold  {REALSR_TEMPORAL_THRESHOLD_DEFAULT};
+};
+
+// ProcessMat of the AI nodes: read a vulkan input back to the cpu, run the
+// network on it and give the output the attributes of the input. 'temporal'
+// is the node's tile cache, only needed with settings.temporal.
+// Returns the inference time in ms.
+int64_t RealSRProcessMat(RealSR* realsr, const RealSRSettings& settings, RealSRTemporal* temporal, const ImGui::ImMat& in, ImGui::ImMat& out, float& progress);
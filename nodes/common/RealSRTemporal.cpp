@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <realsr.h>
+#include "RealSRCache.h"
+#include "RealSRTiler.h"
+#include "RealSRTemporal.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+static int RowMaxDiffU8(const uint8_t* a, const uint8_t* b, size_t n)
+{
+    int max_diff = 0;
+    size_t i = 0;
+#if defined(__SSE2__)
+    __m128i vmax = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+        vmax = _mm_max_epu8(vmax, _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va)));
+    }
+    alignas(16) uint8_t lanes[16];
+    _mm_store_si128((__m128i*)lanes, vmax);
+    for (int l = 0; l < 16; l++) max_diff = std::max(max_diff, (int)lanes[l]);
+#elif defined(__ARM_NEON)
+    uint8x16_t vmax = vdupq_n_u8(0);
+    for (; i + 16 <= n; i += 16)
+        vmax = vmaxq_u8(vmax, vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+    uint8_t lanes[16];
+    vst1q_u8(lanes, vmax);
+    for (int l = 0; l < 16; l++) max_diff = std::max(max_diff, (int)lanes[l]);
+#endif
+    for (; i < n; i++)
+        max_diff = std::max(max_diff, std::abs((int)a[i] - (int)b[i]));
+    return max_diff;
+}
+
+// true when any sample of the row moved by more than threshold (8-bit levels)
+static bool RowChanged(const uint8_t* a, const uint8_t* b, size_t samples, ImDataType type, int threshold)
+{
+    switch (type)
+    {
+        case IM_DT_INT8:
+            return RowMaxDiffU8(a, b, samples) > threshold;
+        case IM_DT_INT16:
+        {
+            const uint16_t* a16 = (const uint16_t*)a;
+            const uint16_t* b16 = (const uint16_t*)b;
+            const int threshold16 = threshold << 8;
+            for (size_t i = 0; i < samples; i++)
+                if (std::abs((int)a16[i] - (int)b16[i]) > threshold16) return true;
+            return false;
+        }
+        case IM_DT_FLOAT32:
+        {
+            const float* af = (const float*)a;
+            const float* bf = (const float*)b;
+            const float thresholdf = threshold / 255.f;
+            for (size_t i = 0; i < samples; i++)
+                if (std::fabs(af[i] - bf[i]) > thresholdf) return true;
+            return false;
+        }
+        default:
+            // no cheap per-sample metric, only reuse exact matches
+            return memcmp(a, b, samples * (type == IM_DT_FLOAT16 ? 2 : type == IM_DT_INT32 ? 4 : 8)) != 0;
+    }
+}
+
+bool RealSRTemporal::TileChanged(const ImGui::ImMat& in, int index, int threshold) const
+{
+    const ImGui::ImMat& ref = m_tile_refs[index];
+    if (ref.empty())
+        return true;
+    RealSRTile tile = RealSRTiler::GetTile(index, m_tile_size, m_reach, in.w, in.h);
+    const int width = tile.px1 - tile.px0;
+    const int height = tile.py1 - tile.py0;
+    if (in.elempack > 1 || in.c == 1)
+    {
+        const size_t pixel_size = (size_t)in.c * in.elemsize;
+        for (int y = 0; y < height; y++)
+        {
+            const uint8_t* in_ptr = (const uint8_t*)in.data + ((size_t)(tile.py0 + y) * in.w + tile.px0) * pixel_size;
+            const uint8_t* ref_ptr = (const uint8_t*)ref.data + (size_t)y * ref.w * pixel_size;
+            if (RowChanged(in_ptr, ref_ptr, (size_t)width * in.c, in.type, threshold))
+                return true;
+        }
+    }
+    else
+    {
+        for (int c = 0; c < in.c; c++)
+        {
+            const uint8_t* in_plane = (const uint8_t*)in.data + c * in.cstep * in.elemsize;
+            const uint8_t* ref_plane = (const uint8_t*)ref.data + c * ref.cstep * ref.elemsize;
+            for (int y = 0; y < height; y++)
+            {
+                const uint8_t* in_ptr = in_plane + ((size_t)(tile.py0 + y) * in.w + tile.px0) * in.elemsize;
+                const uint8_t* ref_ptr = ref_plane + (size_t)y * ref.w * ref.elemsize;
+                if (RowChanged(in_ptr, ref_ptr, width, in.type, threshold))
+                    return true;
+            }
+        }
+    }
+    return false;
+}
+
+static ImGui::ImMat TileReference(const ImGui::ImMat& in, const RealSRTile& tile)
+{
+    ImGui::ImMat ref(tile.px1 - tile.px0, tile.py1 - tile.py0, in.c, in.elemsize, in.elempack);
+    ref.type = in.type;
+    RealSRTiler::CopyRect(in, tile.px0, tile.py0, ref, 0, 0, ref.w, ref.h);
+    return ref;
+}
+
+int RealSRTemporal::Process(RealSR* realsr, const ImGui::ImMat& in, ImGui::ImMat& out, int tile_size, int threshold, float& progress)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!realsr || in.empty())
+        return -1;
+    tile_size = std::max(tile_size, REALSR_TILE_SIZE_MIN);
+    threshold = std::max(0, std::min(threshold, REALSR_TEMPORAL_THRESHOLD_MAX));
+    const int tile_count = RealSRTiler::TileCount(in.w, in.h, tile_size);
+    const int overlap = RealSRTiler::Overlap(realsr, tile_size);
+    const int radius = RealSRCache::ReceptiveRadius(realsr);
+    const int reach = radius >= 0 ? radius : overlap;
+    bool history = !m_output.empty() && m_width == in.w && m_height == in.h && m_channels == in.c &&
+                    m_type == in.type && m_tile_size == tile_size && m_overlap == overlap && m_reach == reach && (int)m_tile_refs.size() == tile_count;
+
+    std::vector<int> tiles;
+    if (history)
+    {
+        for (int i = 0; i < tile_count; i++)
+        {
+            if (TileChanged(in, i, threshold))
+                tiles.push_back(i);
+        }
+    }
+    else
+    {
+        m_tile_refs.assign(tile_count, ImGui::ImMat());
+        m_width = in.w;
+        m_height = in.h;
+        m_channels = in.c;
+        m_type = in.type;
+        m_tile_size = tile_size;
+        m_overlap = overlap;
+        m_reach = reach;
+    }
+    m_tiles_total += tile_count;
+    if (history)
+        m_tiles_skipped += tile_count - tiles.size();
+
+    int ret = 0;
+    if (!history)
+    {
+        ret = RealSRTiler::Process(realsr, in, out, tile_size, progress);
+        for (int i = 0; i < tile_count && ret == 0; i++)
+            tiles.push_back(i);
+    }
+    else if (tiles.empty())
+    {
+        // nothing moved, the cached frame is never written in place so it can be shared
+        out = m_output;
+        progress = 1.f;
+        return 0;
+    }
+    else
+    {
+        out = m_output.clone();
+        ret = RealSRTiler::ProcessTiles(realsr, in, out, tile_size, tiles, progress);
+    }
+
+    if (ret != 0 || out.empty())
+    {
+        m_output.release();
+        m_tile_refs.clear();
+        return ret != 0 ? ret : -1;
+    }
+    for (auto index : tiles)
+        m_tile_refs[index] = TileReference(in, RealSRTiler::GetTile(index, tile_size, reach, in.w, in.h));
+    m_output = out;
+    return ret;
+}
+
+void RealSRTemporal::Reset()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_output.release();
+    m_tile_refs.clear();
+    m_width = m_height = m_channels = m_tile_size = m_overlap = m_reach = 0;
+    m_type = IM_DT_UNDEFINED;
+}
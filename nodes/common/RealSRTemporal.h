@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <immat.h>
+
+class RealSR;
+
+// Max per-sample difference, in 8-bit levels, a tile may drift from the input
+// its cached output was inferred from before it is run again. 0 = exact match,
+// the output is then the one the tile would be inferred to.
+#define REALSR_TEMPORAL_THRESHOLD_DEFAULT   0
+#define REALSR_TEMPORAL_THRESHOLD_MAX       32
+
+// Static-region skipping for video. The frame is split on the RealSRTiler grid
+// and only tiles whose input moved by more than the threshold since their last
+// inference are run again, the rest reuse the cached output. The input compared
+// is the tile grown by the receptive radius of the network, every pixel its
+// output depends on, or by the overlap when the radius is unknown.
+// Each tile is compared against the input it was last inferred from, not the
+// previous frame, so slow drift can't pile up past the threshold.
+// Above 0 only that input drift is bounded, the error of a reused output is
+// whatever the network makes of it. node_bench reports the output difference
+// for a frame changed in one spot at the default threshold as temporal_max_diff.
+class RealSRTemporal
+{
+public:
+    int Process(RealSR* realsr, const ImGui::ImMat& in, ImGui::ImMat& out, int tile_size, int threshold, float& progress);
+    void Reset();
+
+    uint64_t TilesTotal() const { return m_tiles_total; }
+    uint64_t TilesSkipped() const { return m_tiles_skipped; }
+    float SkippedRatio() const { return m_tiles_total > 0 ? (float)m_tiles_skipped / m_tiles_total : 0.f; }
+
+private:
+    bool TileChanged(const ImGui::ImMat& in, int index, int threshold) const;
+
+private:
+    std::mutex m_mutex;
+    ImGui::ImMat m_output;
+    std::vector<ImGui::ImMat> m_tile_refs;
+    int m_width {0};
+    int m_height {0};
+    int m_channels {0};
+    int m_tile_size {0};
+    int m_overlap {0};
+    int m_reach {0};    // margin of the compared input around a tile
+    ImDataType m_type {IM_DT_UNDEFINED};
+    uint64_t m_tiles_total {0};
+    uint64_t m_tiles_skipped {0};
+};
@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <realsr.h>
+#include "ModelParam.h"
+#include "RealSRCache.h"
+#include "RealSRTiler.h"
+
+static int ProcessTile(RealSR* realsr, const ImGui::ImMat& in, const RealSRTile& tile, ImGui::ImMat& tile_out)
+{
+    ImGui::ImMat tile_in(tile.px1 - tile.px0, tile.py1 - tile.py0, in.c, in.elemsize, in.elempack);
+    tile_in.type = in.type;
+    RealSRTiler::CopyRect(in, tile.px0, tile.py0, tile_in, 0, 0, tile_in.w, tile_in.h);
+    float tile_progress = 0;
+    return RealSRCache::Process(realsr, tile_in, tile_out, tile_progress);
+}
+
+static void StoreTile(const ImGui::ImMat& tile_out, const RealSRTile& tile, int scale, ImGui::ImMat& out)
+{
+    RealSRTiler::CopyRect(tile_out, (tile.x0 - tile.px0) * scale, (tile.y0 - tile.py0) * scale,
+                        out, tile.x0 * scale, tile.y0 * scale,
+                        (tile.x1 - tile.x0) * scale, (tile.y1 - tile.y0) * scale);
+}
+
+int RealSRTiler::TileCount(int width, int height, int tile_size)
+{
+    tile_size = std::max(tile_size, REALSR_TILE_SIZE_MIN);
+    return ((width + tile_size - 1) / tile_size) * ((height + tile_size - 1) / tile_size);
+}
+
+RealSRTile RealSRTiler::GetTile(int index, int tile_size, int overlap, int width, int height)
+{
+    tile_size = std::max(tile_size, REALSR_TILE_SIZE_MIN);
+    const int tiles_x = (width + tile_size - 1) / tile_size;
+    RealSRTile tile;
+    tile.x0 = (index % tiles_x) * tile_size;
+    tile.y0 = (index / tiles_x) * tile_size;
+    tile.x1 = std::min(tile.x0 + tile_size, width);
+    tile.y1 = std::min(tile.y0 + tile_size, height);
+    tile.px0 = std::max(tile.x0 - overlap, 0);
+    tile.py0 = std::max(tile.y0 - overlap, 0);
+    tile.px1 = std::min(tile.x1 + overlap, width);
+    tile.py1 = std::min(tile.y1 + overlap, height);
+    return tile;
+}
+
+int RealSRTiler::Overlap(const RealSR* realsr, int tile_size)
+{
+    tile_size = std::max(tile_size, REALSR_TILE_SIZE_MIN);
+    int radius = RealSRCache::ReceptiveRadius(realsr);
+    if (radius < 0)
+        return REALSR_TILE_OVERLAP_UNKNOWN;
+    return std::min(radius, tile_size / 2);
+}
+
+int RealSRTiler::ReceptiveRadius(const void* param, size_t size)
+{
+    // radius of every blob in input pixels, and its pixels per input pixel
+    struct BlobField { double radius {0}; double scale {1}; };
+    std::vector<BlobField> blobs;
+    double max_radius = 0;
+    bool global = false;
+    int blob_count = 0;
+    bool walked = ModelParam::Walk(param, size, blob_count, [&](const ModelParamLayer& layer)
+    {
+        if (blobs.empty())
+            blobs.resize(blob_count);
+        BlobField field;
+        for (size_t i = 0; i < layer.bottoms.size(); i++)
+        {
+            const BlobField& bottom = blobs[layer.bottoms[i].index];
+            field.radius = std::max(field.radius, bottom.radius);
+            field.scale = i == 0 ? bottom.scale : std::min(field.scale, bottom.scale);
+        }
+        const std::string type = layer.type_name ? layer.type_name : "";
+        if (type == "Convolution" || type == "ConvolutionDepthWise")
+        {
+            int kernel_w = layer.Int(1, 0), kernel_h = layer.Int(11, kernel_w);
+            int dilation_w = layer.Int(2, 1), dilation_h = layer.Int(12, dilation_w);
+            int stride_w = layer.Int(3, 1), stride_h = layer.Int(13, stride_w);
+            field.radius += std::max((kernel_w - 1) * dilation_w, (kernel_h - 1) * dilation_h) / 2.0 / field.scale;
+            field.scale /= std::max(std::max(stride_w, stride_h), 1);
+        }
+        else if (type == "Deconvolution" || type == "DeconvolutionDepthWise")
+        {
+            int kernel_w = layer.Int(1, 0), kernel_h = layer.Int(11, kernel_w);
+            int dilation_w = layer.Int(2, 1), dilation_h = layer.Int(12, dilation_w);
+            int stride_w = layer.Int(3, 1), stride_h = layer.Int(13, stride_w);
+            field.scale *= std::max(std::max(stride_w, stride_h), 1);
+            field.radius += std::max((kernel_w - 1) * dilation_w, (kernel_h - 1) * dilation_h) / 2.0 / field.scale;
+        }
+        else if (type == "Pooling")
+        {
+            if (layer.Int(4, 0))
+            {
+                // global pooling, every output pixel sees the whole frame
+                global = true;
+                return false;
+            }
+            int kernel_w = layer.Int(1, 0), kernel_h = layer.Int(11, kernel_w);
+            int stride_w = layer.Int(2, 1), stride_h = layer.Int(12, stride_w);
+            field.radius += (std::max(kernel_w, kernel_h) - 1) / 2.0 / field.scale;
+            field.scale /= std::max(std::max(stride_w, stride_h), 1);
+        }
+        else if (type == "Interp")
+        {
+            // bilinear reads one neighbour, bicubic two
+            int resize_type = layer.Int(0, 0);
+            if (resize_type == 2) field.radius += 1.0 / field.scale;
+            else if (resize_type == 3) field.radius += 2.0 / field.scale;
+            float scale = std::max(layer.Float(1, 0.f), layer.Float(2, 0.f));
+            if (scale > 0) field.scale *= scale;
+        }
+        else if (type == "PixelShuffle")
+            field.scale *= std::max(layer.Int(0, 1), 1);
+        else if (type == "Reorg")
+        {
+            int stride = std::max(layer.Int(0, 1), 1);
+            field.radius += (stride - 1) / field.scale;
+            field.scale /= stride;
+        }
+        for (auto& top : layer.tops)
+            blobs[top.index] = field;
+        max_radius = std::max(max_radius, field.radius);
+        return true;
+    });
+    if (global)
+        return 1 << 20;
+    return walked ? (int)std::ceil(max_radius) : -1;
+}
+
+void RealSRTiler::CopyRect(const ImGui::ImMat& src, int sx, int sy, ImGui::ImMat& dst, int dx, int dy, int w, int h)
+{
+    if (src.elempack > 1 || src.c == 1)
+    {
+        const size_t pixel_size = (size_t)src.c * src.elemsize;
+        for (int y = 0; y < h; y++)
+        {
+            const uint8_t* src_ptr = (const uint8_t*)src.data + ((size_t)(sy + y) * src.w + sx) * pixel_size;
+            uint8_t* dst_ptr = (uint8_t*)dst.data + ((size_t)(dy + y) * dst.w + dx) * pixel_size;
+            memcpy(dst_ptr, src_ptr, w * pixel_size);
+        }
+    }
+    else
+    {
+        for (int c = 0; c < src.c; c++)
+        {
+            const uint8_t* src_plane = (const uint8_t*)src.data + c * src.cstep * src.elemsize;
+            uint8_t* dst_plane = (uint8_t*)dst.data + c * dst.cstep * dst.elemsize;
+            for (int y = 0; y < h; y++)
+            {
+                memcpy(dst_plane + ((size_t)(dy + y) * dst.w + dx) * dst.elemsize,
+                        src_plane + ((size_t)(sy + y) * src.w + sx) * src.elemsize,
+                        w * src.elemsize);
+            }
+        }
+    }
+}
+
+int RealSRTiler::DefaultThreads()
+{
+    int threads = (int)std::thread::hardware_concurrency();
+    return threads > 0 ? threads : 1;
+}
+
+int RealSRTiler::ProcessTiles(RealSR* realsr, const ImGui::ImMat& in, ImGui::ImMat& out, int tile_size, const std::vector<int>& tiles, float& progress)
+{
+    if (!realsr || in.empty() || out.empty())
+        return -1;
+    if (tiles.empty())
+    {
+        progress = 1.f;
+        return 0;
+    }
+    const int scale = (int)realsr->scale;
+    const int overlap = Overlap(realsr, tile_size);
+    for (size_t i = 0; i < tiles.size(); i++)
+    {
+        ImGui::ImMat tile_out;
+        RealSRTile tile = GetTile(tiles[i], tile_size, overlap, in.w, in.h);
+        int ret = ProcessTile(realsr, in, tile, tile_out);
+        if (ret != 0 || tile_out.empty())
+            return ret != 0 ? ret : -1;
+        StoreTile(tile_out, tile, scale, out);
+        progress = (float)(i + 1) / tiles.size();
+    }
+    return 0;
+}
+
+int RealSRTiler::Process(RealSR* realsr, const ImGui::ImMat& in, ImGui::ImMat& out, int tile_size, float& progress)
+{
+    if (!realsr || in.empty())
+        return -1;
+    tile_size = std::max(tile_size, REALSR_TILE_SIZE_MIN);
+    if (in.w <= tile_size && in.h <= tile_size)
+        return RealSRCache::Process(realsr, in, out, progress);
+
+    // first tile runs alone to learn the output layout
+    const int scale = (int)realsr->scale;
+    ImGui::ImMat first_out;
+    RealSRTile first_tile = GetTile(0, tile_size, Overlap(realsr, tile_size), in.w, in.h);
+    int ret = ProcessTile(realsr, in, first_tile, first_out);
+    if (ret != 0 || first_out.empty())
+        return ret != 0 ? ret : -1;
+    out = ImGui::ImMat(in.w * scale, in.h * scale, first_out.c, first_out.elemsize, first_out.elempack);
+    out.type = first_out.type;
+    StoreTile(first_out, first_tile, scale, out);
+
+    std::vector<int> tiles;
+    const int tile_count = TileCount(in.w, in.h, tile_size);
+    for (int i = 1; i < tile_count; i++)
+        tiles.push_back(i);
+    return ProcessTiles(realsr, in, out, tile_size, tiles, progress);
+}
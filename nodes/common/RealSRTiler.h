@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <immat.h>
+
+class RealSR;
+
+#define REALSR_TILE_SIZE_DEFAULT    256
+#define REALSR_TILE_SIZE_MIN        64
+#define REALSR_TILE_SIZE_MAX        1024
+// Overlap used when the receptive radius of the network is unknown. It is
+// not derived from any network, the seams are not exact with it.
+#define REALSR_TILE_OVERLAP_UNKNOWN 16
+
+struct RealSRTile
+{
+    int x0, y0, x1, y1;     // tile area in input pixels
+    int px0, py0, px1, py1; // tile area with overlap
+};
+
+struct RealSRTiler
+{
+    // Split 'in' into overlapping tiles of tile_size x tile_size and run them
+    // one after the other through RealSRCache::Process, a CPU network spreads
+    // each tile over its own ncnn threads. Returns the same value as
+    // RealSR::process.
+    static int Process(RealSR* realsr, const ImGui::ImMat& in, ImGui::ImMat& out, int tile_size, float& progress);
+
+    // Run only the listed tiles into 'out', which must already hold a frame of
+    // in.w * scale x in.h * scale with the network's output layout.
+    static int ProcessTiles(RealSR* realsr, const ImGui::ImMat& in, ImGui::ImMat& out, int tile_size, const std::vector<int>& tiles, float& progress);
+
+    static int TileCount(int width, int height, int tile_size);
+    static RealSRTile GetTile(int index, int tile_size, int overlap, int width, int height);
+
+    // Overlap for the network: its receptive radius, at most half a tile so a
+    // tile never costs more than four times its area. Stitched output equals
+    // the untiled output up to fp rounding only when the radius fits, that is
+    // when tile_size >= 2 * ReceptiveRadius; below that the seams can differ
+    // and node_bench reports by how much.
+    static int Overlap(const RealSR* realsr, int tile_size);
+
+    // Input pixels on each side an output pixel depends on, walked through the
+    // convolution, pooling, deconvolution, interp and pixel shuffle layers of a
+    // binary ncnn param read by ModelParam::Walk. -1 if the param can't be read.
+    static int ReceptiveRadius(const void* param, size_t size);
+
+    // Copy a w x h rectangle between mats with the same channels and element size,
+    // interleaved (elempack == c) or planar.
+    static void CopyRect(const ImGui::ImMat& src, int sx, int sy, ImGui::ImMat& dst, int dx, int dy, int w, int h);
+
+    // Threads of a CPU network when the node leaves it to auto
+    static int DefaultThreads();
+};
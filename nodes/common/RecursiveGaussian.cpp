@@ -0,0 +1,502 @@
+#include "RecursiveGaussian.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <thread>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// columns of a strip of the vertical pass, 32 pixels are 512 bytes of a row
+#define RECURSIVE_GAUSSIAN_STRIP    32
+
+#if defined(__SSE2__)
+typedef __m128 v4f;
+static inline v4f v_set(float v) { return _mm_set1_ps(v); }
+static inline v4f v_load(const float* p) { return _mm_loadu_ps(p); }
+static inline void v_store(float* p, v4f a) { _mm_storeu_ps(p, a); }
+static inline v4f v_add(v4f a, v4f b) { return _mm_add_ps(a, b); }
+static inline v4f v_sub(v4f a, v4f b) { return _mm_sub_ps(a, b); }
+static inline v4f v_mul(v4f a, v4f b) { return _mm_mul_ps(a, b); }
+#elif defined(__ARM_NEON)
+typedef float32x4_t v4f;
+static inline v4f v_set(float v) { return vdupq_n_f32(v); }
+static inline v4f v_load(const float* p) { return vld1q_f32(p); }
+static inline void v_store(float* p, v4f a) { vst1q_f32(p, a); }
+static inline v4f v_add(v4f a, v4f b) { return vaddq_f32(a, b); }
+static inline v4f v_sub(v4f a, v4f b) { return vsubq_f32(a, b); }
+static inline v4f v_mul(v4f a, v4f b) { return vmulq_f32(a, b); }
+#else
+struct v4f { float v[4]; };
+static inline v4f v_set(float v) { return { { v, v, v, v } }; }
+static inline v4f v_load(const float* p) { return { { p[0], p[1], p[2], p[3] } }; }
+static inline void v_store(float* p, v4f a) { for (int i = 0; i < 4; i++) p[i] = a.v[i]; }
+static inline v4f v_add(v4f a, v4f b) { for (int i = 0; i < 4; i++) a.v[i] += b.v[i]; return a; }
+static inline v4f v_sub(v4f a, v4f b) { for (int i = 0; i < 4; i++) a.v[i] -= b.v[i]; return a; }
+static inline v4f v_mul(v4f a, v4f b) { for (int i = 0; i < 4; i++) a.v[i] *= b.v[i]; return a; }
+#endif
+
+// coefficients of one second order section of the recursion as vectors
+struct Section
+{
+    v4f in[2];      // of the inputs, nearest first
+    v4f out[2];     // of the 2 previous outputs, nearest first, subtracted
+    v4f gain;       // output on a constant 1
+};
+
+// one step of a section, x0 the nearest input and y1 the previous output
+static inline v4f Step(const Section& s, v4f x0, v4f x1, v4f y1, v4f y2)
+{
+    return v_sub(v_add(v_mul(s.in[0], x0), v_mul(s.in[1], x1)), v_add(v_mul(s.out[0], y1), v_mul(s.out[1], y2)));
+}
+
+static bool IsSupportedType(ImDataType type)
+{
+    return type == IM_DT_INT8 || type == IM_DT_INT16 || type == IM_DT_FLOAT32;
+}
+
+static inline int ResolveThreads(int threads)
+{
+    return threads > 0 ? threads : std::max(1, (int)std::thread::hardware_concurrency());
+}
+
+// items [0, count) claimed one by one on 'threads'
+static void ParallelFor(int count, int threads, const std::function<void (int)>& func)
+{
+    std::atomic<int> next {0};
+    auto worker = [&]() {
+        for (int i; (i = next.fetch_add(1)) < count;)
+            func(i);
+    };
+    std::vector<std::thread> workers;
+    for (int i = 1; i < std::min(threads, count); i++)
+        workers.emplace_back(worker);
+    worker();
+    for (auto& thread : workers)
+        thread.join();
+}
+
+template<typename T>
+static inline T FromFloat(float v);
+template<> inline uint8_t FromFloat(float v) { return (uint8_t)std::max(0.f, std::min(255.f, v + 0.5f)); }
+template<> inline uint16_t FromFloat(float v) { return (uint16_t)std::max(0.f, std::min(65535.f, v + 0.5f)); }
+template<> inline float FromFloat(float v) { return v; }
+
+// rows of 'src' into 4 float pixels, unused lanes 0
+template<typename T>
+static void LoadRow(const ImGui::ImMat& src, int y, float* row)
+{
+    const int c = src.c;
+    const T* s = (const T*)src.data + (size_t)y * src.w * c;
+    for (int x = 0; x < src.w; x++, s += c, row += 4)
+    {
+        for (int i = 0; i < 4; i++)
+            row[i] = i < c ? (float)s[i] : 0.f;
+    }
+}
+
+template<typename T>
+static void StorePixels(ImGui::ImMat& dst, int y, int x0, int x1, const float* pixels)
+{
+    const int c = dst.c;
+    T* d = (T*)dst.data + ((size_t)y * dst.w + x0) * c;
+    for (int x = x0; x < x1; x++, d += c, pixels += 4)
+    {
+        for (int i = 0; i < c; i++)
+            d[i] = FromFloat<T>(pixels[i]);
+    }
+}
+
+static void LoadRowAny(const ImGui::ImMat& src, int y, float* row)
+{
+    switch (src.type)
+    {
+        case IM_DT_INT8:    LoadRow<uint8_t>(src, y, row); break;
+        case IM_DT_INT16:   LoadRow<uint16_t>(src, y, row); break;
+        default:            LoadRow<float>(src, y, row); break;
+    }
+}
+
+// INT8 and INT16 src values are kept as they are, only their range differs
+static void StorePixelsAny(const ImGui::ImMat& src, ImGui::ImMat& dst, int y, int x0, int x1, float* pixels)
+{
+    float scale = 1.f;
+    if (src.type != dst.type)
+    {
+        float from = src.type == IM_DT_INT8 ? 255.f : src.type == IM_DT_INT16 ? 65535.f : 1.f;
+        float to = dst.type == IM_DT_INT8 ? 255.f : dst.type == IM_DT_INT16 ? 65535.f : 1.f;
+        scale = to / from;
+    }
+    if (scale != 1.f)
+    {
+        for (int i = 0; i < (x1 - x0) * 4; i++)
+            pixels[i] *= scale;
+    }
+    switch (dst.type)
+    {
+        case IM_DT_INT8:    StorePixels<uint8_t>(dst, y, x0, x1, pixels); break;
+        case IM_DT_INT16:   StorePixels<uint16_t>(dst, y, x0, x1, pixels); break;
+        default:            StorePixels<float>(dst, y, x0, x1, pixels); break;
+    }
+}
+
+void RecursiveGaussian::SetSigma(float sigma)
+{
+    sigma = std::min(sigma, RECURSIVE_GAUSSIAN_SIGMA_MAX);
+    if (sigma == m_sigma)
+        return;
+    m_sigma = sigma;
+    m_kernel.clear();
+    if (sigma < RECURSIVE_GAUSSIAN_SIGMA_MIN)
+    {
+        // pass through
+        for (int k = 0; k < 2; k++)
+            for (int i = 0; i < 2; i++)
+                m_causal[k][i] = m_anticausal[k][i] = m_feedback[k][i] = 0;
+        m_causal[0][0] = 1;
+        return;
+    }
+    if (sigma < RECURSIVE_GAUSSIAN_FIR_SIGMA)
+    {
+        // the same kernel as the reference in RecursiveGaussianAccuracy
+        const int radius = (int)ceilf(sigma * 4);
+        m_kernel.resize(radius + 1);
+        double sum = 0;
+        for (int i = 0; i <= radius; i++)
+        {
+            m_kernel[i] = expf(-0.5f * i * i / (sigma * sigma));
+            sum += i ? 2.0 * m_kernel[i] : m_kernel[i];
+        }
+        for (auto& k : m_kernel)
+            k = (float)(k / sum);
+        return;
+    }
+    // Deriche 1993: the gaussian as the sum of two damped cosines, each the
+    // pair alpha / (1 - exp(-lambda / sigma) z^-1) and its conjugate, run as
+    // one second order section per pair and direction. A fourth order filter
+    // in one piece loses the pole positions to float rounding at large sigma.
+    const std::complex<double> alpha[2] = { { 0.84, 1.8675 }, { -0.34015, -0.1299 } };
+    const std::complex<double> lambda[2] = { { 1.783, 0.6318 }, { 1.723, 1.997 } };
+    double causal[2][2], anticausal[2][2], feedback[2][2], sum = 0;
+    for (int k = 0; k < 2; k++)
+    {
+        const std::complex<double> beta = std::exp(-lambda[k] / (double)sigma);
+        causal[k][0] = 2 * alpha[k].real();
+        causal[k][1] = -2 * (alpha[k] * std::conj(beta)).real();
+        // the sums of the feedback are small differences, they are taken on
+        // the float coefficients the filter runs with
+        feedback[k][0] = (float)(-2 * beta.real());
+        feedback[k][1] = (float)std::norm(beta);
+        // the anticausal section is the mirror of the causal one without its
+        // center tap
+        anticausal[k][0] = causal[k][1] - feedback[k][0] * causal[k][0];
+        anticausal[k][1] = -feedback[k][1] * causal[k][0];
+        sum += (causal[k][0] + causal[k][1] + anticausal[k][0] + anticausal[k][1]) / (1 + feedback[k][0] + feedback[k][1]);
+    }
+    // scaled so the whole filter keeps a constant
+    for (int k = 0; k < 2; k++)
+        for (int i = 0; i < 2; i++)
+        {
+            m_causal[k][i] = (float)(causal[k][i] / sum);
+            m_anticausal[k][i] = (float)(anticausal[k][i] / sum);
+            m_feedback[k][i] = (float)feedback[k][i];
+        }
+}
+
+double RecursiveGaussian::filter(const ImGui::ImMat& src, ImGui::ImMat& dst, int threads)
+{
+    if (src.empty() || src.device != IM_DD_CPU || src.c < 1 || src.c > 4 || !IsSupportedType(src.type))
+        return -1;
+    auto start = std::chrono::steady_clock::now();
+    ImDataType type = IsSupportedType(dst.type) ? dst.type : src.type;
+    ImGui::ImMat out;
+    out.create_type(src.w, src.h, src.c, type);
+    if (out.empty())
+        return -1;
+    out.copy_attribute(src);
+    threads = ResolveThreads(threads);
+    if (!m_kernel.empty())
+    {
+        FilterFir(src, out, threads);
+        dst = out;
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    const int w = src.w, h = src.h;
+    const size_t stride = (size_t)w * 4;
+    m_buffer.resize(stride * h);
+    float* buffer = m_buffer.data();
+    // the causal pass of a line, the anticausal one adds to it
+    m_causal_buffer.resize(stride * h);
+    float* causal = m_causal_buffer.data();
+    Section forward[2], backward[2];
+    for (int k = 0; k < 2; k++)
+    {
+        const float feedback_sum = 1 + m_feedback[k][0] + m_feedback[k][1];
+        for (int i = 0; i < 2; i++)
+        {
+            forward[k].in[i] = v_set(m_causal[k][i]);
+            backward[k].in[i] = v_set(m_anticausal[k][i]);
+            forward[k].out[i] = backward[k].out[i] = v_set(m_feedback[k][i]);
+        }
+        // past an edge the input repeats the edge pixel, each section sits
+        // at its output for a constant there
+        forward[k].gain = v_set((m_causal[k][0] + m_causal[k][1]) / feedback_sum);
+        backward[k].gain = v_set((m_anticausal[k][0] + m_anticausal[k][1]) / feedback_sum);
+    }
+
+    // rows, the 4 channels of a pixel in one vector
+    const int bands = std::max(1, std::min(h / 16, threads * 4));
+    ParallelFor(bands, threads, [&](int band) {
+        const int y0 = (int)((int64_t)h * band / bands), y1 = (int)((int64_t)h * (band + 1) / bands);
+        for (int y = y0; y < y1; y++)
+        {
+            float* row = buffer + y * stride;
+            float* line = causal + y * stride;
+            LoadRowAny(src, y, row);
+            v4f x1 = v_load(row);
+            v4f a1 = v_mul(forward[0].gain, x1), a2 = a1;
+            v4f b1 = v_mul(forward[1].gain, x1), b2 = b1;
+            for (int x = 0; x < w; x++)
+            {
+                v4f in = v_load(row + x * 4);
+                v4f a = Step(forward[0], in, x1, a1, a2);
+                v4f b = Step(forward[1], in, x1, b1, b2);
+                v_store(line + x * 4, v_add(a, b));
+                x1 = in;
+                a2 = a1; a1 = a;
+                b2 = b1; b1 = b;
+            }
+            x1 = v_load(row + (w - 1) * 4);
+            v4f x2 = x1;
+            a1 = v_mul(backward[0].gain, x1); a2 = a1;
+            b1 = v_mul(backward[1].gain, x1); b2 = b1;
+            for (int x = w - 1; x >= 0; x--)
+            {
+                v4f in = v_load(row + x * 4);
+                v4f a = Step(backward[0], x1, x2, a1, a2);
+                v4f b = Step(backward[1], x1, x2, b1, b2);
+                v_store(row + x * 4, v_add(v_add(a, b), v_load(line + x * 4)));
+                x2 = x1; x1 = in;
+                a2 = a1; a1 = a;
+                b2 = b1; b1 = b;
+            }
+        }
+    });
+
+    // columns, strips of pixels going down the rows side by side; the rows
+    // of the row pass stay as they are, the anticausal pass reads them back
+    const int strips = (w + RECURSIVE_GAUSSIAN_STRIP - 1) / RECURSIVE_GAUSSIAN_STRIP;
+    ParallelFor(strips, threads, [&](int strip) {
+        const int x0 = strip * RECURSIVE_GAUSSIAN_STRIP, x1 = std::min(w, x0 + RECURSIVE_GAUSSIAN_STRIP);
+        const int n = (x1 - x0) * 4;
+        // rows past the edges repeat the edge row
+        float first[RECURSIVE_GAUSSIAN_STRIP * 4], last[RECURSIVE_GAUSSIAN_STRIP * 4];
+        // the last 2 outputs of each section, row y in [y & 1]
+        float state[2][2][RECURSIVE_GAUSSIAN_STRIP * 4];
+        float pixels[RECURSIVE_GAUSSIAN_STRIP * 4];
+        std::copy(buffer + x0 * 4, buffer + x0 * 4 + n, first);
+        std::copy(buffer + (h - 1) * stride + x0 * 4, buffer + (h - 1) * stride + x0 * 4 + n, last);
+        auto in_at = [&](int y) -> const float* { return y < 0 ? first : y >= h ? last : buffer + y * stride + x0 * 4; };
+        for (int k = 0; k < 2; k++)
+            for (int i = 0; i < n; i += 4)
+            {
+                v4f o = v_mul(forward[k].gain, v_load(first + i));
+                v_store(state[k][0] + i, o);
+                v_store(state[k][1] + i, o);
+            }
+        for (int y = 0; y < h; y++)
+        {
+            const float* x_0 = in_at(y), *x_1 = in_at(y - 1);
+            float* row = causal + y * stride + x0 * 4;
+            // [y & 1] holds the output of y - 2 until it is written
+            for (int i = 0; i < n; i += 4)
+            {
+                v4f in = v_load(x_0 + i), in1 = v_load(x_1 + i);
+                v4f a = Step(forward[0], in, in1, v_load(state[0][(y - 1) & 1] + i), v_load(state[0][y & 1] + i));
+                v4f b = Step(forward[1], in, in1, v_load(state[1][(y - 1) & 1] + i), v_load(state[1][y & 1] + i));
+                v_store(state[0][y & 1] + i, a);
+                v_store(state[1][y & 1] + i, b);
+                v_store(row + i, v_add(a, b));
+            }
+        }
+        for (int k = 0; k < 2; k++)
+            for (int i = 0; i < n; i += 4)
+            {
+                v4f o = v_mul(backward[k].gain, v_load(last + i));
+                v_store(state[k][0] + i, o);
+                v_store(state[k][1] + i, o);
+            }
+        for (int y = h - 1; y >= 0; y--)
+        {
+            const float* x_1 = in_at(y + 1), *x_2 = in_at(y + 2);
+            const float* row = causal + y * stride + x0 * 4;
+            for (int i = 0; i < n; i += 4)
+            {
+                v4f in1 = v_load(x_1 + i), in2 = v_load(x_2 + i);
+                v4f a = Step(backward[0], in1, in2, v_load(state[0][(y + 1) & 1] + i), v_load(state[0][y & 1] + i));
+                v4f b = Step(backward[1], in1, in2, v_load(state[1][(y + 1) & 1] + i), v_load(state[1][y & 1] + i));
+                v_store(state[0][y & 1] + i, a);
+                v_store(state[1][y & 1] + i, b);
+                v_store(pixels + i, v_add(v_add(a, b), v_load(row + i)));
+            }
+            StorePixelsAny(src, out, y, x0, x1, pixels);
+        }
+    });
+    dst = out;
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void RecursiveGaussian::FilterFir(const ImGui::ImMat& src, ImGui::ImMat& out, int threads)
+{
+    const int w = src.w, h = src.h;
+    const int radius = (int)m_kernel.size() - 1;
+    const size_t stride = (size_t)w * 4;
+    m_buffer.resize(stride * h);
+    float* buffer = m_buffer.data();
+    const float* kernel = m_kernel.data();
+
+    // rows into the buffer, each row padded with its edge pixels
+    const int bands = std::max(1, std::min(h / 16, threads * 4));
+    ParallelFor(bands, threads, [&](int band) {
+        const int y0 = (int)((int64_t)h * band / bands), y1 = (int)((int64_t)h * (band + 1) / bands);
+        std::vector<float> padded((w + radius * 2) * 4);
+        float* line = padded.data() + radius * 4;
+        for (int y = y0; y < y1; y++)
+        {
+            LoadRowAny(src, y, line);
+            for (int x = 1; x <= radius; x++)
+            {
+                std::copy(line, line + 4, line - x * 4);
+                std::copy(line + (w - 1) * 4, line + w * 4, line + (w - 1 + x) * 4);
+            }
+            float* row = buffer + y * stride;
+            for (int x = 0; x < w; x++)
+            {
+                const float* p = line + x * 4;
+                v4f acc = v_mul(v_set(kernel[0]), v_load(p));
+                for (int k = 1; k <= radius; k++)
+                    acc = v_add(acc, v_mul(v_set(kernel[k]), v_add(v_load(p - k * 4), v_load(p + k * 4))));
+                v_store(row + x * 4, acc);
+            }
+        }
+    });
+
+    // columns by strips, rows past the edges repeat the edge row
+    const int strips = (w + RECURSIVE_GAUSSIAN_STRIP - 1) / RECURSIVE_GAUSSIAN_STRIP;
+    ParallelFor(strips, threads, [&](int strip) {
+        const int x0 = strip * RECURSIVE_GAUSSIAN_STRIP, x1 = std::min(w, x0 + RECURSIVE_GAUSSIAN_STRIP);
+        const int n = (x1 - x0) * 4;
+        float pixels[RECURSIVE_GAUSSIAN_STRIP * 4];
+        for (int y = 0; y < h; y++)
+        {
+            const float* center = buffer + y * stride + x0 * 4;
+            const v4f k0 = v_set(kernel[0]);
+            for (int i = 0; i < n; i += 4)
+                v_store(pixels + i, v_mul(k0, v_load(center + i)));
+            for (int k = 1; k <= radius; k++)
+            {
+                const float* up = buffer + std::max(y - k, 0) * stride + x0 * 4;
+                const float* down = buffer + std::min(y + k, h - 1) * stride + x0 * 4;
+                const v4f kk = v_set(kernel[k]);
+                for (int i = 0; i < n; i += 4)
+                    v_store(pixels + i, v_add(v_load(pixels + i), v_mul(kk, v_add(v_load(up + i), v_load(down + i)))));
+            }
+            StorePixelsAny(src, out, y, x0, x1, pixels);
+        }
+    });
+}
+
+float RecursiveGaussianSigmaFromRadius(int radius)
+{
+    // the rule of OpenCV's getGaussianKernel for a kernel of 2 * radius + 1
+    return 0.3f * (radius - 1) + 0.8f;
+}
+
+// separable FIR gaussian of radius 4 sigma on 4 float pixels, borders repeat the edge
+static void FirGaussian(const std::vector<float>& src, std::vector<float>& dst, int w, int h, float sigma)
+{
+    const int radius = std::max(1, (int)ceilf(sigma * 4));
+    std::vector<float> kernel(radius * 2 + 1);
+    float sum = 0;
+    for (int i = -radius; i <= radius; i++)
+        sum += kernel[i + radius] = expf(-0.5f * i * i / (sigma * sigma));
+    for (auto& k : kernel)
+        k /= sum;
+    std::vector<float> tmp(src.size());
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+            for (int c = 0; c < 4; c++)
+            {
+                double acc = 0;
+                for (int i = -radius; i <= radius; i++)
+                    acc += kernel[i + radius] * src[((size_t)y * w + std::max(0, std::min(w - 1, x + i))) * 4 + c];
+                tmp[((size_t)y * w + x) * 4 + c] = (float)acc;
+            }
+    dst.resize(src.size());
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+            for (int c = 0; c < 4; c++)
+            {
+                double acc = 0;
+                for (int i = -radius; i <= radius; i++)
+                    acc += kernel[i + radius] * tmp[((size_t)std::max(0, std::min(h - 1, y + i)) * w + x) * 4 + c];
+                dst[((size_t)y * w + x) * 4 + c] = (float)acc;
+            }
+}
+
+imgui_json::value RecursiveGaussianAccuracy(int width, int height)
+{
+    // gradient, hard edged squares and noise, values in 8 bit levels
+    ImGui::ImMat src;
+    src.create_type(width, height, 4, IM_DT_FLOAT32);
+    std::vector<float> pixels((size_t)width * height * 4);
+    uint32_t seed = 1;
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            for (int c = 0; c < 4; c++)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                float v = c == 0 ? 255.f * x / width : c == 1 ? (((x / 32) + (y / 32)) & 1 ? 255.f : 0.f) : c == 2 ? (float)(seed >> 24) : 255.f * y / height;
+                pixels[((size_t)y * width + x) * 4 + c] = ((float*)src.data)[((size_t)y * width + x) * 4 + c] = v;
+            }
+
+    const float sigmas[] = { 1, 2, 2.5f, 3, 5, 10, 20, 40 };
+    imgui_json::value value;
+    value["width"] = imgui_json::number(width);
+    value["height"] = imgui_json::number(height);
+    for (float sigma : sigmas)
+    {
+        RecursiveGaussian blur;
+        blur.SetSigma(sigma);
+        ImGui::ImMat out;
+        double iir_ms = blur.filter(src, out);
+        auto start = std::chrono::steady_clock::now();
+        std::vector<float> fir;
+        FirGaussian(pixels, fir, width, height, sigma);
+        double fir_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        double max_diff = 0, sum_diff = 0;
+        for (size_t i = 0; i < fir.size(); i++)
+        {
+            double diff = fabs((double)((float*)out.data)[i] - fir[i]);
+            max_diff = std::max(max_diff, diff);
+            sum_diff += diff * diff;
+        }
+        imgui_json::value entry;
+        entry["max_diff"] = imgui_json::number(max_diff);
+        entry["rms_diff"] = imgui_json::number(sqrt(sum_diff / fir.size()));
+        entry["recursive_ms"] = imgui_json::number(iir_ms);
+        entry["fir_ms"] = imgui_json::number(fir_ms);
+        char name[32];
+        snprintf(name, sizeof(name), "sigma_%g", sigma);
+        value[name] = entry;
+    }
+    return value;
+}
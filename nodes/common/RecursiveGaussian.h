@@ -0,0 +1,60 @@
+#pragma once
+#include <vector>
+#include <immat.h>
+#include <imgui_json.h>
+
+// Below this the blur is too small to change the mat, it is copied
+#define RECURSIVE_GAUSSIAN_SIGMA_MIN    0.5f
+// Below this a FIR kernel of at most 10 taps a side is exact and about as
+// cheap as the recursion, so it runs instead
+#define RECURSIVE_GAUSSIAN_FIR_SIGMA    2.5f
+#define RECURSIVE_GAUSSIAN_SIGMA_MAX    200.0f
+// Kernel radius the sigma can be given as, 3 sigma of the largest one
+#define RECURSIVE_GAUSSIAN_RADIUS_MAX   600
+
+// Deriche recursive gaussian: a fourth order causal filter along a line plus
+// a fourth order anticausal one, summed, rows first then columns, each run as
+// two second order sections to keep float precision at large sigma. The cost
+// per pixel is the same for any sigma. Borders repeat the edge pixel, each
+// section starts from its steady state on the edge pixel, which is exact for
+// that, so the edges do not darken. Rows run on threads with the channels of
+// a pixel in one SSE2/NEON vector, columns run on threads by strips.
+// Sigma under RECURSIVE_GAUSSIAN_FIR_SIGMA takes a separable FIR kernel of
+// radius 4 sigma through the same threading, at most 10 taps a side.
+class RecursiveGaussian
+{
+public:
+    void SetSigma(float sigma);
+    float Sigma() const { return m_sigma; }
+
+    // Blur a cpu mat of INT8, INT16 or FLOAT32 with 1 ~ 4 interleaved
+    // channels, all channels blurred. dst keeps its type if it is one of
+    // those, otherwise takes the src type. Returns the processing time in ms,
+    // or -1 if the mat is not supported.
+    double filter(const ImGui::ImMat& src, ImGui::ImMat& dst, int threads = 0);
+
+private:
+    void FilterFir(const ImGui::ImMat& src, ImGui::ImMat& out, int threads);
+
+private:
+    float m_sigma {0};
+    // second order sections, one per pair of poles: the causal inputs
+    // x[n] and x[n - 1], the anticausal x[n + 1] and x[n + 2] and the feedback
+    // of the 2 previous outputs, both ways
+    float m_causal[2][2] {{1, 0}, {0, 0}};
+    float m_anticausal[2][2] {};
+    float m_feedback[2][2] {};
+    std::vector<float> m_kernel;    // center tap first, empty when the recursion runs
+    // pixels as 4 floats, the pass between the row and the column filter
+    std::vector<float> m_buffer;
+    // the causal pass of the recursion, the anticausal one is added to it
+    std::vector<float> m_causal_buffer;
+};
+
+// Sigma the FIR blur uses for a kernel radius when its sigma is 0
+float RecursiveGaussianSigmaFromRadius(int radius);
+
+// Max and RMS difference, in 8 bit levels, between RecursiveGaussian and a
+// separable FIR gaussian of radius 4 sigma on a test image for each sigma,
+// with the time of both, see the blur section of node_bench
+imgui_json::value RecursiveGaussianAccuracy(int width = 512, int height = 512);
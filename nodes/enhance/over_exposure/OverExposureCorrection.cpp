@@ -1,8 +1,7 @@
 #include <UI.h>
 #include <imgui_extra_widget.h>
 #include <ImVulkanShader.h>
-#include <realsr.h>
-#include "OverExposure_data.h"
+#include "RealSRNode.h"
 
 #define NODE_VERSION    0x01000000
 
@@ -20,57 +19,29 @@ struct AIOverExposureNode final : Node
     void Reset(Context& context) override
     {
         Node::Reset(context);
+        m_ai.Reset();
     }
 
-    void PreLoad() override
+    void OnStop(Context& context) override
     {
-        m_device = ncnn::get_default_gpu_index();
-        if (m_realsr) { delete m_realsr; m_realsr = nullptr; }
-        m_realsr = new RealSR(OverExposureCorrection_param_bin, OverExposureCorrection_param_bin_size, OverExposureCorrection_bin, OverExposureCorrection_bin_size,
-                            m_device, true /*fp16*/, true /*packing*/, false /*tta*/, 1 /*thread*/);
-        if (m_realsr)
-        {
-            m_realsr->scale = 1;
-            m_realsr->prepadding = floor(m_realsr->scale);
-            // preload model once
-            ImGui::ImMat tmp(64, 64, 4, 1u, 4), tmp_out;
-            float progress = 0;
-            m_realsr->process(tmp, tmp_out, progress);
-        }
+        ImGui::ImMat mat;
+        if (m_ai.Drain(mat))
+            m_MatOut.SetValue(mat);
     }
 
     FlowPin Execute(Context& context, FlowPin& entryPoint, bool threading = false) override
     {
-        int64_t t1, t2;
         auto mat_in = context.GetPinValue<ImGui::ImMat>(m_MatIn);
-        if (!m_Enabled || !m_realsr || context.m_bypass_bg_node)
+        ImGui::ImMat mat_out;
+        if (m_Enabled && !context.m_bypass_bg_node && m_ai.Execute(ImGuiHelper::path_url(GetURL()), mat_in, mat_out))
         {
-            m_NodeTimeMs = 0;
-            m_MatOut.SetValue(mat_in);
+            m_NodeTimeMs = m_ai.TimeMs();
+            m_MatOut.SetValue(mat_out);
         }
-        else if (m_realsr)
+        else
         {
-            ImGui::ImMat src_mat, upscale_mat;
-            if (mat_in.device != IM_DD_CPU)
-            {
-                ImGui::ImVulkanVkMatToImMat(mat_in, src_mat);
-            }
-            else
-                src_mat = mat_in;
-            if (!src_mat.empty())
-            {
-                src_mat.elempack = src_mat.c;
-                t1 = ImGui::get_current_time_msec();
-                m_realsr->process(src_mat, upscale_mat, m_progress);
-                t2 = ImGui::get_current_time_msec();
-                m_NodeTimeMs = t2 - t1;
-                upscale_mat.copy_attribute(mat_in);
-                upscale_mat.elempack = 1;
-                std::cout << "Over Exposure Correction:" << m_NodeTimeMs << "ms" << std::endl; // for debug
-            }
-            else
-                upscale_mat = mat_in;
-            m_MatOut.SetValue(upscale_mat);
+            m_NodeTimeMs = 0;
+            m_MatOut.SetValue(mat_in);
         }
         return m_Exit;
     }
@@ -81,6 +52,8 @@ struct AIOverExposureNode final : Node
         auto changed = Node::DrawSettingLayout(ctx);
         ImGui::Separator();
         changed |= Node::DrawDataTypeSetting("Mat Type:", m_mat_data_type);
+        ImGui::Separator();
+        changed |= m_ai.DrawSettings();
         return changed;
     }
 
@@ -102,6 +75,7 @@ struct AIOverExposureNode final : Node
             if (val.is_number()) 
                 m_mat_data_type = (ImDataType)val.get<imgui_json::number>();
         }
+        m_ai.Load(value);
         return ret;
     }
 
@@ -109,6 +83,7 @@ struct AIOverExposureNode final : Node
     {
         Node::Save(value, MapID);
         value["mat_type"] = imgui_json::number(m_mat_data_type);
+        m_ai.Save(value);
     }
 
     void DrawNodeLogo(ImGuiContext * ctx, ImVec2 size, std::string logo) const override
@@ -136,9 +111,7 @@ struct AIOverExposureNode final : Node
 
 private:
     ImDataType m_mat_data_type {IM_DT_UNDEFINED};
-    int m_device        {-1};
-    float m_progress    {0.f};
-    RealSR* m_realsr    {nullptr};
+    RealSRNode m_ai {"OverExposureCorrection", "OverExposureCorrection", 0};
     mutable ImTextureID  m_logo {0};
     mutable int m_logo_index {0};
 
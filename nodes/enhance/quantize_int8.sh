@@ -0,0 +1,41 @@
+#!/bin/sh
+# Build the INT8 package of an AI enhance node with the ncnn quantize tools.
+#
+# usage: quantize_int8.sh <packer> <model dir> <model> <image list> <ncnn tools dir> <key>
+#   packer          any <plugin>_packer of the build, they all convert packages
+#   model dir       folder holding <model>.model, <model>_int8.model is written there
+#   model           AIDenoise, AIDenoiseISO or AIReFocus
+#   image list      calibration images, one path per line, frames of the footage
+#                   the node is meant for
+#   ncnn tools dir  ncnn2table and ncnn2int8, ncnn built with NCNN_BUILD_TOOLS
+#   key             KEY of the node's add_model_package, its weights are read
+#                   from the encrypted <model>.data next to the package
+#
+# The int8 package holds its weights as they are, unlike the fp32 .data.
+#
+# Check the package with "node_bench --section int8" before shipping it, the
+# report has its PSNR and SSIM against the fp32 network. Record them with
+# --update-baseline so a later quantization can't ship worse.
+set -e
+
+if [ $# -ne 6 ]; then
+    sed -n '4,15p' "$0"
+    exit 1
+fi
+PACKER=$1
+MODEL_DIR=$2
+MODEL=$3
+IMAGE_LIST=$4
+TOOLS=$5
+KEY=$6
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+"$PACKER" --unpack "$MODEL_DIR/$MODEL.model" "$WORK/$MODEL.param" "$WORK/$MODEL.bin" "$KEY"
+# the networks take RGB scaled to [0, 1]
+"$TOOLS/ncnn2table" "$WORK/$MODEL.param" "$WORK/$MODEL.bin" "$IMAGE_LIST" "$WORK/$MODEL.table" \
+    mean=[0,0,0] norm=[0.003921569,0.003921569,0.003921569] shape=[256,256,3] pixel=RGB thread=4 method=kl
+"$TOOLS/ncnn2int8" "$WORK/$MODEL.param" "$WORK/$MODEL.bin" "$WORK/${MODEL}_int8.param" "$WORK/${MODEL}_int8.bin" "$WORK/$MODEL.table"
+"$PACKER" --pack "$WORK/${MODEL}_int8.param" "$WORK/${MODEL}_int8.bin" 1 "$MODEL_DIR/${MODEL}_int8.model"
+echo "$MODEL_DIR/${MODEL}_int8.model"
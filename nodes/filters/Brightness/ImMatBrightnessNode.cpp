@@ -3,6 +3,7 @@
 #include <imgui_extra_widget.h>
 #include <ImVulkanShader.h>
 #include <Brightness_vulkan.h>
+#include "ColorAdjustNode.h"
 
 #define NODE_VERSION    0x01000000
 
@@ -42,6 +43,11 @@ struct BrightnessNode final : Node
                 m_MatOut.SetValue(mat_in);
                 return m_Exit;
             }
+            // no vulkan device on this worker, run the shared cpu backend
+            ColorAdjustParams params;
+            params.brightness = m_brightness;
+            if (ColorAdjustCpuFallback(params, mat_in, m_mat_data_type, *this, m_MatOut))
+                return m_Exit;
             if (!m_filter || gpu != m_device)
             {
                 if (m_filter) { delete m_filter; m_filter = nullptr; }
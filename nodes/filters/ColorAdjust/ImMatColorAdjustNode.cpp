@@ -0,0 +1,315 @@
+#include <UI.h>
+#include <imgui_json.h>
+#include <imgui_extra_widget.h>
+#include <ImVulkanShader.h>
+#include <Lut3D_vulkan.h>
+#include <vector>
+#include "ColorAdjustNode.h"
+
+#define NODE_VERSION    0x01000000
+
+// One node for a Brightness -> Contrast -> Gamma -> Exposure -> Saturation ->
+// Hue -> Vibrance -> Whitebalance grade. The stages are baked into a 3D lut
+// whenever a parameter changes, and the frame is read and written once.
+namespace BluePrint
+{
+struct ColorAdjustNode final : Node
+{
+    BP_NODE_WITH_NAME(ColorAdjustNode, "Color Adjust", "CodeWin", NODE_VERSION, VERSION_BLUEPRINT_API, NodeType::External, NodeStyle::Default, "Filter#Video#Color")
+    ColorAdjustNode(BP* blueprint): Node(blueprint) { m_Name = "Color Adjust"; m_HasCustomLayout = true; m_Skippable = true; }
+
+    ~ColorAdjustNode()
+    {
+        if (m_filter) { delete m_filter; m_filter = nullptr; }
+    }
+
+    void Reset(Context& context) override
+    {
+        Node::Reset(context);
+        m_mutex.lock();
+        m_MatOut.SetValue(ImGui::ImMat());
+        m_mutex.unlock();
+    }
+
+    FlowPin Execute(Context& context, FlowPin& entryPoint, bool threading = false) override
+    {
+        auto mat_in = context.GetPinValue<ImGui::ImMat>(m_MatIn);
+        if (m_BrightnessIn.IsLinked()) m_params.brightness = context.GetPinValue<float>(m_BrightnessIn);
+        if (m_ContrastIn.IsLinked()) m_params.contrast = context.GetPinValue<float>(m_ContrastIn);
+        if (m_GammaIn.IsLinked()) m_params.gamma = context.GetPinValue<float>(m_GammaIn);
+        if (m_ExposureIn.IsLinked()) m_params.exposure = context.GetPinValue<float>(m_ExposureIn);
+        if (m_SaturationIn.IsLinked()) m_params.saturation = context.GetPinValue<float>(m_SaturationIn);
+        if (m_HueIn.IsLinked()) m_params.hue = context.GetPinValue<float>(m_HueIn);
+        if (m_VibranceIn.IsLinked()) m_params.vibrance = context.GetPinValue<float>(m_VibranceIn);
+        if (m_TemperatureIn.IsLinked()) m_params.temperature = context.GetPinValue<float>(m_TemperatureIn);
+        if (!mat_in.empty())
+        {
+            int gpu = mat_in.device == IM_DD_VULKAN ? mat_in.device_number : ImGui::get_default_gpu_index();
+            m_stages = m_params.ActiveStages();
+            if (!m_Enabled || m_stages == 0)
+            {
+                m_MatOut.SetValue(mat_in);
+                return m_Exit;
+            }
+            // no vulkan device on this worker, run the shared cpu backend
+            if (ColorAdjustCpuFallback(m_params, mat_in, m_mat_data_type, *this, m_MatOut))
+            {
+                m_passes_saved += m_stages - 1;
+                return m_Exit;
+            }
+            if (!m_filter || gpu != m_device || m_params != m_baked_params)
+            {
+                if (m_filter) { delete m_filter; m_filter = nullptr; }
+                m_lut.resize(COLOR_ADJUST_LUT_SIZE * COLOR_ADJUST_LUT_SIZE * COLOR_ADJUST_LUT_SIZE * 4);
+                ColorAdjustBakeLut(m_params, COLOR_ADJUST_LUT_SIZE, m_lut.data());
+                m_filter = new ImGui::LUT3D_vulkan((void *)m_lut.data(), COLOR_ADJUST_LUT_SIZE, 1.f, 1.f, 1.f, 1.f, IM_INTERPOLATE_TETRAHEDRAL, gpu);
+                m_baked_params = m_params;
+            }
+            if (!m_filter)
+            {
+                return {};
+            }
+            m_device = gpu;
+            ImGui::VkMat im_RGB; im_RGB.type = m_mat_data_type == IM_DT_UNDEFINED ? mat_in.type : m_mat_data_type;
+            m_NodeTimeMs = m_filter->filter(mat_in, im_RGB);
+            m_MatOut.SetValue(im_RGB);
+            m_passes_saved += m_stages - 1;
+        }
+        return m_Exit;
+    }
+
+    void WasUnlinked(const Pin& receiver, const Pin& provider) override
+    {
+        if (receiver.m_ID == m_BrightnessIn.m_ID) m_BrightnessIn.SetValue(m_params.brightness);
+        if (receiver.m_ID == m_ContrastIn.m_ID) m_ContrastIn.SetValue(m_params.contrast);
+        if (receiver.m_ID == m_GammaIn.m_ID) m_GammaIn.SetValue(m_params.gamma);
+        if (receiver.m_ID == m_ExposureIn.m_ID) m_ExposureIn.SetValue(m_params.exposure);
+        if (receiver.m_ID == m_SaturationIn.m_ID) m_SaturationIn.SetValue(m_params.saturation);
+        if (receiver.m_ID == m_HueIn.m_ID) m_HueIn.SetValue(m_params.hue);
+        if (receiver.m_ID == m_VibranceIn.m_ID) m_VibranceIn.SetValue(m_params.vibrance);
+        if (receiver.m_ID == m_TemperatureIn.m_ID) m_TemperatureIn.SetValue(m_params.temperature);
+    }
+
+    bool DrawSettingLayout(ImGuiContext * ctx) override
+    {
+        // Draw Setting
+        auto changed = Node::DrawSettingLayout(ctx);
+        ImGui::Separator();
+        changed |= Node::DrawDataTypeSetting("Mat Type:", m_mat_data_type);
+        return changed;
+    }
+
+    bool DrawCustomLayout(ImGuiContext * ctx, float zoom, ImVec2 origin, ImGui::ImCurveEdit::Curve * key, bool embedded) override
+    {
+        ImGui::SetCurrentContext(ctx);
+        float setting_offset = 320;
+        if (!embedded)
+        {
+            ImVec2 sub_window_pos = ImGui::GetCursorScreenPos();
+            ImVec2 sub_window_size = ImGui::GetWindowSize();
+            setting_offset = sub_window_size.x - 80;
+        }
+        bool changed = false;
+        ColorAdjustParams val = m_params;
+        float saturation = val.saturation - 1.0;
+        float hue = val.hue / 360.f;
+        static float hue_width = 0.1f;
+        static float featherLeft = 0.125f;
+        static float featherRight = 0.125f;
+        ImGui::PushStyleColor(ImGuiCol_Button, 0);
+        ImGui::PushItemWidth(200);
+
+        ImGui::BeginDisabled(!m_Enabled || m_BrightnessIn.IsLinked());
+        ImGui::LumianceSelector("##slider_brightness##ColorAdjust", ImVec2(200, 20), &val.brightness, 0.0f, -1.f, 1.f, zoom);
+        ImGui::SameLine(setting_offset);  if (ImGui::Button(ICON_RESET "##reset_brightness##ColorAdjust")) { val.brightness = 0.0; changed = true; }
+        ImGui::ShowTooltipOnHover("Reset Brightness");
+        ImGui::EndDisabled();
+        ImGui::BeginDisabled(!m_Enabled);
+        if (key) ImGui::ImCurveCheckEditKeyWithIDByDim("##add_curve_brightness##ColorAdjust", key, ImGui::ImCurveEdit::DIM_X, m_BrightnessIn.IsLinked(), "brightness##ColorAdjust@" + std::to_string(m_ID), -1.f, 1.f, 0.f, m_BrightnessIn.m_ID);
+        ImGui::EndDisabled();
+
+        ImGui::BeginDisabled(!m_Enabled || m_ContrastIn.IsLinked());
+        ImGui::ContrastSelector("##slider_contrast##ColorAdjust", ImVec2(200, 20), &val.contrast, 1.0, zoom);
+        ImGui::SameLine(setting_offset);  if (ImGui::Button(ICON_RESET "##reset_contrast##ColorAdjust")) { val.contrast = 1.0; changed = true; }
+        ImGui::ShowTooltipOnHover("Reset Contrast");
+        ImGui::EndDisabled();
+        ImGui::BeginDisabled(!m_Enabled);
+        if (key) ImGui::ImCurveCheckEditKeyWithIDByDim("##add_curve_contrast##ColorAdjust", key, ImGui::ImCurveEdit::DIM_X, m_ContrastIn.IsLinked(), "contrast##ColorAdjust@" + std::to_string(m_ID), 0.f, 4.f, 1.f, m_ContrastIn.m_ID);
+        ImGui::EndDisabled();
+
+        ImGui::BeginDisabled(!m_Enabled || m_GammaIn.IsLinked());
+        ImGui::GammaSelector("##slider_gamma##ColorAdjust", ImVec2(200, 20), &val.gamma, 1.0f, 0.f, 4.f, zoom);
+        ImGui::SameLine(setting_offset);  if (ImGui::Button(ICON_RESET "##reset_gamma##ColorAdjust")) { val.gamma = 1.0; changed = true; }
+        ImGui::ShowTooltipOnHover("Reset Gamma");
+        ImGui::EndDisabled();
+        ImGui::BeginDisabled(!m_Enabled);
+        if (key) ImGui::ImCurveCheckEditKeyWithIDByDim("##add_curve_gamma##ColorAdjust", key, ImGui::ImCurveEdit::DIM_X, m_GammaIn.IsLinked(), "gamma##ColorAdjust@" + std::to_string(m_ID), 0.f, 4.f, 1.f, m_GammaIn.m_ID);
+        ImGui::EndDisabled();
+
+        ImGui::BeginDisabled(!m_Enabled || m_ExposureIn.IsLinked());
+        ImGui::LumianceSelector("##slider_exposure##ColorAdjust", ImVec2(200, 20), &val.exposure, 0.0f, -2.f, 2.f, zoom);
+        ImGui::SameLine(setting_offset);  if (ImGui::Button(ICON_RESET "##reset_exposure##ColorAdjust")) { val.exposure = 0.0; changed = true; }
+        ImGui::ShowTooltipOnHover("Reset Exposure");
+        ImGui::EndDisabled();
+        ImGui::BeginDisabled(!m_Enabled);
+        if (key) ImGui::ImCurveCheckEditKeyWithIDByDim("##add_curve_exposure##ColorAdjust", key, ImGui::ImCurveEdit::DIM_X, m_ExposureIn.IsLinked(), "exposure##ColorAdjust@" + std::to_string(m_ID), -2.f, 2.f, 0.f, m_ExposureIn.m_ID);
+        ImGui::EndDisabled();
+
+        ImGui::BeginDisabled(!m_Enabled || m_SaturationIn.IsLinked());
+        ImGui::SaturationSelector("##slider_saturation##ColorAdjust", ImVec2(200, 40), &saturation, 0.0f, -1.f, 1.f, zoom, 32, 1.0f, true);
+        ImGui::SameLine(setting_offset);  if (ImGui::Button(ICON_RESET "##reset_saturation##ColorAdjust")) { saturation = 0.0; changed = true; }
+        ImGui::ShowTooltipOnHover("Reset Saturation");
+        ImGui::EndDisabled();
+        ImGui::BeginDisabled(!m_Enabled);
+        if (key) ImGui::ImCurveCheckEditKeyWithIDByDim("##add_curve_saturation##ColorAdjust", key, ImGui::ImCurveEdit::DIM_X, m_SaturationIn.IsLinked(), "saturation##ColorAdjust@" + std::to_string(m_ID), -1.f, 1.f, 0.f, m_SaturationIn.m_ID);
+        ImGui::EndDisabled();
+
+        ImGui::BeginDisabled(!m_Enabled || m_HueIn.IsLinked());
+        ImGui::HueSelector("##slider_hue##ColorAdjust", ImVec2(200, 20), &hue, &hue_width, &featherLeft, &featherRight, 0.0f, zoom, 64, 1.0f, 0.0f);
+        ImGui::SameLine(setting_offset);  if (ImGui::Button(ICON_RESET "##reset_hue##ColorAdjust")) { hue = 0.0; changed = true; }
+        ImGui::ShowTooltipOnHover("Reset Hue");
+        ImGui::EndDisabled();
+        ImGui::BeginDisabled(!m_Enabled);
+        if (key) ImGui::ImCurveCheckEditKeyWithIDByDim("##add_curve_hue##ColorAdjust", key, ImGui::ImCurveEdit::DIM_X, m_HueIn.IsLinked(), "hue##ColorAdjust@" + std::to_string(m_ID), 0.f, 360.f, 0.f, m_HueIn.m_ID);
+        ImGui::EndDisabled();
+
+        ImGui::BeginDisabled(!m_Enabled || m_VibranceIn.IsLinked());
+        ImGui::SaturationSelector("##slider_vibrance##ColorAdjust", ImVec2(200, 40), &val.vibrance, 0.0f, -4.f, 4.f, zoom, 32, 1.0f, true);
+        ImGui::SameLine(setting_offset);  if (ImGui::Button(ICON_RESET "##reset_vibrance##ColorAdjust")) { val.vibrance = 0.0; changed = true; }
+        ImGui::ShowTooltipOnHover("Reset Vibrance");
+        ImGui::EndDisabled();
+        ImGui::BeginDisabled(!m_Enabled);
+        if (key) ImGui::ImCurveCheckEditKeyWithIDByDim("##add_curve_vibrance##ColorAdjust", key, ImGui::ImCurveEdit::DIM_X, m_VibranceIn.IsLinked(), "vibrance##ColorAdjust@" + std::to_string(m_ID), -4.f, 4.f, 0.f, m_VibranceIn.m_ID);
+        ImGui::EndDisabled();
+
+        ImGui::BeginDisabled(!m_Enabled || m_TemperatureIn.IsLinked());
+        ImGui::TemperatureSelector("##slider_temperature##ColorAdjust", ImVec2(200, 20), &val.temperature, 5000.0f, 2000.f, 8000.f, zoom);
+        ImGui::SameLine(setting_offset);  if (ImGui::Button(ICON_RESET "##reset_temperature##ColorAdjust")) { val.temperature = 5000.0; changed = true; }
+        ImGui::ShowTooltipOnHover("Reset Temperature");
+        ImGui::EndDisabled();
+        ImGui::BeginDisabled(!m_Enabled);
+        if (key) ImGui::ImCurveCheckEditKeyWithIDByDim("##add_curve_temperature##ColorAdjust", key, ImGui::ImCurveEdit::DIM_X, m_TemperatureIn.IsLinked(), "temperature##ColorAdjust@" + std::to_string(m_ID), 2000.f, 8000.f, 5000.f, m_TemperatureIn.m_ID);
+        ImGui::EndDisabled();
+
+        ImGui::PopItemWidth();
+        ImGui::PopStyleColor();
+        ImGui::Text("%d stages in 1 pass, %llu passes saved", m_stages, (unsigned long long)m_passes_saved);
+        val.saturation = saturation + 1.0;
+        val.hue = hue * 360.f;
+        if (val != m_params) { m_params = val; changed = true; }
+        return m_Enabled ? changed : false;
+    }
+
+    int Load(const imgui_json::value& value) override
+    {
+        int ret = BP_ERR_NONE;
+        if ((ret = Node::Load(value)) != BP_ERR_NONE)
+            return ret;
+
+        if (value.contains("mat_type"))
+        {
+            auto& val = value["mat_type"];
+            if (val.is_number())
+                m_mat_data_type = (ImDataType)val.get<imgui_json::number>();
+        }
+        if (value.contains("brightness"))
+        {
+            auto& val = value["brightness"];
+            if (val.is_number())
+                m_params.brightness = val.get<imgui_json::number>();
+        }
+        if (value.contains("contrast"))
+        {
+            auto& val = value["contrast"];
+            if (val.is_number())
+                m_params.contrast = val.get<imgui_json::number>();
+        }
+        if (value.contains("gamma"))
+        {
+            auto& val = value["gamma"];
+            if (val.is_number())
+                m_params.gamma = val.get<imgui_json::number>();
+        }
+        if (value.contains("exposure"))
+        {
+            auto& val = value["exposure"];
+            if (val.is_number())
+                m_params.exposure = val.get<imgui_json::number>();
+        }
+        if (value.contains("saturation"))
+        {
+            auto& val = value["saturation"];
+            if (val.is_number())
+                m_params.saturation = val.get<imgui_json::number>();
+        }
+        if (value.contains("hue"))
+        {
+            auto& val = value["hue"];
+            if (val.is_number())
+                m_params.hue = val.get<imgui_json::number>();
+        }
+        if (value.contains("vibrance"))
+        {
+            auto& val = value["vibrance"];
+            if (val.is_number())
+                m_params.vibrance = val.get<imgui_json::number>();
+        }
+        if (value.contains("temperature"))
+        {
+            auto& val = value["temperature"];
+            if (val.is_number())
+                m_params.temperature = val.get<imgui_json::number>();
+        }
+        return ret;
+    }
+
+    void Save(imgui_json::value& value, std::map<ID_TYPE, ID_TYPE> MapID) override
+    {
+        Node::Save(value, MapID);
+        value["mat_type"] = imgui_json::number(m_mat_data_type);
+        value["brightness"] = imgui_json::number(m_params.brightness);
+        value["contrast"] = imgui_json::number(m_params.contrast);
+        value["gamma"] = imgui_json::number(m_params.gamma);
+        value["exposure"] = imgui_json::number(m_params.exposure);
+        value["saturation"] = imgui_json::number(m_params.saturation);
+        value["hue"] = imgui_json::number(m_params.hue);
+        value["vibrance"] = imgui_json::number(m_params.vibrance);
+        value["temperature"] = imgui_json::number(m_params.temperature);
+    }
+
+    span<Pin*> GetInputPins() override { return m_InputPins; }
+    span<Pin*> GetOutputPins() override { return m_OutputPins; }
+    Pin* GetAutoLinkInputFlowPin() override { return &m_Enter; }
+    Pin* GetAutoLinkOutputFlowPin() override { return &m_Exit; }
+    vector<Pin*> GetAutoLinkInputDataPin() override { return {&m_MatIn}; }
+    vector<Pin*> GetAutoLinkOutputDataPin() override { return {&m_MatOut}; }
+
+    FlowPin   m_Enter   = { this, "Enter" };
+    FlowPin   m_Exit    = { this, "Exit" };
+    MatPin    m_MatIn   = { this, "In" };
+    FloatPin  m_BrightnessIn    = { this, "Brightness" };
+    FloatPin  m_ContrastIn      = { this, "Contrast" };
+    FloatPin  m_GammaIn         = { this, "Gamma" };
+    FloatPin  m_ExposureIn      = { this, "Exposure" };
+    FloatPin  m_SaturationIn    = { this, "Saturation" };
+    FloatPin  m_HueIn           = { this, "Hue" };
+    FloatPin  m_VibranceIn      = { this, "Vibrance" };
+    FloatPin  m_TemperatureIn   = { this, "Temperature" };
+    MatPin    m_MatOut  = { this, "Out" };
+
+    Pin* m_InputPins[10] = { &m_Enter, &m_MatIn, &m_BrightnessIn, &m_ContrastIn, &m_GammaIn, &m_ExposureIn, &m_SaturationIn, &m_HueIn, &m_VibranceIn, &m_TemperatureIn };
+    Pin* m_OutputPins[2] = { &m_Exit, &m_MatOut };
+
+private:
+    ImDataType m_mat_data_type {IM_DT_UNDEFINED};
+    int m_device        {-1};
+    ImGui::LUT3D_vulkan * m_filter   {nullptr};
+    ColorAdjustParams m_params;
+    ColorAdjustParams m_baked_params;
+    std::vector<float> m_lut;
+    int m_stages        {0};
+    uint64_t m_passes_saved {0};    // frame passes the unfused chain would have taken on top of this one
+};
+} // namespace BluePrint
+
+BP_NODE_DYNAMIC_WITH_NAME(ColorAdjustNode, "Color Adjust", "CodeWin", NODE_VERSION, VERSION_BLUEPRINT_API, BluePrint::NodeType::External, BluePrint::NodeStyle::Default, "Filter#Video#Color")
@@ -2,6 +2,7 @@
 #include <imgui_extra_widget.h>
 #include <ImVulkanShader.h>
 #include "DeBand_vulkan.h"
+#include "FilterPool.h"
 
 #define NODE_VERSION    0x01000000
 
@@ -13,7 +14,8 @@ struct DeBandNode final : Node
     DeBandNode(BP* blueprint): Node(blueprint) { m_Name = "DeBand"; m_HasCustomLayout = true; m_Skippable = true; }
     ~DeBandNode()
     {
-        if (m_filter) { delete m_filter; m_filter = nullptr; }
+        m_filter = nullptr;
+        m_filters.Clear();
         ImGui::ImDestroyTexture(&m_logo);
     }
 
@@ -39,14 +41,7 @@ struct DeBandNode final : Node
                 m_MatOut.SetValue(mat_in);
                 return m_Exit;
             }
-            if (!m_filter || gpu != m_device ||
-                m_filter->in_width != mat_in.w || 
-                m_filter->in_height != mat_in.h ||
-                m_filter->in_channels != mat_in.c)
-            {
-                if (m_filter) { delete m_filter; m_filter = nullptr; }
-                m_filter = new ImGui::DeBand_vulkan(mat_in.w, mat_in.h, mat_in.c, gpu);
-            }
+            m_filter = m_filters.Get(mat_in.w, mat_in.h, mat_in.c, gpu, [&]() { return new ImGui::DeBand_vulkan(mat_in.w, mat_in.h, mat_in.c, gpu); });
             if (!m_filter)
             {
                 return {};
@@ -124,6 +119,7 @@ struct DeBandNode final : Node
         ImGui::EndDisabled();
         ImGui::PopItemWidth();
         ImGui::PopStyleColor();
+        ImGui::Text("%llu filter allocations", (unsigned long long)m_filters.Allocations());
         if (_threshold != m_threshold) { m_threshold = _threshold; changed = true; }
         if (_range != m_range) { m_range = _range; changed = true; }
         if (_direction != m_direction) { m_direction = _direction; changed = true; }
@@ -214,6 +210,7 @@ private:
     float m_direction       {2};
     bool m_blur             {false};
     ImGui::DeBand_vulkan *  m_filter {nullptr};
+    FilterPool<ImGui::DeBand_vulkan> m_filters;
     mutable ImTextureID  m_logo {0};
     mutable int m_logo_index {0};
 
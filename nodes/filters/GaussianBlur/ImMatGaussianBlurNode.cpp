@@ -3,6 +3,7 @@
 #include <imgui_extra_widget.h>
 #include <ImVulkanShader.h>
 #include <Gaussian_vulkan.h>
+#include "RecursiveGaussian.h"
 
 #define NODE_VERSION    0x01000000
 
@@ -40,6 +41,24 @@ struct GaussianBlurNode final : Node
                 m_MatOut.SetValue(mat_in);
                 return m_Exit;
             }
+            if (m_recursive || (mat_in.device == IM_DD_CPU && ImGui::get_gpu_count() == 0))
+            {
+                // recursive gaussian runs on cpu, its cost does not grow with sigma
+                ImGui::ImMat src_mat;
+                if (mat_in.device != IM_DD_CPU)
+                    ImGui::ImVulkanVkMatToImMat(mat_in, src_mat);
+                else
+                    src_mat = mat_in;
+                m_recursive_filter.SetSigma(m_sigma > 0 ? m_sigma : m_blurRadius > 0 ? RecursiveGaussianSigmaFromRadius(m_blurRadius) : 0.f);
+                ImGui::ImMat im_RGB; im_RGB.type = m_mat_data_type == IM_DT_UNDEFINED ? mat_in.type : m_mat_data_type;
+                double time_ms = m_recursive_filter.filter(src_mat, im_RGB);
+                if (time_ms >= 0)
+                {
+                    m_NodeTimeMs = time_ms;
+                    m_MatOut.SetValue(im_RGB);
+                    return m_Exit;
+                }
+            }
             if (!m_filter || gpu != m_device)
             {
                 if (m_filter) { delete m_filter; m_filter = nullptr; }
@@ -50,7 +69,8 @@ struct GaussianBlurNode final : Node
                 return {};
             }
             m_device = gpu;
-            m_filter->SetParam(m_blurRadius, m_sigma);
+            // values set in recursive mode may be past what the FIR kernel takes
+            m_filter->SetParam(std::min(m_blurRadius, 20), std::min(m_sigma, 10.f));
             ImGui::VkMat im_RGB; im_RGB.type = m_mat_data_type == IM_DT_UNDEFINED ? mat_in.type : m_mat_data_type;
             m_NodeTimeMs = m_filter->filter(mat_in, im_RGB);
             m_MatOut.SetValue(im_RGB);
@@ -70,6 +90,14 @@ struct GaussianBlurNode final : Node
         auto changed = Node::DrawSettingLayout(ctx);
         ImGui::Separator();
         changed |= Node::DrawDataTypeSetting("Mat Type:", m_mat_data_type);
+        ImGui::Separator();
+        bool recursive = m_recursive;
+        ImGui::TextUnformatted("Mode:"); ImGui::SameLine();
+        if (ImGui::RadioButton("FIR", !recursive)) recursive = false;
+        ImGui::SameLine();
+        if (ImGui::RadioButton("Recursive (CPU)", recursive)) recursive = true;
+        ImGui::ShowTooltipOnHover("Same cost for any sigma, lifts the radius and sigma limits.\nRuns on the CPU: a GPU input is downloaded for it and the output stays a CPU mat.");
+        if (recursive != m_recursive) { m_recursive = recursive; changed = true; }
         return changed;
     }
 
@@ -87,23 +115,25 @@ struct GaussianBlurNode final : Node
         float _sigma = m_sigma;
         int _blurRadius = m_blurRadius;
         static ImGuiSliderFlags flags = ImGuiSliderFlags_AlwaysClamp | ImGuiSliderFlags_Stick;
+        const float sigma_max = m_recursive ? RECURSIVE_GAUSSIAN_SIGMA_MAX : 10.f;
+        const int radius_max = m_recursive ? RECURSIVE_GAUSSIAN_RADIUS_MAX : 20;
         ImGui::PushStyleColor(ImGuiCol_Button, 0);
         ImGui::PushItemWidth(200);
         ImGui::BeginDisabled(!m_Enabled || m_SigmaIn.IsLinked());
-        ImGui::SliderFloat("Sigma##GaussianBlur", &_sigma, 0.0, 10.f, "%.1f", flags);
+        ImGui::SliderFloat("Sigma##GaussianBlur", &_sigma, 0.0, sigma_max, "%.1f", flags);
         ImGui::SameLine(setting_offset);  if (ImGui::Button(ICON_RESET "##reset_sigma##GaussianBlur")) { _sigma = 0; changed = true; }
         ImGui::ShowTooltipOnHover("Reset");
         ImGui::EndDisabled();
         ImGui::BeginDisabled(!m_Enabled);
-        if (key) ImGui::ImCurveCheckEditKeyWithIDByDim("##add_curve_sigma##GaussianBlur", key, ImGui::ImCurveEdit::DIM_X, m_SigmaIn.IsLinked(), "sigma##GaussianBlur@" + std::to_string(m_ID), 0.f, 10.f, 0.f, m_SigmaIn.m_ID);
+        if (key) ImGui::ImCurveCheckEditKeyWithIDByDim("##add_curve_sigma##GaussianBlur", key, ImGui::ImCurveEdit::DIM_X, m_SigmaIn.IsLinked(), "sigma##GaussianBlur@" + std::to_string(m_ID), 0.f, sigma_max, 0.f, m_SigmaIn.m_ID);
         ImGui::EndDisabled();
         ImGui::BeginDisabled(!m_Enabled || m_RadiusIn.IsLinked());
-        ImGui::SliderInt("Radius##GaussianBlur", &_blurRadius, 0, 20, "%d", flags);
+        ImGui::SliderInt("Radius##GaussianBlur", &_blurRadius, 0, radius_max, "%d", flags);
         ImGui::SameLine(setting_offset);  if (ImGui::Button(ICON_RESET "##reset_radius##GaussianBlur")) { _blurRadius = 3; changed = true; }
         ImGui::ShowTooltipOnHover("Reset");
         ImGui::EndDisabled();
         ImGui::BeginDisabled(!m_Enabled);
-        if (key) ImGui::ImCurveCheckEditKeyWithIDByDim("##add_curve_radius##GaussianBlur", key, ImGui::ImCurveEdit::DIM_X, m_RadiusIn.IsLinked(), "radius##GaussianBlur@" + std::to_string(m_ID), 0.f, 20.f, 3.f, m_RadiusIn.m_ID);
+        if (key) ImGui::ImCurveCheckEditKeyWithIDByDim("##add_curve_radius##GaussianBlur", key, ImGui::ImCurveEdit::DIM_X, m_RadiusIn.IsLinked(), "radius##GaussianBlur@" + std::to_string(m_ID), 0.f, (float)radius_max, 3.f, m_RadiusIn.m_ID);
         ImGui::EndDisabled();
         ImGui::PopItemWidth();
         ImGui::PopStyleColor();
@@ -137,6 +167,12 @@ struct GaussianBlurNode final : Node
             if (val.is_number()) 
                 m_sigma = val.get<imgui_json::number>();
         }
+        if (value.contains("recursive"))
+        {
+            auto& val = value["recursive"];
+            if (val.is_boolean())
+                m_recursive = val.get<imgui_json::boolean>();
+        }
         return ret;
     }
 
@@ -146,6 +182,7 @@ struct GaussianBlurNode final : Node
         value["mat_type"] = imgui_json::number(m_mat_data_type);
         value["radius"] = imgui_json::number(m_blurRadius);
         value["sigma"] = imgui_json::number(m_sigma);
+        value["recursive"] = imgui_json::boolean(m_recursive);
     }
 
     void DrawNodeLogo(ImGuiContext * ctx, ImVec2 size, std::string logo) const override
@@ -178,7 +215,9 @@ private:
     int m_device            {-1};
     int m_blurRadius        {3};
     float m_sigma           {0.0f};
+    bool m_recursive        {false};
     ImGui::GaussianBlur_vulkan * m_filter   {nullptr};
+    RecursiveGaussian m_recursive_filter;
     mutable ImTextureID  m_logo {0};
     mutable int m_logo_index {0};
 
@@ -2,6 +2,8 @@
 #include <imgui_extra_widget.h>
 #include <ImVulkanShader.h>
 #include "HQDN3D_vulkan.h"
+#include "FilterPool.h"
+#include "HQDN3DCpu.h"
 
 #define NODE_VERSION    0x01000000
 
@@ -13,13 +15,16 @@ struct HQDN3DNode final : Node
     HQDN3DNode(BP* blueprint): Node(blueprint) { m_Name = "HQDN3D Denoise"; m_HasCustomLayout = true; m_Skippable = true; }
     ~HQDN3DNode()
     {
-        if (m_filter) { delete m_filter; m_filter = nullptr; }
+        m_filter = nullptr;
+        m_filters.Clear();
         ImGui::ImDestroyTexture(&m_logo);
     }
 
     void Reset(Context& context) override
     {
         Node::Reset(context);
+        m_stream.Reset();
+        m_cpu_filter.Reset();
         m_mutex.lock();
         m_MatOut.SetValue(ImGui::ImMat());
         m_mutex.unlock();
@@ -40,20 +45,30 @@ struct HQDN3DNode final : Node
                 m_MatOut.SetValue(mat_in);
                 return m_Exit;
             }
-            if (!m_filter || gpu != m_device ||
-                m_filter->in_width != mat_in.w || 
-                m_filter->in_height != mat_in.h ||
-                m_filter->in_channels != mat_in.c)
+            // after a cut or a seek the history belongs to other frames
+            bool restart = m_stream.Discontinuity(mat_in);
+            if (mat_in.device == IM_DD_CPU && ImGui::get_gpu_count() == 0)
             {
-                if (m_filter) { delete m_filter; m_filter = nullptr; }
-                m_filter = new ImGui::HQDN3D_vulkan(mat_in.w, mat_in.h, mat_in.c, gpu);
+                // no vulkan device on this worker, run the cpu engine
+                if (restart) m_cpu_filter.Reset();
+                m_cpu_filter.SetParam(m_lum_spac, m_chrom_spac, m_lum_tmp, m_chrom_tmp);
+                ImGui::ImMat im_RGB; im_RGB.type = m_mat_data_type == IM_DT_UNDEFINED ? mat_in.type : m_mat_data_type;
+                double time_ms = m_cpu_filter.filter(mat_in, im_RGB);
+                if (time_ms >= 0)
+                {
+                    m_NodeTimeMs = time_ms;
+                    m_MatOut.SetValue(im_RGB);
+                    return m_Exit;
+                }
             }
+            m_filter = m_filters.Get(mat_in.w, mat_in.h, mat_in.c, gpu, [&]() { return new ImGui::HQDN3D_vulkan(mat_in.w, mat_in.h, mat_in.c, gpu); });
             if (!m_filter)
             {
                 return {};
             }
             m_device = gpu;
-            m_filter->SetParam(m_lum_spac, m_chrom_spac, m_lum_tmp, m_chrom_tmp);
+            // a zero temporal strength passes this frame through and makes it the history
+            m_filter->SetParam(m_lum_spac, m_chrom_spac, restart ? 0.f : m_lum_tmp, restart ? 0.f : m_chrom_tmp);
             ImGui::VkMat im_RGB; im_RGB.type = m_mat_data_type == IM_DT_UNDEFINED ? mat_in.type : m_mat_data_type;
             m_NodeTimeMs = m_filter->filter(mat_in, im_RGB);
             m_MatOut.SetValue(im_RGB);
@@ -131,6 +146,7 @@ struct HQDN3DNode final : Node
         ImGui::EndDisabled();
         ImGui::PopItemWidth();
         ImGui::PopStyleColor();
+        ImGui::Text("%llu filter allocations, %llu history resets", (unsigned long long)m_filters.Allocations(), (unsigned long long)m_stream.Discontinuities());
         if (_lum_spac != m_lum_spac) { m_lum_spac = _lum_spac; changed = true; }
         if (_chrom_spac != m_chrom_spac) { m_chrom_spac = _chrom_spac; changed = true; }
         if (_lum_tmp != m_lum_tmp) { m_lum_tmp = _lum_tmp; changed = true; }
@@ -222,6 +238,9 @@ private:
     float m_lum_tmp     {4.5};
     float m_chrom_tmp   {3.375};
     ImGui::HQDN3D_vulkan * m_filter   {nullptr};
+    FilterPool<ImGui::HQDN3D_vulkan> m_filters;
+    FilterStream m_stream;
+    HQDN3DCpu m_cpu_filter;
     mutable ImTextureID  m_logo {0};
     mutable int m_logo_index {0};
 
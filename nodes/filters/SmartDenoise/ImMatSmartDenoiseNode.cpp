@@ -3,6 +3,7 @@
 #include <imgui_extra_widget.h>
 #include <ImVulkanShader.h>
 #include "SmartDenoise_vulkan.h"
+#include "FilterPool.h"
 
 #define NODE_VERSION    0x01000000
 
@@ -15,7 +16,8 @@ struct SmartDenoiseNode final : Node
 
     ~SmartDenoiseNode()
     {
-        if (m_filter) { delete m_filter; m_filter = nullptr; }
+        m_filter = nullptr;
+        m_filters.Clear();
         ImGui::ImDestroyTexture(&m_logo);
     }
 
@@ -41,11 +43,8 @@ struct SmartDenoiseNode final : Node
                 m_MatOut.SetValue(mat_in);
                 return m_Exit;
             }
-            if (!m_filter || gpu != m_device)
-            {
-                if (m_filter) { delete m_filter; m_filter = nullptr; }
-                m_filter = new ImGui::SmartDenoise_vulkan(gpu);
-            }
+            // the filter is not built for a size, only the device picks one
+            m_filter = m_filters.Get(0, 0, 0, gpu, [&]() { return new ImGui::SmartDenoise_vulkan(gpu); });
             if (!m_filter)
             {
                 return {};
@@ -126,6 +125,7 @@ struct SmartDenoiseNode final : Node
         ImGui::EndDisabled();
         ImGui::PopItemWidth();
         ImGui::PopStyleColor();
+        ImGui::Text("%llu filter allocations", (unsigned long long)m_filters.Allocations());
         if (_sigma != m_sigma) { m_sigma = _sigma; changed = true; }
         if (_ksigma != m_ksigma) { m_ksigma = _ksigma; changed = true; }
         if (_threshold != m_threshold) { m_threshold = _threshold; changed = true; }
@@ -208,6 +208,7 @@ private:
     float m_ksigma          {2.0};
     float m_threshold       {0.2};
     ImGui::SmartDenoise_vulkan * m_filter   {nullptr};
+    FilterPool<ImGui::SmartDenoise_vulkan> m_filters;
     mutable ImTextureID  m_logo {0};
     mutable int m_logo_index {0};
 
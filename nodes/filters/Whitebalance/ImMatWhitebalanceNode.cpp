@@ -2,6 +2,7 @@
 #include <imgui_json.h>
 #include <imgui_extra_widget.h>
 #include <ImVulkanShader.h>
+#include "ColorAdjustNode.h"
 #include "WhiteBalance_vulkan.h"
 
 #define NODE_VERSION    0x01000000
@@ -42,6 +43,11 @@ struct WhiteBalanceNode final : Node
                 m_MatOut.SetValue(mat_in);
                 return m_Exit;
             }
+            // no vulkan device on this worker, run the shared cpu backend
+            ColorAdjustParams params;
+            params.temperature = m_temperature;
+            if (ColorAdjustCpuFallback(params, mat_in, m_mat_data_type, *this, m_MatOut))
+                return m_Exit;
             if (!m_filter || gpu != m_device)
             {
                 if (m_filter) { delete m_filter; m_filter = nullptr; }
@@ -169,6 +169,13 @@ public:
     AVDictionary* extra_options = nullptr;
     int write_cnt;
 
+    // encoder statistics
+    int64_t send_cnt;       // frames sent to the encoder
+    int64_t packet_cnt;     // packets received from the encoder
+    int encoder_delay;      // frames held by the encoder when its last packet came out
+    int64_t write_bytes;    // packet bytes handed to the muxer
+    int packets_in_flight() const { return (int)(send_cnt - packet_cnt); }
+
     /* audio fifo */
     AVFrame* audio_frame;
     AVAudioFifo* audio_fifo;
@@ -192,6 +199,11 @@ public:
     int get_audio_stream_idx(const int index = -1);
     FFMediaStream* get_stream(const int stream_idx);
     FFMEDIA_RETVALUE write_one_frame(const AVFrame* pFrame, const int stream_idx);
+    // write_one_frame() in two halves, so encoding and muxing can run on
+    // different threads. Packets come back in stream time base, and
+    // write_encoded_packet() takes ownership of the packet.
+    FFMEDIA_RETVALUE encode_frame(const AVFrame* pFrame, const int stream_idx, std::vector<AVPacket*>& packets);
+    FFMEDIA_RETVALUE write_encoded_packet(AVPacket* pPkt);
     FFMEDIA_RETVALUE write_one_packet(const AVPacket* pPkt);
     const FFMedia_HWInfo* get_hw_info();
     void reset_hw_info(bool force_cpu = false);
@@ -200,8 +212,10 @@ public:
 private:
     FFMEDIA_RETVALUE add_audio_stream(FFMediaStream* pStream);
     FFMEDIA_RETVALUE add_video_stream(FFMediaStream* pStream);
-    AVPacket* encode_one_frame(AVFrame* pFrame, const int stream_idx);
-    FFMEDIA_RETVALUE write_audio_frame(const AVFrame* pFrame, const int stream_idx);
+    // pFrame = nullptr flushes the encoder
+    FFMEDIA_RETVALUE encode_one_frame(AVFrame* pFrame, const int stream_idx, std::vector<AVPacket*>& packets);
+    FFMEDIA_RETVALUE receive_packets(FFMediaStream* pStream, const int stream_idx, std::vector<AVPacket*>& packets);
+    FFMEDIA_RETVALUE encode_audio_frame(const AVFrame* pFrame, const int stream_idx, std::vector<AVPacket*>& packets);
     std::string m_name;
     std::string m_container;
     std::string m_extra_params;
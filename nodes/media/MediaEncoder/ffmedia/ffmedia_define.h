@@ -25,6 +25,9 @@ extern "C"
 #include "libavcodec/avcodec.h"
 };
 
+// key frame interval of the video encoders
+#define FFMEDIA_VIDEO_GOP_SIZE  12
+
 enum FFMEDIA_RETVALUE : int
 {
     FFMEDIA_SUCCESS = 0,
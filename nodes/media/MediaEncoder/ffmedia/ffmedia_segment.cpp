@@ -0,0 +1,328 @@
+#include "ffmedia_segment.h"
+#include "ffmedia_queue.h"
+#include "ffmedia_common.h"
+#include <cstdio>
+
+#define SEGMENT_QUEUE_SIZE  8
+
+static void release_frame(void* data)
+{
+    AVFrame* pFrame = (AVFrame*)data;
+    av_frame_free(&pFrame);
+}
+
+static bool open_input(const std::string& file, AVMediaType type, AVFormatContext** ppCtx, int* pIndex)
+{
+    *ppCtx = nullptr;
+    int fferr = avformat_open_input(ppCtx, file.c_str(), nullptr, nullptr);
+    if (fferr)
+    {
+        print_av_err_str(fferr);
+        return false;
+    }
+    fferr = avformat_find_stream_info(*ppCtx, nullptr);
+    if (fferr >= 0)
+        fferr = av_find_best_stream(*ppCtx, type, -1, -1, nullptr, 0);
+    if (fferr < 0)
+    {
+        print_av_err_str(fferr);
+        avformat_close_input(ppCtx);
+        return false;
+    }
+    *pIndex = fferr;
+    return true;
+}
+
+static bool read_stream_packet(AVFormatContext* pCtx, int index, AVPacket* pPkt)
+{
+    while (av_read_frame(pCtx, pPkt) >= 0)
+    {
+        if (pPkt->stream_index == index)
+            return true;
+        av_packet_unref(pPkt);
+    }
+    return false;
+}
+
+static inline int64_t packet_ts(const AVPacket* pPkt)
+{
+    return pPkt->dts != AV_NOPTS_VALUE ? pPkt->dts : pPkt->pts;
+}
+
+FFMediaSegmentWriter::~FFMediaSegmentWriter()
+{
+    abort();
+    if (m_video)
+    {
+        delete m_video;
+        m_video = nullptr;
+    }
+}
+
+FFMEDIA_RETVALUE FFMediaSegmentWriter::open(const FFMediaStream& video, int segment_frames, int workers, const std::string& temp_prefix)
+{
+    if (m_opened || video.type != FFMEDIA_STREAMTYPE::VIDEO || segment_frames <= 0)
+        return FFMEDIA_FAILED;
+
+    if (m_video)
+        delete m_video;
+    m_video = new FFMediaStream(0, FFMEDIA_STREAMTYPE::VIDEO);
+    m_video->activated = true;
+    m_video->width = video.width;
+    m_video->height = video.height;
+    m_video->frame_rate = video.frame_rate;
+    m_video->hdr_type = video.hdr_type;
+    m_video->bit_depth = video.bit_depth;
+    m_video->tbc = video.tbc;
+    m_video->tbn = video.tbn;
+    m_video->codec_id = video.codec_id;
+    m_video->bit_rate = video.bit_rate;
+
+    // segments always run on software encoders, hardware sessions are few
+    FFMediaSink probe(true);
+    bool use_hw = false;
+    bool use_10bit = video.bit_depth > 8;
+    m_video->pixel_format = (AVPixelFormat)probe.update_encoder_caps(video.codec_id, use_hw, use_10bit);
+    m_video->bit_depth = use_10bit ? 10 : 8;
+
+    m_temp_prefix = temp_prefix;
+    m_segment_frames = segment_frames;
+    m_workers = workers > 0 ? workers : 1;
+    m_current = nullptr;
+    m_current_frames = 0;
+    m_segment_num = 0;
+    m_segments_done = 0;
+    m_active = 0;
+    m_opened = true;
+    return FFMEDIA_SUCCESS;
+}
+
+void FFMediaSegmentWriter::segment_proc(Segment* segment)
+{
+    FFMedia_Queue* queue = (FFMedia_Queue*)segment->queue;
+    FFMediaSink sink(true);
+    // no B-frames, so dts never goes back across a segment boundary
+    AVDictionary* options = nullptr;
+    av_dict_set(&options, "bf", "0", 0);
+    int stream_idx = sink.compose_stream(m_video, options);
+    bool ok = stream_idx >= 0 &&
+              sink.open(segment->file.c_str()) == FFMEDIA_SUCCESS &&
+              sink.start_streaming() == FFMEDIA_SUCCESS;
+    if (!ok)
+        fprintf(stderr, "[FFMediaSegmentWriter]Error: fail to start segment %s\n", segment->file.c_str());
+
+    void* data = nullptr;
+    while (queue->pop(data, true))
+    {
+        AVFrame* pFrame = (AVFrame*)data;
+        if (ok && sink.write_one_frame(pFrame, stream_idx) != FFMEDIA_SUCCESS)
+            ok = false;
+        av_frame_free(&pFrame);
+    }
+    if (ok)
+        ok = sink.stop_streaming() == FFMEDIA_SUCCESS;
+    sink.close();
+    av_dict_free(&options);
+
+    segment->failed = !ok;
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_active--;
+    m_segments_done++;
+    m_cond.notify_all();
+}
+
+FFMEDIA_RETVALUE FFMediaSegmentWriter::start_segment()
+{
+    {
+        std::unique_lock<std::mutex> lk(m_mutex);
+        m_cond.wait(lk, [this] { return m_active < m_workers; });
+        m_active++;
+    }
+    Segment* segment = new Segment();
+    segment->file = m_temp_prefix + ".seg" + std::to_string(m_segment_num) + ".mkv";
+    segment->queue = new FFMedia_Queue(SEGMENT_QUEUE_SIZE, release_frame);
+    segment->worker = std::thread(&FFMediaSegmentWriter::segment_proc, this, segment);
+    m_segments.push_back(segment);
+    m_current = segment;
+    m_current_frames = 0;
+    m_segment_num++;
+    return FFMEDIA_SUCCESS;
+}
+
+void FFMediaSegmentWriter::end_segment()
+{
+    if (!m_current)
+        return;
+    ((FFMedia_Queue*)m_current->queue)->stop();
+    m_current = nullptr;
+}
+
+FFMEDIA_RETVALUE FFMediaSegmentWriter::write_frame(AVFrame* pFrame)
+{
+    if (!m_opened)
+    {
+        av_frame_free(&pFrame);
+        return FFMEDIA_FAILED;
+    }
+    if (m_current && m_current_frames >= m_segment_frames)
+        end_segment();
+    if (!m_current)
+        start_segment();
+    if (!((FFMedia_Queue*)m_current->queue)->push(pFrame, true))
+    {
+        av_frame_free(&pFrame);
+        return FFMEDIA_FAILED;
+    }
+    m_current_frames++;
+    return FFMEDIA_SUCCESS;
+}
+
+FFMEDIA_RETVALUE FFMediaSegmentWriter::wait_segments()
+{
+    end_segment();
+    FFMEDIA_RETVALUE ret = FFMEDIA_SUCCESS;
+    for (auto segment : m_segments)
+    {
+        if (segment->worker.joinable())
+            segment->worker.join();
+        if (segment->failed)
+            ret = FFMEDIA_FAILED;
+    }
+    return ret;
+}
+
+FFMEDIA_RETVALUE FFMediaSegmentWriter::remux(const std::string& name, const std::string& audio_file)
+{
+    if (m_segments.empty())
+        return FFMEDIA_FAILED;
+
+    auto seg = m_segments.begin();
+    AVFormatContext* pVideoCtx = nullptr;
+    int video_index = -1;
+    if (!open_input((*seg)->file, AVMEDIA_TYPE_VIDEO, &pVideoCtx, &video_index))
+        return FFMEDIA_FAILED;
+    AVFormatContext* pAudioCtx = nullptr;
+    int audio_index = -1;
+    if (!audio_file.empty() && !open_input(audio_file, AVMEDIA_TYPE_AUDIO, &pAudioCtx, &audio_index))
+        fprintf(stderr, "[FFMediaSegmentWriter]Error: fail to open audio %s, export video only\n", audio_file.c_str());
+
+    FFMediaSink sink(true);
+    FFMediaStream video(0, FFMEDIA_STREAMTYPE::VIDEO);
+    video.activated = false;
+    video.stream = pVideoCtx->streams[video_index];
+    video.tbn = video.stream->time_base;
+    int out_video = sink.compose_stream(&video);
+    int out_audio = -1;
+    if (pAudioCtx)
+    {
+        FFMediaStream audio(1, FFMEDIA_STREAMTYPE::AUDIO);
+        audio.activated = false;
+        audio.stream = pAudioCtx->streams[audio_index];
+        audio.tbn = audio.stream->time_base;
+        out_audio = sink.compose_stream(&audio);
+    }
+    FFMEDIA_RETVALUE ret = FFMEDIA_SUCCESS;
+    bool streaming = out_video >= 0 &&
+                     sink.open(name.c_str()) == FFMEDIA_SUCCESS &&
+                     sink.start_streaming() == FFMEDIA_SUCCESS;
+    if (!streaming)
+    {
+        fprintf(stderr, "[FFMediaSegmentWriter]Error: fail to open %s for remux\n", name.c_str());
+        ret = FFMEDIA_FAILED;
+    }
+
+    AVPacket* pVideoPkt = av_packet_alloc();
+    AVPacket* pAudioPkt = av_packet_alloc();
+    AVRational video_tb = pVideoCtx->streams[video_index]->time_base;
+    AVRational audio_tb = pAudioCtx ? pAudioCtx->streams[audio_index]->time_base : AVRational{1, 1};
+    // video packets continue from one segment file into the next
+    auto read_video = [&]() -> bool
+    {
+        while (pVideoCtx)
+        {
+            if (read_stream_packet(pVideoCtx, video_index, pVideoPkt))
+                return true;
+            avformat_close_input(&pVideoCtx);
+            if (++seg == m_segments.end())
+                break;
+            if (!open_input((*seg)->file, AVMEDIA_TYPE_VIDEO, &pVideoCtx, &video_index))
+            {
+                ret = FFMEDIA_FAILED;
+                break;
+            }
+            video_tb = pVideoCtx->streams[video_index]->time_base;
+        }
+        return false;
+    };
+
+    bool has_video = ret == FFMEDIA_SUCCESS && read_video();
+    bool has_audio = ret == FFMEDIA_SUCCESS && pAudioCtx && read_stream_packet(pAudioCtx, audio_index, pAudioPkt);
+    while (has_video || has_audio)
+    {
+        bool take_video = has_video &&
+                          (!has_audio || av_compare_ts(packet_ts(pVideoPkt), video_tb, packet_ts(pAudioPkt), audio_tb) <= 0);
+        AVPacket* pPkt = take_video ? pVideoPkt : pAudioPkt;
+        int out_index = take_video ? out_video : out_audio;
+        av_packet_rescale_ts(pPkt, take_video ? video_tb : audio_tb, sink.get_stream(out_index)->tbn);
+        pPkt->stream_index = out_index;
+        pPkt->pos = -1;
+        if (sink.write_one_packet(pPkt) != FFMEDIA_SUCCESS)
+            ret = FFMEDIA_FAILED;
+        av_packet_unref(pPkt);
+        if (take_video)
+            has_video = read_video();
+        else
+            has_audio = read_stream_packet(pAudioCtx, audio_index, pAudioPkt);
+    }
+
+    if (streaming && sink.stop_streaming() != FFMEDIA_SUCCESS)
+        ret = FFMEDIA_FAILED;
+    sink.close();
+    av_packet_free(&pVideoPkt);
+    av_packet_free(&pAudioPkt);
+    if (pVideoCtx)
+        avformat_close_input(&pVideoCtx);
+    if (pAudioCtx)
+        avformat_close_input(&pAudioCtx);
+    return ret;
+}
+
+FFMEDIA_RETVALUE FFMediaSegmentWriter::finish(const std::string& name, const std::string& audio_file)
+{
+    if (!m_opened)
+        return FFMEDIA_FAILED;
+    FFMEDIA_RETVALUE ret = wait_segments();
+    if (ret == FFMEDIA_SUCCESS)
+        ret = remux(name, audio_file);
+    else
+        fprintf(stderr, "[FFMediaSegmentWriter]Error: some segments failed, %s is not written\n", name.c_str());
+    abort();
+    return ret;
+}
+
+void FFMediaSegmentWriter::remove_files()
+{
+    for (auto segment : m_segments)
+        std::remove(segment->file.c_str());
+}
+
+void FFMediaSegmentWriter::abort()
+{
+    m_current = nullptr;
+    for (auto segment : m_segments)
+    {
+        FFMedia_Queue* queue = (FFMedia_Queue*)segment->queue;
+        queue->quit();
+        if (segment->worker.joinable())
+            segment->worker.join();
+    }
+    remove_files();
+    for (auto segment : m_segments)
+    {
+        delete (FFMedia_Queue*)segment->queue;
+        delete segment;
+    }
+    m_segments.clear();
+    m_active = 0;
+    m_opened = false;
+}
@@ -0,0 +1,71 @@
+#ifndef __FFMEDIA_SEGMENT_H__
+#define __FFMEDIA_SEGMENT_H__
+
+#include "ffmedia.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <list>
+
+// Splits a video stream into segments of whole GOPs and encodes every segment
+// with its own software FFMediaSink on a worker thread. Each segment starts a
+// fresh encoder, so it opens with an IDR frame and references nothing before
+// it. finish() remuxes the segment files, plus an optional audio file, into
+// the final container without re-encoding.
+class FFMediaSegmentWriter
+{
+public:
+    FFMediaSegmentWriter() = default;
+    ~FFMediaSegmentWriter();
+
+    // video: settings as for FFMediaSink::compose_stream()
+    // temp_prefix: segment files are written to <temp_prefix>.seg<N>.mkv
+    FFMEDIA_RETVALUE open(const FFMediaStream& video, int segment_frames, int workers, const std::string& temp_prefix);
+    // pFrame pts is in video.tbc, the writer takes ownership of the frame.
+    // Blocks while 'workers' segments are already encoding, that is the
+    // back-pressure of a parallel export.
+    FFMEDIA_RETVALUE write_frame(AVFrame* pFrame);
+    // Wait for every segment and remux them into 'name'
+    FFMEDIA_RETVALUE finish(const std::string& name, const std::string& audio_file);
+    // Drop everything, remove the segment files
+    void abort();
+
+    bool is_open() const { return m_opened; }
+    FFMediaStream* get_stream() { return m_video; }
+    int segments() const { return m_segment_num; }
+    int segments_done() const { return m_segments_done; }
+
+private:
+    struct Segment
+    {
+        std::string file;
+        void* queue {nullptr};
+        std::thread worker;
+        bool failed {false};
+    };
+
+    void segment_proc(Segment* segment);
+    FFMEDIA_RETVALUE start_segment();
+    void end_segment();
+    FFMEDIA_RETVALUE wait_segments();
+    FFMEDIA_RETVALUE remux(const std::string& name, const std::string& audio_file);
+    void remove_files();
+
+private:
+    FFMediaStream* m_video {nullptr};
+    std::string m_temp_prefix;
+    int m_segment_frames {0};
+    int m_workers {1};
+    bool m_opened {false};
+
+    std::list<Segment*> m_segments;
+    Segment* m_current {nullptr};
+    int m_current_frames {0};
+    std::atomic_int m_segment_num {0};     // read by the UI while frames come in
+    std::atomic_int m_segments_done {0};
+    int m_active {0};
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+};
+
+#endif  //__FFMEDIA_SEGMENT_H__
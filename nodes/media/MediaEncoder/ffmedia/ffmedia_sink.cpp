@@ -265,7 +265,7 @@ FFMEDIA_RETVALUE FFMediaSink::add_video_stream(FFMediaStream* pMediaStream)
         codec_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
     }
     
-    codec_ctx->gop_size = 12;
+    codec_ctx->gop_size = FFMEDIA_VIDEO_GOP_SIZE;
     codec_ctx->bit_rate = pMediaStream->bit_rate > 0 ? pMediaStream->bit_rate : DEFAULT_VIDEO_BITRATE;
 
     if (pMediaStream->hdr_type != FFMEDIA_HDRTYPE::NONE)
@@ -533,6 +533,21 @@ FFMEDIA_RETVALUE FFMediaSink::stop_streaming()
     if (!m_streaming)
         return FFMEDIA_SUCCESS;
 
+    // drain the frames still held for lookahead and reordering
+    for (int i = 0; i < m_stream_num; i++)
+    {
+        FFMediaStream* pStream = m_active_streams[i];
+        if (!pStream->activated || !pStream->codec_ctx)
+            continue;
+        std::vector<AVPacket*> packets;
+        encode_one_frame(nullptr, i, packets);
+        for (auto pPkt : packets)
+        {
+            av_packet_rescale_ts(pPkt, pStream->tbc, pStream->tbn);
+            write_encoded_packet(pPkt);
+        }
+    }
+
     av_write_trailer(m_AvFmtCtx);
     m_streaming = false;
 
@@ -600,8 +615,18 @@ FFMediaStream* FFMediaSink::get_stream(const int stream_index)
 
 FFMEDIA_RETVALUE FFMediaSink::write_one_frame(const AVFrame* pFrame, const int stream_index)
 {
-    int fferr = 0;
+    std::vector<AVPacket*> packets;
+    FFMEDIA_RETVALUE ret = encode_frame(pFrame, stream_index, packets);
+    for (auto pPkt : packets)
+    {
+        if (write_encoded_packet(pPkt) != FFMEDIA_SUCCESS)
+            ret = FFMEDIA_FAILED;
+    }
+    return ret;
+}
 
+FFMEDIA_RETVALUE FFMediaSink::encode_frame(const AVFrame* pFrame, const int stream_index, std::vector<AVPacket*>& packets)
+{
     if (stream_index < 0 || stream_index >= m_stream_num || !m_streaming)
         return FFMEDIA_FAILED;
 
@@ -613,7 +638,7 @@ FFMEDIA_RETVALUE FFMediaSink::write_one_frame(const AVFrame* pFrame, const int s
 
     if (pStream->type == FFMEDIA_STREAMTYPE::AUDIO && pStream->audio_fifo)
     {
-        return write_audio_frame(pFrame, stream_index);
+        return encode_audio_frame(pFrame, stream_index, packets);
     }
 
     AVFrame* pEncFrame = av_frame_clone(pFrame);
@@ -625,19 +650,32 @@ FFMEDIA_RETVALUE FFMediaSink::write_one_frame(const AVFrame* pFrame, const int s
     }
     // pEncFrame->pts -= pStream->start_pts;
 
-    AVPacket* pPkt = encode_one_frame(pEncFrame, stream_index);
+    size_t first = packets.size();
+    FFMEDIA_RETVALUE ret = encode_one_frame(pEncFrame, stream_index, packets);
     av_frame_free(&pEncFrame);
-    if (pPkt)
+    for (size_t i = first; i < packets.size(); i++)
+        av_packet_rescale_ts(packets[i], pStream->tbc, pStream->tbn);
+    return ret;
+}
+
+FFMEDIA_RETVALUE FFMediaSink::write_encoded_packet(AVPacket* pPkt)
+{
+    int stream_index = pPkt->stream_index;
+    if (stream_index < 0 || stream_index >= m_stream_num || !m_streaming)
     {
-        av_packet_rescale_ts(pPkt, pStream->tbc, pStream->tbn);
-        fferr = av_interleaved_write_frame(m_AvFmtCtx, pPkt);
-        pStream->write_cnt++;
         av_packet_free(&pPkt);
-        if (fferr)
-        {
-            print_av_err_str(fferr);
-            return FFMEDIA_FAILED;
-        }
+        return FFMEDIA_FAILED;
+    }
+
+    FFMediaStream* pStream = m_active_streams[stream_index];
+    pStream->write_bytes += pPkt->size;
+    int fferr = av_interleaved_write_frame(m_AvFmtCtx, pPkt);
+    pStream->write_cnt++;
+    av_packet_free(&pPkt);
+    if (fferr)
+    {
+        print_av_err_str(fferr);
+        return FFMEDIA_FAILED;
     }
     return FFMEDIA_SUCCESS;
 }
@@ -654,7 +692,10 @@ FFMEDIA_RETVALUE FFMediaSink::write_one_packet(const AVPacket* pPkt)
 
     pStream->read_cnt++;
 
-    int fferr = av_interleaved_write_frame(m_AvFmtCtx, av_packet_clone(pPkt));
+    pStream->write_bytes += pPkt->size;
+    AVPacket* pWritePkt = av_packet_clone(pPkt);
+    int fferr = av_interleaved_write_frame(m_AvFmtCtx, pWritePkt);
+    av_packet_free(&pWritePkt);
     pStream->write_cnt++;
     if (fferr)
     {
@@ -664,52 +705,66 @@ FFMEDIA_RETVALUE FFMediaSink::write_one_packet(const AVPacket* pPkt)
     return FFMEDIA_SUCCESS;
 }
 
-AVPacket* FFMediaSink::encode_one_frame(AVFrame* pFrame, const int stream_index)
+FFMEDIA_RETVALUE FFMediaSink::encode_one_frame(AVFrame* pFrame, const int stream_index, std::vector<AVPacket*>& packets)
 {
     if (stream_index < 0 || stream_index >= m_stream_num || !m_streaming)
-        return nullptr;
+        return FFMEDIA_FAILED;
 
     FFMediaStream* pMediaStream = m_active_streams[stream_index];
     if (!pMediaStream->activated || !pMediaStream->codec_ctx)
-        return nullptr;
+        return FFMEDIA_FAILED;
 
     int fferr = avcodec_send_frame(pMediaStream->codec_ctx, pFrame);
-
-    while (fferr == AVERROR(EAGAIN))
+    if (fferr == AVERROR(EAGAIN))
     {
+        // output is pending, read it out and the encoder takes the frame again
+        if (receive_packets(pMediaStream, stream_index, packets) != FFMEDIA_SUCCESS)
+            return FFMEDIA_FAILED;
         fferr = avcodec_send_frame(pMediaStream->codec_ctx, pFrame);
     }
-    if (fferr)
+    if (fferr && !(!pFrame && fferr == AVERROR_EOF))
     {
         print_av_err_str(fferr);
-        return nullptr;
+        return FFMEDIA_FAILED;
     }
+    if (pFrame)
+        pMediaStream->send_cnt++;
 
-    AVPacket* pPkt = av_packet_alloc();
-    if (!pPkt)
-    {
-        fprintf(stderr, "[FFMediaSink]Error: fail to alloc packet for encoder \n");
-        return nullptr;
-    }
+    return receive_packets(pMediaStream, stream_index, packets);
+}
 
-    fferr = avcodec_receive_packet(pMediaStream->codec_ctx, pPkt);
-    if (fferr)
+FFMEDIA_RETVALUE FFMediaSink::receive_packets(FFMediaStream* pMediaStream, const int stream_index, std::vector<AVPacket*>& packets)
+{
+    while (true)
     {
-        if (fferr != AVERROR(EAGAIN))
+        AVPacket* pPkt = av_packet_alloc();
+        if (!pPkt)
+        {
+            fprintf(stderr, "[FFMediaSink]Error: fail to alloc packet for encoder \n");
+            return FFMEDIA_FAILED;
+        }
+
+        int fferr = avcodec_receive_packet(pMediaStream->codec_ctx, pPkt);
+        if (fferr)
+        {
+            av_packet_free(&pPkt);
+            if (fferr == AVERROR(EAGAIN) || fferr == AVERROR_EOF)
+                return FFMEDIA_SUCCESS;
             print_av_err_str(fferr);
-        av_packet_free(&pPkt);
-        return nullptr;
+            return FFMEDIA_FAILED;
+        }
+        pPkt->stream_index = stream_index;
+        pMediaStream->packet_cnt++;
+        pMediaStream->encoder_delay = pMediaStream->packets_in_flight();
+        packets.push_back(pPkt);
     }
-    pPkt->stream_index = stream_index;
-    return pPkt;
 }
 
-FFMEDIA_RETVALUE FFMediaSink::write_audio_frame(const AVFrame* pFrame, const int stream_index)
+FFMEDIA_RETVALUE FFMediaSink::encode_audio_frame(const AVFrame* pFrame, const int stream_index, std::vector<AVPacket*>& packets)
 {
     FFMediaStream* pStream = m_active_streams[stream_index];
     AVFrame* pDstFrame = pStream->audio_frame;
     AVCodecContext* codec_ctx = pStream->codec_ctx;
-    int fferr = 0;
     if (pStream->audio_sample_cnt == 0)
     {
         pStream->fifo_start_pts = pFrame->pts;
@@ -736,19 +791,12 @@ FFMEDIA_RETVALUE FFMediaSink::write_audio_frame(const AVFrame* pFrame, const int
 
         pStream->audio_sample_cnt += pDstFrame->nb_samples;
 
-        AVPacket* pPkt = encode_one_frame(pDstFrame, stream_index);
-        if (pPkt)
-        {
-            av_packet_rescale_ts(pPkt, pStream->tbc, pStream->tbn);
-            fferr = av_interleaved_write_frame(m_AvFmtCtx, pPkt);
-            pStream->write_cnt++;
-            av_packet_free(&pPkt);
-            if (fferr)
-            {
-                print_av_err_str(fferr);
-                return FFMEDIA_FAILED;
-            }
-        }
+        size_t first = packets.size();
+        FFMEDIA_RETVALUE ret = encode_one_frame(pDstFrame, stream_index, packets);
+        for (size_t i = first; i < packets.size(); i++)
+            av_packet_rescale_ts(packets[i], pStream->tbc, pStream->tbn);
+        if (ret != FFMEDIA_SUCCESS)
+            return ret;
     }
 
     return FFMEDIA_SUCCESS;
@@ -41,6 +41,11 @@ FFMediaStream::FFMediaStream(int idx, FFMEDIA_STREAMTYPE _type)
     extra_options = nullptr;
     write_cnt = 0;
 
+    send_cnt = 0;
+    packet_cnt = 0;
+    encoder_delay = 0;
+    write_bytes = 0;
+
     audio_frame = nullptr;
     audio_fifo = nullptr;
     audio_framesize = 0;
@@ -0,0 +1,379 @@
+#include "rgba2yuv.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+struct YUVLayout
+{
+    int bits;           // sample bit depth
+    int shift;          // msb aligned samples (P010)
+    bool wide;          // 16 bit storage
+    bool semi_planar;   // interleaved UV plane
+};
+
+struct YUVCoef
+{
+    float kr, kg, kb;
+    float cb_mul, cr_mul;
+    float y_scale, y_offset;
+    float c_scale, c_offset;
+    int max;
+};
+
+static bool get_layout(int format, YUVLayout& layout)
+{
+    switch (format)
+    {
+        case AV_PIX_FMT_YUV420P:        layout = {8, 0, false, false}; return true;
+        case AV_PIX_FMT_YUV420P10LE:    layout = {10, 0, true, false}; return true;
+        case AV_PIX_FMT_NV12:           layout = {8, 0, false, true}; return true;
+        case AV_PIX_FMT_P010LE:         layout = {10, 6, true, true}; return true;
+        default: return false;
+    }
+}
+
+static YUVCoef get_coef(AVColorSpace colorspace, AVColorRange range, int bits)
+{
+    YUVCoef coef;
+    if (colorspace == AVCOL_SPC_BT2020_NCL || colorspace == AVCOL_SPC_BT2020_CL)
+    {
+        coef.kr = 0.2627f; coef.kb = 0.0593f;
+    }
+    else if (colorspace == AVCOL_SPC_BT470BG || colorspace == AVCOL_SPC_SMPTE170M)
+    {
+        coef.kr = 0.299f; coef.kb = 0.114f;
+    }
+    else
+    {
+        coef.kr = 0.2126f; coef.kb = 0.0722f;
+    }
+    coef.kg = 1.f - coef.kr - coef.kb;
+    coef.cb_mul = 0.5f / (1.f - coef.kb);
+    coef.cr_mul = 0.5f / (1.f - coef.kr);
+    coef.max = (1 << bits) - 1;
+    if (range == AVCOL_RANGE_JPEG)
+    {
+        coef.y_scale = coef.max;
+        coef.y_offset = 0.f;
+        coef.c_scale = coef.max;
+        coef.c_offset = 1 << (bits - 1);
+    }
+    else
+    {
+        const float unit = 1 << (bits - 8);
+        coef.y_scale = 219.f * unit;
+        coef.y_offset = 16.f * unit;
+        coef.c_scale = 224.f * unit;
+        coef.c_offset = 128.f * unit;
+    }
+    // +0.5 makes the truncating float to int conversion round to nearest
+    coef.y_offset += 0.5f;
+    coef.c_offset += 0.5f;
+    return coef;
+}
+
+static inline int clamp_sample(int v, int max)
+{
+    return v < 0 ? 0 : v > max ? max : v;
+}
+
+static inline void store_luma(uint8_t* row, int x, int v, const YUVLayout& layout, const YUVCoef& coef)
+{
+    v = clamp_sample(v, coef.max);
+    if (layout.wide)
+        ((uint16_t*)row)[x] = (uint16_t)(v << layout.shift);
+    else
+        row[x] = (uint8_t)v;
+}
+
+static inline void store_chroma(uint8_t* u_row, uint8_t* v_row, int cx, int u, int v, const YUVLayout& layout, const YUVCoef& coef)
+{
+    u = clamp_sample(u, coef.max) << layout.shift;
+    v = clamp_sample(v, coef.max) << layout.shift;
+    if (layout.semi_planar)
+    {
+        if (layout.wide)
+        {
+            ((uint16_t*)u_row)[cx * 2] = (uint16_t)u;
+            ((uint16_t*)u_row)[cx * 2 + 1] = (uint16_t)v;
+        }
+        else
+        {
+            u_row[cx * 2] = (uint8_t)u;
+            u_row[cx * 2 + 1] = (uint8_t)v;
+        }
+    }
+    else
+    {
+        if (layout.wide)
+        {
+            ((uint16_t*)u_row)[cx] = (uint16_t)u;
+            ((uint16_t*)v_row)[cx] = (uint16_t)v;
+        }
+        else
+        {
+            u_row[cx] = (uint8_t)u;
+            v_row[cx] = (uint8_t)v;
+        }
+    }
+}
+
+static inline void load_pixel(const uint8_t* row, int x, RGBA_SAMPLE sample, float norm, float& r, float& g, float& b)
+{
+    if (sample == RGBA_SAMPLE::UINT8)
+    {
+        const uint8_t* p = row + x * 4;
+        r = p[0] * norm; g = p[1] * norm; b = p[2] * norm;
+    }
+    else if (sample == RGBA_SAMPLE::UINT16)
+    {
+        const uint16_t* p = (const uint16_t*)row + x * 4;
+        r = p[0] * norm; g = p[1] * norm; b = p[2] * norm;
+    }
+    else
+    {
+        const float* p = (const float*)row + x * 4;
+        r = std::min(std::max(p[0], 0.f), 1.f);
+        g = std::min(std::max(p[1], 0.f), 1.f);
+        b = std::min(std::max(p[2], 0.f), 1.f);
+    }
+}
+
+// pixels [x0, x1) of a row pair, x0 even
+static void convert_scalar(const uint8_t* row0, const uint8_t* row1, int x0, int x1, int width, RGBA_SAMPLE sample, float norm,
+                           uint8_t* y_row0, uint8_t* y_row1, uint8_t* u_row, uint8_t* v_row,
+                           const YUVLayout& layout, const YUVCoef& coef)
+{
+    for (int x = x0; x < x1; x += 2)
+    {
+        const int xn = x + 1 < width ? x + 1 : x;
+        float r[4], g[4], b[4];
+        load_pixel(row0, x, sample, norm, r[0], g[0], b[0]);
+        load_pixel(row0, xn, sample, norm, r[1], g[1], b[1]);
+        load_pixel(row1, x, sample, norm, r[2], g[2], b[2]);
+        load_pixel(row1, xn, sample, norm, r[3], g[3], b[3]);
+        for (int i = 0; i < 4; i++)
+        {
+            const float y = coef.kr * r[i] + coef.kg * g[i] + coef.kb * b[i];
+            const int v = (int)(y * coef.y_scale + coef.y_offset);
+            uint8_t* y_row = i < 2 ? y_row0 : y_row1;
+            const int px = (i & 1) ? xn : x;
+            if (y_row)
+                store_luma(y_row, px, v, layout, coef);
+        }
+        const float ra = (r[0] + r[1] + r[2] + r[3]) * 0.25f;
+        const float ga = (g[0] + g[1] + g[2] + g[3]) * 0.25f;
+        const float ba = (b[0] + b[1] + b[2] + b[3]) * 0.25f;
+        const float ya = coef.kr * ra + coef.kg * ga + coef.kb * ba;
+        const int u = (int)((ba - ya) * coef.cb_mul * coef.c_scale + coef.c_offset);
+        const int v = (int)((ra - ya) * coef.cr_mul * coef.c_scale + coef.c_offset);
+        store_chroma(u_row, v_row, x / 2, u, v, layout, coef);
+    }
+}
+
+#if defined(__SSE2__) || defined(__ARM_NEON)
+#if defined(__SSE2__)
+typedef __m128 vfloat;
+static inline vfloat v_set(float v) { return _mm_set1_ps(v); }
+static inline vfloat v_add(vfloat a, vfloat b) { return _mm_add_ps(a, b); }
+static inline vfloat v_sub(vfloat a, vfloat b) { return _mm_sub_ps(a, b); }
+static inline vfloat v_mul(vfloat a, vfloat b) { return _mm_mul_ps(a, b); }
+static inline vfloat v_clamp01(vfloat a) { return _mm_min_ps(_mm_max_ps(a, _mm_setzero_ps()), _mm_set1_ps(1.f)); }
+static inline void v_store_int(int32_t* dst, vfloat a) { _mm_storeu_si128((__m128i*)dst, _mm_cvttps_epi32(a)); }
+// [p0+p1, p2+p3, p0+p1, p2+p3]
+static inline vfloat v_pair_sum(vfloat a)
+{
+    return _mm_add_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 3, 1)));
+}
+
+static inline void v_load4(const uint8_t* row, int x, RGBA_SAMPLE sample, vfloat norm, vfloat& r, vfloat& g, vfloat& b)
+{
+    __m128 p0, p1, p2, p3;
+    const __m128i zero = _mm_setzero_si128();
+    if (sample == RGBA_SAMPLE::UINT8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(row + x * 4));
+        __m128i lo = _mm_unpacklo_epi8(v, zero);
+        __m128i hi = _mm_unpackhi_epi8(v, zero);
+        p0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero));
+        p1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero));
+        p2 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero));
+        p3 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero));
+    }
+    else if (sample == RGBA_SAMPLE::UINT16)
+    {
+        const __m128i* p = (const __m128i*)((const uint16_t*)row + x * 4);
+        __m128i lo = _mm_loadu_si128(p);
+        __m128i hi = _mm_loadu_si128(p + 1);
+        p0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero));
+        p1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero));
+        p2 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero));
+        p3 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero));
+    }
+    else
+    {
+        const float* p = (const float*)row + x * 4;
+        p0 = _mm_loadu_ps(p);
+        p1 = _mm_loadu_ps(p + 4);
+        p2 = _mm_loadu_ps(p + 8);
+        p3 = _mm_loadu_ps(p + 12);
+    }
+    _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+    r = v_mul(p0, norm);
+    g = v_mul(p1, norm);
+    b = v_mul(p2, norm);
+}
+#else
+typedef float32x4_t vfloat;
+static inline vfloat v_set(float v) { return vdupq_n_f32(v); }
+static inline vfloat v_add(vfloat a, vfloat b) { return vaddq_f32(a, b); }
+static inline vfloat v_sub(vfloat a, vfloat b) { return vsubq_f32(a, b); }
+static inline vfloat v_mul(vfloat a, vfloat b) { return vmulq_f32(a, b); }
+static inline vfloat v_clamp01(vfloat a) { return vminq_f32(vmaxq_f32(a, vdupq_n_f32(0.f)), vdupq_n_f32(1.f)); }
+static inline void v_store_int(int32_t* dst, vfloat a) { vst1q_s32(dst, vcvtq_s32_f32(a)); }
+static inline vfloat v_pair_sum(vfloat a)
+{
+    float32x2_t s = vpadd_f32(vget_low_f32(a), vget_high_f32(a));
+    return vcombine_f32(s, s);
+}
+
+static inline void v_load4(const uint8_t* row, int x, RGBA_SAMPLE sample, vfloat norm, vfloat& r, vfloat& g, vfloat& b)
+{
+    if (sample == RGBA_SAMPLE::FLOAT32)
+    {
+        float32x4x4_t p = vld4q_f32((const float*)row + x * 4);
+        r = v_mul(p.val[0], norm);
+        g = v_mul(p.val[1], norm);
+        b = v_mul(p.val[2], norm);
+        return;
+    }
+    uint16x4x4_t p;
+    if (sample == RGBA_SAMPLE::UINT16)
+    {
+        p = vld4_u16((const uint16_t*)row + x * 4);
+    }
+    else
+    {
+        // widen 4 RGBA8 pixels, then split even/odd lanes twice
+        uint8x16_t v = vld1q_u8(row + x * 4);
+        uint16x8x2_t eo = vuzpq_u16(vmovl_u8(vget_low_u8(v)), vmovl_u8(vget_high_u8(v)));
+        uint16x8x2_t rb = vuzpq_u16(eo.val[0], eo.val[0]);
+        uint16x8x2_t ga = vuzpq_u16(eo.val[1], eo.val[1]);
+        p.val[0] = vget_low_u16(rb.val[0]);
+        p.val[1] = vget_low_u16(ga.val[0]);
+        p.val[2] = vget_low_u16(rb.val[1]);
+    }
+    r = v_mul(vcvtq_f32_u32(vmovl_u16(p.val[0])), norm);
+    g = v_mul(vcvtq_f32_u32(vmovl_u16(p.val[1])), norm);
+    b = v_mul(vcvtq_f32_u32(vmovl_u16(p.val[2])), norm);
+}
+#endif
+
+// 4 pixels of a row pair per step, returns the first pixel left over
+static int convert_simd(const uint8_t* row0, const uint8_t* row1, int width, RGBA_SAMPLE sample, float norm,
+                        uint8_t* y_row0, uint8_t* y_row1, uint8_t* u_row, uint8_t* v_row,
+                        const YUVLayout& layout, const YUVCoef& coef)
+{
+    const vfloat vnorm = v_set(sample == RGBA_SAMPLE::FLOAT32 ? 1.f : norm);
+    const vfloat kr = v_set(coef.kr), kg = v_set(coef.kg), kb = v_set(coef.kb);
+    const vfloat y_scale = v_set(coef.y_scale), y_offset = v_set(coef.y_offset);
+    const vfloat cb_scale = v_set(coef.cb_mul * coef.c_scale);
+    const vfloat cr_scale = v_set(coef.cr_mul * coef.c_scale);
+    const vfloat c_offset = v_set(coef.c_offset);
+    const vfloat quarter = v_set(0.25f);
+    const bool clamp = sample == RGBA_SAMPLE::FLOAT32;
+    int32_t y0[4], y1[4], u[4], v[4];
+    int x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        vfloat r0, g0, b0, r1, g1, b1;
+        v_load4(row0, x, sample, vnorm, r0, g0, b0);
+        v_load4(row1, x, sample, vnorm, r1, g1, b1);
+        if (clamp)
+        {
+            r0 = v_clamp01(r0); g0 = v_clamp01(g0); b0 = v_clamp01(b0);
+            r1 = v_clamp01(r1); g1 = v_clamp01(g1); b1 = v_clamp01(b1);
+        }
+        vfloat l0 = v_add(v_add(v_mul(kr, r0), v_mul(kg, g0)), v_mul(kb, b0));
+        vfloat l1 = v_add(v_add(v_mul(kr, r1), v_mul(kg, g1)), v_mul(kb, b1));
+        v_store_int(y0, v_add(v_mul(l0, y_scale), y_offset));
+        v_store_int(y1, v_add(v_mul(l1, y_scale), y_offset));
+
+        vfloat ra = v_mul(v_pair_sum(v_add(r0, r1)), quarter);
+        vfloat ga = v_mul(v_pair_sum(v_add(g0, g1)), quarter);
+        vfloat ba = v_mul(v_pair_sum(v_add(b0, b1)), quarter);
+        vfloat la = v_add(v_add(v_mul(kr, ra), v_mul(kg, ga)), v_mul(kb, ba));
+        v_store_int(u, v_add(v_mul(v_sub(ba, la), cb_scale), c_offset));
+        v_store_int(v, v_add(v_mul(v_sub(ra, la), cr_scale), c_offset));
+
+        for (int i = 0; i < 4; i++)
+        {
+            store_luma(y_row0, x + i, y0[i], layout, coef);
+            if (y_row1)
+                store_luma(y_row1, x + i, y1[i], layout, coef);
+        }
+        store_chroma(u_row, v_row, x / 2, u[0], v[0], layout, coef);
+        store_chroma(u_row, v_row, x / 2 + 1, u[1], v[1], layout, coef);
+    }
+    return x;
+}
+#endif
+
+static void convert_rows(const RGBAImage& src, AVFrame* frame, int pair0, int pair1, const YUVLayout& layout, const YUVCoef& coef)
+{
+    const float norm = src.sample == RGBA_SAMPLE::UINT8 ? 1.f / 255.f :
+                       src.sample == RGBA_SAMPLE::UINT16 ? 1.f / (float)((1 << src.depth) - 1) : 1.f;
+    for (int pair = pair0; pair < pair1; pair++)
+    {
+        const int y = pair * 2;
+        const bool has_row1 = y + 1 < src.height;
+        const uint8_t* row0 = (const uint8_t*)src.data + (size_t)y * src.linesize;
+        const uint8_t* row1 = has_row1 ? row0 + src.linesize : row0;
+        uint8_t* y_row0 = frame->data[0] + (size_t)y * frame->linesize[0];
+        uint8_t* y_row1 = has_row1 ? y_row0 + frame->linesize[0] : nullptr;
+        uint8_t* u_row = frame->data[1] + (size_t)pair * frame->linesize[1];
+        uint8_t* v_row = layout.semi_planar ? nullptr : frame->data[2] + (size_t)pair * frame->linesize[2];
+        int x = 0;
+#if defined(__SSE2__) || defined(__ARM_NEON)
+        x = convert_simd(row0, row1, src.width, src.sample, norm, y_row0, y_row1, u_row, v_row, layout, coef);
+#endif
+        convert_scalar(row0, row1, x, src.width, src.width, src.sample, norm, y_row0, y_row1, u_row, v_row, layout, coef);
+    }
+}
+
+bool rgba_to_yuv420(const RGBAImage& src, AVFrame* frame, AVColorSpace colorspace, AVColorRange range, int threads)
+{
+    YUVLayout layout;
+    if (!src.data || !frame || !get_layout(frame->format, layout))
+        return false;
+    if (frame->width < src.width || frame->height < src.height)
+        return false;
+    if (src.sample == RGBA_SAMPLE::UINT16 && (src.depth <= 0 || src.depth > 16))
+        return false;
+    const YUVCoef coef = get_coef(colorspace, range, layout.bits);
+
+    // bands of at least 16 row pairs, smaller ones cost more to start than to run
+    const int pairs = (src.height + 1) / 2;
+    if (threads <= 0)
+        threads = std::max(1, (int)std::thread::hardware_concurrency());
+    threads = std::max(1, std::min(threads, pairs / 16));
+    const int band = (pairs + threads - 1) / threads;
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads; i++)
+    {
+        const int pair0 = i * band;
+        const int pair1 = std::min(pairs, pair0 + band);
+        if (pair0 < pair1)
+            workers.emplace_back(convert_rows, std::cref(src), frame, pair0, pair1, std::cref(layout), std::cref(coef));
+    }
+    convert_rows(src, frame, 0, std::min(pairs, band), layout, coef);
+    for (auto& worker : workers)
+        worker.join();
+    return true;
+}
@@ -0,0 +1,31 @@
+#ifndef __RGBA2YUV_H__
+#define __RGBA2YUV_H__
+
+#include "ffmedia_define.h"
+
+enum class RGBA_SAMPLE
+{
+    UINT8,
+    UINT16,
+    FLOAT32,
+};
+
+struct RGBAImage
+{
+    const void* data {nullptr};
+    int linesize {0};       // bytes
+    int width {0};
+    int height {0};
+    RGBA_SAMPLE sample {RGBA_SAMPLE::UINT8};
+    int depth {8};          // significant bits of UINT16 samples
+};
+
+/*
+convert interleaved RGBA into the planes of frame, which must already hold
+YUV420P, YUV420P10LE, NV12 or P010LE buffers of the same size. Samples keep
+their full precision down to the output bit depth. Bands of rows run on
+'threads' workers, 0 for hardware concurrency.
+*/
+bool rgba_to_yuv420(const RGBAImage& src, AVFrame* frame, AVColorSpace colorspace, AVColorRange range, int threads = 0);
+
+#endif  //__RGBA2YUV_H__
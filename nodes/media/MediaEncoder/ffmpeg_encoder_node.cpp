@@ -23,10 +23,18 @@
 #include "ffmedia/ffmedia.h"
 #include "ffmedia/ffmedia_utils.h"
 #include "ffmedia/ffmedia_queue.h"
+#include "ffmedia/ffmedia_segment.h"
+#include "ffmedia/rgba2yuv.h"
+#include <AudioSampleCopy.h>
+#include <algorithm>
+#include <deque>
+#include <thread>
 
 static const char* hdr_system_items[] = { "None", "SDR", "HDR PQ", "HDR HLG"};
 
 #define NODE_VERSION    0x01020000
+#define MAX_ENCODE_QUEUE    8
+#define MAX_MUX_QUEUE       64
 
 //#define PRINT_INPUT_PTS
 //#define PRINT_OUTPUT_PTS
@@ -44,14 +52,14 @@ struct FFMpegEncoderNode final : Node
     ~FFMpegEncoderNode()
     {
         m_mutex.lock();
-        m_EncodeMat = ImGui::ImMat();
+        stop_encode_threads(false);
+        if (m_sws_ctx) { sws_freeContext(m_sws_ctx); m_sws_ctx = nullptr; }
 #if IMGUI_VULKAN_SHADER
         if (m_convert) { delete m_convert; m_convert = nullptr; }
-#else
-        if (m_img_convert_ctx) { sws_freeContext(m_img_convert_ctx); m_img_convert_ctx = nullptr; }
 #endif
         m_stream_index = 0;
         m_sink.close();
+        stop_parallel_export();
         m_video_stream = nullptr;
         m_video_stream_idx = -1;
         if (m_video_empty_queue)  { m_video_empty_queue->flush(); delete m_video_empty_queue; }
@@ -78,6 +86,8 @@ struct FFMpegEncoderNode final : Node
     void OnStop(Context& context) override
     {
         m_mutex.lock();
+        stop_encode_threads(true);
+        bool audio_written = m_streaming;
         if (m_streaming)
         {
             m_sink.stop_streaming();
@@ -86,6 +96,12 @@ struct FFMpegEncoderNode final : Node
                 printf("OnStop with %d video frames dropped \n", m_video_drop_frames);
             m_sink.close();
         }
+        if (m_parallel_active)
+        {
+            // segments are done when every worker returns, then one remux pass
+            if (m_segment_writer.finish(m_save_file_path, audio_written ? parallel_audio_path() : "") == FFMEDIA_SUCCESS)
+                printf("OnStop with %d video segments joined \n", m_segment_writer.segments());
+        }
         m_mutex.unlock();
         Reset(context);
     }
@@ -96,14 +112,14 @@ struct FFMpegEncoderNode final : Node
         
         m_mutex.lock();
 
-        m_EncodeMat = ImGui::ImMat();
+        stop_encode_threads(false);
+        if (m_sws_ctx) { sws_freeContext(m_sws_ctx); m_sws_ctx = nullptr; }
 #if IMGUI_VULKAN_SHADER
         if (m_convert) { delete m_convert; m_convert = nullptr; }
-#else
-        if (m_img_convert_ctx) { sws_freeContext(m_img_convert_ctx); m_img_convert_ctx = nullptr; }
 #endif
         m_stream_index = 0;
         m_sink.close();
+        stop_parallel_export();
         m_video_stream = nullptr;
         m_video_stream_idx = -1;
         if (m_video_empty_queue)  m_video_empty_queue->flush();
@@ -128,48 +144,124 @@ struct FFMpegEncoderNode final : Node
         m_mutex.unlock();
     }
 
-    void conv_mat_int8(ImGui::ImMat& in_mat, ImGui::ImMat& out_mat)
+    // interleaved RGBA of 8 or 16 bit or float, what rgba_to_yuv420 takes
+    static bool is_packed_rgba(const ImGui::ImMat& mat)
+    {
+        return mat.c == 4 && mat.elempack > 1 &&
+               (mat.type == IM_DT_INT8 || mat.type == IM_DT_INT16 || mat.type == IM_DT_FLOAT32);
+    }
+
+    bool convert_rgba_frame(const ImGui::ImMat& mat, AVFrame* pFrame)
     {
-        size_t total_size = in_mat.total();
-        unsigned char* dst = (unsigned char*)out_mat.data;
-        int size; 
-        if (in_mat.type == IM_DT_INT16)
+        if (!is_packed_rgba(mat))
+            return false;
+        RGBAImage image;
+        image.data = mat.data;
+        image.width = mat.w;
+        image.height = mat.h;
+        if (mat.type == IM_DT_INT8)
+            image.sample = RGBA_SAMPLE::UINT8;
+        else if (mat.type == IM_DT_INT16)
         {
-            short *src = (short*)in_mat.data;
-            size = total_size / 2;
-            for (int i=0;i<size;i++)
-                *dst++ = *src++ >> 8;
+            image.sample = RGBA_SAMPLE::UINT16;
+            image.depth = mat.depth > 8 && mat.depth <= 16 ? mat.depth : 16;
         }
-        else if (in_mat.type == IM_DT_INT32)
+        else
+            image.sample = RGBA_SAMPLE::FLOAT32;
+        image.linesize = mat.w * 4 * mat.elembits() / 8;
+        AVColorSpace colorspace = m_color_space == IM_CS_BT2020 ? AVCOL_SPC_BT2020_NCL : AVCOL_SPC_BT709;
+        AVColorRange range = m_color_range == IM_CR_FULL_RANGE ? AVCOL_RANGE_JPEG : AVCOL_RANGE_MPEG;
+        return rgba_to_yuv420(image, pFrame, colorspace, range);
+    }
+
+    // Gray, RGB, planar and any other CPU mat rgba_to_yuv420 doesn't take go
+    // through swscale. 8 bit samples are read in place, the others are brought
+    // to full scale 16 bit first so swscale keeps their precision.
+    bool convert_sws_frame(const ImGui::ImMat& mat, AVFrame* pFrame)
+    {
+        static const AVPixelFormat packed_formats[2][5] = {
+            { AV_PIX_FMT_NONE, AV_PIX_FMT_GRAY8, AV_PIX_FMT_NONE, AV_PIX_FMT_RGB24, AV_PIX_FMT_RGBA },
+            { AV_PIX_FMT_NONE, AV_PIX_FMT_GRAY16LE, AV_PIX_FMT_NONE, AV_PIX_FMT_RGB48LE, AV_PIX_FMT_RGBA64LE },
+        };
+        static const AVPixelFormat planar_formats[2][5] = {
+            { AV_PIX_FMT_NONE, AV_PIX_FMT_GRAY8, AV_PIX_FMT_NONE, AV_PIX_FMT_GBRP, AV_PIX_FMT_GBRAP },
+            { AV_PIX_FMT_NONE, AV_PIX_FMT_GRAY16LE, AV_PIX_FMT_NONE, AV_PIX_FMT_GBRP16LE, AV_PIX_FMT_GBRAP16LE },
+        };
+        if (mat.c < 1 || mat.c > 4 || (mat.type != IM_DT_INT8 && mat.type != IM_DT_INT16 && mat.type != IM_DT_FLOAT32))
+            return false;
+        const bool planar = mat.elempack == 1 && mat.c > 1;
+        const bool wide = mat.type != IM_DT_INT8;
+        const AVPixelFormat src_format = (planar ? planar_formats : packed_formats)[wide][mat.c];
+        if (src_format == AV_PIX_FMT_NONE)
+            return false;
+
+        // plane p of the source, in the order the mat keeps them
+        const size_t plane_samples = planar ? (size_t)mat.w * mat.h : (size_t)mat.w * mat.h * mat.c;
+        const int planes = planar ? mat.c : 1;
+        std::vector<const uint8_t*> src_planes(planes);
+        const int depth = mat.type == IM_DT_INT16 && mat.depth > 8 && mat.depth < 16 ? mat.depth : 16;
+        if (mat.type == IM_DT_INT8 || (mat.type == IM_DT_INT16 && depth == 16))
         {
-            int *src = (int*)in_mat.data;
-            size = total_size / 4;
-            for (int i=0;i<size;i++)
-                *dst++ = *src++ >> 24;
+            for (int p = 0; p < planes; p++)
+                src_planes[p] = (const uint8_t*)mat.data + p * mat.cstep * mat.elemsize;
         }
-        else if (in_mat.type == IM_DT_INT64)
+        else
         {
-            int64_t *src = (int64_t*)in_mat.data;
-            size = total_size / 8;
-            for (int i=0;i<size;i++)
-                *dst++ = *src++ >> 56;
+            m_sws_buffer.resize(plane_samples * planes);
+            for (int p = 0; p < planes; p++)
+            {
+                uint16_t* dst = m_sws_buffer.data() + p * plane_samples;
+                const uint8_t* src = (const uint8_t*)mat.data + p * mat.cstep * mat.elemsize;
+                if (mat.type == IM_DT_INT16)
+                {
+                    // msb align, then repeat the top bits into the low ones
+                    for (size_t i = 0; i < plane_samples; i++)
+                    {
+                        uint32_t v = ((const uint16_t*)src)[i] << (16 - depth);
+                        dst[i] = (uint16_t)(v | (v >> depth));
+                    }
+                }
+                else
+                {
+                    for (size_t i = 0; i < plane_samples; i++)
+                    {
+                        float v = std::min(std::max(((const float*)src)[i], 0.f), 1.f);
+                        dst[i] = (uint16_t)(v * 65535.f + 0.5f);
+                    }
+                }
+                src_planes[p] = (const uint8_t*)dst;
+            }
         }
-        else if (in_mat.type == IM_DT_FLOAT32)
+
+        AVPixelFormat dst_format = (AVPixelFormat)pFrame->format;
+        m_sws_ctx = sws_getCachedContext(m_sws_ctx, mat.w, mat.h, src_format, pFrame->width, pFrame->height, dst_format,
+                                         SWS_BICUBIC | SWS_ACCURATE_RND, NULL, NULL, NULL);
+        if (!m_sws_ctx)
+            return false;
+        int colorspace = m_color_space == IM_CS_BT2020 ? SWS_CS_BT2020 : SWS_CS_ITU709;
+        sws_setColorspaceDetails(m_sws_ctx, sws_getCoefficients(colorspace), 1,
+                                 sws_getCoefficients(colorspace), m_color_range == IM_CR_FULL_RANGE ? 1 : 0,
+                                 0, 1 << 16, 1 << 16);
+
+        const uint8_t* src_data[4] = { nullptr };
+        int src_linesize[4] = { 0 };
+        const int sample_bytes = wide ? 2 : 1;
+        if (planar)
         {
-            float *src = (float*)in_mat.data;
-            size = total_size / 4;
-            for (int i=0;i<size;i++)
+            // swscale orders the planes G, B, R, A
+            static const int order[4] = { 1, 2, 0, 3 };
+            for (int p = 0; p < planes; p++)
             {
-                float data = *src++;
-                if (data < 0) data = 0;
-                if (data > 1) data = 1;
-                *dst++ = data * 256;
+                src_data[p] = src_planes[order[p]];
+                src_linesize[p] = mat.w * sample_bytes;
             }
         }
         else
         {
-            printf("copy mat format unknown! \n");
+            src_data[0] = src_planes[0];
+            src_linesize[0] = mat.w * mat.c * sample_bytes;
         }
+        return sws_scale(m_sws_ctx, src_data, src_linesize, 0, mat.h, pFrame->data, pFrame->linesize) > 0;
     }
 
     void check_hw_caps()
@@ -179,6 +271,23 @@ struct FFMpegEncoderNode final : Node
         m_output_pix_fmt = (AVPixelFormat)m_sink.update_encoder_caps(m_video_codec==0 ? AV_CODEC_ID_H264 : AV_CODEC_ID_HEVC, use_hw, use_10bit);
         m_video_bit_depth = use_10bit ? 10 : 8;
         m_video_device = use_hw ? 1 : 0;
+        // an open encoder keeps its format, segment encoders are always software
+        if (m_video_stream)
+            m_output_pix_fmt = m_video_stream->pixel_format;
+    }
+
+    std::string parallel_audio_path()
+    {
+        return m_save_file_path + ".audio.mka";
+    }
+
+    void stop_parallel_export()
+    {
+        if (!m_parallel_active)
+            return;
+        m_segment_writer.abort();
+        std::remove(parallel_audio_path().c_str());
+        m_parallel_active = false;
     }
 
     void add_video_stream()
@@ -197,6 +306,20 @@ struct FFMpegEncoderNode final : Node
         stream.bit_depth = m_video_bit_depth;
         stream.codec_id = !m_video_codec ? AV_CODEC_ID_H264 : AV_CODEC_ID_HEVC;
         stream.hdr_type = m_hdr_type;
+        if (m_parallel)
+        {
+            // video goes to the segment encoders, the sink only carries audio
+            if (m_segment_writer.open(stream, m_segment_frames, m_parallel_workers, m_save_file_path) == FFMEDIA_SUCCESS)
+            {
+                m_parallel_active = true;
+                m_video_stream_idx = -1;
+                m_video_stream = m_segment_writer.get_stream();
+                m_output_pix_fmt = m_video_stream->pixel_format;
+                m_video_bit_depth = m_video_stream->bit_depth;
+                return;
+            }
+            printf("fail to start parallel export, fall back to single encoder \n");
+        }
         m_video_stream_idx = m_sink.compose_stream(&stream);
         m_video_stream = m_sink.get_stream(m_video_stream_idx);
         m_output_pix_fmt = m_video_stream->pixel_format;
@@ -225,7 +348,7 @@ struct FFMpegEncoderNode final : Node
 
     void start_streaming()
     {
-        m_sink.open(m_save_file_path.c_str());
+        m_sink.open(m_parallel_active ? parallel_audio_path().c_str() : m_save_file_path.c_str());
         m_sink.start_streaming();
         m_streaming = true;
 
@@ -239,27 +362,31 @@ struct FFMpegEncoderNode final : Node
         }
     }
 
-    void encode_video()
+    // cpu_rgb: encode_mat is a CPU input frame still to be converted, otherwise
+    // it already holds the encoder's YUV planes
+    void encode_video(ImGui::ImMat& encode_mat, bool cpu_rgb)
     {
         void* pFrame = nullptr;
-        if (m_EncodeMat.empty())
+        if (encode_mat.empty())
             return;
         #if defined(PRINT_INPUT_PTS)
-        printf("input video pts %.3fs \n", m_EncodeMat.time_stamp);
+        printf("input video pts %.3fs \n", encode_mat.time_stamp);
         #endif
 
-        if (!m_streaming && !m_withAudio)
+        if (!m_streaming && !m_withAudio && !m_parallel_active)
             start_streaming();
 
-        m_video_empty_queue->pop(pFrame, false);
+        // segment encoders keep the frame, so it can't come back to the empty queue
+        if (!m_parallel_active)
+            m_video_empty_queue->pop(pFrame, false);
         if (!pFrame)
         {
             pFrame = FFMediaStream_alloc_frame(m_video_stream);
         }
         
-        if (!isnan(m_EncodeMat.time_stamp))
+        if (!isnan(encode_mat.time_stamp))
         {
-            ((AVFrame*)pFrame)->pts = m_EncodeMat.time_stamp * 1000;
+            ((AVFrame*)pFrame)->pts = encode_mat.time_stamp * 1000;
         }
         else
         {
@@ -267,83 +394,108 @@ struct FFMpegEncoderNode final : Node
             ((AVFrame*)pFrame)->pts = av_rescale_q(m_video_frame_num, m_video_stream->tbc, (AVRational){1, 1000});
         }
 
-        ImGui::ImMat mat_Y = m_EncodeMat.channel(0);
+        if (cpu_rgb)
         {
-            uint8_t* dst_data = ((AVFrame*)pFrame)->data[0];
-            uint8_t* src_data = (uint8_t*)mat_Y.data;
-            for (int i = 0; i < mat_Y.h; i++)
+            // interleaved RGBA converts at full sample precision, the other layouts through swscale
+            bool converted = is_packed_rgba(encode_mat) ? convert_rgba_frame(encode_mat, (AVFrame*)pFrame)
+                                                        : convert_sws_frame(encode_mat, (AVFrame*)pFrame);
+            if (!converted)
             {
-                memcpy(dst_data, src_data, mat_Y.w * mat_Y.elembits() / 8);
-                dst_data += ((AVFrame*)pFrame)->linesize[0];
-                src_data +=  mat_Y.w * mat_Y.elembits() / 8;
+                printf("unsupported mat type %d with %d channels for encoding\n", encode_mat.type, encode_mat.c);
+                if (m_parallel_active)
+                    av_frame_free((AVFrame**)&pFrame);
+                else
+                    m_video_empty_queue->push(pFrame, false);
+                return;
             }
         }
-        if (m_EncodeMat.color_format == IM_CF_YUV444)
+        else
         {
-            ImGui::ImMat mat_U = m_EncodeMat.channel(1);
+            ImGui::ImMat mat_Y = encode_mat.channel(0);
             {
-                uint8_t* dst_data = ((AVFrame*)pFrame)->data[1];
-                uint8_t* src_data = (uint8_t*)mat_U.data;
-                for (int i = 0; i < mat_U.h; i++)
+                uint8_t* dst_data = ((AVFrame*)pFrame)->data[0];
+                uint8_t* src_data = (uint8_t*)mat_Y.data;
+                for (int i = 0; i < mat_Y.h; i++)
                 {
-                    memcpy(dst_data, src_data, mat_U.w * mat_U.elembits() / 8);
-                    dst_data += ((AVFrame*)pFrame)->linesize[1];
-                    src_data += mat_U.w * mat_U.elembits() / 8;
+                    memcpy(dst_data, src_data, mat_Y.w * mat_Y.elembits() / 8);
+                    dst_data += ((AVFrame*)pFrame)->linesize[0];
+                    src_data +=  mat_Y.w * mat_Y.elembits() / 8;
                 }
             }
-            ImGui::ImMat mat_V = m_EncodeMat.channel(2);
+            if (encode_mat.color_format == IM_CF_YUV444)
             {
-                uint8_t* dst_data = ((AVFrame*)pFrame)->data[2];
-                uint8_t* src_data = (uint8_t*)mat_V.data;
-                for (int i = 0; i < mat_V.h; i++)
+                ImGui::ImMat mat_U = encode_mat.channel(1);
                 {
-                    memcpy(dst_data, src_data, mat_V.w * mat_V.elembits() / 8);
-                    dst_data += ((AVFrame*)pFrame)->linesize[2];
-                    src_data += mat_V.w * mat_V.elembits() / 8;
+                    uint8_t* dst_data = ((AVFrame*)pFrame)->data[1];
+                    uint8_t* src_data = (uint8_t*)mat_U.data;
+                    for (int i = 0; i < mat_U.h; i++)
+                    {
+                        memcpy(dst_data, src_data, mat_U.w * mat_U.elembits() / 8);
+                        dst_data += ((AVFrame*)pFrame)->linesize[1];
+                        src_data += mat_U.w * mat_U.elembits() / 8;
+                    }
                 }
-            }
-        }
-        else
-        {
-            ImGui::ImMat mat_UV = m_EncodeMat.channel(1);
-            if (m_EncodeMat.color_format == IM_CF_NV12 || m_EncodeMat.color_format == IM_CF_P010LE)
-            {
-                uint8_t* dst_data = ((AVFrame*)pFrame)->data[1];
-                uint8_t* src_data = (uint8_t*)mat_UV.data;
-                for (int i = 0; i < mat_UV.h / 2; i++)
+                ImGui::ImMat mat_V = encode_mat.channel(2);
                 {
-                    memcpy(dst_data, src_data, (mat_UV.w * mat_UV.elembits() / 8));
-                    dst_data += ((AVFrame*)pFrame)->linesize[1];
-                    src_data += mat_UV.w * mat_UV.elembits() / 8;
+                    uint8_t* dst_data = ((AVFrame*)pFrame)->data[2];
+                    uint8_t* src_data = (uint8_t*)mat_V.data;
+                    for (int i = 0; i < mat_V.h; i++)
+                    {
+                        memcpy(dst_data, src_data, mat_V.w * mat_V.elembits() / 8);
+                        dst_data += ((AVFrame*)pFrame)->linesize[2];
+                        src_data += mat_V.w * mat_V.elembits() / 8;
+                    }
                 }
             }
             else
             {
-                int UV_H = m_EncodeMat.color_format == IM_CF_YUV420 ? mat_UV.h / 2 : mat_UV.h;
-                uint8_t* dst_u_data = ((AVFrame*)pFrame)->data[1];
-                uint8_t* dst_v_data = ((AVFrame*)pFrame)->data[2];
-                uint8_t* src_u_data = (uint8_t*)mat_UV.data;
-                uint8_t* src_v_data = (uint8_t*)mat_UV.data + mat_UV.w * UV_H / 2 * mat_UV.elembits() / 8;
-                for (int i = 0; i < UV_H; i++)
+                ImGui::ImMat mat_UV = encode_mat.channel(1);
+                if (encode_mat.color_format == IM_CF_NV12 || encode_mat.color_format == IM_CF_P010LE)
+                {
+                    uint8_t* dst_data = ((AVFrame*)pFrame)->data[1];
+                    uint8_t* src_data = (uint8_t*)mat_UV.data;
+                    for (int i = 0; i < mat_UV.h / 2; i++)
+                    {
+                        memcpy(dst_data, src_data, (mat_UV.w * mat_UV.elembits() / 8));
+                        dst_data += ((AVFrame*)pFrame)->linesize[1];
+                        src_data += mat_UV.w * mat_UV.elembits() / 8;
+                    }
+                }
+                else
                 {
-                    memcpy(dst_u_data, src_u_data, (mat_UV.w * mat_UV.elembits() / 8) / 2);
-                    dst_u_data += ((AVFrame*)pFrame)->linesize[1];
-                    src_u_data += (mat_UV.w * mat_UV.elembits() / 8) / 2;
-                    memcpy(dst_v_data, src_v_data, (mat_UV.w * mat_UV.elembits() / 8) / 2);
-                    dst_v_data += ((AVFrame*)pFrame)->linesize[2];
-                    src_v_data += (mat_UV.w * mat_UV.elembits() / 8) / 2;
+                    int UV_H = encode_mat.color_format == IM_CF_YUV420 ? mat_UV.h / 2 : mat_UV.h;
+                    uint8_t* dst_u_data = ((AVFrame*)pFrame)->data[1];
+                    uint8_t* dst_v_data = ((AVFrame*)pFrame)->data[2];
+                    uint8_t* src_u_data = (uint8_t*)mat_UV.data;
+                    uint8_t* src_v_data = (uint8_t*)mat_UV.data + mat_UV.w * UV_H / 2 * mat_UV.elembits() / 8;
+                    for (int i = 0; i < UV_H; i++)
+                    {
+                        memcpy(dst_u_data, src_u_data, (mat_UV.w * mat_UV.elembits() / 8) / 2);
+                        dst_u_data += ((AVFrame*)pFrame)->linesize[1];
+                        src_u_data += (mat_UV.w * mat_UV.elembits() / 8) / 2;
+                        memcpy(dst_v_data, src_v_data, (mat_UV.w * mat_UV.elembits() / 8) / 2);
+                        dst_v_data += ((AVFrame*)pFrame)->linesize[2];
+                        src_v_data += (mat_UV.w * mat_UV.elembits() / 8) / 2;
+                    }
                 }
             }
         }
         
         m_video_frame_num++;
 
-        if (!m_withAudio)
+        if (m_parallel_active)
+        {
+            m_video_pts_ms = ((AVFrame*)pFrame)->pts;
+            ((AVFrame*)pFrame)->pts = av_rescale_q(((AVFrame*)pFrame)->pts,
+                                    (AVRational){ 1, 1000 }, m_video_stream->tbc);
+            m_segment_writer.write_frame((AVFrame*)pFrame);
+        }
+        else if (!m_withAudio)
         {
             m_video_pts_ms = ((AVFrame*)pFrame)->pts;
             ((AVFrame*)pFrame)->pts = av_rescale_q(((AVFrame*)pFrame)->pts,
                                     (AVRational){ 1, 1000 }, m_video_stream->tbc);
-            m_sink.write_one_frame((const AVFrame*)pFrame, m_video_stream_idx);
+            mux_frame((const AVFrame*)pFrame, m_video_stream_idx);
             m_video_empty_queue->push(pFrame);
             #if defined(PRINT_OUTPUT_PTS)
             printf("output video (no audio) frame %d pts %.3fs \n", m_video_frame_num, m_video_pts_ms/1000.f);
@@ -385,26 +537,11 @@ struct FFMpegEncoderNode final : Node
             m_audio_pts_offset = av_rescale_q(m_audio_pts_offset, (AVRational){1, 1000}, m_audio_stream->tbc);
         }
         
-        if (mat.type == IM_DT_FLOAT32)
-        {
-            for (int c = 0; c < m_output_channels; c++)
-            {
-                ImGui::ImMat channel_mat = mat.channel(c);
-                memcpy(m_audio_iframe->data[c], channel_mat.data, channel_mat.w * sizeof(float));
-            }
-        }
-        else if (mat.type == IM_DT_INT16)
-        {
-            for (int c = 0; c < m_output_channels; c++)
-            {
-                float* dst = (float*)m_audio_iframe->data[c];
-                for (int i = 0; i < mat.w; i++)
-                {
-                    *dst = mat.at<int16_t>(i, 0, c) / 32768.f;
-                    dst ++;
-                }
-            }
-        }
+        std::vector<void*> src_data(m_output_channels);
+        for (int c = 0; c < m_output_channels; c++)
+            src_data[c] = mat.channel(c).data;
+        if (!AudioSampleCopy((void* const*)m_audio_iframe->data, IM_DT_FLOAT32, src_data.data(), mat.type, true, m_output_channels, mat.w))
+            printf("unsupported audio mat type %d for encoding\n", mat.type);
 
         add_samples_to_fifo(m_audio_fifo, m_audio_iframe->data, mat.w);
 
@@ -432,7 +569,7 @@ struct FFMpegEncoderNode final : Node
             m_audio_sample_num += m_audio_frame->nb_samples;
             m_audio_frame_num++;
 
-            m_sink.write_one_frame((const AVFrame*)m_audio_frame, m_audio_stream_idx);
+            mux_frame((const AVFrame*)m_audio_frame, m_audio_stream_idx);
             #if defined(PRINT_OUTPUT_PTS)
             printf("output audio frame %d pts %.3fs \n", m_audio_frame_num, m_audio_pts_ms/1000.f);
             #endif
@@ -445,7 +582,7 @@ struct FFMpegEncoderNode final : Node
                     m_video_pts_ms = ((AVFrame*)pFrame)->pts;
                     ((AVFrame*)pFrame)->pts = av_rescale_q(((AVFrame*)pFrame)->pts,
                                             (AVRational){ 1, 1000 }, m_video_stream->tbc);
-                    m_sink.write_one_frame((const AVFrame*)pFrame, m_video_stream_idx);
+                    mux_frame((const AVFrame*)pFrame, m_video_stream_idx);
                     m_video_empty_queue->push(pFrame, false);
                     #if defined(PRINT_OUTPUT_PTS)
                     printf("output video frame %d pts %.3fs \n", m_video_frame_num, m_video_pts_ms/1000.f);
@@ -458,6 +595,107 @@ struct FFMpegEncoderNode final : Node
         
     }
 
+    static void release_packet(void* data)
+    {
+        AVPacket* pkt = (AVPacket*)data;
+        av_packet_free(&pkt);
+    }
+
+    // runs under m_sink_mutex, the packets are queued by encode_thread_proc once it is released
+    void mux_frame(const AVFrame* frame, int stream_idx)
+    {
+        m_sink.encode_frame(frame, stream_idx, m_encoded_packets);
+    }
+
+    void encode_thread_proc()
+    {
+        while (true)
+        {
+            EncodeJob job;
+            {
+                std::unique_lock<std::mutex> lk(m_job_mutex);
+                m_job_cond.wait(lk, [this] { return m_encode_quit || !m_job_queue.empty(); });
+                if (m_job_queue.empty())
+                    break;
+                job = m_job_queue.front();
+                m_job_queue.pop_front();
+            }
+            m_job_cond.notify_all();
+            {
+                std::lock_guard<std::mutex> lk(m_sink_mutex);
+                if (job.is_video)
+                    encode_video(job.mat, job.cpu_rgb);
+                else
+                    encode_audio(job.mat);
+            }
+            // the muxer takes m_sink_mutex too, so don't wait on its queue holding it
+            for (auto pkt : m_encoded_packets)
+            {
+                // blocks while the muxer is behind, fails only when quitting
+                if (!m_mux_queue->push(pkt, true))
+                    av_packet_free(&pkt);
+            }
+            m_encoded_packets.clear();
+        }
+    }
+
+    void mux_thread_proc()
+    {
+        void* data = nullptr;
+        while (m_mux_queue->pop(data, true))
+        {
+            // streams are still composed from Execute while packets are written
+            std::lock_guard<std::mutex> lk(m_sink_mutex);
+            m_sink.write_encoded_packet((AVPacket*)data);
+        }
+    }
+
+    void start_encode_threads()
+    {
+        if (m_encode_thread.joinable())
+            return;
+        m_encode_quit = false;
+        m_mux_queue = new FFMedia_Queue(MAX_MUX_QUEUE, release_packet);
+        m_mux_thread = std::thread(&FFMpegEncoderNode::mux_thread_proc, this);
+        m_encode_thread = std::thread(&FFMpegEncoderNode::encode_thread_proc, this);
+    }
+
+    // drain = true encodes and writes every queued frame before returning,
+    // otherwise the queued frames and packets are dropped
+    void stop_encode_threads(bool drain)
+    {
+        if (!m_encode_thread.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lk(m_job_mutex);
+            if (!drain)
+                m_job_queue.clear();
+            m_encode_quit = true;
+        }
+        m_job_cond.notify_all();
+        if (!drain)
+            m_mux_queue->quit();
+        m_encode_thread.join();
+        m_mux_queue->stop();
+        m_mux_thread.join();
+        m_mux_queue->flush();
+        delete m_mux_queue;
+        m_mux_queue = nullptr;
+    }
+
+    // back-pressure: waits while the encoder is MAX_ENCODE_QUEUE frames behind.
+    // In a parallel export the encode thread itself waits in write_frame for a
+    // free segment worker, so the queue fills and the graph waits here too.
+    void push_encode_job(bool is_video, const ImGui::ImMat& mat, bool cpu_rgb = false)
+    {
+        start_encode_threads();
+        std::unique_lock<std::mutex> lk(m_job_mutex);
+        m_job_cond.wait(lk, [this] { return m_job_queue.size() < MAX_ENCODE_QUEUE; });
+        m_job_queue.push_back({is_video, mat, cpu_rgb});
+        lk.unlock();
+        m_job_cond.notify_all();
+    }
+
     FlowPin Execute(Context& context, FlowPin& entryPoint, bool threading = false) override
     {
         if (entryPoint.m_ID == m_Reset.m_ID)
@@ -475,7 +713,12 @@ struct FFMpegEncoderNode final : Node
                 m_input_height = mat.h;
                 m_frame_rate = {mat.rate.den != 0 ? mat.rate.num : 25, mat.rate.den != 0 ? mat.rate.den : 1};
                 if(!m_video_stream)
+                {
+                    std::lock_guard<std::mutex> lk(m_sink_mutex);
                     add_video_stream();
+                }
+                ImGui::ImMat encode_mat;
+                bool cpu_rgb = false;
 #if IMGUI_VULKAN_SHADER
                 if (!m_convert)
                 {
@@ -507,80 +750,27 @@ struct FFMpegEncoderNode final : Node
                         Im_RGB = mat;
                     }
                     m_color_format = m_output_pix_fmt == AV_PIX_FMT_NV12 ? IM_CF_NV12 : m_output_pix_fmt == AV_PIX_FMT_P010LE ? IM_CF_P010LE : IM_CF_YUV420;
-                    m_EncodeMat.type = m_video_bit_depth > 8 ? IM_DT_INT16 : IM_DT_INT8;
-                    m_EncodeMat.color_format = m_color_format;
-                    m_EncodeMat.color_space = m_color_space;
-                    m_EncodeMat.color_range = m_color_range;
-                    m_convert->ConvertColorFormat(Im_RGB, m_EncodeMat);
-                    m_EncodeMat.depth = m_video_bit_depth;
-                    m_EncodeMat.time_stamp = mat.time_stamp;
+                    encode_mat.type = m_video_bit_depth > 8 ? IM_DT_INT16 : IM_DT_INT8;
+                    encode_mat.color_format = m_color_format;
+                    encode_mat.color_space = m_color_space;
+                    encode_mat.color_range = m_color_range;
+                    m_convert->ConvertColorFormat(Im_RGB, encode_mat);
+                    encode_mat.depth = m_video_bit_depth;
+                    encode_mat.time_stamp = mat.time_stamp;
 #endif
                 }
                 else if (mat.device == IM_DD_CPU)
                 {
-                    ImGui::ImMat mat_rgb;
-                    if (mat.type != IM_DT_INT8)
-                    {
-                        mat_rgb.create(mat.w, mat.h, 4, 1u);
-                        conv_mat_int8(mat, mat_rgb);
-                    }
-                    else
-                    {
-                        mat_rgb = mat;
-                    }
-#if !IMGUI_VULKAN_SHADER
-                    int video_depth = mat.type == IM_DT_INT8 ? 8 : mat.type == IM_DT_INT16 ? 16 : 8;
-                    int video_shift = mat.depth != 0 ? mat.depth : mat.type == IM_DT_INT8 ? 8 : mat.type == IM_DT_INT16 ? 16 : 8;
-                    m_EncodeMat.create_type(mat.w, mat.h, 4, m_video_bit_depth > 8 ? IM_DT_INT16 : IM_DT_INT8);
-                    if (!m_img_convert_ctx)
-                    {
-                        m_img_convert_ctx = sws_getCachedContext(
-                                    m_img_convert_ctx,
-                                    mat_rgb.w,
-                                    mat_rgb.h,
-                                    AV_PIX_FMT_RGBA,
-                                    mat_rgb.w,
-                                    mat_rgb.h,
-                                    m_output_pix_fmt,
-                                    SWS_BICUBIC,
-                                    NULL, NULL, NULL);
-                    }
-                    if (m_img_convert_ctx)
-                    {
-                        ImGui::ImMat MatY = m_EncodeMat.channel(0);
-                        ImGui::ImMat MatU = m_EncodeMat.channel(1);
-                        ImGui::ImMat MatV = m_EncodeMat.channel(2);
-                        int mat_u_width = MatU.w >> (m_color_format == IM_CF_YUV420 ? 1 : 0);
-                        int mat_v_width = MatV.w >> (m_color_format == IM_CF_YUV420 ? 1 : 0);
-                        int data_shift = m_video_bit_depth > 8 ? 2 : 1;
-                        uint8_t *src_data[] = { (uint8_t *)mat_rgb.data };
-                        uint8_t *dst_data[] = { (uint8_t *)MatY.data, (uint8_t *)MatU.data, (uint8_t *)MatV.data };
-                        int src_linesize[] = { mat_rgb.w * 4 };
-                        int dst_linesize[] = { MatY.w * data_shift, mat_u_width * data_shift, mat_v_width * data_shift};
-                        sws_scale(
-                            m_img_convert_ctx,
-                            src_data,
-                            src_linesize,
-                            0, mat_rgb.h,
-                            dst_data,
-                            dst_linesize
-                        );
-                        m_EncodeMat.color_format = m_color_format;
-                        m_EncodeMat.color_space = m_color_space;
-                        m_EncodeMat.color_range = m_color_range;
-                        m_EncodeMat.depth = m_video_bit_depth;
-                        m_EncodeMat.time_stamp = mat_rgb.time_stamp;
-                    }
-#else
-                    m_EncodeMat = mat;
-#endif
+                    // converted on the encode thread, see encode_video()
+                    encode_mat = mat;
+                    cpu_rgb = true;
                 }
                 else
                 {
                     // TODO:JJ
                 }
 
-                encode_video();
+                push_encode_job(true, encode_mat, cpu_rgb);
                 m_mutex.unlock();
             }
         }
@@ -593,8 +783,11 @@ struct FFMpegEncoderNode final : Node
                 m_input_samplerate = mat.rate.num;
                 m_input_channels = mat.c;
                 if(!m_audio_stream)
+                {
+                    std::lock_guard<std::mutex> lk(m_sink_mutex);
                     add_audio_stream(mat);
-                encode_audio(mat);
+                }
+                push_encode_job(false, mat);
                 m_mutex.unlock();
             }
         }
@@ -629,6 +822,17 @@ struct FFMpegEncoderNode final : Node
         changed |= ImGui::SliderInt("Audio Bitrate", &audio_bitrate, 1, 500, "%dKbps", ImGuiSliderFlags_None);
         m_audio_bitrate = audio_bitrate * 1000;
         ImGui::Separator();
+        changed |= ImGui::Checkbox("Parallel Export", &m_parallel);
+        if (m_parallel)
+        {
+            changed |= ImGui::SliderInt("Workers", &m_parallel_workers, 1, 64, "%d", ImGuiSliderFlags_None);
+            int segment_gops = m_segment_frames / FFMEDIA_VIDEO_GOP_SIZE;
+            changed |= ImGui::SliderInt("Segment GOPs", &segment_gops, 1, 500, "%d", ImGuiSliderFlags_None);
+            m_segment_frames = std::max(segment_gops, 1) * FFMEDIA_VIDEO_GOP_SIZE;
+            if (m_parallel_active)
+                ImGui::Text("Segments: %d / %d", m_segment_writer.segments_done(), m_segment_writer.segments());
+        }
+        ImGui::Separator();
         changed |= ImGui::Combo("HDR System", (int *)&m_hdr_type, hdr_system_items, IM_ARRAYSIZE(hdr_system_items));
         if (m_hdr_type == FFMEDIA_HDRTYPE::HDR_HLG || m_hdr_type == FFMEDIA_HDRTYPE::HDR_PQ)
             m_color_space = IM_CS_BT2020;
@@ -678,6 +882,16 @@ struct FFMpegEncoderNode final : Node
         ImGui::TextUnformatted(file_name.c_str());
         if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable)
             io.ConfigViewportsNoDecoration = false;
+        if (m_streaming)
+        {
+            ImGui::Separator();
+            if (m_video_stream)
+                ImGui::Text("Video: %d in flight, delay %d frames, %.1f MB", m_video_stream->packets_in_flight(),
+                            m_video_stream->encoder_delay, m_video_stream->write_bytes / (1024.f * 1024.f));
+            if (m_audio_stream)
+                ImGui::Text("Audio: %d in flight, delay %d frames, %.1f MB", m_audio_stream->packets_in_flight(),
+                            m_audio_stream->encoder_delay, m_audio_stream->write_bytes / (1024.f * 1024.f));
+        }
         check_hw_caps();
         return changed;
     }
@@ -753,6 +967,23 @@ struct FFMpegEncoderNode final : Node
             if (val.is_number()) 
                 m_hdr_type = (FFMEDIA_HDRTYPE)val.get<imgui_json::number>();
         }
+        if (value.contains("parallel_export"))
+        {
+            auto& val = value["parallel_export"];
+            if (val.is_boolean()) m_parallel = val.get<imgui_json::boolean>();
+        }
+        if (value.contains("parallel_workers"))
+        {
+            auto& val = value["parallel_workers"];
+            if (val.is_number()) 
+                m_parallel_workers = val.get<imgui_json::number>();
+        }
+        if (value.contains("segment_frames"))
+        {
+            auto& val = value["segment_frames"];
+            if (val.is_number()) 
+                m_segment_frames = val.get<imgui_json::number>();
+        }
         return ret;
     }
 
@@ -770,6 +1001,9 @@ struct FFMpegEncoderNode final : Node
         value["audio_bitrate"] = imgui_json::number(m_audio_bitrate);
         value["video_bit_depth"] = imgui_json::number(m_video_bit_depth);
         value["hdr_type"] = imgui_json::number(m_hdr_type);
+        value["parallel_export"] = m_parallel;
+        value["parallel_workers"] = imgui_json::number(m_parallel_workers);
+        value["segment_frames"] = imgui_json::number(m_segment_frames);
     }
 
     span<Pin*> GetInputPins() override { return m_InputPins; }
@@ -787,15 +1021,12 @@ struct FFMpegEncoderNode final : Node
 
 #if IMGUI_VULKAN_SHADER
     ImGui::ColorConvert_vulkan *m_convert   {nullptr};
-#else
-    struct SwsContext *m_img_convert_ctx {nullptr};
 #endif
     std::string m_save_file_path    {"output.mp4"};
     std::string m_filters {".mp4"};
     bool m_isShowBookmark {false};
     bool m_isShowHiddenFiles {true};
     std::mutex m_mutex;
-    ImGui::ImMat m_EncodeMat;
 
     // configurations
     int m_input_width           {0};
@@ -813,6 +1044,9 @@ struct FFMpegEncoderNode final : Node
     int m_video_device          {0}; // 0 for CPU, 1 for GPU
     int m_video_bitrate         {10*1000*1000};
     int m_audio_bitrate         {128*1000};
+    bool m_parallel             {false};
+    int m_parallel_workers      {(int)std::max(1u, std::thread::hardware_concurrency() / 2)};
+    int m_segment_frames        {FFMEDIA_VIDEO_GOP_SIZE * 20};
 
     // encoder
     int m_stream_index              {0};
@@ -842,8 +1076,31 @@ struct FFMpegEncoderNode final : Node
     AVFrame* m_audio_iframe         {nullptr};
     int64_t m_audio_pts_offset      {AV_NOPTS_VALUE};
 
+    // parallel export
+    FFMediaSegmentWriter m_segment_writer;
+    bool m_parallel_active {false};
+
     // control
     bool m_streaming {false};
+
+    // encode and mux threads
+    struct EncodeJob
+    {
+        bool is_video {true};
+        ImGui::ImMat mat;
+        bool cpu_rgb {false};
+    };
+    std::mutex m_sink_mutex;
+    std::mutex m_job_mutex;
+    std::condition_variable m_job_cond;
+    std::deque<EncodeJob> m_job_queue;
+    bool m_encode_quit {false};
+    std::thread m_encode_thread;
+    std::thread m_mux_thread;
+    FFMedia_Queue* m_mux_queue {nullptr};
+    std::vector<AVPacket*> m_encoded_packets;   // encode thread only
+    struct SwsContext* m_sws_ctx {nullptr};     // encode thread only
+    std::vector<uint16_t> m_sws_buffer;
 };
 } // namespace BluePrint
 
@@ -4,6 +4,7 @@
 #include <imgui_fft.h>
 #include <immat.h>
 #include <ImGuiFileDialog.h>
+#include <cmath>
 #include "MediaPlayer.h"
 
 #define CheckPlayerError(funccall) \
@@ -108,6 +109,9 @@ struct MediaSourceNode final : Node
         }
         if (m_player)
         {
+            CheckPlayerError(m_player->SetPreviewScale(m_preview_scale));
+            CheckPlayerError(m_player->SetFullResolution(m_full_resolution));
+            CheckPlayerError(m_player->SetScrubCacheOptions(m_scrub_width, m_scrub_memory_mb, m_scrub_disk_mb));
             if (m_path.empty()) m_player->Open("Camera");
             else m_player->Open(m_path);
             m_info = m_player->GetMediaInfo();
@@ -169,6 +173,16 @@ struct MediaSourceNode final : Node
         }
         else if (m_player->IsSeeking())
         {
+            // while the timeline is dragged the player hands out scrub cache frames
+            ImGui::ImMat vmat;
+            m_player->GetVideo(vmat);
+            if (!vmat.empty() && vmat.time_stamp != m_scrub_time && m_flow)
+            {
+                m_scrub_time = vmat.time_stamp;
+                if (m_vmat) m_vmat->SetValue(vmat);
+                context.PushReturnPoint(entryPoint);
+                return *m_flow;
+            }
             if (threading)
                 ImGui::sleep((int)(40));
             else
@@ -246,6 +260,41 @@ struct MediaSourceNode final : Node
         ImGui::Separator();
         changed |= ImGui::RadioButton("GPU",  (int *)&m_device, 0); ImGui::SameLine();
         changed |= ImGui::RadioButton("CPU",   (int *)&m_device, -1);
+        ImGui::Separator();
+        static const char* scale_items[] = { "Full", "1/2", "1/4", "1/8" };
+        int scale_index = m_preview_scale >= 8 ? 3 : m_preview_scale >= 4 ? 2 : m_preview_scale >= 2 ? 1 : 0;
+        bool reopen = false;
+        ImGui::BeginDisabled(m_full_resolution);
+        if (ImGui::Combo("Preview Size", &scale_index, scale_items, IM_ARRAYSIZE(scale_items)))
+        {
+            m_preview_scale = 1 << scale_index;
+            reopen = changed = true;
+        }
+        ImGui::EndDisabled();
+        // a graph rendering its output keeps the preview size for editing and
+        // switches this on, the player then decodes at source size
+        if (ImGui::Checkbox("Full Resolution", &m_full_resolution))
+            reopen = changed = true;
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Output the source size whatever the Preview Size, for render and export");
+        if (reopen && m_player && m_player->IsOpened())
+        {
+            CloseMedia();
+            OpenMedia();
+        }
+        // frames kept for scrubbing the timeline, the player takes them on open
+        bool scrub_reopen = false;
+        changed |= ImGui::SliderInt("Scrub Width", &m_scrub_width, 0, 1920, m_scrub_width > 0 ? "%d" : "Source", ImGuiSliderFlags_AlwaysClamp);
+        scrub_reopen |= ImGui::IsItemDeactivatedAfterEdit();
+        changed |= ImGui::SliderInt("Scrub Memory", &m_scrub_memory_mb, 16, 4096, "%d MB", ImGuiSliderFlags_AlwaysClamp);
+        scrub_reopen |= ImGui::IsItemDeactivatedAfterEdit();
+        changed |= ImGui::SliderInt("Scrub Disk", &m_scrub_disk_mb, 0, 16384, m_scrub_disk_mb > 0 ? "%d MB" : "Off", ImGuiSliderFlags_AlwaysClamp);
+        scrub_reopen |= ImGui::IsItemDeactivatedAfterEdit();
+        if (scrub_reopen && m_player && m_player->IsOpened())
+        {
+            CloseMedia();
+            OpenMedia();
+        }
         if (ImGuiFileDialog::Instance()->Display("##NodeMediaSourceDlgKey", ImGuiWindowFlags_NoCollapse, minSize, maxSize))
         {
 	        // action if OK
@@ -276,10 +325,16 @@ struct MediaSourceNode final : Node
         {
             float time = m_player && m_player->IsOpened() ? m_player->GetPlayPos() / 1000.f : 0;
             float total_time = m_total_time;
+            // dragging seeks through the scrub cache, the release seeks for real
             if (ImGui::SliderFloat("##time", &time, 0, total_time, "%.2f", flags))
             {
-                if (m_player && m_player->IsOpened() && !m_player->IsSeeking())
-                    m_player->Seek(time * 1000);
+                if (m_player && m_player->IsOpened())
+                    m_player->SeekAsync(time * 1000);
+            }
+            if (ImGui::IsItemDeactivated() && m_player && m_player->IsSeeking())
+            {
+                m_player->QuitSeekAsync();
+                m_scrub_time = NAN;
             }
             string str_current_time = PrintTimeStamp(time);
             string str_total_time = PrintTimeStamp(m_total_time);
@@ -311,6 +366,9 @@ struct MediaSourceNode final : Node
                     }
                 }
             }
+            uint64_t pool_hits = 0, pool_misses = 0;
+            m_player->GetBufferPoolStats(pool_hits, pool_misses);
+            ImGui::Text("     Pools: %llu hit / %llu miss", (unsigned long long)pool_hits, (unsigned long long)pool_misses);
             if (m_player->HasAudio())
             {
                 auto channels = m_player->GetAudioChannels();
@@ -422,6 +480,36 @@ struct MediaSourceNode final : Node
                 m_file_name = val.get<imgui_json::string>();
             }
         }
+        if (value.contains("preview_scale"))
+        {
+            auto& val = value["preview_scale"];
+            if (val.is_number()) 
+                m_preview_scale = val.get<imgui_json::number>();
+        }
+        if (value.contains("full_resolution"))
+        {
+            auto& val = value["full_resolution"];
+            if (val.is_boolean())
+                m_full_resolution = val.get<imgui_json::boolean>();
+        }
+        if (value.contains("scrub_width"))
+        {
+            auto& val = value["scrub_width"];
+            if (val.is_number())
+                m_scrub_width = val.get<imgui_json::number>();
+        }
+        if (value.contains("scrub_memory_mb"))
+        {
+            auto& val = value["scrub_memory_mb"];
+            if (val.is_number())
+                m_scrub_memory_mb = val.get<imgui_json::number>();
+        }
+        if (value.contains("scrub_disk_mb"))
+        {
+            auto& val = value["scrub_disk_mb"];
+            if (val.is_number())
+                m_scrub_disk_mb = val.get<imgui_json::number>();
+        }
         if (value.contains("camera"))
         {
             auto& val = value["camera"];
@@ -468,6 +556,11 @@ struct MediaSourceNode final : Node
         value["mat_type"] = imgui_json::number(m_mat_data_type);
         value["device_type"] = imgui_json::number(m_device);
         value["camera"] = imgui_json::boolean(m_camera);
+        value["preview_scale"] = imgui_json::number(m_preview_scale);
+        value["full_resolution"] = imgui_json::boolean(m_full_resolution);
+        value["scrub_width"] = imgui_json::number(m_scrub_width);
+        value["scrub_memory_mb"] = imgui_json::number(m_scrub_memory_mb);
+        value["scrub_disk_mb"] = imgui_json::number(m_scrub_disk_mb);
         value["media_path"] = m_path;
         value["file_name"] = m_file_name;
     }
@@ -488,6 +581,12 @@ private:
     int                 m_device  {0};          // 0 = GPU -1 = CPU
     ImDataType m_mat_data_type {IM_DT_UNDEFINED};
     bool                m_camera {false};
+    int                 m_preview_scale {1};    // output 1/scale of the source size
+    bool                m_full_resolution {false};  // source size, the preview scale is kept
+    int                 m_scrub_width {640};    // scrub cache frame width, 0 = source
+    int                 m_scrub_memory_mb {256};
+    int                 m_scrub_disk_mb {0};    // 0 = no spilling to the temp directory
+    double              m_scrub_time {NAN};     // time stamp of the last scrub frame sent
     std::string         m_path;
     std::string         m_file_name;
     MediaPlayer*        m_player = nullptr;
@@ -6,6 +6,11 @@
 #if IMGUI_VULKAN_SHADER
 #include <ColorConvert_vulkan.h>
 #endif
+#include <AudioSampleCopy.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 
 #ifdef __cplusplus
 extern "C" {
@@ -194,7 +199,7 @@ static int hw_decoder_init(AVCodecContext *ctx, const enum AVHWDeviceType type)
     return err;
 }
 
-static int open_codec_context(int *stream_idx, AVCodecContext **dec_ctx, AVFormatContext *fmt_ctx, enum AVMediaType type, int device_type = 0)
+static int open_codec_context(int *stream_idx, AVCodecContext **dec_ctx, AVFormatContext *fmt_ctx, enum AVMediaType type, int device_type = 0, int thread_count = 0, int thread_type = 0)
 {
     int ret, stream_index;
     AVStream *st;
@@ -266,6 +271,10 @@ static int open_codec_context(int *stream_idx, AVCodecContext **dec_ctx, AVForma
         if ((ret = hw_decoder_init(*dec_ctx, m_hw_type)) < 0)
             return ret;
     }
+    /* 0 lets the decoder pick one thread per core */
+    (*dec_ctx)->thread_count = thread_count;
+    if (thread_type != 0)
+        (*dec_ctx)->thread_type = thread_type;
     /* Init the decoders */
     if ((ret = avcodec_open2(*dec_ctx, dec, &opts)) < 0) 
     {
@@ -279,6 +288,7 @@ static int open_codec_context(int *stream_idx, AVCodecContext **dec_ctx, AVForma
 }
 
 #define NODE_VERSION    0x01000000
+#define MAX_FRAME_QUEUE 8
 
 namespace BluePrint
 {
@@ -300,6 +310,12 @@ struct MediaSourceSampleNode final : Node
 #endif
     };
 
+    struct decoded_frame
+    {
+        media_stream *      m_stream {nullptr};
+        AVFrame *           m_frame {nullptr};
+    };
+
     BP_NODE_WITH_NAME(MediaSourceSampleNode, "Media Source Sample", "CodeWin", NODE_VERSION, VERSION_BLUEPRINT_API, NodeType::External, NodeStyle::Default, "Media")
     MediaSourceSampleNode(BP* blueprint): Node(blueprint)
     {
@@ -330,6 +346,7 @@ struct MediaSourceSampleNode final : Node
 
     void CloseMedia()
     {
+        StopDecodeThread();
         // rebuild output pins
         for (auto iter = m_OutputPins.begin(); iter != m_OutputPins.end();)
         {
@@ -421,7 +438,7 @@ struct MediaSourceSampleNode final : Node
             {
                 // create video codec context
                 AVCodecContext* video_dec_ctx = nullptr;
-                if (open_codec_context(&stream_index, &video_dec_ctx, m_fmt_ctx, AVMEDIA_TYPE_VIDEO, m_device) >= 0)
+                if (open_codec_context(&stream_index, &video_dec_ctx, m_fmt_ctx, AVMEDIA_TYPE_VIDEO, m_device, m_thread_count, m_thread_type) >= 0)
                 {
                     struct media_stream * new_stream = new media_stream;
                     if (new_stream)
@@ -442,7 +459,7 @@ struct MediaSourceSampleNode final : Node
             else if (stream->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
             {
                 AVCodecContext* audio_dec_ctx = nullptr;
-                if (open_codec_context(&stream_index, &audio_dec_ctx, m_fmt_ctx, AVMEDIA_TYPE_AUDIO) >= 0)
+                if (open_codec_context(&stream_index, &audio_dec_ctx, m_fmt_ctx, AVMEDIA_TYPE_AUDIO, -1, m_thread_count, m_thread_type) >= 0)
                 {
                     struct media_stream * new_stream = new media_stream;
                     if (new_stream)
@@ -475,6 +492,7 @@ struct MediaSourceSampleNode final : Node
         m_pkt = av_packet_alloc();
         m_paused = false;
         m_need_update = false;
+        StartDecodeThread();
     }
 
     int OutVideoFrame(media_stream* stream)
@@ -768,9 +786,12 @@ struct MediaSourceSampleNode final : Node
         ImGui::ImMat mat_A;
         int data_size = av_get_bytes_per_sample((enum AVSampleFormat)stream->m_frame->format);
         AVRational tb = (AVRational){1, stream->m_frame->sample_rate};
-        ImDataType type  =  (stream->m_frame->format == AV_SAMPLE_FMT_FLT) || (stream->m_frame->format == AV_SAMPLE_FMT_FLTP) ? IM_DT_FLOAT32 :
-                            (stream->m_frame->format == AV_SAMPLE_FMT_S32) || (stream->m_frame->format == AV_SAMPLE_FMT_S32P) ? IM_DT_INT32:
-                            (stream->m_frame->format == AV_SAMPLE_FMT_S16) || (stream->m_frame->format == AV_SAMPLE_FMT_S16P) ? IM_DT_INT16:
+        AVSampleFormat format = (AVSampleFormat)stream->m_frame->format;
+        ImDataType type  =  (format == AV_SAMPLE_FMT_FLT) || (format == AV_SAMPLE_FMT_FLTP) ? IM_DT_FLOAT32 :
+                            (format == AV_SAMPLE_FMT_DBL) || (format == AV_SAMPLE_FMT_DBLP) ? IM_DT_FLOAT64 :
+                            (format == AV_SAMPLE_FMT_S64) || (format == AV_SAMPLE_FMT_S64P) ? IM_DT_INT64 :
+                            (format == AV_SAMPLE_FMT_S32) || (format == AV_SAMPLE_FMT_S32P) ? IM_DT_INT32:
+                            (format == AV_SAMPLE_FMT_S16) || (format == AV_SAMPLE_FMT_S16P) ? IM_DT_INT16:
                             IM_DT_INT8;
         double current_audio_pts = (stream->m_frame->pts == AV_NOPTS_VALUE) ? NAN : stream->m_frame->pts * av_q2d(tb);
         m_mutex.lock();
@@ -780,20 +801,12 @@ struct MediaSourceSampleNode final : Node
         int channels = stream->m_frame->ch_layout.nb_channels;
 #endif
         mat_A.create_type(stream->m_frame->nb_samples, 1, channels, type);
+        std::vector<void*> channel_data(channels);
         for (int i = 0; i < channels; i++)
-        {
-            for (int x = 0; x < stream->m_frame->nb_samples; x++)
-            {
-                if (type == IM_DT_FLOAT32)
-                    mat_A.at<float>(x, 0, i) = ((float *)stream->m_frame->data[i])[x];
-                else if (type == IM_DT_INT32)
-                    mat_A.at<int32_t>(x, 0, i) = ((int32_t *)stream->m_frame->data[i])[x];
-                else if (type == IM_DT_INT16)
-                    mat_A.at<int16_t>(x, 0, i) = ((int16_t *)stream->m_frame->data[i])[x];
-                else
-                    mat_A.at<int8_t>(x, 0, i) = ((int8_t *)stream->m_frame->data[i])[x];
-            }
-        }
+            channel_data[i] = mat_A.channel(i).data;
+        // interleaved frames keep every channel in data[0]
+        AudioSampleCopy(channel_data.data(), type, (const void* const*)stream->m_frame->extended_data, type,
+                        av_sample_fmt_is_planar(format), channels, stream->m_frame->nb_samples);
         mat_A.time_stamp = current_audio_pts;
         mat_A.rate = {stream->m_frame->sample_rate, 1};
         mat_A.flags = IM_MAT_FLAGS_AUDIO_FRAME;
@@ -804,77 +817,201 @@ struct MediaSourceSampleNode final : Node
         return 0;
     }
 
-    FlowPin DecodeMedia()
+    void StartDecodeThread()
+    {
+        m_decode_quit = false;
+        m_decode_eof = false;
+        m_seek_pending = false;
+        m_decode_thread = std::thread(&MediaSourceSampleNode::DecodeThreadProc, this);
+    }
+
+    void StopDecodeThread()
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_queue_mutex);
+            m_decode_quit = true;
+        }
+        m_queue_cond.notify_all();
+        if (m_decode_thread.joinable())
+            m_decode_thread.join();
+        ClearFrameQueue();
+    }
+
+    void ClearFrameQueue()
+    {
+        for (auto& frame : m_frame_queue)
+            av_frame_free(&frame.m_frame);
+        m_frame_queue.clear();
+    }
+
+    // seek is done by the decode thread, which owns m_fmt_ctx while media is open
+    void SeekMedia(int64_t seek_time, int flags)
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_queue_mutex);
+            ClearFrameQueue();
+            m_seek_time = seek_time;
+            m_seek_flags = flags;
+            m_seek_pending = true;
+            m_decode_eof = false;
+        }
+        m_queue_cond.notify_all();
+    }
+
+    // false if the frame was dropped for seek or quit
+    bool PushFrame(media_stream* stream, AVFrame* frame)
+    {
+        std::unique_lock<std::mutex> lk(m_queue_mutex);
+        m_queue_cond.wait(lk, [this] { return m_decode_quit || m_seek_pending || m_frame_queue.size() < MAX_FRAME_QUEUE; });
+        if (m_decode_quit || m_seek_pending)
+        {
+            av_frame_free(&frame);
+            return false;
+        }
+        m_frame_queue.push_back({stream, frame});
+        return true;
+    }
+
+    // take every frame the decoder has ready, a packet may hold more than one
+    bool ReceiveFrames(media_stream* stream)
     {
         while (true)
         {
-            int ret = 0;
-            ret = av_read_frame(m_fmt_ctx, m_pkt);
+            AVFrame* frame = av_frame_alloc();
+            if (!frame)
+                return false;
+            int ret = avcodec_receive_frame(stream->m_dec_ctx, frame);
             if (ret < 0)
             {
-                if (ret == AVERROR_EOF) 
+                av_frame_free(&frame);
+                return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF;
+            }
+            if (frame->format == m_hw_pix_fmt && m_hw_pix_fmt != AV_PIX_FMT_NONE)
+            {
+                // retrieve data from GPU to CPU here, so the hw surface goes back to the decoder
+                AVFrame* sw_frame = av_frame_alloc();
+                if (!sw_frame || av_hwframe_transfer_data(sw_frame, frame, 0) < 0)
                 {
-                    for (auto stream : m_streams) avcodec_flush_buffers(stream->m_dec_ctx); 
-                    return m_Exit;
+                    fprintf(stderr, "Error transferring the data to system memory\n");
+                    av_frame_free(&sw_frame);
+                    av_frame_free(&frame);
+                    continue;
                 }
-                break;
+                av_frame_copy_props(sw_frame, frame);
+                av_frame_free(&frame);
+                frame = sw_frame;
+            }
+            if (!PushFrame(stream, frame))
+                return false;
+        }
+    }
+
+    void DecodeThreadProc()
+    {
+        while (true)
+        {
+            bool do_seek = false;
+            int64_t seek_time = 0;
+            int seek_flags = 0;
+            {
+                std::unique_lock<std::mutex> lk(m_queue_mutex);
+                m_queue_cond.wait(lk, [this] { return m_decode_quit || m_seek_pending || !m_decode_eof; });
+                if (m_decode_quit)
+                    break;
+                if (m_seek_pending)
+                {
+                    do_seek = true;
+                    seek_time = m_seek_time;
+                    seek_flags = m_seek_flags;
+                    m_seek_pending = false;
+                }
+            }
+            if (do_seek)
+            {
+                av_seek_frame(m_fmt_ctx, -1, seek_time, seek_flags);
+                for (auto stream : m_streams) avcodec_flush_buffers(stream->m_dec_ctx);
+                continue;
+            }
+
+            int ret = av_read_frame(m_fmt_ctx, m_pkt);
+            if (ret < 0)
+            {
+                if (ret == AVERROR_EOF)
+                {
+                    // drain the frames decoders still hold
+                    for (auto stream : m_streams)
+                    {
+                        if (avcodec_send_packet(stream->m_dec_ctx, nullptr) >= 0)
+                            ReceiveFrames(stream);
+                        avcodec_flush_buffers(stream->m_dec_ctx);
+                    }
+                    std::lock_guard<std::mutex> lk(m_queue_mutex);
+                    if (!m_seek_pending)
+                        m_decode_eof = true;
+                }
+                else
+                    ImGui::sleep(5);
+                continue;
             }
             // find stream index
             auto iter = std::find_if(m_streams.begin(), m_streams.end(), [&](const media_stream* ss) {
                 return ss->m_index == m_pkt->stream_index;
             });
             if (iter == m_streams.end())
-                break;
+            {
+                av_packet_unref(m_pkt);
+                continue;
+            }
             media_stream * stream = *iter;
             ret = avcodec_send_packet(stream->m_dec_ctx, m_pkt);
-            av_packet_unref(m_pkt);
-            if (ret < 0)
+            if (ret == AVERROR(EAGAIN))
             {
-                if (ret == AVERROR_EOF)
-                {
-                    for (auto stream : m_streams) avcodec_flush_buffers(stream->m_dec_ctx); 
-                    return m_Exit;
-                }
-                break;
+                // decoder is full, empty it and send again
+                if (ReceiveFrames(stream))
+                    ret = avcodec_send_packet(stream->m_dec_ctx, m_pkt);
             }
-            ret = avcodec_receive_frame(stream->m_dec_ctx, stream->m_frame);
-            if (ret < 0) 
+            av_packet_unref(m_pkt);
+            if (ret >= 0)
+                ReceiveFrames(stream);
+        }
+    }
+
+    // only takes decoded frames from the queue, never waits for the decoder
+    FlowPin DecodeMedia(bool& ready)
+    {
+        decoded_frame frame;
+        {
+            std::lock_guard<std::mutex> lk(m_queue_mutex);
+            if (m_frame_queue.empty())
             {
-                if (ret == AVERROR_EOF)
-                {
-                    for (auto stream : m_streams) avcodec_flush_buffers(stream->m_dec_ctx); 
+                ready = m_decode_eof;
+                if (m_decode_eof)
                     return m_Exit;
-                }
-                else if (ret == AVERROR(EAGAIN)) continue;
-                else break;
-            }
-            else
-            {
-                if (stream->m_type == AVMEDIA_TYPE_VIDEO)
-                {
-                    ret = OutVideoFrame(stream);
-                    av_frame_unref(stream->m_frame);
-                    if (ret != 0)
-                        break;
-                    return *(FlowPin*)stream->m_flow;
-                }
-                else if (stream->m_type == AVMEDIA_TYPE_AUDIO)
-                {
-                    ret = OutAudioFrame(stream);
-                    av_frame_unref(stream->m_frame);
-                    if (ret != 0)
-                        break;
-                    return *(FlowPin*)stream->m_flow;
-                }
+                return {};
             }
+            frame = m_frame_queue.front();
+            m_frame_queue.pop_front();
         }
-        return {};
+        m_queue_cond.notify_all();
+        ready = true;
+        media_stream * stream = frame.m_stream;
+        av_frame_move_ref(stream->m_frame, frame.m_frame);
+        av_frame_free(&frame.m_frame);
+        int ret = -1;
+        if (stream->m_type == AVMEDIA_TYPE_VIDEO)
+            ret = OutVideoFrame(stream);
+        else if (stream->m_type == AVMEDIA_TYPE_AUDIO)
+            ret = OutAudioFrame(stream);
+        av_frame_unref(stream->m_frame);
+        if (ret != 0)
+            return {};
+        return *(FlowPin*)stream->m_flow;
     }
 
     void Reset(Context& context) override
     {
         Node::Reset(context);
-        if (m_fmt_ctx) av_seek_frame(m_fmt_ctx, -1, 0, AVSEEK_FLAG_BACKWARD);
+        if (m_fmt_ctx) SeekMedia(0, AVSEEK_FLAG_BACKWARD);
     }
 
     FlowPin Execute(Context& context, FlowPin& entryPoint, bool threading = false) override
@@ -888,11 +1025,18 @@ struct MediaSourceSampleNode final : Node
         {
             if (m_need_update || !m_paused)
             {
-                m_need_update = false;
-                auto ret = DecodeMedia();
-                if (ret.m_Name != "Exit")
-                    context.PushReturnPoint(entryPoint);
-                return ret;
+                bool ready = false;
+                auto ret = DecodeMedia(ready);
+                if (ready)
+                {
+                    m_need_update = false;
+                    if (ret.m_Name != "Exit")
+                        context.PushReturnPoint(entryPoint);
+                    return ret;
+                }
+                // decoder hasn't caught up, come back later
+                ImGui::sleep(threading ? 2 : 0);
+                context.PushReturnPoint(entryPoint);
             }
             else
             {
@@ -949,6 +1093,22 @@ struct MediaSourceSampleNode final : Node
         ImGui::Separator();
         changed |= ImGui::RadioButton("GPU",  (int *)&m_device, 0); ImGui::SameLine();
         changed |= ImGui::RadioButton("CPU",   (int *)&m_device, -1);
+        ImGui::Separator();
+        // decoder threads are fixed once the codec is open, reopen media to apply
+        bool thread_changed = false;
+        ImGui::SliderInt("Decode Threads", &m_thread_count, 0, 32, m_thread_count == 0 ? "Auto" : "%d", ImGuiSliderFlags_AlwaysClamp);
+        thread_changed |= ImGui::IsItemDeactivatedAfterEdit();
+        thread_changed |= ImGui::CheckboxFlags("Frame Threads", &m_thread_type, FF_THREAD_FRAME); ImGui::SameLine();
+        thread_changed |= ImGui::CheckboxFlags("Slice Threads", &m_thread_type, FF_THREAD_SLICE);
+        if (thread_changed)
+        {
+            if (m_fmt_ctx)
+            {
+                CloseMedia();
+                OpenMedia();
+            }
+            changed = true;
+        }
         if (ImGuiFileDialog::Instance()->Display("##NodeMediaSourceDlgKey", ImGuiWindowFlags_NoCollapse, minSize, maxSize))
         {
 	        // action if OK
@@ -990,7 +1150,7 @@ struct MediaSourceSampleNode final : Node
                 {
                     // Seek
                     int64_t seek_time = time * AV_TIME_BASE;
-                    auto ret = av_seek_frame(m_fmt_ctx, -1, seek_time, AVSEEK_FLAG_BACKWARD | AVSEEK_FLAG_ANY);
+                    SeekMedia(seek_time, AVSEEK_FLAG_BACKWARD | AVSEEK_FLAG_ANY);
                     m_current_pts = time;
                     m_need_update = true;
                 }
@@ -1094,6 +1254,18 @@ struct MediaSourceSampleNode final : Node
             if (val.is_number()) 
                 m_device = (ImDataType)val.get<imgui_json::number>();
         }
+        if (value.contains("thread_count"))
+        {
+            auto& val = value["thread_count"];
+            if (val.is_number()) 
+                m_thread_count = val.get<imgui_json::number>();
+        }
+        if (value.contains("thread_type"))
+        {
+            auto& val = value["thread_type"];
+            if (val.is_number()) 
+                m_thread_type = val.get<imgui_json::number>();
+        }
         if (value.contains("media_path"))
         {
             auto& val = value["media_path"];
@@ -1154,6 +1326,8 @@ struct MediaSourceSampleNode final : Node
         value["mat_type"] = imgui_json::number(m_mat_data_type);
         value["device_type"] = imgui_json::number(m_device);
         value["camera"] = imgui_json::boolean(m_camera);
+        value["thread_count"] = imgui_json::number(m_thread_count);
+        value["thread_type"] = imgui_json::number(m_thread_type);
         value["media_path"] = m_path;
         value["file_name"] = m_file_name;
     }
@@ -1174,6 +1348,8 @@ private:
     int                 m_device  {0};          // 0 = GPU -1 = CPU
     ImDataType m_mat_data_type {IM_DT_UNDEFINED};
     bool                m_camera {false};
+    int                 m_thread_count {0};     // 0 = auto
+    int                 m_thread_type {FF_THREAD_FRAME | FF_THREAD_SLICE};
     std::string         m_path;
     std::string         m_file_name;
 
@@ -1186,6 +1362,16 @@ private:
     int64_t             m_last_video_pts {AV_NOPTS_VALUE};
     bool                m_paused        {false};
     bool                m_need_update   {false};
+
+    std::thread         m_decode_thread;
+    std::deque<decoded_frame> m_frame_queue;
+    std::mutex          m_queue_mutex;
+    std::condition_variable m_queue_cond;
+    bool                m_decode_quit   {false};
+    bool                m_decode_eof    {false};
+    bool                m_seek_pending  {false};
+    int64_t             m_seek_time     {0};
+    int                 m_seek_flags    {0};
 };
 }
 
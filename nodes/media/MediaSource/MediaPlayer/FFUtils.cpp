@@ -29,6 +29,7 @@ extern "C"
     #include "libavutil/avutil.h"
     #include "libavutil/opt.h"
     #include "libavutil/channel_layout.h"
+    #include "libavutil/imgutils.h"
 #if LIBAVCODEC_VERSION_MAJOR > 58 || (LIBAVCODEC_VERSION_MAJOR == 58 && LIBAVCODEC_VERSION_MINOR >= 78)
     #include "libavcodec/codec_desc.h"
 #endif
@@ -389,6 +390,135 @@ SelfFreeAVFramePtr WrapSelfFreeAVFramePtr(AVFrame* avfrm)
     return frm;
 }
 
+AVFrameBufferPool::~AVFrameBufferPool()
+{
+    // buffers still held by frames keep the pool alive until they are unref'd
+    av_buffer_pool_uninit(&m_pool);
+}
+
+#if LIBAVUTIL_VERSION_MAJOR >= 57
+AVBufferRef* AVFrameBufferPool::AllocBuffer(void* opaque, size_t size)
+#else
+AVBufferRef* AVFrameBufferPool::AllocBuffer(void* opaque, int size)
+#endif
+{
+    AVFrameBufferPool* pool = reinterpret_cast<AVFrameBufferPool*>(opaque);
+    pool->m_misses++;
+    return av_buffer_alloc(size);
+}
+
+bool AVFrameBufferPool::GetBuffer(AVFrame* avfrm)
+{
+    const bool isVideo = avfrm->width > 0 && avfrm->height > 0;
+    const int channels = isVideo ? 0 : avfrm->ch_layout.nb_channels;
+    int fferr;
+    if (isVideo)
+        fferr = av_image_get_buffer_size((AVPixelFormat)avfrm->format, avfrm->width, avfrm->height, 32);
+    else if (channels > AV_NUM_DATA_POINTERS && av_sample_fmt_is_planar((AVSampleFormat)avfrm->format))
+        fferr = -1;
+    else
+        fferr = av_samples_get_buffer_size(nullptr, channels, avfrm->nb_samples, (AVSampleFormat)avfrm->format, 0);
+    if (fferr < 0)
+    {
+        // hw, bitstream and wide planar layouts are not pooled
+        fferr = av_frame_get_buffer(avfrm, 0);
+        if (fferr < 0)
+        {
+            cerr << "FAILED to invoke 'av_frame_get_buffer()'! fferr = " << fferr << "." << endl;
+            return false;
+        }
+        m_gets++;
+        m_misses++;
+        return true;
+    }
+
+    const size_t bufSize = (size_t)fferr+AV_INPUT_BUFFER_PADDING_SIZE;
+    if (!m_pool || m_poolSize != bufSize)
+    {
+        av_buffer_pool_uninit(&m_pool);
+        m_pool = av_buffer_pool_init2(bufSize, this, AllocBuffer, nullptr);
+        if (!m_pool)
+        {
+            cerr << "FAILED to invoke 'av_buffer_pool_init2()' with buffer size " << bufSize << "!" << endl;
+            return false;
+        }
+        m_poolSize = bufSize;
+    }
+    AVBufferRef* buf = av_buffer_pool_get(m_pool);
+    m_gets++;
+    if (!buf)
+    {
+        cerr << "FAILED to invoke 'av_buffer_pool_get()'!" << endl;
+        return false;
+    }
+    if (isVideo)
+        fferr = av_image_fill_arrays(avfrm->data, avfrm->linesize, buf->data, (AVPixelFormat)avfrm->format, avfrm->width, avfrm->height, 32);
+    else
+        fferr = av_samples_fill_arrays(avfrm->data, avfrm->linesize, buf->data, channels, avfrm->nb_samples, (AVSampleFormat)avfrm->format, 0);
+    if (fferr < 0)
+    {
+        av_buffer_unref(&buf);
+        cerr << "FAILED to fill frame data pointers from pooled buffer! fferr = " << fferr << "." << endl;
+        return false;
+    }
+    avfrm->buf[0] = buf;
+    avfrm->extended_data = avfrm->data;
+    return true;
+}
+
+FFPoolStats AVFrameBufferPool::GetStats() const
+{
+    FFPoolStats stats;
+    stats.misses = m_misses;
+    const uint64_t gets = m_gets;
+    stats.hits = gets > stats.misses ? gets-stats.misses : 0;
+    return stats;
+}
+
+ImGui::ImMat ImMatPool::Get(int w, int h, int c, ImDataType type)
+{
+    lock_guard<mutex> lk(m_lock);
+    auto iter = find_if(m_mats.begin(), m_mats.end(), [&] (const ImGui::ImMat& m) {
+        return m.w == w && m.h == h && m.c == c && m.type == type && m.refcount && *m.refcount == 1;
+    });
+    if (iter != m_mats.end())
+    {
+        m_hits++;
+        return *iter;
+    }
+    m_misses++;
+    ImGui::ImMat mat;
+    mat.create_type(w, h, c, type);
+    if (m_mats.size() < m_capacity)
+    {
+        m_mats.push_back(mat);
+    }
+    else
+    {
+        // replace an idle mat of an old layout
+        iter = find_if(m_mats.begin(), m_mats.end(), [] (const ImGui::ImMat& m) {
+            return !m.refcount || *m.refcount == 1;
+        });
+        if (iter != m_mats.end())
+            *iter = mat;
+    }
+    return mat;
+}
+
+void ImMatPool::Clear()
+{
+    lock_guard<mutex> lk(m_lock);
+    m_mats.clear();
+}
+
+FFPoolStats ImMatPool::GetStats() const
+{
+    FFPoolStats stats;
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    return stats;
+}
+
 bool IsHwFrame(const AVFrame* avfrm)
 {
     const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)avfrm->format);
@@ -459,7 +589,7 @@ bool MakeAVFrameCopy(AVFrame* dst, const AVFrame* src)
     return true;
 }
 
-bool ConvertAVFrameToImMat(const AVFrame* avfrm, ImGui::ImMat& vmat, double timestamp)
+bool ConvertAVFrameToImMat(const AVFrame* avfrm, ImGui::ImMat& vmat, double timestamp, ImMatPool* pool)
 {
     SelfFreeAVFramePtr swfrm;
     if (IsHwFrame(avfrm))
@@ -512,7 +642,10 @@ bool ConvertAVFrameToImMat(const AVFrame* avfrm, ImGui::ImMat& vmat, double time
         else
             channel = 2;
     }
-    mat_V.create_type(width, height, channel, dataType);
+    if (pool)
+        mat_V = pool->Get(width, height, channel, dataType);
+    else
+        mat_V.create_type(width, height, channel, dataType);
     uint8_t* prevDataPtr = nullptr;
     for (int i = 0; i < desc->nb_components; i++)
     {
@@ -706,6 +839,7 @@ bool ConvertImMatToAVFrame(const ImGui::ImMat& vmat, AVFrame* avfrm, int64_t pts
 }
 
 AVFrameToImMatConverter::AVFrameToImMatConverter()
+    : m_swsBufPool(new AVFrameBufferPool()), m_matPool(new ImMatPool())
 {
 #if IMGUI_VULKAN_SHADER
     m_useVulkanComponents = true;
@@ -870,7 +1004,7 @@ bool AVFrameToImMatConverter::ConvertImage(const AVFrame* avfrm, ImGui::ImMat& o
 #else // YUV_CONVERT_NON_PLANAR
         // AVFrame -> ImMat
         ImGui::ImMat inMat;
-        if (!ConvertAVFrameToImMat(avfrm, inMat, timestamp))
+        if (!ConvertAVFrameToImMat(avfrm, inMat, timestamp, m_matPool.get()))
         {
             m_errMsg = "Failed to invoke 'ConvertAVFrameToImMat()'!";
             return false;
@@ -967,33 +1101,34 @@ bool AVFrameToImMatConverter::ConvertImage(const AVFrame* avfrm, ImGui::ImMat& o
             }
         }
 
-        SelfFreeAVFramePtr swsfrm;
         if (!m_passThrough && m_swsCtx)
         {
-            swsfrm = AllocSelfFreeAVFramePtr();
-            if (!swsfrm)
+            if (!m_swsfrm)
+                m_swsfrm = AllocSelfFreeAVFramePtr();
+            if (!m_swsfrm)
             {
                 m_errMsg = "FAILED to allocate AVFrame to perform 'swscale'!";
                 return false;
             }
 
-            AVFrame* pfrm = swsfrm.get();
+            // drop the previous output, its buffer returns to the pool
+            AVFrame* pfrm = m_swsfrm.get();
+            av_frame_unref(pfrm);
             pfrm->width = outWidth;
             pfrm->height = outHeight;
             pfrm->format = (int)m_swsOutFormat;
-            int fferr = av_frame_get_buffer(pfrm, 0);
-            if (fferr < 0)
+            if (!m_swsBufPool->GetBuffer(pfrm))
             {
-                m_errMsg = string("FAILED to invoke 'av_frame_get_buffer()' for 'swsfrm'! fferr = ")+to_string(fferr)+".";
+                m_errMsg = "FAILED to get a pooled buffer for 'swsfrm'!";
                 return false;
             }
-            fferr = sws_scale(m_swsCtx, avfrm->data, avfrm->linesize, 0, avfrm->height, swsfrm->data, swsfrm->linesize);
-            av_frame_copy_props(swsfrm.get(), avfrm);
-            avfrm = swsfrm.get();
+            sws_scale(m_swsCtx, avfrm->data, avfrm->linesize, 0, avfrm->height, pfrm->data, pfrm->linesize);
+            av_frame_copy_props(pfrm, avfrm);
+            avfrm = pfrm;
         }
 
         // AVFrame -> ImMat
-        if (!ConvertAVFrameToImMat(avfrm, outMat, timestamp))
+        if (!ConvertAVFrameToImMat(avfrm, outMat, timestamp, m_matPool.get()))
         {
             m_errMsg = "Failed to invoke 'ConvertAVFrameToImMat()'!";
             return false;
@@ -1004,6 +1139,15 @@ bool AVFrameToImMatConverter::ConvertImage(const AVFrame* avfrm, ImGui::ImMat& o
     }
 }
 
+FFPoolStats AVFrameToImMatConverter::GetPoolStats() const
+{
+    FFPoolStats stats = m_matPool->GetStats();
+    const FFPoolStats swsStats = m_swsBufPool->GetStats();
+    stats.hits += swsStats.hits;
+    stats.misses += swsStats.misses;
+    return stats;
+}
+
 ImMatToAVFrameConverter::ImMatToAVFrameConverter()
 {
 #if IMGUI_VULKAN_SHADER
@@ -20,6 +20,8 @@
 #include <string>
 #include <memory>
 #include <vector>
+#include <atomic>
+#include <mutex>
 #include <imconfig.h>
 #include <immat.h>
 #if IMGUI_VULKAN_SHADER
@@ -34,6 +36,7 @@ extern "C"
     #include "libavutil/pixdesc.h"
     #include "libavutil/samplefmt.h"
     #include "libavutil/frame.h"
+    #include "libavutil/buffer.h"
     #include "libswscale/swscale.h"
     #include "libavfilter/avfilter.h"
 }
@@ -59,10 +62,69 @@ SelfFreeAVFramePtr AllocSelfFreeAVFramePtr();
 SelfFreeAVFramePtr CloneSelfFreeAVFramePtr(const AVFrame* avfrm);
 SelfFreeAVFramePtr WrapSelfFreeAVFramePtr(AVFrame* avfrm);
 
+struct FFPoolStats
+{
+    uint64_t hits{0};
+    uint64_t misses{0};
+};
+
+// Hands out frame data buffers from an AVBufferPool. The buffer goes back to
+// the pool when the last AVFrame referencing it is unref'd, so frames can be
+// freed by any consumer as before.
+class AVFrameBufferPool
+{
+public:
+    AVFrameBufferPool() = default;
+    ~AVFrameBufferPool();
+
+    AVFrameBufferPool(const AVFrameBufferPool&) = delete;
+    AVFrameBufferPool& operator=(const AVFrameBufferPool&) = delete;
+
+    // Same contract as av_frame_get_buffer(): 'format' and 'width'/'height' or
+    // 'nb_samples'/'ch_layout' must be set on 'avfrm'.
+    bool GetBuffer(AVFrame* avfrm);
+    FFPoolStats GetStats() const;
+
+private:
+#if LIBAVUTIL_VERSION_MAJOR >= 57
+    static AVBufferRef* AllocBuffer(void* opaque, size_t size);
+#else
+    static AVBufferRef* AllocBuffer(void* opaque, int size);
+#endif
+
+private:
+    AVBufferPool* m_pool{nullptr};
+    size_t m_poolSize{0};
+    std::atomic<uint64_t> m_gets{0};
+    std::atomic<uint64_t> m_misses{0};
+};
+
+// Recycles ImMat storage. A mat is handed out again once every copy returned
+// earlier has been released.
+class ImMatPool
+{
+public:
+    ImMatPool(uint32_t capacity = 8) : m_capacity(capacity) {}
+
+    ImMatPool(const ImMatPool&) = delete;
+    ImMatPool& operator=(const ImMatPool&) = delete;
+
+    ImGui::ImMat Get(int w, int h, int c, ImDataType type);
+    void Clear();
+    FFPoolStats GetStats() const;
+
+private:
+    std::mutex m_lock;
+    std::vector<ImGui::ImMat> m_mats;
+    uint32_t m_capacity;
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+};
+
 AVPixelFormat GetAVPixelFormatByName(const std::string& name);
 ImColorFormat ConvertPixelFormatToColorFormat(AVPixelFormat pixfmt);
 ImDataType GetDataTypeFromSampleFormat(AVSampleFormat smpfmt);
-bool ConvertAVFrameToImMat(const AVFrame* avfrm, ImGui::ImMat& vmat, double timestamp);
+bool ConvertAVFrameToImMat(const AVFrame* avfrm, ImGui::ImMat& vmat, double timestamp, ImMatPool* pool = nullptr);
 bool ConvertAVFrameToImMat(const AVFrame* avfrm, std::vector<ImGui::ImMat>& vmat, double timestamp);
 bool ConvertImMatToAVFrame(const ImGui::ImMat& vmat, AVFrame* avfrm, int64_t pts);
 
@@ -88,6 +150,7 @@ public:
 
     void SetUseVulkanConverter(bool use) { m_useVulkanComponents = use; }
 
+    FFPoolStats GetPoolStats() const;
     std::string GetError() const { return m_errMsg; }
 
 private:
@@ -106,6 +169,9 @@ private:
     AVPixelFormat m_swsInFormat{AV_PIX_FMT_NONE};
     AVPixelFormat m_swsOutFormat{AV_PIX_FMT_RGBA};
     AVColorSpace m_swsClrspc{AVCOL_SPC_RGB};
+    SelfFreeAVFramePtr m_swsfrm;
+    std::unique_ptr<AVFrameBufferPool> m_swsBufPool;
+    std::unique_ptr<ImMatPool> m_matPool;
     bool m_passThrough{false};
     std::string m_errMsg;
 };
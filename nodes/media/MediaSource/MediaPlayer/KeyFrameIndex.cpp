@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include "KeyFrameIndex.h"
+extern "C"
+{
+    #include "libavformat/avformat.h"
+}
+
+using namespace std;
+namespace fs = std::filesystem;
+
+#define KEYFRAME_INDEX_MAGIC    0x5849464b // "KFIX"
+#define KEYFRAME_INDEX_VERSION  1
+
+struct KeyFrameIndexHeader
+{
+    uint32_t magic      {KEYFRAME_INDEX_MAGIC};
+    uint32_t version    {KEYFRAME_INDEX_VERSION};
+    int32_t streamIndex {-1};
+    uint32_t reserved   {0};
+    uint64_t fileSize   {0};
+    int64_t fileTime    {0};
+    uint64_t count      {0};
+};
+
+KeyFrameIndex::~KeyFrameIndex()
+{
+    Close();
+}
+
+void KeyFrameIndex::Open(const string& url, int streamIndex)
+{
+    Close();
+    // only local files can be indexed and validated
+    error_code ec;
+    if (url.empty() || url.find("://") != string::npos || !fs::is_regular_file(url, ec))
+        return;
+    m_url = url;
+    m_streamIndex = streamIndex;
+    m_fileSize = (uint64_t)fs::file_size(url, ec);
+    m_fileTime = (int64_t)fs::last_write_time(url, ec).time_since_epoch().count();
+    // never write next to the user's media, keep the index in the temp directory
+    auto tempDir = fs::temp_directory_path(ec);
+    if (!ec)
+        m_indexPath = (tempDir / (to_string(hash<string>()(url)) + ".kfidx")).string();
+
+    if (!m_indexPath.empty() && LoadFile(m_indexPath))
+    {
+        m_ready = true;
+        return;
+    }
+    m_quit = false;
+    m_buildThread = thread(&KeyFrameIndex::BuildThreadProc, this);
+}
+
+void KeyFrameIndex::Close()
+{
+    m_quit = true;
+    if (m_buildThread.joinable())
+        m_buildThread.join();
+    m_ready = false;
+    lock_guard<mutex> lk(m_keysLock);
+    m_keys.clear();
+    m_indexPath.clear();
+    m_url.clear();
+    m_streamIndex = -1;
+}
+
+bool KeyFrameIndex::Find(int64_t pts, int64_t& key0, int64_t& key1) const
+{
+    if (!m_ready)
+        return false;
+    lock_guard<mutex> lk(m_keysLock);
+    if (m_keys.empty())
+        return false;
+    auto iter = upper_bound(m_keys.begin(), m_keys.end(), pts);
+    key1 = iter == m_keys.end() ? INT64_MAX : *iter;
+    key0 = iter == m_keys.begin() ? INT64_MIN : *(iter-1);
+    return true;
+}
+
+int64_t KeyFrameIndex::First() const
+{
+    lock_guard<mutex> lk(m_keysLock);
+    return m_keys.empty() ? INT64_MIN : m_keys.front();
+}
+
+size_t KeyFrameIndex::Size() const
+{
+    lock_guard<mutex> lk(m_keysLock);
+    return m_keys.size();
+}
+
+void KeyFrameIndex::BuildThreadProc()
+{
+    AVFormatContext* avfmtCtx = nullptr;
+    int fferr = avformat_open_input(&avfmtCtx, m_url.c_str(), nullptr, nullptr);
+    if (fferr < 0)
+        return;
+    fferr = avformat_find_stream_info(avfmtCtx, nullptr);
+    if (fferr < 0 || m_streamIndex < 0 || m_streamIndex >= (int)avfmtCtx->nb_streams)
+    {
+        avformat_close_input(&avfmtCtx);
+        return;
+    }
+    // only the video packets are needed, let the demuxer skip the rest
+    for (int i = 0; i < (int)avfmtCtx->nb_streams; i++)
+    {
+        if (i != m_streamIndex)
+            avfmtCtx->streams[i]->discard = AVDISCARD_ALL;
+    }
+
+    vector<int64_t> keys;
+    AVPacket* avpkt = av_packet_alloc();
+    while (!m_quit && (fferr = av_read_frame(avfmtCtx, avpkt)) >= 0)
+    {
+        if (avpkt->stream_index == m_streamIndex && (avpkt->flags & AV_PKT_FLAG_KEY))
+        {
+            int64_t pts = avpkt->pts != AV_NOPTS_VALUE ? avpkt->pts : avpkt->dts;
+            if (pts != AV_NOPTS_VALUE)
+                keys.push_back(pts);
+        }
+        av_packet_unref(avpkt);
+    }
+    av_packet_free(&avpkt);
+    avformat_close_input(&avfmtCtx);
+    if (m_quit || fferr != AVERROR_EOF || keys.empty())
+        return;
+
+    sort(keys.begin(), keys.end());
+    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+    {
+        lock_guard<mutex> lk(m_keysLock);
+        m_keys.swap(keys);
+    }
+    m_ready = true;
+    cout << "Keyframe index built for '" << m_url << "', " << Size() << " keyframes." << endl;
+    if (!m_indexPath.empty())
+        SaveFile(m_indexPath);
+}
+
+bool KeyFrameIndex::LoadFile(const string& path)
+{
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp)
+        return false;
+    KeyFrameIndexHeader header;
+    bool valid = fread(&header, 1, sizeof(header), fp) == sizeof(header) &&
+        header.magic == KEYFRAME_INDEX_MAGIC && header.version == KEYFRAME_INDEX_VERSION &&
+        header.streamIndex == m_streamIndex && header.fileSize == m_fileSize && header.fileTime == m_fileTime &&
+        header.count > 0 && header.count < (1ull << 32);
+    vector<int64_t> keys;
+    if (valid)
+    {
+        keys.resize(header.count);
+        valid = fread(keys.data(), sizeof(int64_t), keys.size(), fp) == keys.size();
+    }
+    fclose(fp);
+    if (!valid)
+        return false;
+    lock_guard<mutex> lk(m_keysLock);
+    m_keys.swap(keys);
+    return true;
+}
+
+bool KeyFrameIndex::SaveFile(const string& path) const
+{
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (!fp)
+        return false;
+    lock_guard<mutex> lk(m_keysLock);
+    KeyFrameIndexHeader header;
+    header.streamIndex = m_streamIndex;
+    header.fileSize = m_fileSize;
+    header.fileTime = m_fileTime;
+    header.count = m_keys.size();
+    bool ok = fwrite(&header, 1, sizeof(header), fp) == sizeof(header) &&
+        fwrite(m_keys.data(), sizeof(int64_t), m_keys.size(), fp) == m_keys.size();
+    fclose(fp);
+    if (!ok)
+        remove(path.c_str());
+    return ok;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Keyframe positions (pts in stream time base) of one video stream. The index
+// is loaded from '<hash of the url>.kfidx' in the temp directory, the media
+// folder is never written. If it is not valid it is rebuilt on a background
+// thread with a separate demuxer, so playback never waits on it.
+class KeyFrameIndex
+{
+public:
+    KeyFrameIndex() = default;
+    ~KeyFrameIndex();
+
+    KeyFrameIndex(const KeyFrameIndex&) = delete;
+    KeyFrameIndex& operator=(const KeyFrameIndex&) = delete;
+
+    void Open(const std::string& url, int streamIndex);
+    void Close();
+
+    bool IsReady() const { return m_ready; }
+    // GOP holding 'pts': [key0, key1), key0 is INT64_MIN before the first
+    // keyframe and key1 is INT64_MAX after the last one. False if not ready.
+    bool Find(int64_t pts, int64_t& key0, int64_t& key1) const;
+    int64_t First() const;
+    size_t Size() const;
+
+private:
+    void BuildThreadProc();
+    bool LoadFile(const std::string& path);
+    bool SaveFile(const std::string& path) const;
+
+private:
+    std::string m_url;
+    std::string m_indexPath;
+    int m_streamIndex {-1};
+    uint64_t m_fileSize {0};
+    int64_t m_fileTime {0};
+    std::vector<int64_t> m_keys;
+    mutable std::mutex m_keysLock;
+    std::thread m_buildThread;
+    std::atomic_bool m_ready {false};
+    std::atomic_bool m_quit {false};
+};
@@ -3,6 +3,7 @@
 #include <iomanip>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <list>
 #include <atomic>
 #include <limits>
@@ -12,6 +13,8 @@
 #include <imgui_fft.h>
 #include "MediaPlayer.h"
 #include "FFUtils.h"
+#include "KeyFrameIndex.h"
+#include "ScrubCache.h"
 extern "C"
 {
     #include "libavutil/avutil.h"
@@ -34,6 +37,35 @@ using namespace std;
 
 static AVPixelFormat get_hw_format(AVCodecContext *ctx, const AVPixelFormat *pix_fmts);
 
+// Wake-up latch for one pipeline stage. A stage with nothing to do waits here
+// instead of sleeping, and its neighbours Notify() it whenever a queue it
+// depends on changes. The timeout is only a fallback for state that is not
+// signalled, e.g. the play clock.
+class StageEvent
+{
+public:
+    void Notify()
+    {
+        {
+            lock_guard<mutex> lk(m_lock);
+            m_signaled = true;
+        }
+        m_cond.notify_one();
+    }
+
+    void WaitFor(int64_t ms)
+    {
+        unique_lock<mutex> lk(m_lock);
+        m_cond.wait_for(lk, chrono::milliseconds(ms), [this] { return m_signaled; });
+        m_signaled = false;
+    }
+
+private:
+    mutex m_lock;
+    condition_variable m_cond;
+    bool m_signaled {false};
+};
+
 struct AudioData
 {
     double audio_pts {0};
@@ -62,6 +94,7 @@ class MediaPlayer_FFImpl : public MediaPlayer
         list<AVPacket*>     m_audpktQ;
         mutex               m_audpktQLock;
         thread              m_auddecThread;
+        StageEvent          m_auddecEvent;
         int                 m_audfrmQMaxSize{5};
         list<AVFrame*>      m_audfrmQ;
         mutex               m_audfrmQLock;
@@ -74,6 +107,9 @@ class MediaPlayer_FFImpl : public MediaPlayer
         int                 m_swrfrmQMaxSize{24};
         list<AVFrame*>      m_swrfrmQ;
         mutex               m_swrfrmQLock;
+        StageEvent          m_swrEvent;
+        AVFrameBufferPool   m_swrBufPool;
+        AVFrameBufferPool   m_swrDBBufPool;
         bool                m_swrPassThrough{false};
         bool                m_swrEof{false};
         AVSampleFormat      m_swrOutSmpfmt{AV_SAMPLE_FMT_S16};
@@ -89,6 +125,8 @@ public:
     using Duration = chrono::duration<int64_t, milli>;
     using TimePoint = chrono::time_point<Clock>;
     static const TimePoint CLOCK_MIN;
+    // longest a stage waits for a notification before re-checking its state
+    static constexpr int64_t STAGE_IDLE_WAIT_MS = 50;
 
     MediaPlayer_FFImpl() : m_audByteStream(this) {}
 
@@ -120,6 +158,8 @@ public:
         lock_guard<recursive_mutex> lk(m_ctlLock);
         WaitAllThreadsQuit();
         FlushAllQueues();
+        m_kfIndex.Close();
+        m_scrubCache.Close();
 
         if (m_audrnd)
             m_audrnd->CloseDevice();
@@ -209,6 +249,7 @@ public:
         if (m_audrnd)
             m_audrnd->Resume();
         m_isPlaying = true;
+        m_renderEvent.Notify();
         return true;
     }
 
@@ -310,7 +351,15 @@ public:
         m_pauseStartTp = CLOCK_MIN;
 
         int64_t ffpos = av_rescale_q(pos, MILLISEC_TIMEBASE, FFAV_TIMEBASE);
-        int fferr = avformat_seek_file(m_avfmtCtx, -1, INT64_MIN, ffpos, ffpos, 0);
+        int fferr;
+        int64_t keyPos0, keyPos1;
+        if (HasVideo() && m_kfIndex.Find(MillisecToVidPts(pos), keyPos0, keyPos1) && keyPos0 != INT64_MIN)
+        {
+            // land on the keyframe starting the GOP, frames before 'pos' are dropped after decoding
+            fferr = avformat_seek_file(m_avfmtCtx, m_vidStmIdx, INT64_MIN, keyPos0, keyPos0, 0);
+        }
+        else
+            fferr = avformat_seek_file(m_avfmtCtx, -1, INT64_MIN, ffpos, ffpos, 0);
         if (fferr < 0)
         {
             SetFFError("avformat_seek_file(In Seek)", fferr);
@@ -376,6 +425,8 @@ public:
         }
 
         m_asyncSeekPos = pos;
+        m_demuxEvent.Notify();
+        m_renderEvent.Notify();
         cout << "Seek(async) to " << MillisecToString(pos) << endl;
         return true;
     }
@@ -489,6 +540,39 @@ public:
         return true;
     }
 
+    bool SetPreviewScale(uint32_t scale) override
+    {
+        lock_guard<recursive_mutex> lk(m_ctlLock);
+        if (scale != 1 && scale != 2 && scale != 4 && scale != 8)
+        {
+            m_errMessage = "Preview scale can ONLY be 1, 2, 4 or 8!";
+            return false;
+        }
+        m_previewScale = scale;
+        return true;
+    }
+
+    bool SetFullResolution(bool full) override
+    {
+        lock_guard<recursive_mutex> lk(m_ctlLock);
+        m_fullResolution = full;
+        return true;
+    }
+
+    bool SetScrubCacheOptions(uint32_t previewWidth, uint32_t memoryMB, uint32_t diskMB) override
+    {
+        lock_guard<recursive_mutex> lk(m_ctlLock);
+        if (memoryMB == 0)
+        {
+            m_errMessage = "Scrub cache memory budget can NOT be 0!";
+            return false;
+        }
+        m_scrubPreviewWidth = previewWidth;
+        m_scrubMemoryMB = memoryMB;
+        m_scrubDiskMB = diskMB;
+        return true;
+    }
+
     uint64_t GetDuration() const override
     {
         if (!m_avfmtCtx)
@@ -721,6 +805,21 @@ public:
         return true;
     }
 
+    void GetBufferPoolStats(uint64_t& hits, uint64_t& misses) override
+    {
+        lock_guard<recursive_mutex> lk(m_ctlLock);
+        FFPoolStats stats = m_frmCvt.GetPoolStats();
+        for (auto stream : m_audio_streams)
+        {
+            FFPoolStats swrStats = stream->m_swrBufPool.GetStats();
+            FFPoolStats dbStats = stream->m_swrDBBufPool.GetStats();
+            stats.hits += swrStats.hits+dbStats.hits;
+            stats.misses += swrStats.misses+dbStats.misses;
+        }
+        hits = stats.hits;
+        misses = stats.misses;
+    }
+
     string GetError() const override
     {
         return m_errMessage;
@@ -735,6 +834,22 @@ private:
     static const AVRational MILLISEC_TIMEBASE;
     static const AVRational FFAV_TIMEBASE;
 
+    // play positions start from 0, the packet pts of the video stream from its start_time
+    int64_t MillisecToVidPts(int64_t mts) const
+    {
+        int64_t pts = av_rescale_q(mts, MILLISEC_TIMEBASE, m_vidStream->time_base);
+        if (m_vidStream->start_time != AV_NOPTS_VALUE)
+            pts += m_vidStream->start_time;
+        return pts;
+    }
+
+    int64_t VidPtsToMillisec(int64_t pts) const
+    {
+        if (m_vidStream->start_time != AV_NOPTS_VALUE)
+            pts -= m_vidStream->start_time;
+        return av_rescale_q(pts, m_vidStream->time_base, MILLISEC_TIMEBASE);
+    }
+
     void SetFFError(const string& funcname, int fferr)
     {
         ostringstream oss;
@@ -918,12 +1033,25 @@ private:
                 if (!OpenVideoDecoder())
                     return false;
             }
+            // the scale is folded into the color conversion, lowres frames only need what is left
+            uint32_t scale = GetOutputScale();
+            if (scale > 1)
+            {
+                uint32_t outWidth = max(2u, ((uint32_t)m_vidStream->codecpar->width/scale+1)&~1u);
+                uint32_t outHeight = max(2u, ((uint32_t)m_vidStream->codecpar->height/scale+1)&~1u);
+                m_frmCvt.SetOutSize(outWidth, outHeight);
+            }
+            else
+                m_frmCvt.SetOutSize(0, 0);
             int qMaxSize = 0;
             if (m_vidStream->avg_frame_rate.den > 0)
                 qMaxSize = (int)(m_vidpktQDuration*m_vidStream->avg_frame_rate.num/m_vidStream->avg_frame_rate.den);
             if (qMaxSize < 20)
                 qMaxSize = 20;
             m_vidpktQMaxSize = qMaxSize;
+            if (!url.empty() && url != "Camera")
+                m_kfIndex.Open(url, m_vidStmIdx);
+            m_scrubCache.Open(url, m_scrubPreviewWidth, m_scrubMemoryMB, m_scrubDiskMB);
         }
         for (auto stream : m_audio_streams)
         {
@@ -938,6 +1066,11 @@ private:
         return true;
     }
 
+    uint32_t GetOutputScale() const
+    {
+        return m_fullResolution ? 1 : m_previewScale;
+    }
+
     bool OpenVideoDecoder()
     {
         m_viddecCtx = avcodec_alloc_context3(m_viddec);
@@ -958,6 +1091,17 @@ private:
 
         m_viddecCtx->thread_count = 8;
         // m_viddecCtx->thread_type = FF_THREAD_FRAME;
+        uint32_t scale = GetOutputScale();
+        if (scale > 1)
+        {
+            // let codecs with lowres support (mpeg1/2/4, mjpeg, ...) decode at reduced size
+            int lowres = 0;
+            while ((2u<<lowres) <= scale && lowres < m_viddec->max_lowres)
+                lowres++;
+            m_viddecCtx->lowres = lowres;
+            // deblocking artifacts hardly show at preview size, skip it on all frames below 1/2
+            m_viddecCtx->skip_loop_filter = scale > 2 ? AVDISCARD_ALL : AVDISCARD_NONREF;
+        }
         fferr = avcodec_open2(m_viddecCtx, m_viddec, nullptr);
         if (fferr < 0)
         {
@@ -965,7 +1109,7 @@ private:
             return false;
         }
         cout << "Video decoder '" << m_viddec->name << "' opened." << " thread_count=" << m_viddecCtx->thread_count
-            << ", thread_type=" << m_viddecCtx->thread_type << endl;
+            << ", thread_type=" << m_viddecCtx->thread_type << ", lowres=" << m_viddecCtx->lowres << endl;
         return true;
     }
 
@@ -1183,6 +1327,7 @@ private:
                     av_packet_unref(&avpkt);
                     avpktLoaded = false;
                     idleLoop = false;
+                    m_viddecEvent.Notify();
                 }
             }
             else
@@ -1207,6 +1352,7 @@ private:
                         av_packet_unref(&avpkt);
                         avpktLoaded = false;
                         idleLoop = false;
+                        stream->m_auddecEvent.Notify();
                     }
                 }
                 else
@@ -1217,9 +1363,10 @@ private:
             }
 
             if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(5));
+                m_demuxEvent.WaitFor(STAGE_IDLE_WAIT_MS);
         }
         m_demuxEof = true;
+        NotifyDemuxEof();
         if (avpktLoaded)
             av_packet_unref(&avpkt);
         cout << "Leave DemuxThreadProc()." << endl;
@@ -1243,7 +1390,7 @@ private:
                 int64_t currSeekPos = m_asyncSeekPos;
                 if (currSeekPos != INT64_MIN)
                 {
-                    int64_t vidSeekPos = av_rescale_q(currSeekPos, MILLISEC_TIMEBASE, m_vidStream->time_base);
+                    int64_t vidSeekPos = MillisecToVidPts(currSeekPos);
                     if (vidSeekPos < seekPos0 || vidSeekPos >= seekPos1)
                     {
                         if (avpktLoaded)
@@ -1251,31 +1398,46 @@ private:
                             av_packet_unref(&avpkt);
                             avpktLoaded = false;
                         }
-                        int fferr = avformat_seek_file(m_avfmtCtx, m_vidStmIdx, vidSeekPos+1, vidSeekPos+1, INT64_MAX, 0);
-                        if (fferr < 0)
-                        {
-                            cerr << "avformat_seek_file() FAILED for finding 'seekPos1'! fferr = " << fferr << "!" << endl;
-                            fatalError = true;
-                            break;
-                        }
-                        if (!ReadNextStreamPacket(m_vidStmIdx, &avpkt, &avpktLoaded, &seekPos1))
-                        {
-                            fatalError = true;
-                            break;
-                        }
-                        if (avpktLoaded)
-                            av_packet_unref(&avpkt);
-                        fferr = avformat_seek_file(m_avfmtCtx, m_vidStmIdx, INT64_MIN, vidSeekPos, vidSeekPos, 0);
-                        if (fferr < 0)
+                        if (m_kfIndex.Find(vidSeekPos, seekPos0, seekPos1))
                         {
-                            cerr << "avformat_seek_file() FAILED for finding 'seekPos0'! fferr = " << fferr << "!" << endl;
-                            fatalError = true;
-                            break;
+                            // the index knows the GOP, jump to its keyframe without probing
+                            int64_t seekTs = seekPos0 != INT64_MIN ? seekPos0 : m_kfIndex.First();
+                            int fferr = avformat_seek_file(m_avfmtCtx, m_vidStmIdx, INT64_MIN, seekTs, seekTs, 0);
+                            if (fferr < 0)
+                            {
+                                cerr << "avformat_seek_file() FAILED for keyframe " << seekTs << "! fferr = " << fferr << "!" << endl;
+                                fatalError = true;
+                                break;
+                            }
                         }
-                        if (!ReadNextStreamPacket(m_vidStmIdx, &avpkt, &avpktLoaded, &seekPos0))
+                        else
                         {
-                            fatalError = true;
-                            break;
+                            int fferr = avformat_seek_file(m_avfmtCtx, m_vidStmIdx, vidSeekPos+1, vidSeekPos+1, INT64_MAX, 0);
+                            if (fferr < 0)
+                            {
+                                cerr << "avformat_seek_file() FAILED for finding 'seekPos1'! fferr = " << fferr << "!" << endl;
+                                fatalError = true;
+                                break;
+                            }
+                            if (!ReadNextStreamPacket(m_vidStmIdx, &avpkt, &avpktLoaded, &seekPos1))
+                            {
+                                fatalError = true;
+                                break;
+                            }
+                            if (avpktLoaded)
+                                av_packet_unref(&avpkt);
+                            fferr = avformat_seek_file(m_avfmtCtx, m_vidStmIdx, INT64_MIN, vidSeekPos, vidSeekPos, 0);
+                            if (fferr < 0)
+                            {
+                                cerr << "avformat_seek_file() FAILED for finding 'seekPos0'! fferr = " << fferr << "!" << endl;
+                                fatalError = true;
+                                break;
+                            }
+                            if (!ReadNextStreamPacket(m_vidStmIdx, &avpkt, &avpktLoaded, &seekPos0))
+                            {
+                                fatalError = true;
+                                break;
+                            }
                         }
 
                         // for debug info
@@ -1344,6 +1506,7 @@ private:
                     av_packet_unref(&avpkt);
                     avpktLoaded = false;
                     idleLoop = false;
+                    m_viddecEvent.Notify();
                 }
             }
             else
@@ -1368,6 +1531,7 @@ private:
                         av_packet_unref(&avpkt);
                         avpktLoaded = false;
                         idleLoop = false;
+                        stream->m_auddecEvent.Notify();
                     }
                 }
                 else
@@ -1378,9 +1542,10 @@ private:
             }
 
             if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(5));
+                m_demuxEvent.WaitFor(STAGE_IDLE_WAIT_MS);
         }
         m_demuxEof = true;
+        NotifyDemuxEof();
         if (avpktLoaded)
             av_packet_unref(&avpkt);
         cout << "Leave DemuxAsyncSeekThreadProc()." << endl;
@@ -1483,11 +1648,18 @@ private:
                     lock_guard<mutex> lk(m_vidfrmQLock);
                     if (m_vidfrmQ.size() < m_vidfrmQMaxSize)
                     {
-                        AVFrame* enqfrm = av_frame_clone(&avfrm);
+                        AVFrame* enqfrm = av_frame_alloc();
+                        if (!enqfrm)
+                        {
+                            m_errMessage = "FAILED to allocate new AVFrame for video frame queue!";
+                            quitLoop = true;
+                            break;
+                        }
+                        av_frame_move_ref(enqfrm, &avfrm);
                         m_vidfrmQ.push_back(enqfrm);
-                        av_frame_unref(&avfrm);
                         avfrmLoaded = false;
                         idleLoop = false;
+                        m_renderEvent.Notify();
                     }
                     else
                         break;
@@ -1505,10 +1677,13 @@ private:
                     int fferr = avcodec_send_packet(m_viddecCtx, avpkt);
                     if (fferr == 0)
                     {
-                        lock_guard<mutex> lk(m_vidpktQLock);
-                        m_vidpktQ.pop_front();
+                        {
+                            lock_guard<mutex> lk(m_vidpktQLock);
+                            m_vidpktQ.pop_front();
+                        }
                         av_packet_free(&avpkt);
                         idleLoop = false;
+                        m_demuxEvent.Notify();
                     }
                     else
                     {
@@ -1535,9 +1710,10 @@ private:
             }
 
             if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(5));
+                m_viddecEvent.WaitFor(STAGE_IDLE_WAIT_MS);
         }
         m_viddecEof = true;
+        m_renderEvent.Notify();
         if (avfrmLoaded)
             av_frame_unref(&avfrm);
         cout << "Leave VideoDecodeThreadProc()." << endl;
@@ -1612,11 +1788,18 @@ private:
                     lock_guard<mutex> lk(stream->m_audfrmQLock);
                     if (stream->m_audfrmQ.size() < stream->m_audfrmQMaxSize)
                     {
-                        AVFrame* enqfrm = av_frame_clone(&avfrm);
+                        AVFrame* enqfrm = av_frame_alloc();
+                        if (!enqfrm)
+                        {
+                            m_errMessage = "FAILED to allocate new AVFrame for audio frame queue!";
+                            quitLoop = true;
+                            break;
+                        }
+                        av_frame_move_ref(enqfrm, &avfrm);
                         stream->m_audfrmQ.push_back(enqfrm);
-                        av_frame_unref(&avfrm);
                         avfrmLoaded = false;
                         idleLoop = false;
+                        stream->m_swrEvent.Notify();
                     }
                     else
                         break;
@@ -1634,10 +1817,13 @@ private:
                     int fferr = avcodec_send_packet(stream->m_dec_ctx, avpkt);
                     if (fferr == 0)
                     {
-                        lock_guard<mutex> lk(stream->m_audpktQLock);
-                        stream->m_audpktQ.pop_front();
+                        {
+                            lock_guard<mutex> lk(stream->m_audpktQLock);
+                            stream->m_audpktQ.pop_front();
+                        }
                         av_packet_free(&avpkt);
                         idleLoop = false;
+                        m_demuxEvent.Notify();
                     }
                     else
                     {
@@ -1649,10 +1835,13 @@ private:
                                 quitLoop = true;
                             else
                             {
-                                lock_guard<mutex> lk(stream->m_audpktQLock);
-                                stream->m_audpktQ.pop_front();
+                                {
+                                    lock_guard<mutex> lk(stream->m_audpktQLock);
+                                    stream->m_audpktQ.pop_front();
+                                }
                                 av_packet_free(&avpkt);
                                 idleLoop = false;
+                                m_demuxEvent.Notify();
                             }
                         }
                         break;
@@ -1670,9 +1859,10 @@ private:
             }
 
             if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(5));
+                stream->m_auddecEvent.WaitFor(STAGE_IDLE_WAIT_MS);
         }
         stream->m_auddecEof = true;
+        stream->m_swrEvent.Notify();
         if (avfrmLoaded)
             av_frame_unref(&avfrm);
         cout << "Leave AudioDecodeThreadProc()." << endl;
@@ -1701,14 +1891,13 @@ private:
                             dstDBfrm->sample_rate = stream->m_stream->codecpar->sample_rate;
                             dstDBfrm->ch_layout = stream->m_stream->codecpar->ch_layout;
                             dstDBfrm->nb_samples = swr_get_out_samples(stream->m_swrDBCtx, srcfrm->nb_samples);
-                            int fferr = av_frame_get_buffer(dstDBfrm, 0);
-                            if (fferr >= 0)
+                            if (stream->m_swrDBBufPool.GetBuffer(dstDBfrm))
                             {
                                 av_frame_copy_props(dstDBfrm, srcfrm);
                                 dstDBfrm->pts = swr_next_pts(stream->m_swrDBCtx, srcfrm->pts);
                                 int64_t mts = av_rescale_q(dstDBfrm->pts, stream->m_stream->time_base, MILLISEC_TIMEBASE);
                                 mts -= m_audioStart == -1 ? 0 : m_audioStart;
-                                fferr = swr_convert(stream->m_swrDBCtx, dstDBfrm->data, dstDBfrm->nb_samples, (const uint8_t **)srcfrm->data, srcfrm->nb_samples);
+                                int fferr = swr_convert(stream->m_swrDBCtx, dstDBfrm->data, dstDBfrm->nb_samples, (const uint8_t **)srcfrm->data, srcfrm->nb_samples);
                                 if (fferr >= 0 && dstDBfrm->nb_samples >= 64)
                                 {
                                     for (int c = 0; c < dstDBfrm->ch_layout.nb_channels; c++)
@@ -1734,9 +1923,9 @@ private:
                                             }
                                         }
                                     }
-                                    av_frame_free(&dstDBfrm);
                                 }
                             }
+                            av_frame_free(&dstDBfrm);
                         }
                     }
 
@@ -1756,15 +1945,15 @@ private:
                         dstfrm->sample_rate = stream->m_swrOutSampleRate;
                         dstfrm->ch_layout = stream->m_swrOutChnLyt;
                         dstfrm->nb_samples = swr_get_out_samples(stream->m_swrCtx, srcfrm->nb_samples);
-                        int fferr = av_frame_get_buffer(dstfrm, 0);
-                        if (fferr < 0)
+                        if (!stream->m_swrBufPool.GetBuffer(dstfrm))
                         {
-                            SetFFError("av_frame_get_buffer(SwrThreadProc)", fferr);
+                            av_frame_free(&dstfrm);
+                            m_errMessage = "FAILED to get a pooled buffer for 'swr_convert()'!";
                             break;
                         }
                         av_frame_copy_props(dstfrm, srcfrm);
                         dstfrm->pts = swr_next_pts(stream->m_swrCtx, srcfrm->pts);
-                        fferr = swr_convert(stream->m_swrCtx, dstfrm->data, dstfrm->nb_samples, (const uint8_t **)srcfrm->data, srcfrm->nb_samples);
+                        int fferr = swr_convert(stream->m_swrCtx, dstfrm->data, dstfrm->nb_samples, (const uint8_t **)srcfrm->data, srcfrm->nb_samples);
                         if (fferr < 0)
                         {
                             SetFFError("swr_convert(SwrThreadProc)", fferr);
@@ -1782,15 +1971,18 @@ private:
                     if (srcfrm != dstfrm)
                         av_frame_free(&srcfrm);
                     idleLoop = false;
+                    stream->m_auddecEvent.Notify();
+                    m_audReadEvent.Notify();
                 }
             }
             else if (stream->m_auddecEof)
                 break;
 
             if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(5));
+                stream->m_swrEvent.WaitFor(STAGE_IDLE_WAIT_MS);
         }
         stream->m_swrEof = true;
+        m_audReadEvent.Notify();
     }
 
     void RenderThreadProc()
@@ -1799,11 +1991,12 @@ private:
         {
             if (!m_isPlaying)
             {
-                this_thread::sleep_for(chrono::milliseconds(5));
+                m_renderEvent.WaitFor(STAGE_IDLE_WAIT_MS);
                 continue;
             }
 
             bool vidIdleRun = true;
+            int64_t idleWaitMs = STAGE_IDLE_WAIT_MS;
             // Audio
             if (HasAudio())
             {
@@ -1852,6 +2045,7 @@ private:
                         lock_guard<mutex> lk(m_vidfrmQLock);
                         m_vidfrmQ.pop_front();
                     }
+                    m_viddecEvent.Notify();
                     {
                         lock_guard<mutex> lk(m_vidMatLock);
                         m_frmCvt.ConvertImage(vidfrm, m_vidMat, (double)mts/1000);
@@ -1859,10 +2053,15 @@ private:
                     av_frame_free(&vidfrm);
                     vidIdleRun = false;
                 }
+                else
+                {
+                    // sleep until the frame is due, audio clock updates wake us earlier
+                    idleWaitMs = min(mts-m_playPos, STAGE_IDLE_WAIT_MS);
+                }
             }
 
             if (vidIdleRun)
-                this_thread::sleep_for(chrono::milliseconds(1));
+                m_renderEvent.WaitFor(idleWaitMs);
         }
         m_renderEof = true;
     }
@@ -1870,11 +2069,7 @@ private:
     void RenderThreadProc_SeekAsync()
     {
         cout << "Enter RenderThreadProc_SeekAsync()." << endl;
-        const int MAX_CACHE_SIZE = 64;
-        const int CACHE_SHRINK_SIZE = 48;
-        const double MIN_CACHE_FRAME_INTERVAL = 0.5;
-        list<ImGui::ImMat> vidMatCache;
-        list<ImGui::ImMat>::iterator cacheIter = vidMatCache.begin();
+        const int64_t MIN_CACHE_FRAME_INTERVAL = 500;
         int64_t prevSeekPos = INT64_MIN;
         while (!m_quitPlay)
         {
@@ -1882,7 +2077,6 @@ private:
             int64_t currSeekPos = m_asyncSeekPos;
 
             bool cacheUpdated = false;
-            double prevCachedTimestamp = numeric_limits<double>::min();
             while (!m_vidfrmQ.empty())
             {
                 AVFrame* vidfrm = m_vidfrmQ.front();
@@ -1890,122 +2084,29 @@ private:
                     lock_guard<mutex> lk(m_vidfrmQLock);
                     m_vidfrmQ.pop_front();
                 }
-                double timestamp = vidfrm->pts*av_q2d(m_vidStream->time_base);
-
-                double checkedTimestamp = prevCachedTimestamp;
-                bool skipThisFrame = abs(timestamp-prevCachedTimestamp) < MIN_CACHE_FRAME_INTERVAL;
-                if (!skipThisFrame)
-                {
-                    auto findIter = find_if(vidMatCache.begin(), vidMatCache.end(),
-                        [timestamp, MIN_CACHE_FRAME_INTERVAL](const ImGui::ImMat& m) { return abs(m.time_stamp-timestamp) < MIN_CACHE_FRAME_INTERVAL; });
-                    if (findIter != vidMatCache.end())
-                    {
-                        checkedTimestamp = findIter->time_stamp;
-                        skipThisFrame = true;
-                    }
-                }
-
-                if (!skipThisFrame)
-                {
-                    ImGui::ImMat vidMat;
-                    m_frmCvt.ConvertImage(vidfrm, vidMat, timestamp);
-                    vidMatCache.push_back(vidMat);
-                    prevCachedTimestamp = timestamp;
+                m_viddecEvent.Notify();
+                // cached under the play position, the seek positions start from 0 too
+                int64_t mts = VidPtsToMillisec(vidfrm->pts);
+                if (!m_scrubCache.Has(mts, MIN_CACHE_FRAME_INTERVAL) &&
+                    m_scrubCache.Add(vidfrm, mts, currSeekPos != INT64_MIN ? currSeekPos : mts))
                     cacheUpdated = true;
-                    // cout << "------> Add one cache frame, timestamp = " << MillisecToString((int64_t)(timestamp*1000)) << endl;
-
-                    // shrink the cache if the cache size exceeds the limit
-                    if (vidMatCache.size() > MAX_CACHE_SIZE)
-                    {
-                        double vidSeekTimestamp = (double)currSeekPos/1000;
-                        auto iter0 = vidMatCache.begin();
-                        auto iter1 = vidMatCache.end();
-                        iter1--;
-                        while (vidMatCache.size() > CACHE_SHRINK_SIZE)
-                        {
-                            if (abs(iter0->time_stamp-vidSeekTimestamp) > abs(iter1->time_stamp-vidSeekTimestamp))
-                            {
-                                iter0++;
-                                vidMatCache.pop_front();
-                            }
-                            else
-                            {
-                                iter1--;
-                                vidMatCache.pop_back();
-                            }
-                        }
-                    }
-                }
-                // else
-                //     cout << "skipThisFrame, timestamp = " << MillisecToString((int64_t)(timestamp*1000))
-                //         << ", checkedTimestamp = " << MillisecToString((int64_t)(checkedTimestamp*1000))
-                //         << ", diff = " << abs(checkedTimestamp-timestamp) << endl;
                 av_frame_free(&vidfrm);
             }
-            if (cacheUpdated)
-            {
-                // cout << "vidMatCache updated." << endl;
-                vidMatCache.sort([](const ImGui::ImMat& a, const ImGui::ImMat& b) { return a.time_stamp < b.time_stamp; });
-                cacheIter = vidMatCache.begin();
-            }
-            // else
-            //     cout << "No video frame updated." << " currSeekPos=" << MillisecToString(currSeekPos)
-            //         << ", prevSeekPos=" << MillisecToString(prevSeekPos) << endl;
 
             if (currSeekPos != INT64_MIN && (currSeekPos != prevSeekPos || cacheUpdated))
             {
-                // cout << "To find frame update m_vidMat" << endl;
-                double vidSeekTimestamp = (double)currSeekPos/1000;
-                bool farword = true;
-                if (cacheIter != vidMatCache.begin())
-                {
-                    auto temp = cacheIter--;
-                    if (abs(cacheIter->time_stamp-vidSeekTimestamp) < abs(temp->time_stamp-vidSeekTimestamp))
-                        farword = false;
-                    else
-                        cacheIter = temp;
-                }
-                if (farword)
-                {
-                    while (cacheIter != vidMatCache.end())
-                    {
-                        auto temp = cacheIter++;
-                        if (cacheIter == vidMatCache.end() ||
-                            abs(temp->time_stamp-vidSeekTimestamp) < abs(cacheIter->time_stamp-vidSeekTimestamp))
-                        {
-                            cacheIter = temp;
-                            break;
-                        }
-                    }
-                }
-                else
+                ImGui::ImMat vidMat;
+                if (m_scrubCache.Find(currSeekPos, vidMat))
                 {
-                    while (cacheIter != vidMatCache.begin())
-                    {
-                        auto temp = cacheIter--;
-                        if (abs(temp->time_stamp-vidSeekTimestamp) < abs(cacheIter->time_stamp-vidSeekTimestamp))
-                        {
-                            cacheIter = temp;
-                            break;
-                        }
-                    }
-                }
-                if (cacheIter != vidMatCache.end())
-                {
-                    // int64_t vidfrmMts = (int64_t)(cacheIter->time_stamp*1000);
-                    // cout << "Found closest frame to seek point " << MillisecToString(currSeekPos) << ", is " << MillisecToString(vidfrmMts)
-                    //     << ", the difference is " << (vidfrmMts-currSeekPos) << "ms." << endl;
                     lock_guard<mutex> lk(m_vidMatLock);
-                    m_vidMat = *cacheIter;
+                    m_vidMat = vidMat;
                 }
-                // else
-                //     cout << "cacheIter is at list.end()" << endl;
                 prevSeekPos = currSeekPos;
                 idleLoop = false;
             }
 
             if (idleLoop)
-                this_thread::sleep_for(chrono::milliseconds(1));
+                m_renderEvent.WaitFor(STAGE_IDLE_WAIT_MS);
         }
         cout << "Leave RenderThreadProc_SeekAsync()." << endl;
     }
@@ -2044,9 +2145,25 @@ private:
         m_renderThread = thread(&MediaPlayer_FFImpl::RenderThreadProc_SeekAsync, this);
     }
 
+    void NotifyDemuxEof()
+    {
+        m_viddecEvent.Notify();
+        for (auto stream : m_audio_streams)
+            stream->m_auddecEvent.Notify();
+    }
+
     void WaitAllThreadsQuit()
     {
         m_quitPlay = true;
+        m_demuxEvent.Notify();
+        m_viddecEvent.Notify();
+        m_renderEvent.Notify();
+        m_audReadEvent.Notify();
+        for (auto stream : m_audio_streams)
+        {
+            stream->m_auddecEvent.Notify();
+            stream->m_swrEvent.Notify();
+        }
         if (m_demuxThread.joinable())
         {
             m_demuxThread.join();
@@ -2163,8 +2280,11 @@ private:
                     else
                     {
                         audfrm = stream->m_swrfrmQ.front();
-                        lock_guard<mutex> lk(stream->m_swrfrmQLock);
-                        stream->m_swrfrmQ.pop_front();
+                        {
+                            lock_guard<mutex> lk(stream->m_swrfrmQLock);
+                            stream->m_swrfrmQ.pop_front();
+                        }
+                        stream->m_swrEvent.Notify();
                     }
 
                     if (audfrm != nullptr)
@@ -2213,10 +2333,13 @@ private:
                 if (need_break)
                     break;
                 if (idleLoop)
-                    this_thread::sleep_for(chrono::milliseconds(5));
+                    m_outterThis->m_audReadEvent.WaitFor(STAGE_IDLE_WAIT_MS);
             }
             if (tsUpdate)
+            {
                 m_outterThis->m_audioMts = audMts - (m_outterThis->m_audioStart == -1 ? 0 : m_outterThis->m_audioStart);
+                m_outterThis->m_renderEvent.Notify();
+            }
             return loadSize;
         }
 
@@ -2275,6 +2398,7 @@ private:
     int m_vidpktQMaxSize{0};
     list<AVPacket*> m_vidpktQ;
     mutex m_vidpktQLock;
+    StageEvent m_demuxEvent;
     
     bool m_demuxEof{false};
     // video decoding thread
@@ -2282,11 +2406,15 @@ private:
     int m_vidfrmQMaxSize{4};
     list<AVFrame*> m_vidfrmQ;
     mutex m_vidfrmQLock;
+    StageEvent m_viddecEvent;
     bool m_viddecEof{false};
 
     // rendering thread
     thread m_renderThread;
+    StageEvent m_renderEvent;
     bool m_renderEof{false};
+    // audio render pulling pcm from the swr queues
+    StageEvent m_audReadEvent;
 
     recursive_mutex m_ctlLock;
     bool m_quitPlay{false};
@@ -2314,6 +2442,13 @@ private:
     std::vector<media_stream*> m_audio_streams;
     int m_render_audio_index {-1};
     AVFrameToImMatConverter m_frmCvt;
+    KeyFrameIndex m_kfIndex;
+    ScrubCache m_scrubCache;
+    uint32_t m_scrubPreviewWidth{640};
+    uint32_t m_scrubMemoryMB{256};
+    uint32_t m_scrubDiskMB{0};
+    uint32_t m_previewScale{1};
+    bool m_fullResolution{false};
 };
 
 constexpr MediaPlayer_FFImpl::TimePoint MediaPlayer_FFImpl::CLOCK_MIN = MediaPlayer_FFImpl::Clock::time_point::min();
@@ -33,6 +33,13 @@ struct MediaPlayer
     virtual float GetPlaySpeed() const = 0;
     virtual bool SetPlaySpeed(float speed) = 0;
     virtual bool SetPreferHwDecoder(bool prefer) = 0;
+    // output 1/scale (1, 2, 4 or 8) of the source size, applied on the next Open()
+    virtual bool SetPreviewScale(uint32_t scale) = 0;
+    // ignore the preview scale and output source size, e.g. for export
+    virtual bool SetFullResolution(bool full) = 0;
+    // frames kept while seeking async, applied on the next Open(). previewWidth 0
+    // keeps the source size, diskMB 0 disables spilling to the temp directory
+    virtual bool SetScrubCacheOptions(uint32_t previewWidth, uint32_t memoryMB, uint32_t diskMB) = 0;
     virtual uint64_t GetDuration() const = 0;
     virtual int64_t GetPlayPos() const = 0; 
     virtual void GetVideo(ImGui::ImMat& out) = 0;
@@ -50,6 +57,8 @@ struct MediaPlayer
     virtual int GetRenderingAudioIndex() const = 0;
     virtual void SetRenderingAudioIndex(int index) = 0;
     virtual bool SetPlayMode(int mode) = 0;
+    // frame buffers served from the player's pools vs. freshly allocated
+    virtual void GetBufferPoolStats(uint64_t& hits, uint64_t& misses) = 0;
 
     virtual std::string GetError() const = 0;
 };
@@ -0,0 +1,300 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include "ScrubCache.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+static size_t MatSize(const ImGui::ImMat& mat)
+{
+    return (size_t)mat.w * mat.h * mat.c * mat.elemsize;
+}
+
+// entry with the key closest to 'key', end() if the map is empty
+template<typename T>
+static typename map<int64_t, T>::const_iterator FindNearest(const map<int64_t, T>& m, int64_t key)
+{
+    auto iter = m.lower_bound(key);
+    if (iter == m.end())
+        return m.empty() ? m.end() : prev(iter);
+    if (iter != m.begin())
+    {
+        auto prevIter = prev(iter);
+        if (key - prevIter->first <= iter->first - key)
+            return prevIter;
+    }
+    return iter;
+}
+
+ScrubCache::~ScrubCache()
+{
+    Close();
+}
+
+void ScrubCache::Open(const string& url, uint32_t previewWidth, uint32_t memoryMB, uint32_t diskMB)
+{
+    Close();
+    m_previewWidth = previewWidth;
+    m_memBudget = (size_t)memoryMB << 20;
+    m_diskBudget = (size_t)diskMB << 20;
+    if (m_diskBudget == 0)
+        return;
+
+    // only local files can be validated, same as KeyFrameIndex
+    error_code ec;
+    if (url.find("://") != string::npos || !fs::is_regular_file(url, ec))
+        return;
+    uint64_t fileSize = (uint64_t)fs::file_size(url, ec);
+    int64_t fileTime = (int64_t)fs::last_write_time(url, ec).time_since_epoch().count();
+    auto tempDir = fs::temp_directory_path(ec);
+    if (ec)
+        return;
+    size_t key = hash<string>()(url + "|" + to_string(fileSize) + "|" + to_string(fileTime));
+    fs::path diskDir = tempDir / (to_string(key) + "_" + to_string(previewWidth) + ".scrub");
+    if (!fs::create_directories(diskDir, ec) && ec)
+    {
+        cerr << "FAILED to create scrub cache directory '" << diskDir.string() << "'!" << endl;
+        return;
+    }
+    m_diskDir = diskDir.string();
+    for (auto& entry : fs::directory_iterator(diskDir, ec))
+    {
+        if (!entry.is_regular_file(ec) || entry.path().extension() != ".png")
+            continue;
+        char* end = nullptr;
+        string stem = entry.path().stem().string();
+        int64_t timestamp = strtoll(stem.c_str(), &end, 10);
+        if (end == stem.c_str() || *end != '\0')
+            continue;
+        size_t size = (size_t)entry.file_size(ec);
+        m_diskFrames[timestamp] = size;
+        m_diskSize += size;
+    }
+}
+
+void ScrubCache::Close()
+{
+    m_frames.clear();
+    m_memSize = 0;
+    m_diskFrames.clear();
+    m_diskSize = 0;
+    m_diskDir.clear();
+    m_cvtReady = false;
+    if (m_pngEncCtx)
+        avcodec_free_context(&m_pngEncCtx);
+    if (m_pngDecCtx)
+        avcodec_free_context(&m_pngDecCtx);
+}
+
+bool ScrubCache::Has(int64_t timestamp, int64_t interval) const
+{
+    auto iter = FindNearest(m_frames, timestamp);
+    if (iter != m_frames.end() && abs(iter->first - timestamp) < interval)
+        return true;
+    auto diskIter = FindNearest(m_diskFrames, timestamp);
+    return diskIter != m_diskFrames.end() && abs(diskIter->first - timestamp) < interval;
+}
+
+bool ScrubCache::Add(const AVFrame* avfrm, int64_t timestamp, int64_t focus)
+{
+    if (!m_cvtReady)
+    {
+        // previews are small enough for swscale, and stay on cpu for the disk tier
+        m_frmCvt.SetUseVulkanConverter(false);
+        m_frmCvt.SetResizeInterpolateMode(IM_INTERPOLATE_BILINEAR);
+        if (m_previewWidth > 0 && m_previewWidth < (uint32_t)avfrm->width)
+        {
+            AVRational sar = avfrm->sample_aspect_ratio.num > 0 ? avfrm->sample_aspect_ratio : AVRational{1, 1};
+            double aspect = (double)avfrm->width * sar.num / ((double)avfrm->height * sar.den);
+            uint32_t height = (uint32_t)(m_previewWidth / aspect + 0.5);
+            m_frmCvt.SetOutSize(m_previewWidth, max(2u, (height + 1) & ~1u));
+        }
+        m_cvtReady = true;
+    }
+    ImGui::ImMat frame;
+    if (!m_frmCvt.ConvertImage(avfrm, frame, (double)timestamp / 1000))
+    {
+        cerr << "Scrub cache FAILED to convert frame: " << m_frmCvt.GetError() << endl;
+        return false;
+    }
+    auto iter = m_frames.find(timestamp);
+    if (iter != m_frames.end())
+        m_memSize -= MatSize(iter->second);
+    m_frames[timestamp] = frame;
+    m_memSize += MatSize(frame);
+    Shrink(focus);
+    return true;
+}
+
+bool ScrubCache::Find(int64_t timestamp, ImGui::ImMat& frame)
+{
+    auto iter = FindNearest(m_frames, timestamp);
+    auto diskIter = FindNearest(m_diskFrames, timestamp);
+    if (diskIter != m_diskFrames.end() && m_frames.find(diskIter->first) == m_frames.end() &&
+        (iter == m_frames.end() || abs(diskIter->first - timestamp) < abs(iter->first - timestamp)))
+    {
+        ImGui::ImMat loaded;
+        int64_t loadedTs = diskIter->first;
+        if (LoadFrame(loadedTs, loaded))
+        {
+            m_frames[loadedTs] = loaded;
+            m_memSize += MatSize(loaded);
+            Shrink(timestamp);
+            frame = loaded;
+            return true;
+        }
+    }
+    if (iter == m_frames.end())
+        return false;
+    frame = iter->second;
+    return true;
+}
+
+void ScrubCache::Shrink(int64_t focus)
+{
+    // drop from the end that is farther from the seek position
+    while (m_memSize > m_memBudget && m_frames.size() > 1)
+    {
+        auto iter = m_frames.begin();
+        auto last = prev(m_frames.end());
+        if (abs(last->first - focus) > abs(iter->first - focus))
+            iter = last;
+        if (!m_diskDir.empty() && m_diskFrames.find(iter->first) == m_diskFrames.end())
+            SaveFrame(iter->first, iter->second);
+        m_memSize -= MatSize(iter->second);
+        m_frames.erase(iter);
+    }
+    ShrinkDisk(focus);
+}
+
+void ScrubCache::ShrinkDisk(int64_t focus)
+{
+    error_code ec;
+    while (m_diskSize > m_diskBudget && !m_diskFrames.empty())
+    {
+        auto iter = m_diskFrames.begin();
+        auto last = prev(m_diskFrames.end());
+        if (abs(last->first - focus) > abs(iter->first - focus))
+            iter = last;
+        fs::remove(FramePath(iter->first), ec);
+        m_diskSize -= iter->second;
+        m_diskFrames.erase(iter);
+    }
+}
+
+string ScrubCache::FramePath(int64_t timestamp) const
+{
+    return (fs::path(m_diskDir) / (to_string(timestamp) + ".png")).string();
+}
+
+bool ScrubCache::SaveFrame(int64_t timestamp, const ImGui::ImMat& frame)
+{
+    if (frame.type != IM_DT_INT8 || frame.c != 4 || !frame.data)
+        return false;
+    if (m_pngEncCtx && (m_pngEncCtx->width != frame.w || m_pngEncCtx->height != frame.h))
+        avcodec_free_context(&m_pngEncCtx);
+    if (!m_pngEncCtx)
+    {
+        const AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_PNG);
+        if (!codec || !(m_pngEncCtx = avcodec_alloc_context3(codec)))
+            return false;
+        m_pngEncCtx->width = frame.w;
+        m_pngEncCtx->height = frame.h;
+        m_pngEncCtx->pix_fmt = AV_PIX_FMT_RGBA;
+        m_pngEncCtx->time_base = { 1, 1000 };
+        // lossless, and fast zlib level since it runs on the render thread
+        m_pngEncCtx->compression_level = 1;
+        if (avcodec_open2(m_pngEncCtx, codec, nullptr) < 0)
+        {
+            cerr << "FAILED to open png encoder for scrub cache!" << endl;
+            avcodec_free_context(&m_pngEncCtx);
+            m_diskDir.clear();
+            return false;
+        }
+    }
+
+    AVFrame* avfrm = av_frame_alloc();
+    avfrm->format = AV_PIX_FMT_RGBA;
+    avfrm->width = frame.w;
+    avfrm->height = frame.h;
+    avfrm->data[0] = (uint8_t*)frame.data;
+    avfrm->linesize[0] = frame.w * 4;
+    avfrm->pts = timestamp;
+    AVPacket* avpkt = av_packet_alloc();
+    bool saved = false;
+    if (avcodec_send_frame(m_pngEncCtx, avfrm) >= 0 && avcodec_receive_packet(m_pngEncCtx, avpkt) >= 0)
+    {
+        string path = FramePath(timestamp);
+        FILE* fp = fopen(path.c_str(), "wb");
+        if (fp)
+        {
+            saved = fwrite(avpkt->data, 1, avpkt->size, fp) == (size_t)avpkt->size;
+            fclose(fp);
+            if (saved)
+            {
+                m_diskFrames[timestamp] = avpkt->size;
+                m_diskSize += avpkt->size;
+            }
+            else
+                remove(path.c_str());
+        }
+    }
+    av_packet_free(&avpkt);
+    av_frame_free(&avfrm);
+    return saved;
+}
+
+bool ScrubCache::LoadFrame(int64_t timestamp, ImGui::ImMat& frame)
+{
+    string path = FramePath(timestamp);
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp)
+        return false;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    AVPacket* avpkt = av_packet_alloc();
+    bool readOk = size > 0 && av_new_packet(avpkt, (int)size) >= 0 && fread(avpkt->data, 1, size, fp) == (size_t)size;
+    fclose(fp);
+    if (readOk && !m_pngDecCtx)
+    {
+        const AVCodec* codec = avcodec_find_decoder(AV_CODEC_ID_PNG);
+        if (codec && (m_pngDecCtx = avcodec_alloc_context3(codec)) && avcodec_open2(m_pngDecCtx, codec, nullptr) < 0)
+            avcodec_free_context(&m_pngDecCtx);
+        readOk = m_pngDecCtx != nullptr;
+    }
+
+    bool loaded = false;
+    AVFrame* avfrm = av_frame_alloc();
+    if (readOk && avcodec_send_packet(m_pngDecCtx, avpkt) >= 0 && avcodec_receive_frame(m_pngDecCtx, avfrm) >= 0 &&
+        avfrm->format == AV_PIX_FMT_RGBA)
+    {
+        frame.create_type(avfrm->width, avfrm->height, 4, IM_DT_INT8);
+        for (int i = 0; i < avfrm->height; i++)
+            memcpy((uint8_t*)frame.data + (size_t)i * avfrm->width * 4, avfrm->data[0] + (size_t)i * avfrm->linesize[0], avfrm->width * 4);
+        frame.color_format = IM_CF_RGBA;
+        frame.time_stamp = (double)timestamp / 1000;
+        loaded = true;
+    }
+    av_frame_free(&avfrm);
+    av_packet_free(&avpkt);
+    if (!loaded)
+    {
+        // unreadable file, forget it
+        error_code ec;
+        fs::remove(path, ec);
+        auto iter = m_diskFrames.find(timestamp);
+        if (iter != m_diskFrames.end())
+        {
+            m_diskSize -= iter->second;
+            m_diskFrames.erase(iter);
+        }
+    }
+    return loaded;
+}
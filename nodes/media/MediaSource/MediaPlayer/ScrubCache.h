@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <immat.h>
+#include "FFUtils.h"
+
+// Frames decoded while scrubbing (MediaPlayer::SeekAsync), keyed by timestamp
+// in millisecond. Frames are scaled to a preview width and kept in memory up
+// to a budget in MB; when the budget is exceeded the frames farthest from the
+// seek position are dropped, or spilled as PNG into
+// '<temp>/<hash>_<w>.scrub/' if a disk budget is set. The disk tier is keyed
+// by file path, size and modification time like KeyFrameIndex, so scrubbing a
+// reopened clip starts with the frames of the previous session.
+// Not thread safe, only the render thread uses it while seeking.
+class ScrubCache
+{
+public:
+    ScrubCache() = default;
+    ~ScrubCache();
+
+    ScrubCache(const ScrubCache&) = delete;
+    ScrubCache& operator=(const ScrubCache&) = delete;
+
+    // previewWidth 0 keeps the source size, diskMB 0 disables the disk tier
+    void Open(const std::string& url, uint32_t previewWidth, uint32_t memoryMB, uint32_t diskMB);
+    void Close();
+
+    // true if a frame within 'interval' of 'timestamp' is in either tier
+    bool Has(int64_t timestamp, int64_t interval) const;
+    // converts and stores 'avfrm', 'focus' is the current seek position
+    bool Add(const AVFrame* avfrm, int64_t timestamp, int64_t focus);
+    // frame nearest to 'timestamp', loaded back from disk if that one is closer
+    bool Find(int64_t timestamp, ImGui::ImMat& frame);
+
+    size_t MemorySize() const { return m_memSize; }
+    size_t MemoryFrames() const { return m_frames.size(); }
+    size_t DiskFrames() const { return m_diskFrames.size(); }
+
+private:
+    void Shrink(int64_t focus);
+    void ShrinkDisk(int64_t focus);
+    bool SaveFrame(int64_t timestamp, const ImGui::ImMat& frame);
+    bool LoadFrame(int64_t timestamp, ImGui::ImMat& frame);
+    std::string FramePath(int64_t timestamp) const;
+
+private:
+    uint32_t m_previewWidth {0};
+    size_t m_memBudget {0};
+    size_t m_diskBudget {0};
+    std::map<int64_t, ImGui::ImMat> m_frames;
+    size_t m_memSize {0};
+    // timestamp -> file size of the frames in the disk tier
+    std::map<int64_t, size_t> m_diskFrames;
+    size_t m_diskSize {0};
+    std::string m_diskDir;
+
+    AVFrameToImMatConverter m_frmCvt;
+    bool m_cvtReady {false};
+    AVCodecContext* m_pngEncCtx {nullptr};
+    AVCodecContext* m_pngDecCtx {nullptr};
+};
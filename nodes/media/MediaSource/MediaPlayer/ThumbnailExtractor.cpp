@@ -0,0 +1,381 @@
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include "ThumbnailExtractor.h"
+#include "FFUtils.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+#define THUMBNAIL_CACHE_MAGIC   0x424d4854 // "THMB"
+#define THUMBNAIL_CACHE_VERSION 1
+
+struct ThumbnailCacheHeader
+{
+    uint32_t magic      {THUMBNAIL_CACHE_MAGIC};
+    uint32_t version    {THUMBNAIL_CACHE_VERSION};
+    uint32_t width      {0};
+    uint32_t height     {0};
+};
+
+ThumbnailExtractor::~ThumbnailExtractor()
+{
+    Close();
+}
+
+bool ThumbnailExtractor::Open(const string& url, uint32_t width, uint32_t height, uint32_t workers, bool diskCache)
+{
+    Close();
+    if (width == 0)
+    {
+        m_errMsg = "Thumbnail width can NOT be 0!";
+        return false;
+    }
+    AVFormatContext* avfmtCtx = nullptr;
+    int fferr = avformat_open_input(&avfmtCtx, url.c_str(), nullptr, nullptr);
+    if (fferr < 0)
+    {
+        m_errMsg = "FAILED to open '" + url + "'!";
+        return false;
+    }
+    fferr = avformat_find_stream_info(avfmtCtx, nullptr);
+    if (fferr >= 0)
+        fferr = av_find_best_stream(avfmtCtx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (fferr < 0)
+    {
+        m_errMsg = "No video stream in '" + url + "'!";
+        avformat_close_input(&avfmtCtx);
+        return false;
+    }
+    m_streamIndex = fferr;
+    AVStream* stream = avfmtCtx->streams[m_streamIndex];
+    if (stream->duration != AV_NOPTS_VALUE)
+        m_duration = av_rescale_q(stream->duration, stream->time_base, MILLISEC_TIMEBASE);
+    else if (avfmtCtx->duration != AV_NOPTS_VALUE)
+        m_duration = av_rescale_q(avfmtCtx->duration, FF_AV_TIMEBASE, MILLISEC_TIMEBASE);
+    if (height == 0)
+    {
+        const AVCodecParameters* codecpar = stream->codecpar;
+        AVRational sar = codecpar->sample_aspect_ratio.num > 0 ? codecpar->sample_aspect_ratio : AVRational{1, 1};
+        double aspect = (double)codecpar->width * sar.num / ((double)codecpar->height * sar.den);
+        height = aspect > 0 ? (uint32_t)(width / aspect + 0.5) : width;
+        height = max(2u, (height + 1) & ~1u);
+    }
+    avformat_close_input(&avfmtCtx);
+    m_url = url;
+    m_width = width;
+    m_height = height;
+
+    // only local files can be cached and validated, same as KeyFrameIndex
+    error_code ec;
+    if (diskCache && url.find("://") == string::npos && fs::is_regular_file(url, ec))
+    {
+        uint64_t fileSize = (uint64_t)fs::file_size(url, ec);
+        int64_t fileTime = (int64_t)fs::last_write_time(url, ec).time_since_epoch().count();
+        auto tempDir = fs::temp_directory_path(ec);
+        if (!ec)
+        {
+            size_t key = hash<string>()(url + "|" + to_string(fileSize) + "|" + to_string(fileTime));
+            m_cachePath = (tempDir / (to_string(key) + "_" + to_string(m_width) + "x" + to_string(m_height) + ".thumbs")).string();
+            LoadCache();
+        }
+    }
+
+    if (workers == 0)
+        workers = max(1u, thread::hardware_concurrency());
+    m_quit = false;
+    m_failed = false;
+    m_alive = workers;
+    for (uint32_t i = 0; i < workers; i++)
+        m_workers.push_back(thread(&ThumbnailExtractor::WorkerThreadProc, this));
+    return true;
+}
+
+void ThumbnailExtractor::Close()
+{
+    {
+        lock_guard<mutex> lk(m_taskLock);
+        m_quit = true;
+        m_tasks.clear();
+    }
+    m_taskCv.notify_all();
+    for (auto& worker : m_workers)
+    {
+        if (worker.joinable())
+            worker.join();
+    }
+    m_workers.clear();
+    m_busy = 0;
+    m_alive = 0;
+    lock_guard<mutex> lk(m_thumbLock);
+    m_thumbnails.clear();
+    m_url.clear();
+    m_cachePath.clear();
+    m_streamIndex = -1;
+    m_duration = 0;
+}
+
+void ThumbnailExtractor::Request(const vector<int64_t>& timestamps)
+{
+    {
+        lock_guard<mutex> lk(m_taskLock);
+        lock_guard<mutex> lk2(m_thumbLock);
+        if (m_failed)
+            return;
+        for (auto timestamp : timestamps)
+        {
+            if (m_thumbnails.find(timestamp) != m_thumbnails.end() ||
+                find(m_tasks.begin(), m_tasks.end(), timestamp) != m_tasks.end())
+                continue;
+            m_tasks.push_back(timestamp);
+        }
+    }
+    m_taskCv.notify_all();
+}
+
+vector<int64_t> ThumbnailExtractor::RequestEvenly(uint32_t count)
+{
+    vector<int64_t> timestamps;
+    if (count == 0 || m_duration <= 0)
+        return timestamps;
+    // centre of each of 'count' equal spans
+    for (uint32_t i = 0; i < count; i++)
+        timestamps.push_back(m_duration * (2 * i + 1) / (2 * count));
+    Request(timestamps);
+    return timestamps;
+}
+
+bool ThumbnailExtractor::Get(int64_t timestamp, ImGui::ImMat& thumbnail) const
+{
+    lock_guard<mutex> lk(m_thumbLock);
+    auto iter = m_thumbnails.find(timestamp);
+    if (iter == m_thumbnails.end())
+        return false;
+    thumbnail = iter->second;
+    return true;
+}
+
+bool ThumbnailExtractor::IsDone() const
+{
+    lock_guard<mutex> lk(m_taskLock);
+    return m_tasks.empty() && m_busy == 0;
+}
+
+string ThumbnailExtractor::GetError() const
+{
+    lock_guard<mutex> lk(m_taskLock);
+    return m_errMsg;
+}
+
+size_t ThumbnailExtractor::Pending() const
+{
+    lock_guard<mutex> lk(m_taskLock);
+    return m_tasks.size() + m_busy;
+}
+
+void ThumbnailExtractor::WorkerThreadProc()
+{
+    AVFormatContext* avfmtCtx = nullptr;
+    AVCodecContext* decCtx = nullptr;
+    int fferr = avformat_open_input(&avfmtCtx, m_url.c_str(), nullptr, nullptr);
+    if (fferr >= 0)
+        fferr = avformat_find_stream_info(avfmtCtx, nullptr);
+    if (fferr >= 0 && m_streamIndex < (int)avfmtCtx->nb_streams)
+    {
+        // only the video packets are needed, let the demuxer skip the rest
+        for (int i = 0; i < (int)avfmtCtx->nb_streams; i++)
+        {
+            if (i != m_streamIndex)
+                avfmtCtx->streams[i]->discard = AVDISCARD_ALL;
+        }
+        AVStream* stream = avfmtCtx->streams[m_streamIndex];
+        AVCodecPtr decoder = avcodec_find_decoder(stream->codecpar->codec_id);
+        decCtx = decoder ? avcodec_alloc_context3(decoder) : nullptr;
+        if (decCtx && avcodec_parameters_to_context(decCtx, stream->codecpar) >= 0)
+        {
+            // the pool already runs one decoder per core, keyframes need no reordering
+            decCtx->thread_count = 1;
+            decCtx->skip_frame = AVDISCARD_NONKEY;
+            decCtx->pkt_timebase = stream->time_base;
+            if (avcodec_open2(decCtx, decoder, nullptr) < 0)
+                avcodec_free_context(&decCtx);
+        }
+        else if (decCtx)
+            avcodec_free_context(&decCtx);
+    }
+    if (!decCtx)
+    {
+        cerr << "ThumbnailExtractor FAILED to open decoder for '" << m_url << "'!" << endl;
+        if (avfmtCtx)
+            avformat_close_input(&avfmtCtx);
+        {
+            // with no worker left nothing would ever take the pending tasks
+            lock_guard<mutex> lk(m_taskLock);
+            if (--m_alive == 0)
+            {
+                m_errMsg = "FAILED to open decoder for '" + m_url + "'!";
+                m_tasks.clear();
+                m_failed = true;
+            }
+        }
+        m_taskCv.notify_all();
+        return;
+    }
+
+    AVStream* stream = avfmtCtx->streams[m_streamIndex];
+    int64_t startTime = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    AVFrameToImMatConverter converter;
+    converter.SetUseVulkanConverter(false);
+    converter.SetOutSize(m_width, m_height);
+    converter.SetResizeInterpolateMode(IM_INTERPOLATE_BILINEAR);
+    AVPacket* avpkt = av_packet_alloc();
+    AVFrame* avfrm = av_frame_alloc();
+    while (true)
+    {
+        int64_t timestamp;
+        {
+            unique_lock<mutex> lk(m_taskLock);
+            m_taskCv.wait(lk, [this] { return m_quit || !m_tasks.empty(); });
+            if (m_quit)
+                break;
+            timestamp = m_tasks.front();
+            m_tasks.pop_front();
+            m_busy++;
+        }
+
+        int64_t seekPts = av_rescale_q(timestamp, MILLISEC_TIMEBASE, stream->time_base) + startTime;
+        av_seek_frame(avfmtCtx, m_streamIndex, seekPts, AVSEEK_FLAG_BACKWARD);
+        avcodec_flush_buffers(decCtx);
+        bool gotFrame = false, eof = false;
+        while (!gotFrame && !m_quit)
+        {
+            if (!eof)
+            {
+                fferr = av_read_frame(avfmtCtx, avpkt);
+                if (fferr < 0)
+                {
+                    eof = true;
+                    avcodec_send_packet(decCtx, nullptr);
+                }
+                else
+                {
+                    if (avpkt->stream_index == m_streamIndex && (avpkt->flags & AV_PKT_FLAG_KEY))
+                        avcodec_send_packet(decCtx, avpkt);
+                    av_packet_unref(avpkt);
+                }
+            }
+            fferr = avcodec_receive_frame(decCtx, avfrm);
+            if (fferr >= 0)
+                gotFrame = true;
+            else if (fferr != AVERROR(EAGAIN) || eof)
+                break;
+        }
+        if (gotFrame)
+        {
+            ImGui::ImMat vmat;
+            if (converter.ConvertImage(avfrm, vmat, (double)timestamp / 1000))
+            {
+                // the converter reuses its buffers, keep a copy of our own
+                ImGui::ImMat thumbnail = vmat.clone();
+                thumbnail.color_format = IM_CF_RGBA;
+                thumbnail.time_stamp = (double)timestamp / 1000;
+                AddThumbnail(timestamp, thumbnail);
+                SaveToCache(timestamp, thumbnail);
+            }
+            else
+                cerr << "ThumbnailExtractor FAILED to convert frame at " << timestamp << "ms! " << converter.GetError() << endl;
+            av_frame_unref(avfrm);
+        }
+        m_busy--;
+    }
+    av_frame_free(&avfrm);
+    av_packet_free(&avpkt);
+    avcodec_free_context(&decCtx);
+    avformat_close_input(&avfmtCtx);
+}
+
+void ThumbnailExtractor::AddThumbnail(int64_t timestamp, const ImGui::ImMat& thumbnail)
+{
+    lock_guard<mutex> lk(m_thumbLock);
+    m_thumbnails[timestamp] = thumbnail;
+}
+
+void ThumbnailExtractor::LoadCache()
+{
+    FILE* fp = fopen(m_cachePath.c_str(), "rb");
+    ThumbnailCacheHeader header;
+    bool valid = fp && fread(&header, 1, sizeof(header), fp) == sizeof(header) &&
+        header.magic == THUMBNAIL_CACHE_MAGIC && header.version == THUMBNAIL_CACHE_VERSION &&
+        header.width == m_width && header.height == m_height;
+    uintmax_t validEnd = sizeof(header);
+    if (valid)
+    {
+        const size_t size = (size_t)m_width * m_height * 4;
+        int64_t timestamp;
+        // a record cut short by an earlier crash ends the file
+        while (fread(&timestamp, sizeof(timestamp), 1, fp) == 1)
+        {
+            ImGui::ImMat thumbnail;
+            thumbnail.create_type(m_width, m_height, 4, IM_DT_INT8);
+            if (fread(thumbnail.data, 1, size, fp) != size)
+                break;
+            thumbnail.color_format = IM_CF_RGBA;
+            thumbnail.time_stamp = (double)timestamp / 1000;
+            AddThumbnail(timestamp, thumbnail);
+            validEnd += sizeof(timestamp) + size;
+        }
+    }
+    if (fp)
+        fclose(fp);
+    if (valid)
+    {
+        // cut the torn record off, records appended after it would be misaligned
+        error_code ec;
+        if (fs::file_size(m_cachePath, ec) != validEnd && !ec)
+        {
+            fs::resize_file(m_cachePath, validEnd, ec);
+            if (ec)
+                valid = false;
+        }
+    }
+    if (!valid)
+    {
+        // start a fresh cache file, new thumbnails are appended to it
+        ThumbnailCacheHeader newHeader;
+        newHeader.width = m_width;
+        newHeader.height = m_height;
+        fp = fopen(m_cachePath.c_str(), "wb");
+        if (!fp || fwrite(&newHeader, 1, sizeof(newHeader), fp) != sizeof(newHeader))
+            m_cachePath.clear();
+        if (fp)
+            fclose(fp);
+    }
+}
+
+void ThumbnailExtractor::SaveToCache(int64_t timestamp, const ImGui::ImMat& thumbnail)
+{
+    lock_guard<mutex> lk(m_cacheLock);
+    if (m_cachePath.empty())
+        return;
+    error_code ec;
+    uintmax_t recordStart = fs::file_size(m_cachePath, ec);
+    if (ec)
+        return;
+    FILE* fp = fopen(m_cachePath.c_str(), "ab");
+    if (!fp)
+        return;
+    const size_t size = (size_t)m_width * m_height * 4;
+    bool ok = fwrite(&timestamp, sizeof(timestamp), 1, fp) == 1 &&
+        fwrite(thumbnail.data, 1, size, fp) == size;
+    ok = fclose(fp) == 0 && ok;
+    if (!ok)
+    {
+        cerr << "ThumbnailExtractor FAILED to write cache file '" << m_cachePath << "'!" << endl;
+        // drop the partial record, or stop caching if the file can't be cut back
+        fs::resize_file(m_cachePath, recordStart, ec);
+        if (ec)
+            m_cachePath.clear();
+    }
+}
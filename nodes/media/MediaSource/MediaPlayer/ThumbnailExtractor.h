@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <immat.h>
+
+// Filmstrip thumbnails of one video file without a MediaPlayer. Workers each
+// run their own demuxer and keyframe-only decoder, seek to the keyframe at or
+// before every requested time and let swscale scale it straight to thumbnail
+// size. Results are RGBA8 CPU mats, cached in memory and in
+// '<temp>/<hash>_<w>x<h>.thumbs', keyed by file path, size, modification time
+// and requested time, so a reopened clip gets its filmstrip back from disk.
+class ThumbnailExtractor
+{
+public:
+    ThumbnailExtractor() = default;
+    ~ThumbnailExtractor();
+
+    ThumbnailExtractor(const ThumbnailExtractor&) = delete;
+    ThumbnailExtractor& operator=(const ThumbnailExtractor&) = delete;
+
+    // height 0 follows the video aspect ratio, workers 0 = hardware concurrency.
+    // Without diskCache nothing is read from or written to the cache file.
+    bool Open(const std::string& url, uint32_t width, uint32_t height = 0, uint32_t workers = 0, bool diskCache = true);
+    void Close();
+
+    // times in millisecond, already extracted ones are not queued again
+    void Request(const std::vector<int64_t>& timestamps);
+    // 'count' times spread evenly over the duration, returns them
+    std::vector<int64_t> RequestEvenly(uint32_t count);
+
+    bool Get(int64_t timestamp, ImGui::ImMat& thumbnail) const;
+    // also true once every worker failed to open the decoder, IsFailed() then
+    bool IsDone() const;
+    bool IsFailed() const { return m_failed; }
+    size_t Pending() const;
+
+    int64_t GetDuration() const { return m_duration; }
+    uint32_t GetWidth() const { return m_width; }
+    uint32_t GetHeight() const { return m_height; }
+    std::string GetError() const;
+
+private:
+    void WorkerThreadProc();
+    void AddThumbnail(int64_t timestamp, const ImGui::ImMat& thumbnail);
+    void LoadCache();
+    void SaveToCache(int64_t timestamp, const ImGui::ImMat& thumbnail);
+
+private:
+    std::string m_url;
+    std::string m_cachePath;
+    int m_streamIndex {-1};
+    int64_t m_duration {0};
+    uint32_t m_width {0};
+    uint32_t m_height {0};
+
+    std::vector<std::thread> m_workers;
+    std::deque<int64_t> m_tasks;
+    std::atomic<uint32_t> m_busy {0};
+    uint32_t m_alive {0};       // workers with a decoder, under m_taskLock
+    std::atomic_bool m_failed {false};
+    mutable std::mutex m_taskLock;
+    std::condition_variable m_taskCv;
+    std::atomic_bool m_quit {false};
+
+    std::map<int64_t, ImGui::ImMat> m_thumbnails;
+    mutable std::mutex m_thumbLock;
+    std::mutex m_cacheLock;
+    std::string m_errMsg;
+};